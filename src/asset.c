@@ -0,0 +1,131 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <string.h>
+
+#include "common.h"
+#include "asset.h"
+#include "channel.h"
+#include "window.h"
+#include "log.h"
+#include "profiler.h"
+
+static struct asset assets[ASSET_MAX];
+static int asset_count = 0;
+static int asset_pending[ASSET_GROUP_COUNT];
+static int asset_workers = 0;
+static bool asset_done = false;
+
+static struct channel asset_work_queue;	  // of struct asset*, NULL stops a worker
+static struct channel asset_result_queue; // of struct asset*
+
+static void* asset_worker(void* user) {
+	pthread_detach(pthread_self());
+	PROFILE_THREAD("asset worker");
+
+	while(1) {
+		struct asset* a;
+		channel_await(&asset_work_queue, &a);
+
+		if(!a)
+			break;
+
+		PROFILE_SCOPE("asset_decode");
+		a->decode(a);
+		channel_put(&asset_result_queue, &a);
+	}
+
+	return NULL;
+}
+
+void asset_init() {
+	channel_create(&asset_work_queue, sizeof(struct asset*), ASSET_MAX);
+	channel_create(&asset_result_queue, sizeof(struct asset*), ASSET_MAX);
+
+	asset_workers = min(max(window_cpucores() - 1, 1), ASSET_WORKERS_MAX);
+
+	for(int k = 0; k < asset_workers; k++) {
+		pthread_t thread;
+		pthread_create(&thread, NULL, asset_worker, NULL);
+	}
+
+	log_info("Loading assets on %i threads", asset_workers);
+}
+
+void asset_load(struct asset* a) {
+	if(asset_count >= ASSET_MAX) {
+		log_fatal("Too many assets, raise ASSET_MAX");
+		exit(1);
+	}
+
+	struct asset* copy = assets + asset_count++;
+	*copy = *a;
+	asset_pending[copy->group]++;
+	channel_put(&asset_work_queue, &copy);
+}
+
+static void asset_finish(struct asset* a) {
+	a->upload(a);
+	asset_pending[a->group]--;
+
+	for(int k = 0; k < ASSET_GROUP_COUNT; k++) {
+		if(asset_pending[k])
+			return;
+	}
+
+	// nothing left to decode, the workers can go
+	if(!asset_done) {
+		asset_done = true;
+		log_info("All %i assets ready after %.0fms", asset_count, window_time() * 1000.0F);
+
+		struct asset* stop = NULL;
+		for(int k = 0; k < asset_workers; k++)
+			channel_put(&asset_work_queue, &stop);
+	}
+}
+
+void asset_update() {
+	size_t drain = channel_size(&asset_result_queue);
+
+	for(size_t k = 0; k < drain; k++) {
+		struct asset* a;
+		channel_await(&asset_result_queue, &a);
+		asset_finish(a);
+	}
+}
+
+void asset_wait(enum asset_group group) {
+	double start = window_time();
+
+	while(asset_pending[group] > 0) {
+		struct asset* a;
+		channel_await(&asset_result_queue, &a);
+		asset_finish(a);
+	}
+
+	double waited = window_time() - start;
+	if(waited > 0.001)
+		log_info("Waited %.0fms for assets", waited * 1000.0);
+}
+
+bool asset_ready(enum asset_group group) {
+	return !asset_pending[group];
+}
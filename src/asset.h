@@ -0,0 +1,57 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ASSET_H
+#define ASSET_H
+
+#include <stdbool.h>
+
+#define ASSET_MAX 128
+#define ASSET_WORKERS_MAX 8
+
+enum asset_group {
+	ASSET_GROUP_MENU, // needed before the first frame
+	ASSET_GROUP_GAME, // needed once a game starts
+	ASSET_GROUP_COUNT,
+};
+
+// files are read and decoded on a pool of worker threads, only the upload to GL or OpenAL
+// happens on the main thread, whoever owns the target supplies both steps
+struct asset {
+	enum asset_group group;
+	char* filename;
+	void* target;
+	float param[2];					 // meaning is up to the owner
+	void (*decode)(struct asset* a); // worker thread, must not touch target
+	void (*upload)(struct asset* a); // main thread, frees data
+	void* data;
+	unsigned int info[3]; // e.g. dimensions of data
+};
+
+void asset_init(void);
+// queues a copy of a, decoding starts right away
+void asset_load(struct asset* a);
+// uploads everything decoded so far, call once per frame
+void asset_update(void);
+// blocks until every asset of the group is uploaded
+void asset_wait(enum asset_group group);
+bool asset_ready(enum asset_group group);
+
+#endif
@@ -0,0 +1,291 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "common.h"
+#include "glx.h"
+#include "batch.h"
+
+// how many runs a quad may skip to join one with the same state
+#define BATCH_LOOKBACK 16
+
+static struct glx_stream batch_stream;
+static bool batch_stream_created = false;
+
+void batch_create(struct batch* b, size_t capacity) {
+	b->capacity = max(capacity, 64);
+	b->vertices = malloc(b->capacity * 6 * sizeof(struct batch_vertex));
+	CHECK_ALLOCATION_ERROR(b->vertices)
+	b->sorted = malloc(b->capacity * 6 * sizeof(struct batch_vertex));
+	CHECK_ALLOCATION_ERROR(b->sorted)
+	b->quad_run = malloc(b->capacity * sizeof(size_t));
+	CHECK_ALLOCATION_ERROR(b->quad_run)
+
+	b->runs_capacity = 16;
+	b->runs = malloc(b->runs_capacity * sizeof(struct batch_run));
+	CHECK_ALLOCATION_ERROR(b->runs)
+
+	batch_clear(b);
+}
+
+void batch_destroy(struct batch* b) {
+	free(b->vertices);
+	free(b->sorted);
+	free(b->quad_run);
+	free(b->runs);
+	b->vertices = NULL;
+	b->sorted = NULL;
+	b->quad_run = NULL;
+	b->runs = NULL;
+}
+
+void batch_clear(struct batch* b) {
+	b->quads = 0;
+	b->runs_count = 0;
+	b->is_sorted = false;
+	b->texture = 0;
+	b->color = 0xFFFFFFFF;
+	b->key = 0;
+	batch_scissor_disable(b);
+}
+
+bool batch_retained(struct batch* b, uint64_t key) {
+	if(key && key == b->key)
+		return true;
+
+	batch_clear(b);
+	b->key = key;
+	return false;
+}
+
+uint64_t batch_hash(uint64_t hash, const void* data, size_t length) {
+	const uint8_t* bytes = data;
+
+	for(size_t k = 0; k < length; k++)
+		hash = (hash ^ bytes[k]) * 1099511628211ULL;
+
+	return hash;
+}
+
+void batch_texture(struct batch* b, uint32_t texture) {
+	b->texture = texture;
+}
+
+void batch_scissor(struct batch* b, int x, int y, int w, int h) {
+	b->scissor[0] = x;
+	b->scissor[1] = y;
+	b->scissor[2] = max(w, 0);
+	b->scissor[3] = max(h, 0);
+}
+
+void batch_scissor_disable(struct batch* b) {
+	b->scissor[0] = b->scissor[1] = 0;
+	b->scissor[2] = b->scissor[3] = -1;
+}
+
+void batch_color(struct batch* b, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha) {
+	b->color = rgba(red, green, blue, alpha);
+}
+
+static bool batch_overlaps(const float* a, const float* b) {
+	return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+static struct batch_run* batch_run_find(struct batch* b, const float* bounds) {
+	size_t stop = (b->runs_count > BATCH_LOOKBACK) ? b->runs_count - BATCH_LOOKBACK : 0;
+
+	for(size_t k = b->runs_count; k > stop; k--) {
+		struct batch_run* r = b->runs + k - 1;
+
+		if(r->texture == b->texture && !memcmp(r->scissor, b->scissor, sizeof(r->scissor)))
+			return r;
+
+		// the quad must stay on top of this one
+		if(batch_overlaps(r->bounds, bounds))
+			break;
+	}
+
+	if(b->runs_count >= b->runs_capacity) {
+		b->runs_capacity *= 2;
+		b->runs = realloc(b->runs, b->runs_capacity * sizeof(struct batch_run));
+		CHECK_ALLOCATION_ERROR(b->runs)
+	}
+
+	struct batch_run* r = b->runs + b->runs_count++;
+	r->texture = b->texture;
+	memcpy(r->scissor, b->scissor, sizeof(r->scissor));
+	memcpy(r->bounds, bounds, sizeof(r->bounds));
+	r->count = 0;
+	return r;
+}
+
+// corners in order top left, bottom left, bottom right, top right
+static void batch_push(struct batch* b, const float* xy, float u, float v, float us, float vs) {
+	if(b->quads >= b->capacity) {
+		b->capacity *= 2;
+		b->vertices = realloc(b->vertices, b->capacity * 6 * sizeof(struct batch_vertex));
+		CHECK_ALLOCATION_ERROR(b->vertices)
+		b->sorted = realloc(b->sorted, b->capacity * 6 * sizeof(struct batch_vertex));
+		CHECK_ALLOCATION_ERROR(b->sorted)
+		b->quad_run = realloc(b->quad_run, b->capacity * sizeof(size_t));
+		CHECK_ALLOCATION_ERROR(b->quad_run)
+	}
+
+	float bounds[4] = {xy[0], xy[1], xy[0], xy[1]};
+	for(int k = 1; k < 4; k++) {
+		bounds[0] = fmin(bounds[0], xy[k * 2 + 0]);
+		bounds[1] = fmin(bounds[1], xy[k * 2 + 1]);
+		bounds[2] = fmax(bounds[2], xy[k * 2 + 0]);
+		bounds[3] = fmax(bounds[3], xy[k * 2 + 1]);
+	}
+
+	struct batch_run* r = batch_run_find(b, bounds);
+	r->bounds[0] = fmin(r->bounds[0], bounds[0]);
+	r->bounds[1] = fmin(r->bounds[1], bounds[1]);
+	r->bounds[2] = fmax(r->bounds[2], bounds[2]);
+	r->bounds[3] = fmax(r->bounds[3], bounds[3]);
+	r->count++;
+
+	float uv[8] = {u, v, u, v + vs, u + us, v + vs, u + us, v};
+	struct batch_vertex* out = b->vertices + b->quads * 6;
+
+	for(int k = 0; k < 6; k++) {
+		int corner = (int[]) {0, 1, 2, 0, 2, 3}[k];
+		out[k] = (struct batch_vertex) {
+			.x = xy[corner * 2 + 0],
+			.y = xy[corner * 2 + 1],
+			.u = uv[corner * 2 + 0],
+			.v = uv[corner * 2 + 1],
+			.color = b->color,
+		};
+	}
+
+	b->quad_run[b->quads++] = r - b->runs;
+	b->is_sorted = false;
+}
+
+void batch_rect(struct batch* b, float x, float y, float w, float h, float u, float v, float us, float vs) {
+	batch_push(b, (float[]) {x, y, x, y - h, x + w, y - h, x + w, y}, u, v, us, vs);
+}
+
+#define batch_rotate(tx, ty, x, y, a) cos(a) * (x)-sin(a) * (y) + (tx), sin(a) * (x) + cos(a) * (y) + (ty)
+
+void batch_rect_rotated(struct batch* b, float x, float y, float w, float h, float angle, float u, float v, float us,
+						float vs) {
+	batch_push(b,
+			   (float[]) {batch_rotate(x, y, -w / 2, h / 2, angle), batch_rotate(x, y, -w / 2, -h / 2, angle),
+						  batch_rotate(x, y, w / 2, -h / 2, angle), batch_rotate(x, y, w / 2, h / 2, angle)},
+			   u, v, us, vs);
+}
+
+// stable counting sort of the quads by run
+static void batch_sort(struct batch* b) {
+	size_t first = 0;
+	for(size_t k = 0; k < b->runs_count; k++) {
+		b->runs[k].first = first;
+		first += b->runs[k].count;
+	}
+
+	for(size_t k = 0; k < b->runs_count; k++)
+		b->runs[k].count = 0;
+
+	for(size_t k = 0; k < b->quads; k++) {
+		struct batch_run* r = b->runs + b->quad_run[k];
+		memcpy(b->sorted + (r->first + r->count++) * 6, b->vertices + k * 6, 6 * sizeof(struct batch_vertex));
+	}
+
+	b->is_sorted = true;
+}
+
+void batch_draw(struct batch* b) {
+	if(!b->quads)
+		return;
+
+	if(!b->is_sorted)
+		batch_sort(b);
+
+	if(!batch_stream_created) {
+		glx_stream_create(&batch_stream, GLX_STREAM_REGIONS * b->capacity * 6 * sizeof(struct batch_vertex));
+		batch_stream_created = true;
+	}
+
+	size_t offset = glx_stream_upload(&batch_stream, b->sorted, b->quads * 6 * sizeof(struct batch_vertex));
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(struct batch_vertex), (const void*)(offset + offsetof(struct batch_vertex, x)));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(struct batch_vertex),
+					  (const void*)(offset + offsetof(struct batch_vertex, u)));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(struct batch_vertex),
+				   (const void*)(offset + offsetof(struct batch_vertex, color)));
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	uint32_t texture = 0;
+	bool clipped = false;
+
+	for(size_t k = 0; k < b->runs_count; k++) {
+		struct batch_run* r = b->runs + k;
+
+		if(r->texture != texture) {
+			if(!texture)
+				glEnable(GL_TEXTURE_2D);
+			if(!r->texture)
+				glDisable(GL_TEXTURE_2D);
+			glBindTexture(GL_TEXTURE_2D, r->texture);
+			texture = r->texture;
+		}
+
+		if(r->scissor[2] >= 0) {
+			if(!clipped)
+				glEnable(GL_SCISSOR_TEST);
+			glScissor(r->scissor[0], r->scissor[1], r->scissor[2], r->scissor[3]);
+			clipped = true;
+		} else if(clipped) {
+			glDisable(GL_SCISSOR_TEST);
+			clipped = false;
+		}
+
+		glDrawArrays(GL_TRIANGLES, r->first * 6, r->count * 6);
+	}
+
+	if(clipped)
+		glDisable(GL_SCISSOR_TEST);
+
+	if(texture) {
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDisable(GL_TEXTURE_2D);
+	}
+
+	glDisable(GL_BLEND);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	// the color array leaves the current color undefined
+	glColor3f(1.0F, 1.0F, 1.0F);
+}
@@ -0,0 +1,86 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define BATCH_HASH_START 14695981039346656037ULL
+
+struct batch_vertex {
+	float x, y;
+	float u, v;
+	uint32_t color;
+};
+
+// quads sharing texture and clip rectangle, drawn with a single call
+struct batch_run {
+	uint32_t texture;
+	int scissor[4]; // scissor[2] < 0 if not clipped
+	float bounds[4];
+	size_t first;
+	size_t count;
+};
+
+// 2D quads in window coordinates (y up) collected over a frame, drawn in as few calls as possible
+// a quad is moved back to an earlier run with the same state as long as it does not overlap
+// anything submitted in between, so the result looks the same as drawing in submission order
+struct batch {
+	struct batch_vertex* vertices;
+	struct batch_vertex* sorted;
+	size_t* quad_run;
+	size_t quads;
+	size_t capacity;
+	struct batch_run* runs;
+	size_t runs_count;
+	size_t runs_capacity;
+	bool is_sorted;
+	uint32_t texture;
+	int scissor[4];
+	uint32_t color;
+	uint64_t key;
+};
+
+void batch_create(struct batch* b, size_t capacity);
+void batch_destroy(struct batch* b);
+void batch_clear(struct batch* b);
+// true if the batch still holds what was built for key, otherwise it is cleared and remembers key
+bool batch_retained(struct batch* b, uint64_t key);
+// FNV-1a, start with BATCH_HASH_START
+uint64_t batch_hash(uint64_t hash, const void* data, size_t length);
+
+// state for following quads, texture 0 draws untextured
+void batch_texture(struct batch* b, uint32_t texture);
+void batch_scissor(struct batch* b, int x, int y, int w, int h);
+void batch_scissor_disable(struct batch* b);
+void batch_color(struct batch* b, uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
+
+// same placement as texture_draw_sector(), (x, y) is the top left corner
+void batch_rect(struct batch* b, float x, float y, float w, float h, float u, float v, float us, float vs);
+// same placement as texture_draw_rotated(), (x, y) is the center
+void batch_rect_rotated(struct batch* b, float x, float y, float w, float h, float angle, float u, float v, float us,
+						float vs);
+
+// blends everything on top of the current framebuffer, the batch stays intact for another draw
+void batch_draw(struct batch* b);
+
+#endif
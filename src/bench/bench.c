@@ -0,0 +1,111 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include <libvxl.h>
+
+#include "bench.h"
+
+double bench_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+void bench_consume(const void* data) {
+	__asm__ __volatile__("" : : "g"(data) : "memory");
+}
+
+static void bench_generate_hills(struct occupancy* occ) {
+	for(int z = 0; z < occ->depth; z++) {
+		for(int x = 0; x < occ->width; x++) {
+			int height = 20 + (int)(sinf(x * 0.05F) * 8.0F + cosf(z * 0.07F) * 8.0F);
+
+			// some pillars and overhangs to hit during raycasts
+			if((x % 37) < 3 && (z % 41) < 3)
+				height = occ->height - 8;
+
+			uint64_t column = (height >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << height) - 1);
+
+			if((x % 53) < 10 && (z % 47) < 10)
+				column |= (uint64_t)0x3F << 40;
+
+			occupancy_set_column(occ, x, z, column);
+		}
+	}
+
+	occupancy_update_tiles(occ);
+}
+
+bool bench_load_map(struct occupancy* occ, const char* filename) {
+	if(!filename) {
+		bench_generate_hills(occ);
+		return true;
+	}
+
+	FILE* f = fopen(filename, "rb");
+
+	if(!f) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	void* data = malloc(size);
+
+	if(!data || fread(data, 1, size, f) != (size_t)size) {
+		fclose(f);
+		free(data);
+		return false;
+	}
+
+	fclose(f);
+
+	struct libvxl_map map;
+	bool ok = libvxl_create(&map, occ->width, occ->depth, occ->height, data, size);
+	free(data);
+
+	if(!ok)
+		return false;
+
+	for(int z = 0; z < occ->depth; z++) {
+		for(int x = 0; x < occ->width; x++) {
+			uint64_t column = 0;
+
+			for(int y = 0; y < occ->height; y++) {
+				if(libvxl_map_issolid(&map, x, z, occ->height - 1 - y))
+					column |= (uint64_t)1 << y;
+			}
+
+			occupancy_set_column(occ, x, z, column);
+		}
+	}
+
+	libvxl_free(&map);
+	occupancy_update_tiles(occ);
+
+	return true;
+}
@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+#include "../occupancy.h"
+
+// monotonic wall clock in seconds
+double bench_time(void);
+
+// fills the occupancy grid from a .vxl file, or with generated hills if filename is NULL
+bool bench_load_map(struct occupancy* occ, const char* filename);
+
+// prevents the compiler from discarding benchmarked work
+void bench_consume(const void* data);
+
+#endif
@@ -0,0 +1,167 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../broadphase.h"
+#include "../utils.h"
+#include "bench.h"
+
+#define PLAYERS_MAX 256
+#define HIT_RADIUS 2.5F
+#define SLACK 1.0F
+#define RANGE 128.0F
+
+struct bench_player {
+	float x, y, z;
+	AABB bounds;
+};
+
+static bool bench_slab(const AABB* b, const Ray* r) {
+	float tmin = 0.0F;
+	float tmax = INFINITY;
+
+	for(int k = 0; k < 3; k++) {
+		float inv = 1.0F / r->direction.coords[k];
+		float t1 = (b->min[k] - r->origin.coords[k]) * inv;
+		float t2 = (b->max[k] - r->origin.coords[k]) * inv;
+		tmin = fmaxf(tmin, fminf(t1, t2));
+		tmax = fminf(tmax, fmaxf(t1, t2));
+	}
+
+	return tmin <= tmax;
+}
+
+// the old loop: every player in range goes to the narrow phase
+static int bench_brute(struct bench_player* players, int count, const Ray* r, int* candidates) {
+	int n = 0;
+
+	for(int k = 0; k < count; k++) {
+		float dx = players[k].x - r->origin.x;
+		float dz = players[k].z - r->origin.z;
+		if(dx * dx + dz * dz < RANGE * RANGE)
+			candidates[n++] = k;
+	}
+
+	return n;
+}
+
+static void bench_run(int count, int rays, struct occupancy* occ) {
+	struct rng rng;
+	rng_seed(&rng, count);
+
+	struct bench_player players[PLAYERS_MAX];
+	struct broadphase bp;
+	broadphase_create(&bp, 512, 512, PLAYERS_MAX);
+
+	// a fight around the middle of the map
+	for(int k = 0; k < count; k++) {
+		float x = 128.0F + rng_float(&rng) * 256.0F;
+		float z = 128.0F + rng_float(&rng) * 256.0F;
+		uint64_t column = occupancy_column(occ, x, z);
+		float y = column ? (64 - __builtin_clzll(column)) + 1.5F : 1.5F;
+
+		players[k] = (struct bench_player) {
+			.x = x,
+			.y = y,
+			.z = z,
+			.bounds.min = {x - HIT_RADIUS - SLACK, y - HIT_RADIUS - SLACK, z - HIT_RADIUS - SLACK},
+			.bounds.max = {x + HIT_RADIUS + SLACK, y + HIT_RADIUS + SLACK, z + HIT_RADIUS + SLACK},
+		};
+	}
+
+	Ray* ray_list = malloc(rays * sizeof(Ray));
+
+	for(int k = 0; k < rays; k++) {
+		struct bench_player* p = players + (rng_next(&rng) % count);
+		float yaw = rng_float(&rng) * 6.2831853F;
+		float pitch = (rng_float(&rng) - 0.5F) * 0.6F;
+		ray_list[k] = (Ray) {
+			.origin.coords = {p->x, p->y, p->z},
+			.direction.coords = {cosf(yaw) * cosf(pitch), sinf(pitch), sinf(yaw) * cosf(pitch)},
+		};
+	}
+
+	int candidates[PLAYERS_MAX];
+	int expected[PLAYERS_MAX];
+
+	double start = bench_time();
+	for(int k = 0; k < count; k++)
+		broadphase_insert(&bp, k, &players[k].bounds);
+	double build = bench_time() - start;
+
+	// every player the old loop would have hit must also be a grid candidate
+	long mismatches = 0;
+	for(int k = 0; k < rays; k++) {
+		int n = broadphase_ray(&bp, ray_list + k, RANGE + HIT_RADIUS + SLACK, candidates);
+		int m = bench_brute(players, count, ray_list + k, expected);
+
+		for(int i = 0, j = 0; i < m; i++) {
+			if(!bench_slab(&players[expected[i]].bounds, ray_list + k))
+				continue;
+			while(j < n && candidates[j] < expected[i])
+				j++;
+			if(j >= n || candidates[j] != expected[i])
+				mismatches++;
+		}
+	}
+
+	long brute_calls = 0;
+	start = bench_time();
+	for(int k = 0; k < rays; k++)
+		brute_calls += bench_brute(players, count, ray_list + k, candidates);
+	double brute = bench_time() - start;
+
+	long grid_calls = 0;
+	start = bench_time();
+	for(int k = 0; k < rays; k++)
+		grid_calls += broadphase_ray(&bp, ray_list + k, RANGE + HIT_RADIUS + SLACK, candidates);
+	double grid = bench_time() - start;
+
+	bench_consume(candidates);
+
+	printf("%8i %12.2f %12.1f %12.1f %12.1f %12.2f %10ld\n", count, build * 1e6, brute / rays * 1e9,
+		   grid / rays * 1e9, (double)brute_calls / rays, (double)grid_calls / rays, mismatches);
+
+	free(ray_list);
+	broadphase_destroy(&bp);
+}
+
+// usage: bench_hits [rays] [map.vxl]
+int main(int argc, char** argv) {
+	int rays = (argc > 1) ? atoi(argv[1]) : 100000;
+
+	struct occupancy occ;
+	occupancy_create(&occ, 512, 512, 64);
+
+	if(!bench_load_map(&occ, (argc > 2) ? argv[2] : NULL))
+		return 1;
+
+	printf("%8s %12s %12s %12s %12s %12s %10s\n", "players", "build [us]", "loop [ns]", "grid [ns]", "narrow/loop",
+		   "narrow/grid", "missed");
+
+	for(int count = 32; count <= PLAYERS_MAX; count *= 2)
+		bench_run(count, rays, &occ);
+
+	occupancy_destroy(&occ);
+
+	return 0;
+}
@@ -0,0 +1,415 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "../kv6mesh.h"
+#include "../utils.h"
+#include "bench.h"
+
+// meshes every kv6 in a directory with the old bsearch based mesher and with kv6mesh, checks that
+// both produce the same quads and compares against reading them back from the mesh cache
+//
+// usage: bench_kv6mesh [kv6 directory] [rounds]
+// without models (e.g. before the resources are extracted) a few generated ones are used
+
+#define MODELS_MAX 64
+
+struct bench_model {
+	char name[64];
+	int xsiz, ysiz, zsiz;
+	struct kv6_voxel* voxels;
+	int voxel_count;
+};
+
+static uint32_t bench_read32(const uint8_t* data, size_t index) {
+	return data[index] | (data[index + 1] << 8) | (data[index + 2] << 16) | ((uint32_t)data[index + 3] << 24);
+}
+
+// like kv6_load()
+static bool bench_load_kv6(struct bench_model* m, const char* filename) {
+	FILE* f = fopen(filename, "rb");
+	if(!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	size_t size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	uint8_t* data = malloc(size);
+	bool ok = data && fread(data, 1, size, f) == size && size >= 32 && bench_read32(data, 0) == 0x6C78764B;
+	fclose(f);
+
+	if(ok) {
+		m->xsiz = bench_read32(data, 4);
+		m->ysiz = bench_read32(data, 8);
+		m->zsiz = bench_read32(data, 12);
+		m->voxel_count = bench_read32(data, 28);
+		ok = 32 + m->voxel_count * 8 + m->xsiz * 4 + m->xsiz * m->ysiz * 2 <= size;
+	}
+
+	if(!ok) {
+		free(data);
+		return false;
+	}
+
+	m->voxels = malloc(m->voxel_count * sizeof(struct kv6_voxel));
+
+	for(int k = 0; k < m->voxel_count; k++) {
+		const uint8_t* v = data + 32 + k * 8;
+		m->voxels[k] = (struct kv6_voxel) {
+			.color = (bench_read32(v, 0) & 0xFFFFFF) | (v[7] << 24),
+			.z = (m->zsiz - 1) - (v[4] | (v[5] << 8)),
+			.visfaces = v[6],
+		};
+	}
+
+	size_t index = 32 + m->voxel_count * 8 + m->xsiz * 4;
+	struct kv6_voxel* voxel = m->voxels;
+
+	for(int x = 0; x < m->xsiz; x++) {
+		for(int y = 0; y < m->ysiz; y++, index += 2) {
+			int length = data[index] | (data[index + 1] << 8);
+
+			for(int z = 0; z < length && voxel < m->voxels + m->voxel_count; z++, voxel++) {
+				voxel->x = x;
+				voxel->y = y;
+			}
+		}
+	}
+
+	free(data);
+	return true;
+}
+
+// surface of a few overlapping spheres with a handful of colors, voxels in kv6 order
+static void bench_generate(struct bench_model* m, struct rng* rng, int size) {
+	m->xsiz = m->ysiz = size;
+	m->zsiz = size * 2;
+	m->voxel_count = 0;
+	m->voxels = malloc((size_t)m->xsiz * m->ysiz * m->zsiz * sizeof(struct kv6_voxel));
+	sprintf(m->name, "generated %ix%ix%i", m->xsiz, m->ysiz, m->zsiz);
+
+	float spheres[4][4];
+	for(int k = 0; k < 4; k++) {
+		spheres[k][0] = size * (0.3F + rng_float(rng) * 0.4F);
+		spheres[k][1] = size * (0.3F + rng_float(rng) * 0.4F);
+		spheres[k][2] = size * (0.4F + rng_float(rng) * 1.2F);
+		spheres[k][3] = size * (0.2F + rng_float(rng) * 0.2F);
+	}
+
+	uint8_t* solid = calloc((size_t)m->xsiz * m->ysiz * m->zsiz, 1);
+	uint32_t palette[4] = {0x404040, 0x000000, 0x8A6B3C, 0x404040 | (1 << 24)};
+
+#define SOLID(x, y, z)                                                                                                 \
+	((x) >= 0 && (y) >= 0 && (z) >= 0 && (x) < m->xsiz && (y) < m->ysiz && (z) < m->zsiz                              \
+	 && solid[(x) + ((y) + (z) * m->ysiz) * m->xsiz])
+
+	for(int z = 0; z < m->zsiz; z++)
+		for(int y = 0; y < m->ysiz; y++)
+			for(int x = 0; x < m->xsiz; x++)
+				for(int k = 0; k < 4; k++) {
+					float dx = x - spheres[k][0], dy = y - spheres[k][1], dz = z - spheres[k][2];
+					if(dx * dx + dy * dy + dz * dz < spheres[k][3] * spheres[k][3])
+						solid[x + (y + z * m->ysiz) * m->xsiz] = 1;
+				}
+
+	for(int x = 0; x < m->xsiz; x++) {
+		for(int y = 0; y < m->ysiz; y++) {
+			for(int z = m->zsiz - 1; z >= 0; z--) {
+				if(!SOLID(x, y, z))
+					continue;
+
+				uint8_t vis = (!SOLID(x - 1, y, z) ? KV6_VIS_NEG_X : 0) | (!SOLID(x + 1, y, z) ? KV6_VIS_POS_X : 0)
+					| (!SOLID(x, y - 1, z) ? KV6_VIS_NEG_Z : 0) | (!SOLID(x, y + 1, z) ? KV6_VIS_POS_Z : 0)
+					| (!SOLID(x, y, z + 1) ? KV6_VIS_POS_Y : 0) | (!SOLID(x, y, z - 1) ? KV6_VIS_NEG_Y : 0);
+
+				if(vis)
+					m->voxels[m->voxel_count++] = (struct kv6_voxel) {
+						.x = x,
+						.y = y,
+						.z = z,
+						.visfaces = vis,
+						.color = palette[(z / 6 + x / 9) % 4],
+					};
+			}
+		}
+	}
+
+#undef SOLID
+	free(solid);
+}
+
+static int bench_voxel_cmp(const void* a, const void* b) {
+	const struct kv6_voxel* A = a;
+	const struct kv6_voxel* B = b;
+
+	if(A->x == B->x) {
+		if(A->y == B->y) {
+			return B->z - A->z;
+		} else {
+			return A->y - B->y;
+		}
+	} else {
+		return A->x - B->x;
+	}
+}
+
+// the mesher as it was in model.c, minus the settings lookup
+static void bench_greedy_mesh(struct bench_model* kv6, struct kv6_voxel* voxel, uint8_t* marked, size_t* max_a,
+							  size_t* max_b, uint8_t face) {
+	switch(face) {
+		case KV6_VIS_POS_X:
+		case KV6_VIS_NEG_X:
+			*max_a = kv6->ysiz;
+			*max_b = kv6->zsiz;
+			break;
+		case KV6_VIS_POS_Y:
+		case KV6_VIS_NEG_Y:
+			*max_a = kv6->xsiz;
+			*max_b = kv6->ysiz;
+			break;
+		case KV6_VIS_POS_Z:
+		case KV6_VIS_NEG_Z:
+			*max_a = kv6->xsiz;
+			*max_b = kv6->zsiz;
+			break;
+	}
+
+	struct kv6_voxel lookup = *voxel;
+
+	for(size_t a = 0; a < *max_a; a++) {
+		struct kv6_voxel* recent[*max_b];
+		size_t b;
+		for(b = 0; b < *max_b; b++) {
+			switch(face) {
+				case KV6_VIS_POS_X:
+				case KV6_VIS_NEG_X:
+					lookup.y = voxel->y + b;
+					lookup.z = voxel->z - a;
+					break;
+				case KV6_VIS_POS_Y:
+				case KV6_VIS_NEG_Y:
+					lookup.x = voxel->x + a;
+					lookup.y = voxel->y + b;
+					break;
+				case KV6_VIS_POS_Z:
+				case KV6_VIS_NEG_Z:
+					lookup.x = voxel->x + a;
+					lookup.z = voxel->z - b;
+					break;
+			}
+
+			struct kv6_voxel* neighbour
+				= bsearch(&lookup, kv6->voxels, kv6->voxel_count, sizeof(struct kv6_voxel), bench_voxel_cmp);
+
+			if(!neighbour || !(neighbour->visfaces & face)
+			   || (neighbour->color & 0xFFFFFF) != (voxel->color & 0xFFFFFF) || marked[neighbour - kv6->voxels] & face) {
+				break;
+			} else {
+				marked[neighbour - kv6->voxels] |= face;
+				recent[b] = neighbour;
+			}
+		}
+
+		if(a == 0)
+			*max_b = b;
+
+		if(b < *max_b) { // early abort
+			*max_a = a;
+
+			for(size_t k = 0; k < b; k++)
+				marked[recent[k] - kv6->voxels] &= ~face;
+
+			break;
+		}
+	}
+}
+
+static void bench_old_add(struct kv6_mesh* mesh, struct kv6_voxel* v, uint8_t face, int x, int y, int z, int sx,
+						  int sy, int sz) {
+	if(sx > 0 && sy > 0 && sz > 0) // the old mesher also emitted empty quads
+		mesh->quads[mesh->count++] = (struct kv6_quad) {x, y, z, sx, sy, sz, v->color, face};
+}
+
+static void bench_old_mesher(struct bench_model* kv6, struct kv6_mesh* mesh) {
+	uint8_t marked[kv6->voxel_count];
+	memset(marked, 0, sizeof(uint8_t) * kv6->voxel_count);
+
+	mesh->count = 0;
+
+	struct kv6_voxel* voxel = kv6->voxels;
+	for(int k = 0; k < kv6->voxel_count; k++, voxel++) {
+		size_t a, b;
+
+		if(voxel->visfaces & KV6_VIS_POS_Y) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_POS_Y);
+			bench_old_add(mesh, voxel, KV6_VIS_POS_Y, voxel->x, voxel->z, voxel->y, a, 1, b);
+		}
+
+		if(voxel->visfaces & KV6_VIS_NEG_Y) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_NEG_Y);
+			bench_old_add(mesh, voxel, KV6_VIS_NEG_Y, voxel->x, voxel->z, voxel->y, a, 1, b);
+		}
+
+		if(voxel->visfaces & KV6_VIS_NEG_Z) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_NEG_Z);
+			bench_old_add(mesh, voxel, KV6_VIS_NEG_Z, voxel->x, voxel->z - (b - 1), voxel->y, a, b, 1);
+		}
+
+		if(voxel->visfaces & KV6_VIS_POS_Z) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_POS_Z);
+			bench_old_add(mesh, voxel, KV6_VIS_POS_Z, voxel->x, voxel->z - (b - 1), voxel->y, a, b, 1);
+		}
+
+		if(voxel->visfaces & KV6_VIS_NEG_X) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_NEG_X);
+			bench_old_add(mesh, voxel, KV6_VIS_NEG_X, voxel->x, voxel->z - (a - 1), voxel->y, 1, a, b);
+		}
+
+		if(voxel->visfaces & KV6_VIS_POS_X) {
+			bench_greedy_mesh(kv6, voxel, marked, &a, &b, KV6_VIS_POS_X);
+			bench_old_add(mesh, voxel, KV6_VIS_POS_X, voxel->x, voxel->z - (a - 1), voxel->y, 1, a, b);
+		}
+	}
+}
+
+static bool bench_same(const struct kv6_mesh* a, const struct kv6_mesh* b) {
+	if(a->count != b->count)
+		return false;
+
+	for(int k = 0; k < a->count; k++) {
+		const struct kv6_quad* p = a->quads + k;
+		const struct kv6_quad* q = b->quads + k;
+
+		if(p->x != q->x || p->y != q->y || p->z != q->z || p->sx != q->sx || p->sy != q->sy || p->sz != q->sz
+		   || p->color != q->color || p->face != q->face)
+			return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* path = (argc > 1) ? argv[1] : "kv6";
+	int rounds = (argc > 2) ? atoi(argv[2]) : 20;
+
+	static struct bench_model models[MODELS_MAX];
+	int count = 0;
+
+	DIR* d = opendir(path);
+	struct dirent* ent;
+
+	while(d && (ent = readdir(d)) && count < MODELS_MAX) {
+		size_t length = strlen(ent->d_name);
+		if(length < 4 || length >= sizeof(models[0].name) || strcmp(ent->d_name + length - 4, ".kv6"))
+			continue;
+
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s/%s", path, ent->d_name);
+
+		if(bench_load_kv6(models + count, filename)) {
+			strcpy(models[count].name, ent->d_name);
+			count++;
+		}
+	}
+
+	if(d)
+		closedir(d);
+
+	if(!count) {
+		printf("no models in %s, using generated ones\n", path);
+
+		struct rng rng;
+		rng_seed(&rng, 1);
+
+		for(int size = 8; size <= 48; size += 8)
+			bench_generate(models + count++, &rng, size);
+	}
+
+	printf("%-24s %8s %8s %10s %10s %10s %6s\n", "model", "voxels", "quads", "old [us]", "new [us]", "cache [us]",
+		   "same");
+
+	double total_old = 0.0, total_new = 0.0, total_cache = 0.0;
+	int mismatches = 0;
+
+	for(int k = 0; k < count; k++) {
+		struct bench_model* m = models + k;
+
+		// each surface voxel contributes at most six quads
+		struct kv6_mesh old = {
+			.quads = malloc((m->voxel_count * 6 + 1) * sizeof(struct kv6_quad)),
+			.greedy = true,
+		};
+		struct kv6_mesh new = {0};
+
+		double start = bench_time();
+		for(int r = 0; r < rounds; r++) {
+			bench_old_mesher(m, &old);
+			bench_consume(old.quads);
+		}
+		double time_old = (bench_time() - start) / rounds;
+
+		start = bench_time();
+		for(int r = 0; r < rounds; r++) {
+			kv6mesh_destroy(&new);
+			kv6mesh_build(&new, m->voxels, m->voxel_count, m->xsiz, m->ysiz, m->zsiz, true);
+			bench_consume(new.quads);
+		}
+		double time_new = (bench_time() - start) / rounds;
+
+		uint32_t key = kv6mesh_key(m->voxels, m->voxel_count, m->xsiz, m->ysiz, m->zsiz, true);
+		char filename[64];
+		sprintf(filename, "bench_%08X.kv6m", key);
+		kv6mesh_save(&new, filename, key);
+
+		struct kv6_mesh cached = {0};
+		start = bench_time();
+		for(int r = 0; r < rounds; r++) {
+			kv6mesh_destroy(&cached);
+			kv6mesh_load(&cached, filename, key);
+			bench_consume(cached.quads);
+		}
+		double time_cache = (bench_time() - start) / rounds;
+		remove(filename);
+
+		bool same = bench_same(&old, &new) && bench_same(&new, &cached);
+		mismatches += !same;
+
+		printf("%-24s %8i %8i %10.1f %10.1f %10.1f %6s\n", m->name, m->voxel_count, new.count, time_old * 1e6,
+			   time_new * 1e6, time_cache * 1e6, same ? "yes" : "NO");
+
+		total_old += time_old;
+		total_new += time_new;
+		total_cache += time_cache;
+
+		free(old.quads);
+		kv6mesh_destroy(&new);
+		kv6mesh_destroy(&cached);
+	}
+
+	printf("total: old %.2fms, new %.2fms (%.1fx), cache %.2fms, %i mismatches\n", total_old * 1e3, total_new * 1e3,
+		   total_old / total_new, total_cache * 1e3, mismatches);
+
+	return mismatches > 0;
+}
@@ -0,0 +1,712 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <enet/enet.h>
+#include <libdeflate.h>
+
+#include "../sim.h"
+#include "../network.h"
+#include "bench.h"
+
+// stand-in server for load testing the client: serves a map from disk and lets bots move, shoot,
+// build, throw grenades, kill each other and chat at configurable rates
+//
+// usage: loadserver <map.vxl> [--port <n>] [--bots <n>] [--world-rate <hz>] [--blocks <per second>]
+//                   [--lines <per second>] [--grenades <per second>] [--kills <per second>]
+//                   [--chat <per second>] [--no-shoot]
+// then connect with: client -aos://16777343:<port>
+
+#define LOADSERVER_CLIENTS 8 // real clients get the highest player ids
+#define LOADSERVER_CHUNK 8192
+#define LOADSERVER_GRENADES 64
+#define LOADSERVER_RESPAWN 3
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+struct loadserver_config {
+	const char* map;
+	int port;
+	int bots;
+	float world_rate;
+	float blocks, lines, grenades, kills, chat;
+	bool shoot;
+};
+
+struct loadserver_client {
+	ENetPeer* peer;
+	int id;
+	bool ready;	 // got the map and the game state
+	bool joined; // has spawned as a player
+	// last state the client sent, broadcast instead of what the sim made of it
+	float pos[3], orientation[3];
+};
+
+struct loadserver_grenade {
+	bool active;
+	int player_id;
+	float explode;
+	int x, y, z;
+};
+
+struct loadserver {
+	struct loadserver_config config;
+	ENetHost* host;
+	struct loadserver_client clients[LOADSERVER_CLIENTS];
+	struct sim_world* world;
+	void* map;
+	size_t map_size;
+	unsigned char keys[SIM_PLAYERS];
+	bool firing[SIM_PLAYERS];
+	float respawn[SIM_PLAYERS];
+	struct loadserver_grenade grenades[LOADSERVER_GRENADES];
+	float world_update;
+	unsigned long packets, bytes; // sent since the last report
+};
+
+static const char* loadserver_chat[] = {
+	"gg",
+	"who is building on our base",
+	"anyone got blocks?",
+	"lag",
+	"nice shot",
+	"push mid!",
+	"intel is moving",
+	"grenade incoming",
+};
+
+static void* loadserver_read_file(const char* filename, size_t* size) {
+	FILE* f = fopen(filename, "rb");
+
+	if(!f) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	void* data = malloc(*size);
+
+	if(!data || fread(data, 1, *size, f) != *size) {
+		fclose(f);
+		free(data);
+		return NULL;
+	}
+
+	fclose(f);
+	return data;
+}
+
+static void loadserver_send(struct loadserver* ls, ENetPeer* peer, int id, const void* data, size_t length,
+							bool reliable) {
+	ENetPacket* packet = enet_packet_create(NULL, length + 1, reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+	packet->data[0] = id;
+	memcpy(packet->data + 1, data, length);
+	enet_peer_send(peer, 0, packet);
+	ls->packets++;
+	ls->bytes += length + 1;
+}
+
+// the server's own world is driven by exactly what the clients get to see
+static void loadserver_emit(struct loadserver* ls, int id, const void* data, size_t length, bool reliable) {
+	unsigned char packet[1 + 256];
+
+	if(length < sizeof(packet)) {
+		packet[0] = id;
+		memcpy(packet + 1, data, length);
+		sim_packet(ls->world, packet, length + 1);
+	}
+
+	for(int k = 0; k < LOADSERVER_CLIENTS; k++) {
+		if(ls->clients[k].peer && ls->clients[k].ready)
+			loadserver_send(ls, ls->clients[k].peer, id, data, length, reliable);
+	}
+}
+
+static void loadserver_spawn_position(struct loadserver* ls, float* x, float* y, float* z) {
+	struct sim_world* w = ls->world;
+	*x = 32.0F + rng_float(&w->rng) * (w->map.width - 64);
+	*y = 32.0F + rng_float(&w->rng) * (w->map.depth - 64);
+	*z = w->map.height - occupancy_column_top(occupancy_column(&w->map, *x, *y)) - 2.5F;
+}
+
+static void loadserver_name(char* name, size_t size, int id) {
+	snprintf(name, size, "bot%i", id);
+}
+
+static void loadserver_spawn(struct loadserver* ls, int id, int team, const char* name) {
+	struct PacketCreatePlayer p = {
+		.player_id = id,
+		.weapon = id % 3,
+		.team = team,
+	};
+
+	loadserver_spawn_position(ls, &p.x, &p.y, &p.z);
+	strncpy(p.name, name, sizeof(p.name) - 1);
+	loadserver_emit(ls, PACKET_CREATEPLAYER_ID, &p, sizeof(p), true);
+
+	ls->keys[id] = 0;
+	ls->firing[id] = false;
+}
+
+static struct sim_player* loadserver_random_bot(struct loadserver* ls) {
+	for(int tries = 0; tries < 16; tries++) {
+		int id = rng_next(&ls->world->rng) % ls->config.bots;
+
+		if(ls->world->players[id].alive)
+			return ls->world->players + id;
+	}
+
+	return NULL;
+}
+
+// a voxel in front of the bot, in voxlap coordinates
+static void loadserver_target(struct sim_player* p, float distance, int* x, int* y, int* z) {
+	*x = p->body.pos.x + p->body.orientation.x * distance;
+	*y = p->body.pos.y + p->body.orientation.y * distance;
+	*z = p->body.pos.z + 2.0F;
+}
+
+// number of events this tick for a rate in events per second
+static int loadserver_events(struct loadserver* ls, float rate) {
+	float n = rate / SIM_TICK_RATE;
+	int count = n;
+	return count + (rng_float(&ls->world->rng) < n - count);
+}
+
+static void loadserver_bots(struct loadserver* ls) {
+	struct sim_world* w = ls->world;
+
+	for(int id = 0; id < ls->config.bots; id++) {
+		struct sim_player* p = w->players + id;
+
+		if(!p->alive) {
+			if(w->time >= ls->respawn[id]) {
+				char name[17];
+				loadserver_name(name, sizeof(name), id);
+				loadserver_spawn(ls, id, id & 1, name);
+			}
+			continue;
+		}
+
+		uint32_t r = rng_next(&w->rng);
+
+		if(r % 30 == 0) {
+			float yaw = rng_float(&w->rng) * 6.2831853F;
+			float pitch = (rng_float(&w->rng) - 0.5F) * 1.5F;
+			p->body.orientation.x = cosf(yaw) * cosf(pitch);
+			p->body.orientation.y = sinf(yaw) * cosf(pitch);
+			p->body.orientation.z = -sinf(pitch);
+
+			struct PacketInputData in = {
+				.player_id = id,
+				.keys = 1 | (rng_next(&w->rng) & (4 | 8 | 32 | 128)),
+			};
+
+			if(in.keys != ls->keys[id]) {
+				ls->keys[id] = in.keys;
+				loadserver_emit(ls, PACKET_INPUTDATA_ID, &in, sizeof(in), true);
+			}
+		} else if(r % 90 == 1) {
+			struct PacketInputData in = {.player_id = id, .keys = ls->keys[id] | 16};
+			loadserver_emit(ls, PACKET_INPUTDATA_ID, &in, sizeof(in), true);
+		} else if(ls->config.shoot && r % 45 == 2) {
+			ls->firing[id] = !ls->firing[id];
+			struct PacketWeaponInput in = {.player_id = id, .primary = ls->firing[id]};
+			loadserver_emit(ls, PACKET_WEAPONINPUT_ID, &in, sizeof(in), true);
+		}
+	}
+
+	for(int k = loadserver_events(ls, ls->config.blocks); k > 0; k--) {
+		struct sim_player* p = loadserver_random_bot(ls);
+
+		if(p) {
+			struct PacketBlockAction a = {
+				.player_id = p - w->players,
+				.action_type = (rng_next(&w->rng) & 1) ? ACTION_DESTROY : ACTION_BUILD,
+			};
+			loadserver_target(p, 2.0F, &a.x, &a.y, &a.z);
+			loadserver_emit(ls, PACKET_BLOCKACTION_ID, &a, sizeof(a), true);
+		}
+	}
+
+	for(int k = loadserver_events(ls, ls->config.lines); k > 0; k--) {
+		struct sim_player* p = loadserver_random_bot(ls);
+
+		if(p) {
+			struct PacketBlockLine l = {.player_id = p - w->players};
+			loadserver_target(p, 1.0F, &l.sx, &l.sy, &l.sz);
+			loadserver_target(p, 2.0F + rng_float(&w->rng) * 8.0F, &l.ex, &l.ey, &l.ez);
+			l.sz = l.ez = min(l.sz, w->map.height - 2);
+			loadserver_emit(ls, PACKET_BLOCKLINE_ID, &l, sizeof(l), true);
+		}
+	}
+
+	for(int k = loadserver_events(ls, ls->config.grenades); k > 0; k--) {
+		struct sim_player* p = loadserver_random_bot(ls);
+		struct loadserver_grenade* g = NULL;
+
+		for(int i = 0; i < LOADSERVER_GRENADES && !g; i++) {
+			if(!ls->grenades[i].active)
+				g = ls->grenades + i;
+		}
+
+		if(p && g) {
+			struct PacketGrenade n = {
+				.player_id = p - w->players,
+				.fuse_length = 2.0F + rng_float(&w->rng),
+				.x = p->body.pos.x,
+				.y = p->body.pos.y,
+				.z = p->body.pos.z,
+				.vx = p->body.orientation.x,
+				.vy = p->body.orientation.y,
+				.vz = p->body.orientation.z,
+			};
+			loadserver_emit(ls, PACKET_GRENADE_ID, &n, sizeof(n), true);
+
+			g->active = true;
+			g->player_id = n.player_id;
+			g->explode = w->time + n.fuse_length;
+			loadserver_target(p, 6.0F, &g->x, &g->y, &g->z);
+		}
+	}
+
+	for(int i = 0; i < LOADSERVER_GRENADES; i++) {
+		struct loadserver_grenade* g = ls->grenades + i;
+
+		if(g->active && w->time >= g->explode) {
+			struct PacketBlockAction a = {
+				.player_id = g->player_id,
+				.action_type = ACTION_GRENADE,
+				.x = g->x,
+				.y = g->y,
+				.z = g->z,
+			};
+			loadserver_emit(ls, PACKET_BLOCKACTION_ID, &a, sizeof(a), true);
+			g->active = false;
+		}
+	}
+
+	for(int k = loadserver_events(ls, ls->config.kills); k > 0; k--) {
+		struct sim_player* victim = loadserver_random_bot(ls);
+		struct sim_player* killer = loadserver_random_bot(ls);
+
+		if(victim && killer) {
+			struct PacketKillAction a = {
+				.player_id = victim - w->players,
+				.killer_id = killer - w->players,
+				.kill_type = rng_next(&w->rng) % 4,
+				.respawn_time = LOADSERVER_RESPAWN,
+			};
+			loadserver_emit(ls, PACKET_KILLACTION_ID, &a, sizeof(a), true);
+			ls->respawn[a.player_id] = w->time + LOADSERVER_RESPAWN;
+		}
+	}
+
+	for(int k = loadserver_events(ls, ls->config.chat); k > 0; k--) {
+		struct sim_player* p = loadserver_random_bot(ls);
+
+		if(p) {
+			struct PacketChatMessage msg = {
+				.player_id = p - w->players,
+				.chat_type = CHAT_ALL,
+			};
+			const char* text
+				= loadserver_chat[rng_next(&w->rng) % (sizeof(loadserver_chat) / sizeof(*loadserver_chat))];
+			strcpy(msg.message, text);
+			loadserver_emit(ls, PACKET_CHATMESSAGE_ID, &msg, sizeof(msg) - sizeof(msg.message) + strlen(text) + 1,
+							true);
+		}
+	}
+}
+
+// one entry per player id up to the highest one in use, like the 0.75 protocol for 32 players
+static void loadserver_world_update(struct loadserver* ls) {
+	int count = ls->config.bots;
+
+	for(int k = 0; k < LOADSERVER_CLIENTS; k++) {
+		if(ls->clients[k].joined)
+			count = max(count, ls->clients[k].id + 1);
+	}
+
+	static struct PacketWorldUpdate075 update[SIM_PLAYERS];
+	memset(update, 0, count * sizeof(struct PacketWorldUpdate075));
+
+	for(int k = 0; k < count; k++) {
+		struct sim_player* p = ls->world->players + k;
+
+		if(p->alive) {
+			update[k] = (struct PacketWorldUpdate075) {
+				.x = p->body.pos.x,
+				.y = p->body.pos.y,
+				.z = p->body.pos.z,
+				.ox = p->body.orientation.x,
+				.oy = p->body.orientation.y,
+				.oz = p->body.orientation.z,
+			};
+		}
+	}
+
+	for(int k = 0; k < LOADSERVER_CLIENTS; k++) {
+		struct loadserver_client* c = ls->clients + k;
+
+		if(c->joined && ls->world->players[c->id].alive)
+			update[c->id] = (struct PacketWorldUpdate075) {
+				.x = c->pos[0],
+				.y = c->pos[1],
+				.z = c->pos[2],
+				.ox = c->orientation[0],
+				.oy = c->orientation[1],
+				.oz = c->orientation[2],
+			};
+	}
+
+	for(int k = 0; k < LOADSERVER_CLIENTS; k++) {
+		if(ls->clients[k].peer && ls->clients[k].ready)
+			loadserver_send(ls, ls->clients[k].peer, PACKET_WORLDUPDATE_ID, update,
+							count * sizeof(struct PacketWorldUpdate075), false);
+	}
+}
+
+// map, everyone already playing, then the game state, as a real 0.75 server does it
+static void loadserver_login(struct loadserver* ls, struct loadserver_client* c) {
+	struct PacketMapStart075 start = {.map_size = ls->map_size};
+	loadserver_send(ls, c->peer, PACKET_MAPSTART_ID, &start, sizeof(start), true);
+
+	for(size_t offset = 0; offset < ls->map_size; offset += LOADSERVER_CHUNK)
+		loadserver_send(ls, c->peer, PACKET_MAPCHUNK_ID, (unsigned char*)ls->map + offset,
+						min(ls->map_size - offset, LOADSERVER_CHUNK), true);
+
+	for(int k = 0; k < SIM_PLAYERS; k++) {
+		if(ls->world->players[k].alive) {
+			struct PacketExistingPlayer p = {
+				.player_id = k,
+				.team = k & 1,
+				.weapon = k % 3,
+				.held_item = TOOL_GUN,
+				.red = 111,
+				.green = 111,
+				.blue = 111,
+			};
+			loadserver_name(p.name, sizeof(p.name), k);
+			loadserver_send(ls, c->peer, PACKET_EXISTINGPLAYER_ID, &p, sizeof(p), true);
+		}
+	}
+
+	struct PacketStateData state = {
+		.player_id = c->id,
+		.fog_red = 128,
+		.fog_green = 232,
+		.fog_blue = 255,
+		.team_1_blue = 255,
+		.team_2_green = 255,
+		.team_1_name = "Blue",
+		.team_2_name = "Green",
+		.gamemode = 0, // ctf
+		.gamemode_data.ctf = {
+			.capture_limit = 10,
+			.team_1_intel_location.dropped = {64.0F, 256.0F, 32.0F},
+			.team_2_intel_location.dropped = {448.0F, 256.0F, 32.0F},
+			.team_1_base = {32.0F, 256.0F, 32.0F},
+			.team_2_base = {480.0F, 256.0F, 32.0F},
+		},
+	};
+	loadserver_send(ls, c->peer, PACKET_STATEDATA_ID, &state,
+					sizeof(state) - sizeof(state.gamemode_data) + sizeof(state.gamemode_data.ctf), true);
+
+	c->ready = true;
+}
+
+static void loadserver_receive(struct loadserver* ls, struct loadserver_client* c, const unsigned char* data,
+							   size_t length) {
+	if(length < 1)
+		return;
+
+	const void* payload = data + 1;
+	size_t size = length - 1;
+
+	switch(data[0]) {
+		case PACKET_EXISTINGPLAYER_ID:
+			if(size >= offsetof(struct PacketExistingPlayer, name)) {
+				const struct PacketExistingPlayer* p = payload;
+				char name[17] = {0};
+				memcpy(name, p->name, min(size - offsetof(struct PacketExistingPlayer, name), sizeof(name) - 1));
+				loadserver_spawn(ls, c->id, p->team, name);
+				c->joined = true;
+
+				struct movement_body* b = &ls->world->players[c->id].body;
+				memcpy(c->pos, &b->pos, sizeof(c->pos));
+				memcpy(c->orientation, &b->orientation, sizeof(c->orientation));
+			}
+			break;
+		case PACKET_POSITIONDATA_ID:
+			if(c->joined && size >= sizeof(struct PacketPositionData)) {
+				const struct PacketPositionData* p = payload;
+				struct movement_body* b = &ls->world->players[c->id].body;
+				c->pos[0] = b->pos.x = p->x;
+				c->pos[1] = b->pos.y = p->y;
+				c->pos[2] = b->pos.z = p->z;
+			}
+			break;
+		case PACKET_ORIENTATIONDATA_ID:
+			if(c->joined && size >= sizeof(struct PacketOrientationData)) {
+				const struct PacketOrientationData* p = payload;
+				struct movement_body* b = &ls->world->players[c->id].body;
+				c->orientation[0] = b->orientation.x = p->x;
+				c->orientation[1] = b->orientation.y = p->y;
+				c->orientation[2] = b->orientation.z = p->z;
+			}
+			break;
+		case PACKET_CHATMESSAGE_ID:
+			if(size > offsetof(struct PacketChatMessage, message) && size <= sizeof(struct PacketChatMessage)) {
+				struct PacketChatMessage msg;
+				memcpy(&msg, payload, size);
+				msg.player_id = c->id;
+				loadserver_emit(ls, PACKET_CHATMESSAGE_ID, &msg, size, true);
+			}
+			break;
+		case PACKET_BLOCKACTION_ID:
+			if(size >= sizeof(struct PacketBlockAction)) {
+				struct PacketBlockAction a;
+				memcpy(&a, payload, sizeof(a));
+				a.player_id = c->id;
+				loadserver_emit(ls, PACKET_BLOCKACTION_ID, &a, sizeof(a), true);
+			}
+			break;
+		case PACKET_BLOCKLINE_ID:
+			if(size >= sizeof(struct PacketBlockLine)) {
+				struct PacketBlockLine l;
+				memcpy(&l, payload, sizeof(l));
+				l.player_id = c->id;
+				loadserver_emit(ls, PACKET_BLOCKLINE_ID, &l, sizeof(l), true);
+			}
+			break;
+	}
+}
+
+static void loadserver_service(struct loadserver* ls, enet_uint32 timeout) {
+	ENetEvent event;
+
+	while(enet_host_service(ls->host, &event, timeout) > 0) {
+		timeout = 0;
+		struct loadserver_client* c = event.peer->data;
+
+		switch(event.type) {
+			case ENET_EVENT_TYPE_CONNECT:
+				for(int k = 0; k < LOADSERVER_CLIENTS && !c; k++) {
+					if(!ls->clients[k].peer)
+						c = ls->clients + k;
+				}
+
+				if(!c) {
+					enet_peer_disconnect(event.peer, 0);
+					break;
+				}
+
+				*c = (struct loadserver_client) {
+					.peer = event.peer,
+					.id = SIM_PLAYERS - 1 - (c - ls->clients),
+				};
+				event.peer->data = c;
+				printf("client connected as player %i\n", c->id);
+				loadserver_login(ls, c);
+				break;
+			case ENET_EVENT_TYPE_RECEIVE:
+				if(c)
+					loadserver_receive(ls, c, event.packet->data, event.packet->dataLength);
+				enet_packet_destroy(event.packet);
+				break;
+			case ENET_EVENT_TYPE_DISCONNECT:
+				if(c) {
+					printf("player %i disconnected\n", c->id);
+					c->peer = NULL;
+					c->ready = false;
+
+					if(c->joined) {
+						c->joined = false;
+						struct PacketPlayerLeft p = {.player_id = c->id};
+						loadserver_emit(ls, PACKET_PLAYERLEFT_ID, &p, sizeof(p), true);
+					}
+				}
+				event.peer->data = NULL;
+				break;
+			default: break;
+		}
+	}
+}
+
+static bool loadserver_load_map(struct loadserver* ls) {
+	size_t size;
+	void* data = loadserver_read_file(ls->config.map, &size);
+
+	if(!data)
+		return false;
+
+	if(!sim_load_vxl(ls->world, data, size)) {
+		fprintf(stderr, "%s is not a valid map\n", ls->config.map);
+		free(data);
+		return false;
+	}
+
+	struct libdeflate_compressor* c = libdeflate_alloc_compressor(6);
+	size_t bound = libdeflate_zlib_compress_bound(c, size);
+	ls->map = malloc(bound);
+	ls->map_size = ls->map ? libdeflate_zlib_compress(c, data, size, ls->map, bound) : 0;
+	libdeflate_free_compressor(c);
+	free(data);
+
+	return ls->map_size > 0;
+}
+
+static bool loadserver_args(struct loadserver_config* config, int argc, char** argv) {
+	if(argc < 2)
+		return false;
+
+	config->map = argv[1];
+
+	for(int k = 2; k < argc; k++) {
+		float* rate = NULL;
+
+		if(!strcmp(argv[k], "--no-shoot")) {
+			config->shoot = false;
+			continue;
+		}
+
+		if(k + 1 >= argc)
+			return false;
+
+		if(!strcmp(argv[k], "--port")) {
+			config->port = atoi(argv[++k]);
+		} else if(!strcmp(argv[k], "--bots")) {
+			config->bots = atoi(argv[++k]);
+		} else if(!strcmp(argv[k], "--world-rate")) {
+			rate = &config->world_rate;
+		} else if(!strcmp(argv[k], "--blocks")) {
+			rate = &config->blocks;
+		} else if(!strcmp(argv[k], "--lines")) {
+			rate = &config->lines;
+		} else if(!strcmp(argv[k], "--grenades")) {
+			rate = &config->grenades;
+		} else if(!strcmp(argv[k], "--kills")) {
+			rate = &config->kills;
+		} else if(!strcmp(argv[k], "--chat")) {
+			rate = &config->chat;
+		} else {
+			return false;
+		}
+
+		if(rate)
+			*rate = atof(argv[++k]);
+	}
+
+	config->bots = max(0, min(config->bots, SIM_PLAYERS - LOADSERVER_CLIENTS));
+	config->world_rate = max(config->world_rate, 1.0F);
+	return true;
+}
+
+int main(int argc, char** argv) {
+	static struct loadserver ls = {
+		.config = {
+			.port = 32887,
+			.bots = 32,
+			.world_rate = 10.0F,
+			.blocks = 4.0F,
+			.lines = 0.5F,
+			.grenades = 0.5F,
+			.kills = 1.0F,
+			.chat = 0.5F,
+			.shoot = true,
+		},
+	};
+
+	if(!loadserver_args(&ls.config, argc, argv)) {
+		fprintf(stderr,
+				"usage: loadserver <map.vxl> [--port <n>] [--bots <n>] [--world-rate <hz>] [--blocks <per second>]\n"
+				"                  [--lines <per second>] [--grenades <per second>] [--kills <per second>]\n"
+				"                  [--chat <per second>] [--no-shoot]\n");
+		return 1;
+	}
+
+	ls.world = malloc(sizeof(struct sim_world));
+
+	if(!ls.world || enet_initialize())
+		return 1;
+
+	sim_create(ls.world, 512, 512, 64, 1);
+
+	if(!loadserver_load_map(&ls))
+		return 1;
+
+	ENetAddress address = {.host = ENET_HOST_ANY, .port = ls.config.port};
+	ls.host = enet_host_create(&address, LOADSERVER_CLIENTS, 1, 0, 0);
+
+	if(!ls.host) {
+		fprintf(stderr, "could not listen on port %i\n", ls.config.port);
+		return 1;
+	}
+
+	enet_host_compress_with_range_coder(ls.host);
+
+	printf("serving %s (%zu bytes compressed) on port %i with %i bots\n", ls.config.map, ls.map_size,
+		   ls.config.port, ls.config.bots);
+
+	double start = bench_time();
+	double report = start;
+	unsigned long tick = 0;
+
+	while(1) {
+		double next = start + (tick + 1) / (double)SIM_TICK_RATE;
+		double now = bench_time();
+
+		loadserver_service(&ls, (now < next) ? (enet_uint32)((next - now) * 1000.0) : 0);
+
+		if(bench_time() < next)
+			continue;
+
+		loadserver_bots(&ls);
+		sim_step(ls.world, 1.0F / SIM_TICK_RATE);
+
+		if(ls.world->time >= ls.world_update) {
+			ls.world_update = ls.world->time + 1.0F / ls.config.world_rate;
+			loadserver_world_update(&ls);
+		}
+
+		enet_host_flush(ls.host);
+		tick++;
+
+		if(bench_time() - report >= 5.0) {
+			double elapsed = bench_time() - report;
+			printf("%.0fs: %.0f packets/s, %.1f KiB/s to clients\n", bench_time() - start, ls.packets / elapsed,
+				   ls.bytes / elapsed / 1024.0);
+			fflush(stdout);
+			ls.packets = ls.bytes = 0;
+			report = bench_time();
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,375 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../movement.h"
+#include "../utils.h"
+#include "bench.h"
+
+#define PLAYERS_MAX 256
+#define TICK (1.0F / 60.0F)
+
+static pthread_rwlock_t bench_lock = PTHREAD_RWLOCK_INITIALIZER;
+static long bench_probes;
+
+// the old player_clipbox(): a locked map_isair() for every probe
+static int bench_clipbox(const struct occupancy* occ, float x, float y, float z) {
+	int sz;
+
+	bench_probes++;
+
+	if(x < 0 || x >= 512 || y < 0 || y >= 512)
+		return 1;
+	else if(z < 0)
+		return 0;
+	sz = (int)z;
+	if(sz == 63)
+		sz = 62;
+	else if(sz >= 64)
+		return 1;
+
+	pthread_rwlock_rdlock(&bench_lock);
+	bool air = occupancy_isair(occ, (int)x, 63 - sz, (int)y);
+	pthread_rwlock_unlock(&bench_lock);
+	return !air;
+}
+
+// the old player_boxclipmove(), unchanged apart from the probe
+static void bench_boxclipmove(struct movement_body* b, const struct occupancy* occ, float fsynctics) {
+	float offset, m, f, nx, ny, nz, z;
+	long climb = 0;
+
+	f = fsynctics * 32.f;
+	nx = f * b->velocity.x + b->pos.x;
+	ny = f * b->velocity.y + b->pos.y;
+
+	if(b->crouch) {
+		offset = 0.45f;
+		m = 0.9f;
+	} else {
+		offset = 0.9f;
+		m = 1.35f;
+	}
+
+	nz = b->pos.z + offset;
+
+	if(b->velocity.x < 0)
+		f = -0.45f;
+	else
+		f = 0.45f;
+	z = m;
+	while(z >= -1.36f && !bench_clipbox(occ, nx + f, b->pos.y - 0.45f, nz + z)
+		  && !bench_clipbox(occ, nx + f, b->pos.y + 0.45f, nz + z))
+		z -= 0.9f;
+	if(z < -1.36f)
+		b->pos.x = nx;
+	else if(!b->crouch && b->orientation.z < 0.5f && !b->sprint) {
+		z = 0.35f;
+		while(z >= -2.36f && !bench_clipbox(occ, nx + f, b->pos.y - 0.45f, nz + z)
+			  && !bench_clipbox(occ, nx + f, b->pos.y + 0.45f, nz + z))
+			z -= 0.9f;
+		if(z < -2.36f) {
+			b->pos.x = nx;
+			climb = 1;
+		} else
+			b->velocity.x = 0;
+	} else
+		b->velocity.x = 0;
+
+	if(b->velocity.y < 0)
+		f = -0.45f;
+	else
+		f = 0.45f;
+	z = m;
+	while(z >= -1.36f && !bench_clipbox(occ, b->pos.x - 0.45f, ny + f, nz + z)
+		  && !bench_clipbox(occ, b->pos.x + 0.45f, ny + f, nz + z))
+		z -= 0.9f;
+	if(z < -1.36f)
+		b->pos.y = ny;
+	else if(!b->crouch && b->orientation.z < 0.5f && !b->sprint && !climb) {
+		z = 0.35f;
+		while(z >= -2.36f && !bench_clipbox(occ, b->pos.x - 0.45f, ny + f, nz + z)
+			  && !bench_clipbox(occ, b->pos.x + 0.45f, ny + f, nz + z))
+			z -= 0.9f;
+		if(z < -2.36f) {
+			b->pos.y = ny;
+			climb = 1;
+		} else
+			b->velocity.y = 0;
+	} else if(!climb)
+		b->velocity.y = 0;
+
+	b->climbed = climb;
+
+	if(climb) {
+		b->velocity.x *= 0.5f;
+		b->velocity.y *= 0.5f;
+		nz--;
+		m = -1.35f;
+	} else {
+		if(b->velocity.z < 0)
+			m = -m;
+		nz += b->velocity.z * fsynctics * 32.f;
+	}
+
+	b->airborne = true;
+
+	if(bench_clipbox(occ, b->pos.x - 0.45f, b->pos.y - 0.45f, nz + m)
+	   || bench_clipbox(occ, b->pos.x - 0.45f, b->pos.y + 0.45f, nz + m)
+	   || bench_clipbox(occ, b->pos.x + 0.45f, b->pos.y - 0.45f, nz + m)
+	   || bench_clipbox(occ, b->pos.x + 0.45f, b->pos.y + 0.45f, nz + m)) {
+		if(b->velocity.z >= 0) {
+			b->wade = b->pos.z > 61;
+			b->airborne = false;
+		}
+		b->velocity.z = 0;
+	} else
+		b->pos.z = nz - offset;
+}
+
+// the old player_move() without sounds
+static int bench_step(struct movement_body* b, const struct occupancy* occ, float fsynctics) {
+	float f, f2;
+
+	f = fsynctics;
+	if(b->airborne)
+		f *= 0.1f;
+	else if(b->crouch)
+		f *= 0.3f;
+	else if(b->aiming || b->sneak)
+		f *= 0.5f;
+	else if(b->sprint)
+		f *= 1.3f;
+
+	if((b->up || b->down) && (b->left || b->right))
+		f *= 0.70710678F;
+
+	float len = sqrt(pow(b->orientation.x, 2.0F) + pow(b->orientation.y, 2.0F));
+	float sx = -b->orientation.y / len;
+	float sy = b->orientation.x / len;
+
+	if(b->up) {
+		b->velocity.x += b->orientation.x * f;
+		b->velocity.y += b->orientation.y * f;
+	} else if(b->down) {
+		b->velocity.x -= b->orientation.x * f;
+		b->velocity.y -= b->orientation.y * f;
+	}
+	if(b->left) {
+		b->velocity.x -= sx * f;
+		b->velocity.y -= sy * f;
+	} else if(b->right) {
+		b->velocity.x += sx * f;
+		b->velocity.y += sy * f;
+	}
+
+	f = fsynctics + 1;
+	b->velocity.z += fsynctics;
+	b->velocity.z /= f;
+	if(b->wade)
+		f = fsynctics * 6.0F + 1;
+	else if(!b->airborne)
+		f = fsynctics * 4.0F + 1;
+	b->velocity.x /= f;
+	b->velocity.y /= f;
+	f2 = b->velocity.z;
+	bench_boxclipmove(b, occ, fsynctics);
+
+	int ret = 0;
+	b->landed = false;
+
+	if(!b->velocity.z && (f2 > 0.24F)) {
+		b->velocity.x *= 0.5F;
+		b->velocity.y *= 0.5F;
+		b->landed = true;
+
+		if(f2 > 0.58F) {
+			f2 -= 0.58F;
+			ret = f2 * f2 * 4096;
+		} else {
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
+
+struct bench_input {
+	bool change, jump;
+	float yaw, pitch;
+	uint32_t keys;
+};
+
+static struct bench_input bench_input_next(struct rng* rng) {
+	struct bench_input in = {0};
+
+	in.change = (rng_next(rng) % 30) == 0;
+	in.jump = (rng_next(rng) % 90) == 0;
+
+	if(in.change) {
+		in.yaw = rng_float(rng) * 6.2831853F;
+		in.pitch = (rng_float(rng) - 0.5F) * 2.0F;
+		in.keys = rng_next(rng);
+	}
+
+	return in;
+}
+
+static void bench_input_apply(struct movement_body* b, const struct bench_input* in) {
+	if(in->change) {
+		b->orientation.x = cosf(in->yaw) * cosf(in->pitch);
+		b->orientation.y = sinf(in->yaw) * cosf(in->pitch);
+		b->orientation.z = -sinf(in->pitch);
+		b->up = (in->keys & 3) != 0; // mostly running forward
+		b->down = false;
+		b->left = in->keys & 4;
+		b->right = !b->left && (in->keys & 8);
+		b->crouch = (in->keys & 0x70) == 0;
+		b->sprint = !b->crouch && (in->keys & 0x80);
+		b->sneak = false;
+		b->aiming = (in->keys & 0x300) == 0;
+	}
+
+	if(in->jump && !b->airborne)
+		b->velocity.z = -0.36F;
+}
+
+static void bench_spawn(struct movement_body* players, const struct occupancy* occ, struct rng* rng) {
+	for(int k = 0; k < PLAYERS_MAX; k++) {
+		float x = 32.0F + rng_float(rng) * 448.0F;
+		float y = 32.0F + rng_float(rng) * 448.0F;
+		int top = occupancy_column_top(occupancy_column(occ, x, y));
+
+		players[k] = (struct movement_body) {
+			.pos = {x, y, 64.0F - top - 2.5F},
+			.orientation = {1.0F, 0.0F, 0.0F},
+			.airborne = true,
+		};
+	}
+}
+
+static bool bench_same(const struct movement_body* a, const struct movement_body* b) {
+	return !memcmp(&a->pos, &b->pos, sizeof(a->pos)) && !memcmp(&a->velocity, &b->velocity, sizeof(a->velocity))
+		&& a->airborne == b->airborne && a->wade == b->wade && a->climbed == b->climbed && a->landed == b->landed;
+}
+
+// usage: bench_movement [ticks] [map.vxl]
+int main(int argc, char** argv) {
+	int ticks = (argc > 1) ? atoi(argv[1]) : 3600;
+
+	struct occupancy occ;
+	occupancy_create(&occ, 512, 512, 64);
+
+	if(!bench_load_map(&occ, (argc > 2) ? argv[2] : NULL))
+		return 1;
+
+	static struct movement_body legacy[PLAYERS_MAX], batched[PLAYERS_MAX];
+	static struct movement_cache cache[PLAYERS_MAX];
+	static struct bench_input inputs[PLAYERS_MAX];
+	struct rng rng;
+
+	// lockstep run: every player has to end up in the exact same state every tick
+	rng_seed(&rng, 1);
+	bench_spawn(legacy, &occ, &rng);
+	memcpy(batched, legacy, sizeof(legacy));
+
+	long mismatches = 0, landings = 0, climbs = 0;
+	int damage = 0;
+
+	for(int t = 0; t < ticks; t++) {
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			inputs[k] = bench_input_next(&rng);
+			bench_input_apply(legacy + k, inputs + k);
+			bench_input_apply(batched + k, inputs + k);
+		}
+
+		for(int k = 0; k < PLAYERS_MAX; k++)
+			movement_cache_gather(cache + k, &occ, batched[k].pos.x, batched[k].pos.y);
+
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			int a = bench_step(legacy + k, &occ, TICK);
+			int b = movement_step(batched + k, cache + k, TICK);
+
+			if(a != b || !bench_same(legacy + k, batched + k))
+				mismatches++;
+
+			landings += batched[k].landed;
+			climbs += batched[k].climbed;
+			if(b > 0)
+				damage += b;
+		}
+	}
+
+	// timed runs, inputs are replayed from the same seed
+	bench_probes = 0;
+	rng_seed(&rng, 1);
+	bench_spawn(legacy, &occ, &rng);
+
+	double start = bench_time();
+	for(int t = 0; t < ticks; t++) {
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			struct bench_input in = bench_input_next(&rng);
+			bench_input_apply(legacy + k, &in);
+		}
+
+		for(int k = 0; k < PLAYERS_MAX; k++)
+			bench_step(legacy + k, &occ, TICK);
+	}
+	double legacy_time = bench_time() - start;
+
+	rng_seed(&rng, 1);
+	bench_spawn(batched, &occ, &rng);
+
+	start = bench_time();
+	for(int t = 0; t < ticks; t++) {
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			struct bench_input in = bench_input_next(&rng);
+			bench_input_apply(batched + k, &in);
+		}
+
+		for(int k = 0; k < PLAYERS_MAX; k++)
+			movement_cache_gather(cache + k, &occ, batched[k].pos.x, batched[k].pos.y);
+
+		for(int k = 0; k < PLAYERS_MAX; k++)
+			movement_step(batched + k, cache + k, TICK);
+	}
+	double batched_time = bench_time() - start;
+
+	bench_consume(legacy);
+	bench_consume(batched);
+
+	printf("%i players, %i ticks, %ld landings, %ld climbs, %i fall damage\n", PLAYERS_MAX, ticks, landings, climbs,
+		   damage);
+	printf("%-10s %14s %14s %14s\n", "", "tick [us]", "player [ns]", "probes/player");
+	printf("%-10s %14.2f %14.1f %14.1f\n", "legacy", legacy_time / ticks * 1e6,
+		   legacy_time / ticks / PLAYERS_MAX * 1e9, (double)bench_probes / ticks / PLAYERS_MAX);
+	printf("%-10s %14.2f %14.1f %14s\n", "batched", batched_time / ticks * 1e6,
+		   batched_time / ticks / PLAYERS_MAX * 1e9, "-");
+	printf("mismatched player ticks: %ld\n", mismatches);
+
+	occupancy_destroy(&occ);
+
+	return mismatches != 0;
+}
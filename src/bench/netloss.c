@@ -0,0 +1,314 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include <enet/enet.h>
+
+#include "../delivery.h"
+#include "../network.h"
+#include "../utils.h"
+#include "bench.h"
+
+// a client streams orientation updates to a server through a lossy, delaying udp relay on loopback,
+// once with everything reliable (the old behaviour) and once with the delivery policy table
+
+#define TICK_RATE 60
+#define SERVER_PORT 32900
+#define RELAY_PORT 32901
+#define RELAY_SLOTS 4096
+#define EVENT_INTERVAL 30
+
+struct relay_datagram {
+	double due;
+	bool to_server;
+	size_t length;
+	unsigned char data[1500];
+};
+
+struct relay {
+	ENetSocket socket;
+	ENetAddress server, client;
+	bool has_client;
+	bool lossy;
+	float loss;
+	double delay;
+	struct rng rng;
+	struct relay_datagram* line; // delay line ordered by due time, delay is the same for every datagram
+	size_t head, count;
+	long dropped;
+};
+
+struct netloss_result {
+	long updates_sent, updates_received;
+	double age_sum, age_max;
+	long age_samples;
+	long events_sent, events_received;
+	double event_sum, event_max;
+	enet_uint32 bytes, datagrams, resends;
+	size_t coalesced;
+};
+
+static bool relay_create(struct relay* r, float loss, double delay) {
+	r->socket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	enet_address_set_host(&r->server, "127.0.0.1");
+	r->server.port = SERVER_PORT;
+
+	ENetAddress bind = r->server;
+	bind.port = RELAY_PORT;
+
+	if(enet_socket_bind(r->socket, &bind) < 0) {
+		fprintf(stderr, "could not bind relay to port %i\n", RELAY_PORT);
+		return false;
+	}
+
+	enet_socket_set_option(r->socket, ENET_SOCKOPT_NONBLOCK, 1);
+
+	r->has_client = false;
+	r->lossy = false;
+	r->loss = loss;
+	r->delay = delay;
+	rng_seed(&r->rng, 1);
+	r->line = malloc(RELAY_SLOTS * sizeof(struct relay_datagram));
+	r->head = r->count = 0;
+	r->dropped = 0;
+	return r->line != NULL;
+}
+
+static void relay_destroy(struct relay* r) {
+	enet_socket_destroy(r->socket);
+	free(r->line);
+}
+
+static void relay_pump(struct relay* r) {
+	double now = bench_time();
+
+	while(1) {
+		struct relay_datagram* d = r->line + (r->head + r->count) % RELAY_SLOTS;
+		ENetAddress from;
+		ENetBuffer buffer = {.data = d->data, .dataLength = sizeof(d->data)};
+		int length = enet_socket_receive(r->socket, &from, &buffer, 1);
+
+		if(length <= 0)
+			break;
+
+		d->to_server = !(from.host == r->server.host && from.port == r->server.port);
+
+		if(d->to_server && !r->has_client) {
+			r->client = from;
+			r->has_client = true;
+		}
+
+		if((r->lossy && rng_float(&r->rng) < r->loss) || r->count >= RELAY_SLOTS) {
+			r->dropped++;
+			continue;
+		}
+
+		d->due = now + r->delay;
+		d->length = length;
+		r->count++;
+	}
+
+	while(r->count > 0 && r->line[r->head].due <= now) {
+		struct relay_datagram* d = r->line + r->head;
+		ENetBuffer buffer = {.data = d->data, .dataLength = d->length};
+		enet_socket_send(r->socket, d->to_server ? &r->server : &r->client, &buffer, 1);
+		r->head = (r->head + 1) % RELAY_SLOTS;
+		r->count--;
+	}
+}
+
+static void netloss_sleep(double seconds) {
+	struct timespec ts = {.tv_sec = 0, .tv_nsec = seconds * 1000000000.0};
+	nanosleep(&ts, NULL);
+}
+
+static void netloss_send(ENetPacket* packet, void* user) {
+	enet_peer_send(user, 0, packet);
+}
+
+static double netloss_tick_of(ENetPacket* packet) {
+	float tick;
+	memcpy(&tick, packet->data + 1, sizeof(tick));
+	return tick;
+}
+
+static bool netloss_run(struct netloss_result* res, float loss, double delay, int ticks) {
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = SERVER_PORT;
+
+	ENetHost* server = enet_host_create(&address, 1, 1, 0, 0);
+	ENetHost* client = enet_host_create(NULL, 1, 1, 0, 0);
+	struct relay relay;
+
+	if(!server || !client || !relay_create(&relay, loss, delay)) {
+		fprintf(stderr, "could not create hosts\n");
+		return false;
+	}
+
+	address.port = RELAY_PORT;
+	ENetPeer* peer = enet_host_connect(client, &address, 1, 0);
+	bool connected = false;
+	double start = bench_time();
+	ENetEvent event;
+
+	while(!connected && bench_time() - start < 5.0) {
+		relay_pump(&relay);
+		while(enet_host_service(server, &event, 0) > 0)
+			;
+		while(enet_host_service(client, &event, 0) > 0)
+			connected |= event.type == ENET_EVENT_TYPE_CONNECT;
+		netloss_sleep(0.0005);
+	}
+
+	if(!connected) {
+		fprintf(stderr, "could not connect through the relay\n");
+		return false;
+	}
+
+	memset(res, 0, sizeof(struct netloss_result));
+	relay.lossy = true;
+
+	struct delivery_batch batch;
+	delivery_create(&batch);
+
+	enet_uint32 bytes = client->totalSentData;
+	enet_uint32 datagrams = client->totalSentPackets;
+	double newest = -1.0;
+	double* event_sent = calloc(ticks / EVENT_INTERVAL + 1, sizeof(double));
+	start = bench_time();
+
+	// keep going a little after the last tick so that resent events can still arrive
+	for(int tick = 0; tick < ticks + TICK_RATE; tick++) {
+		if(tick < ticks) {
+			// two orientation updates per tick like a client rendering faster than it sends
+			for(int k = 0; k < 2; k++) {
+				struct PacketOrientationData orient = {.x = tick, .y = k, .z = 0.0F};
+				ENetPacket* packet = delivery_packet(&batch, PACKET_ORIENTATIONDATA_ID, sizeof(orient));
+				memcpy(packet->data + 1, &orient, sizeof(orient));
+				res->updates_sent++;
+			}
+
+			// a rare event that has to arrive, it shares the channel with the updates
+			if(tick % EVENT_INTERVAL == 0) {
+				struct PacketBlockAction blk = {.x = tick};
+				ENetPacket* packet = delivery_packet(&batch, PACKET_BLOCKACTION_ID, sizeof(blk));
+				memcpy(packet->data + 1, &blk, sizeof(blk));
+				event_sent[tick / EVENT_INTERVAL] = bench_time();
+				res->events_sent++;
+			}
+
+			delivery_flush(&batch, netloss_send, peer);
+			enet_host_flush(client);
+		}
+
+		double next = start + (tick + 1) / (double)TICK_RATE;
+
+		while(bench_time() < next) {
+			relay_pump(&relay);
+
+			while(enet_host_service(client, &event, 0) > 0)
+				;
+
+			while(enet_host_service(server, &event, 0) > 0) {
+				if(event.type != ENET_EVENT_TYPE_RECEIVE)
+					continue;
+
+				if(event.packet->data[0] == PACKET_ORIENTATIONDATA_ID) {
+					newest = fmax(newest, netloss_tick_of(event.packet));
+					res->updates_received++;
+				} else {
+					struct PacketBlockAction blk;
+					memcpy(&blk, event.packet->data + 1, sizeof(blk));
+					double latency = (bench_time() - event_sent[blk.x / EVENT_INTERVAL]) * 1000.0;
+					res->event_sum += latency;
+					res->event_max = fmax(res->event_max, latency);
+					res->events_received++;
+				}
+
+				enet_packet_destroy(event.packet);
+			}
+
+			netloss_sleep(0.0005);
+		}
+
+		// how old the newest orientation the server knows about is
+		if(tick < ticks && newest >= 0.0) {
+			double age = (tick - newest) * 1000.0 / TICK_RATE;
+			res->age_sum += age;
+			res->age_max = fmax(res->age_max, age);
+			res->age_samples++;
+		}
+	}
+
+	res->bytes = client->totalSentData - bytes;
+	res->datagrams = client->totalSentPackets - datagrams;
+	res->resends = peer->packetsLost;
+	res->coalesced = batch.coalesced;
+
+	free(event_sent);
+	delivery_destroy(&batch);
+	enet_peer_reset(peer);
+	enet_host_destroy(client);
+	enet_host_destroy(server);
+	relay_destroy(&relay);
+	return true;
+}
+
+static void netloss_print(const char* name, struct netloss_result* res) {
+	printf("%-10s updates %6li/%-6li age avg %6.1fms max %6.1fms | events %3li/%-3li latency avg %6.1fms max %6.1fms | "
+		   "%7u bytes %5u datagrams %4u resends %5zu coalesced\n",
+		   name, res->updates_received, res->updates_sent, res->age_samples ? res->age_sum / res->age_samples : 0.0,
+		   res->age_max, res->events_received, res->events_sent, res->events_received ? res->event_sum / res->events_received : 0.0,
+		   res->event_max, res->bytes, res->datagrams, res->resends, res->coalesced);
+}
+
+int main(int argc, char** argv) {
+	float loss = ((argc > 1) ? atof(argv[1]) : 5.0F) / 100.0F;
+	double delay = ((argc > 2) ? atof(argv[2]) : 40.0) / 1000.0;
+	int ticks = ((argc > 3) ? atof(argv[3]) : 10.0) * TICK_RATE;
+
+	if(enet_initialize()) {
+		fprintf(stderr, "could not initialize enet\n");
+		return 1;
+	}
+
+	printf("%.1f%% loss, %.0fms one way delay, %i ticks at %iHz\n", loss * 100.0F, delay * 1000.0, ticks, TICK_RATE);
+
+	struct netloss_result reliable, policy;
+
+	delivery_set_policy(PACKET_ORIENTATIONDATA_ID, DELIVERY_RELIABLE);
+	if(!netloss_run(&reliable, loss, delay, ticks))
+		return 1;
+	netloss_print("reliable", &reliable);
+
+	delivery_set_policy(PACKET_ORIENTATIONDATA_ID, DELIVERY_LATEST);
+	if(!netloss_run(&policy, loss, delay, ticks))
+		return 1;
+	netloss_print("policy", &policy);
+
+	enet_deinitialize();
+	return 0;
+}
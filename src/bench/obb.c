@@ -0,0 +1,231 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../obb.h"
+#include "../utils.h"
+#include "bench.h"
+
+#define BOXES 256 // 32 players with 8 boxes each
+#define RAYS 8	  // one shotgun shot
+
+// general 4x4 inverse by cofactors, column major like cglm
+static void bench_inverse(const float m[4][4], float out[4][4]) {
+	float a[16], inv[16];
+	for(int k = 0; k < 16; k++)
+		a[k] = m[k / 4][k % 4];
+
+	inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14]
+		+ a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+	inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14]
+		- a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+	inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13]
+		+ a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+	inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13]
+		- a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+	inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14]
+		- a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+	inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14]
+		+ a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+	inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13]
+		- a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+	inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13]
+		+ a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+	inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14]
+		+ a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+	inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14]
+		- a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+	inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13]
+		+ a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+	inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13]
+		- a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+	inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10]
+		- a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+	inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10]
+		+ a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+	inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9]
+		- a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+	inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9]
+		+ a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+	float det = 1.0F / (a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12]);
+
+	for(int k = 0; k < 16; k++)
+		out[k / 4][k % 4] = inv[k] * det;
+}
+
+struct bench_box {
+	float model[4][4];
+	float min[3], max[3];
+};
+
+// the previous player_collision() path: invert the model matrix for every test, slab test in doubles
+static bool bench_reference(const struct bench_box* b, const Ray* r, float* distance) {
+	float inv[4][4];
+	bench_inverse(b->model, inv);
+
+	double o[3], d[3];
+	for(int k = 0; k < 3; k++) {
+		o[k] = inv[0][k] * r->origin.x + inv[1][k] * r->origin.y + inv[2][k] * r->origin.z + inv[3][k];
+		d[k] = inv[0][k] * r->direction.x + inv[1][k] * r->direction.y + inv[2][k] * r->direction.z;
+	}
+
+	double tmin = -INFINITY, tmax = INFINITY;
+	for(int k = 0; k < 3; k++) {
+		double t1 = (b->min[k] - o[k]) / d[k];
+		double t2 = (b->max[k] - o[k]) / d[k];
+		tmin = fmax(tmin, fmin(fmin(t1, t2), tmax));
+		tmax = fmin(tmax, fmax(fmax(t1, t2), tmin));
+	}
+
+	*distance = fmax(tmin, 0.0) * sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	return tmax > fmax(tmin, 0.0);
+}
+
+static void bench_random_box(struct rng* rng, struct bench_box* b) {
+	// random rotation from a unit quaternion, uniform scale like the head hitbox
+	float q[4], len = 0.0F;
+	for(int k = 0; k < 4; k++) {
+		q[k] = rng_float(rng) * 2.0F - 1.0F;
+		len += q[k] * q[k];
+	}
+	len = sqrtf(len);
+	float w = q[0] / len, x = q[1] / len, y = q[2] / len, z = q[3] / len;
+	float s = 0.8F + rng_float(rng) * 0.4F;
+
+	float rot[3][3] = {
+		{1 - 2 * (y * y + z * z), 2 * (x * y + w * z), 2 * (x * z - w * y)},
+		{2 * (x * y - w * z), 1 - 2 * (x * x + z * z), 2 * (y * z + w * x)},
+		{2 * (x * z + w * y), 2 * (y * z - w * x), 1 - 2 * (x * x + y * y)},
+	};
+
+	for(int c = 0; c < 3; c++) {
+		for(int r = 0; r < 3; r++)
+			b->model[c][r] = rot[c][r] * s;
+		b->model[c][3] = 0.0F;
+
+		b->min[c] = -0.1F - rng_float(rng) * 0.5F;
+		b->max[c] = 0.1F + rng_float(rng) * 0.5F;
+	}
+
+	b->model[3][0] = (rng_float(rng) - 0.5F) * 4.0F;
+	b->model[3][1] = (rng_float(rng) - 0.5F) * 4.0F;
+	b->model[3][2] = (rng_float(rng) - 0.5F) * 4.0F;
+	b->model[3][3] = 1.0F;
+}
+
+// usage: bench_obb [shots]
+int main(int argc, char** argv) {
+	int shots = (argc > 1) ? atoi(argv[1]) : 20000;
+
+	struct rng rng;
+	rng_seed(&rng, 1);
+
+	struct bench_box* boxes = malloc(BOXES * sizeof(struct bench_box));
+	struct obb_set set;
+	obb_set_create(&set, BOXES);
+
+	for(int k = 0; k < BOXES; k++) {
+		bench_random_box(&rng, boxes + k);
+
+		float inv[4][4];
+		bench_inverse(boxes[k].model, inv);
+		obb_set_box(&set, k, inv, boxes[k].min, boxes[k].max);
+	}
+
+	// pellets from some distance aimed into the cluster
+	Ray* rays = malloc(shots * RAYS * sizeof(Ray));
+	for(int k = 0; k < shots * RAYS; k++) {
+		float target[3], origin[3], len = 0.0F;
+		for(int i = 0; i < 3; i++) {
+			target[i] = (rng_float(&rng) - 0.5F) * 4.0F;
+			origin[i] = (rng_float(&rng) - 0.5F) * 40.0F;
+			len += (target[i] - origin[i]) * (target[i] - origin[i]);
+		}
+		len = sqrtf(len);
+		rays[k] = (Ray) {
+			.origin.coords = {origin[0], origin[1], origin[2]},
+			.direction.coords = {(target[0] - origin[0]) / len, (target[1] - origin[1]) / len,
+								 (target[2] - origin[2]) / len},
+		};
+	}
+
+	float* expected = malloc(RAYS * BOXES * sizeof(float));
+	bool* expected_hit = malloc(RAYS * BOXES * sizeof(bool));
+	float* result = malloc(RAYS * BOXES * sizeof(float));
+
+	long tests = 0, hits = 0, mismatches = 0;
+	double max_error = 0.0;
+
+	double reference_time = 0.0, single_time = 0.0, batch_time = 0.0;
+
+	for(int s = 0; s < shots; s++) {
+		Ray* shot = rays + s * RAYS;
+
+		double start = bench_time();
+		for(int r = 0; r < RAYS; r++)
+			for(int k = 0; k < BOXES; k++)
+				expected_hit[r * BOXES + k] = bench_reference(boxes + k, shot + r, expected + r * BOXES + k);
+		reference_time += bench_time() - start;
+
+		start = bench_time();
+		for(int r = 0; r < RAYS; r++)
+			obb_raycast(&set, 0, BOXES, shot + r, result + r * BOXES);
+		single_time += bench_time() - start;
+		bench_consume(result);
+
+		start = bench_time();
+		obb_raycast_batch(&set, 0, BOXES, shot, RAYS, result);
+		batch_time += bench_time() - start;
+		bench_consume(result);
+
+		for(int k = 0; k < RAYS * BOXES; k++) {
+			bool hit = isfinite(result[k]);
+			tests++;
+			hits += expected_hit[k];
+
+			if(hit != expected_hit[k]) {
+				mismatches++;
+			} else if(hit) {
+				double error = fabs(result[k] - expected[k]) / fmax(expected[k], 1.0);
+				if(error > max_error)
+					max_error = error;
+			}
+		}
+	}
+
+	printf("tests:          %ld (%.1f%% hits)\n", tests, 100.0 * hits / tests);
+	printf("mismatches:     %ld\n", mismatches);
+	printf("max rel error:  %.2e\n", max_error);
+	printf("reference:      %.2f ns/test\n", reference_time / tests * 1e9);
+	printf("kernel:         %.2f ns/test\n", single_time / tests * 1e9);
+	printf("kernel batch:   %.2f ns/test\n", batch_time / tests * 1e9);
+
+	free(rays);
+	free(boxes);
+	free(expected);
+	free(expected_hit);
+	free(result);
+	obb_set_destroy(&set);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../particlesystem.h"
+#include "bench.h"
+
+// usage: bench_particles [count] [steps] [map.vxl]
+int main(int argc, char** argv) {
+	size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+	int steps = (argc > 2) ? atoi(argv[2]) : 600;
+
+	struct occupancy occ;
+	occupancy_create(&occ, 512, 512, 64);
+
+	if(!bench_load_map(&occ, (argc > 3) ? argv[3] : NULL))
+		return 1;
+
+	struct particle_system ps;
+	particlesys_create(&ps, count);
+
+	struct rng rng;
+	rng_seed(&rng, 1);
+
+	float dt = 1.0F / 60.0F;
+	float now = 0.0F;
+
+	// bursts spread over the map like grenades and block breaks would
+	double start = bench_time();
+	while(ps.count < count) {
+		float x = rng_float(&rng) * 512.0F;
+		float z = rng_float(&rng) * 512.0F;
+		particlesys_burst(&ps, &rng, 0x505050, x, 45.0F, z, 2.5F, 1.0F, 256, 0.1F, 0.25F, now);
+	}
+	double spawn = bench_time() - start;
+
+	start = bench_time();
+	for(int k = 0; k < steps; k++) {
+		// lifetime is shorter than the run, so keep the system saturated
+		if(ps.count < count) {
+			float x = rng_float(&rng) * 512.0F;
+			float z = rng_float(&rng) * 512.0F;
+			particlesys_burst(&ps, &rng, 0x505050, x, 45.0F, z, 2.5F, 1.0F, count - ps.count, 0.1F, 0.25F, now);
+		}
+
+		particlesys_update(&ps, &occ, dt, now);
+		now += dt;
+	}
+	double total = bench_time() - start;
+
+	bench_consume(ps.x);
+
+	printf("particles:      %zu\n", count);
+	printf("steps:          %i\n", steps);
+	printf("spawn:          %.2f ns/particle\n", spawn / count * 1e9);
+	printf("update:         %.3f ms/step\n", total / steps * 1e3);
+	printf("update:         %.2f ns/particle\n", total / steps / count * 1e9);
+	printf("evicted:        %zu\n", ps.evicted);
+
+	particlesys_destroy(&ps);
+	occupancy_destroy(&occ);
+
+	return 0;
+}
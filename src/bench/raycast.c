@@ -0,0 +1,222 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "../raycast.h"
+#include "../utils.h"
+#include "bench.h"
+
+#define LENGTH 128.0F
+
+static pthread_rwlock_t bench_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// what map_isair() costs: a read lock around every probe
+static bool bench_isair(const struct occupancy* occ, int x, int y, int z) {
+	pthread_rwlock_rdlock(&bench_lock);
+	bool air = occupancy_isair(occ, x, y, z);
+	pthread_rwlock_unlock(&bench_lock);
+	return air;
+}
+
+// the old camera_terrain_pickEx() walk in mode 1
+static bool bench_legacy(const struct occupancy* occ, const struct raycast_ray* ray, struct raycast_result* r) {
+	float gx0 = ray->origin[0], gy0 = ray->origin[1], gz0 = ray->origin[2];
+	float gx1 = gx0 + ray->direction[0] * LENGTH;
+	float gy1 = gy0 + ray->direction[1] * LENGTH;
+	float gz1 = gz0 + ray->direction[2] * LENGTH;
+
+	int gx0idx = floor(gx0), gy0idx = floor(gy0), gz0idx = floor(gz0);
+	int gx1idx = floor(gx1), gy1idx = floor(gy1), gz1idx = floor(gz1);
+
+	int sx = gx1idx > gx0idx ? 1 : gx1idx < gx0idx ? -1 : 0;
+	int sy = gy1idx > gy0idx ? 1 : gy1idx < gy0idx ? -1 : 0;
+	int sz = gz1idx > gz0idx ? 1 : gz1idx < gz0idx ? -1 : 0;
+
+	int gx = gx0idx, gy = gy0idx, gz = gz0idx;
+
+	int gxp = gx0idx + (gx1idx > gx0idx ? 1 : 0);
+	int gyp = gy0idx + (gy1idx > gy0idx ? 1 : 0);
+	int gzp = gz0idx + (gz1idx > gz0idx ? 1 : 0);
+
+	float vx = gx1 == gx0 ? 1 : gx1 - gx0;
+	float vy = gy1 == gy0 ? 1 : gy1 - gy0;
+	float vz = gz1 == gz0 ? 1 : gz1 - gz0;
+
+	float errx = (gxp - gx0) * vy * vz;
+	float erry = (gyp - gy0) * vx * vz;
+	float errz = (gzp - gz0) * vx * vy;
+
+	float derrx = sx * vy * vz;
+	float derry = sy * vx * vz;
+	float derrz = sz * vx * vy;
+
+	int gx_pre = gx, gy_pre = gy, gz_pre = gz;
+
+	r->hit = false;
+	r->steps = 0;
+
+	while(1) {
+		r->steps++;
+
+		if(gx >= occ->width || gx < 0 || gy < 0 || gz >= occ->depth || gz < 0)
+			return false;
+
+		if(!bench_isair(occ, gx, gy, gz)) {
+			*r = (struct raycast_result) {
+				.hit = true,
+				.x = gx,
+				.y = gy,
+				.z = gz,
+				.px = gx_pre,
+				.py = gy_pre,
+				.pz = gz_pre,
+				.steps = r->steps,
+			};
+			return true;
+		}
+
+		gx_pre = gx;
+		gy_pre = gy;
+		gz_pre = gz;
+
+		if(gx == gx1idx && gy == gy1idx && gz == gz1idx)
+			return false;
+
+		int xr = abs(errx);
+		int yr = abs(erry);
+		int zr = abs(errz);
+
+		if(sx != 0 && (sy == 0 || xr < yr) && (sz == 0 || xr < zr)) {
+			gx += sx;
+			errx += derrx;
+		} else if(sy != 0 && (sz == 0 || yr < zr)) {
+			gy += sy;
+			erry += derry;
+		} else if(sz != 0) {
+			gz += sz;
+			errz += derrz;
+		}
+	}
+}
+
+static float bench_height(const struct occupancy* occ, float x, float z) {
+	return occupancy_column_top(occupancy_column(occ, x, z));
+}
+
+static void bench_run(const char* name, struct occupancy* occ, struct raycast_ray* rays, int count) {
+	struct raycast_result* legacy = malloc(count * sizeof(struct raycast_result));
+	struct raycast_result* results = malloc(count * sizeof(struct raycast_result));
+
+	double start = bench_time();
+	for(int k = 0; k < count; k++)
+		bench_legacy(occ, rays + k, legacy + k);
+	double legacy_time = bench_time() - start;
+
+	start = bench_time();
+	raycast_batch(occ, rays, count, results);
+	double new_time = bench_time() - start;
+
+	bench_consume(legacy);
+	bench_consume(results);
+
+	long legacy_steps = 0, new_steps = 0, same = 0;
+	for(int k = 0; k < count; k++) {
+		legacy_steps += legacy[k].steps;
+		new_steps += results[k].steps;
+
+		if(legacy[k].hit == results[k].hit
+		   && (!legacy[k].hit
+			   || (legacy[k].x == results[k].x && legacy[k].y == results[k].y && legacy[k].z == results[k].z)))
+			same++;
+	}
+
+	printf("%-10s %12.1f %12.1f %12.1f %12.1f %10.3f\n", name, legacy_time / count * 1e9, new_time / count * 1e9,
+		   (double)legacy_steps / count, (double)new_steps / count, 100.0 * same / count);
+
+	free(legacy);
+	free(results);
+}
+
+// usage: bench_raycast [rays] [map.vxl]
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 200000;
+
+	struct occupancy occ;
+	occupancy_create(&occ, 512, 512, 64);
+
+	if(!bench_load_map(&occ, (argc > 2) ? argv[2] : NULL))
+		return 1;
+
+	struct rng rng;
+	rng_seed(&rng, 1);
+
+	struct raycast_ray* rays = malloc(count * sizeof(struct raycast_ray));
+
+	printf("%-10s %12s %12s %12s %12s %10s\n", "rays", "legacy [ns]", "new [ns]", "legacy step", "new step",
+		   "same [%]");
+
+	// eye height above the ground in any direction, like block picking and shooting
+	for(int k = 0; k < count; k++) {
+		float x = 64.0F + rng_float(&rng) * 384.0F;
+		float z = 64.0F + rng_float(&rng) * 384.0F;
+		float yaw = rng_float(&rng) * 6.2831853F;
+		float pitch = (rng_float(&rng) - 0.5F) * 3.0F;
+		rays[k] = (struct raycast_ray) {
+			.origin = {x, bench_height(&occ, x, z) + 1.9F, z},
+			.direction = {cosf(yaw) * cosf(pitch), sinf(pitch), sinf(yaw) * cosf(pitch)},
+			.length = LENGTH,
+			.mode = RAYCAST_SOLID,
+		};
+	}
+
+	bench_run("ground", &occ, rays, count);
+
+	// flat over the terrain at eye height, mostly misses
+	for(int k = 0; k < count; k++) {
+		rays[k].origin[1] = 62.5F;
+		rays[k].direction[1] = 0.0F;
+		float len = sqrtf(rays[k].direction[0] * rays[k].direction[0] + rays[k].direction[2] * rays[k].direction[2]);
+		rays[k].direction[0] /= len;
+		rays[k].direction[2] /= len;
+	}
+
+	bench_run("sky", &occ, rays, count);
+
+	// from high above looking down onto the map
+	for(int k = 0; k < count; k++) {
+		float yaw = rng_float(&rng) * 6.2831853F;
+		float pitch = -0.2F - rng_float(&rng) * 0.8F;
+		rays[k].direction[0] = cosf(yaw) * cosf(pitch);
+		rays[k].direction[1] = sinf(pitch);
+		rays[k].direction[2] = sinf(yaw) * cosf(pitch);
+		rays[k].origin[1] = 63.5F;
+	}
+
+	bench_run("overview", &occ, rays, count);
+
+	free(rays);
+	occupancy_destroy(&occ);
+
+	return 0;
+}
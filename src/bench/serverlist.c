@@ -0,0 +1,292 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+
+#include <enet/enet.h>
+
+#include "../serverlist.h"
+#include "../utils.h"
+#include "bench.h"
+
+// serves a large synthetic server list from a stand-in http server on loopback, then compares
+// the old server browser (qsort the entries on every ping, four strstr per entry on every frame)
+// against struct serverlist while the user types a filter and ping results trickle in
+
+#define HTTP_PORT 32910
+#define CACHE_FILE "bench_serverlist.json"
+#define FRAMES_PER_KEY 4
+
+struct http_standin {
+	ENetSocket socket;
+	char* body;
+	size_t length;
+	int requests;
+};
+
+static const char* maps[] = {"hallway", "normandie", "arctic", "classicgen", "mesa", "lunar", "urbantankctf"};
+static const char* modes[] = {"ctf", "tc", "babel", "arena", "tdm"};
+static const char* countries[] = {"US", "DE", "FR", "GB", "PL", "BR", "CA", "RU"};
+
+static char* serverlist_generate(int count, struct rng* rng, size_t* length) {
+	size_t capacity = count * 256 + 16;
+	char* json = malloc(capacity);
+	size_t offset = sprintf(json, "[");
+
+	for(int k = 0; k < count; k++) {
+		int max = 8 + rng_next(rng) % 25;
+		offset += snprintf(json + offset, capacity - offset,
+						   "%s{\"name\":\"%s server #%i\",\"identifier\":\"aos://%u:%i\",\"map\":\"%s\","
+						   "\"game_mode\":\"%s\",\"country\":\"%s\",\"players_current\":%i,\"players_max\":%i}",
+						   k ? "," : "", (k % 9) ? "public" : "pro", k, rng_next(rng), 32887 + k % 10,
+						   maps[rng_next(rng) % 7], modes[rng_next(rng) % 5], countries[rng_next(rng) % 8],
+						   (int)(rng_next(rng) % (max + 1)), max);
+	}
+
+	offset += snprintf(json + offset, capacity - offset, "]");
+	*length = offset;
+	return json;
+}
+
+static void* http_standin_run(void* user) {
+	struct http_standin* h = (struct http_standin*)user;
+
+	for(int k = 0; k < h->requests; k++) {
+		ENetSocket client = enet_socket_accept(h->socket, NULL);
+		if(client < 0)
+			break;
+
+		// the request is a single GET, read until the header ends
+		char request[1024];
+		size_t received = 0;
+		while(received < sizeof(request) - 1) {
+			ENetBuffer buffer = {.data = request + received, .dataLength = sizeof(request) - 1 - received};
+			int length = enet_socket_receive(client, NULL, &buffer, 1);
+			if(length <= 0)
+				break;
+			received += length;
+			request[received] = 0;
+			if(strstr(request, "\r\n\r\n"))
+				break;
+		}
+
+		char header[256];
+		int header_length = snprintf(header, sizeof(header),
+									 "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+									 "Connection: close\r\n\r\n",
+									 h->length);
+		ENetBuffer buffers[2] = {
+			{.data = header, .dataLength = header_length},
+			{.data = h->body, .dataLength = h->length},
+		};
+		enet_socket_send(client, NULL, buffers, 2);
+		enet_socket_destroy(client);
+	}
+
+	return NULL;
+}
+
+// the server browser before struct serverlist
+static int old_sort(const void* a, const void* b) {
+	const struct serverlist_entry* aa = a;
+	const struct serverlist_entry* bb = b;
+
+	if(strcmp(aa->country, "LAN") == 0)
+		return -1;
+	if(strcmp(bb->country, "LAN") == 0)
+		return 1;
+	if(aa->current != bb->current)
+		return bb->current - aa->current;
+	if(aa->ping != bb->ping)
+		return aa->ping - bb->ping;
+	return strcmp(aa->name, bb->name);
+}
+
+static int old_frame(struct serverlist_entry* entries, int count, const char* filter) {
+	int visible = 0;
+	for(int k = 0; k < count; k++) {
+		if(strstr(entries[k].name, filter) || strstr(entries[k].identifier, filter) || strstr(entries[k].map, filter)
+		   || strstr(entries[k].gamemode, filter))
+			visible++;
+	}
+	return visible;
+}
+
+static void old_ping(struct serverlist_entry* entries, int count, const char* identifier, int ping) {
+	for(int k = 0; k < count; k++) {
+		if(!strcmp(entries[k].identifier, identifier)) {
+			entries[k].ping = ping;
+			break;
+		}
+	}
+
+	qsort(entries, count, sizeof(struct serverlist_entry), old_sort);
+}
+
+static int new_frame(struct serverlist* list, const char* filter) {
+	serverlist_filter(list, filter);
+
+	int visible = 0;
+	for(int k = 0; k < serverlist_visible_count(list); k++)
+		visible += serverlist_visible(list, k)->current >= 0;
+	return visible;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 20000;
+	int pings = (argc > 2) ? atoi(argv[2]) : 500;
+	const char* typed = (argc > 3) ? argv[3] : "arctic ct";
+
+	if(enet_initialize()) {
+		fprintf(stderr, "could not initialize enet\n");
+		return 1;
+	}
+
+	struct rng rng;
+	rng_seed(&rng, 1);
+
+	struct http_standin h = {.requests = 1};
+	h.body = serverlist_generate(count, &rng, &h.length);
+
+	ENetAddress address;
+	enet_address_set_host(&address, "127.0.0.1");
+	address.port = HTTP_PORT;
+	h.socket = enet_socket_create(ENET_SOCKET_TYPE_STREAM);
+	enet_socket_set_option(h.socket, ENET_SOCKOPT_REUSEADDR, 1);
+	if(enet_socket_bind(h.socket, &address) || enet_socket_listen(h.socket, 4)) {
+		fprintf(stderr, "could not listen on port %i\n", HTTP_PORT);
+		return 1;
+	}
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, http_standin_run, &h);
+
+	printf("%i servers, %.1f KiB of json\n", count, h.length / 1024.0);
+
+	// fetch on the worker, the main thread keeps running frames meanwhile
+	struct serverlist list;
+	serverlist_create(&list);
+
+	char url[64];
+	sprintf(url, "http://127.0.0.1:%i/serverlist.json", HTTP_PORT);
+	remove(CACHE_FILE);
+
+	double start = bench_time();
+	double stall = 0.0;
+	int frames = 0;
+	serverlist_fetch(&list, url, CACHE_FILE);
+
+	while(serverlist_status(&list) == SERVERLIST_STATUS_FETCHING) {
+		double frame = bench_time();
+		serverlist_update(&list);
+		stall = fmax(stall, bench_time() - frame);
+		frames++;
+		usleep(1000);
+	}
+
+	pthread_join(thread, NULL);
+	enet_socket_destroy(h.socket);
+
+	if(serverlist_status(&list) != SERVERLIST_STATUS_IDLE || list.count != count) {
+		fprintf(stderr, "fetch failed, got %i servers\n", list.count);
+		return 1;
+	}
+
+	printf("fetch      %8.2fms total, %i frames meanwhile, longest frame %.2fms\n", (bench_time() - start) * 1000.0,
+		   frames, stall * 1000.0);
+
+	struct serverlist cached;
+	serverlist_create(&cached);
+	start = bench_time();
+	bool loaded = serverlist_load(&cached, CACHE_FILE);
+	printf("cache load %8.2fms, %s %i servers\n", (bench_time() - start) * 1000.0, loaded ? "restored" : "failed",
+		   cached.count);
+	serverlist_destroy(&cached);
+	remove(CACHE_FILE);
+
+	struct serverlist_entry* entries = malloc(count * sizeof(struct serverlist_entry));
+	memcpy(entries, list.entries, count * sizeof(struct serverlist_entry));
+	qsort(entries, count, sizeof(struct serverlist_entry), old_sort);
+
+	// type the filter one key at a time, then delete it again, rendering a few frames per key
+	int length = strlen(typed);
+	char filter[SERVERLIST_SEARCH_LENGTH];
+	int visible_old = 0, visible_new = 0;
+	double time_old = 0.0, time_new = 0.0;
+
+	for(int step = 0; step <= length * 2; step++) {
+		int chars = (step <= length) ? step : length * 2 - step;
+		strncpy(filter, typed, chars);
+		filter[chars] = 0;
+
+		for(int f = 0; f < FRAMES_PER_KEY; f++) {
+			start = bench_time();
+			visible_old += old_frame(entries, count, filter);
+			time_old += bench_time() - start;
+
+			start = bench_time();
+			visible_new += new_frame(&list, filter);
+			time_new += bench_time() - start;
+		}
+	}
+
+	int filter_frames = (length * 2 + 1) * FRAMES_PER_KEY;
+	printf("filter     old %8.3fms/frame new %8.3fms/frame (%i frames typing \"%s\", %s)\n",
+		   time_old * 1000.0 / filter_frames, time_new * 1000.0 / filter_frames, filter_frames, typed,
+		   visible_old == visible_new ? "same results" : "RESULTS DIFFER");
+
+	// ping results arrive one by one in random order
+	time_old = time_new = 0.0;
+	for(int k = 0; k < pings; k++) {
+		const char* identifier = list.entries[rng_next(&rng) % count].identifier;
+		int ping = 20 + rng_next(&rng) % 300;
+
+		start = bench_time();
+		old_ping(entries, count, identifier, ping);
+		time_old += bench_time() - start;
+
+		start = bench_time();
+		serverlist_set_ping(&list, identifier, ping);
+		time_new += bench_time() - start;
+	}
+
+	printf("ping       old %8.3fms/result new %8.3fms/result (%i results)\n", time_old * 1000.0 / pings,
+		   time_new * 1000.0 / pings, pings);
+
+	time_old = time_new = 0.0;
+	for(int order = SERVERLIST_ORDER_PLAYERS; order <= SERVERLIST_ORDER_PING; order++) {
+		start = bench_time();
+		serverlist_sort(&list, order);
+		time_new += bench_time() - start;
+	}
+
+	printf("sort       %8.3fms per column click\n", time_new * 1000.0 / (SERVERLIST_ORDER_PING - SERVERLIST_ORDER_DEFAULT));
+
+	free(entries);
+	free(h.body);
+	serverlist_destroy(&list);
+	enet_deinitialize();
+	return 0;
+}
@@ -0,0 +1,350 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "../sim.h"
+#include "../network.h"
+#include "../record.h"
+#include "bench.h"
+
+struct simulate_event {
+	unsigned int tick;
+	size_t order;
+	size_t length;
+	unsigned char* packet;
+};
+
+struct simulate_events {
+	struct simulate_event* list;
+	size_t count, capacity;
+};
+
+static void simulate_event_add(struct simulate_events* events, unsigned int tick, int id, const void* data,
+							   size_t length) {
+	if(events->count >= events->capacity) {
+		events->capacity = events->capacity ? events->capacity * 2 : 256;
+		events->list = realloc(events->list, events->capacity * sizeof(struct simulate_event));
+
+		if(!events->list) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+	}
+
+	struct simulate_event* e = events->list + events->count;
+	e->tick = tick;
+	e->order = events->count++;
+	e->length = length + 1;
+	e->packet = malloc(e->length);
+
+	if(!e->packet) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	e->packet[0] = id;
+	memcpy(e->packet + 1, data, length);
+}
+
+static int simulate_event_cmp(const void* a, const void* b) {
+	const struct simulate_event* A = a;
+	const struct simulate_event* B = b;
+
+	if(A->tick != B->tick)
+		return A->tick < B->tick ? -1 : 1;
+	return A->order < B->order ? -1 : 1;
+}
+
+static void* simulate_read_file(const char* filename, size_t* size) {
+	FILE* f = fopen(filename, "rb");
+
+	if(!f) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	void* data = malloc(*size);
+
+	if(!data || fread(data, 1, *size, f) != *size) {
+		fclose(f);
+		free(data);
+		return NULL;
+	}
+
+	fclose(f);
+	return data;
+}
+
+static bool simulate_replay(struct simulate_events* events, const char* filename) {
+	struct record_reader r;
+
+	if(!record_open(&r, filename)) {
+		fprintf(stderr, "could not read recording %s\n", filename);
+		return false;
+	}
+
+	struct record_entry entry;
+	unsigned char* packet;
+
+	while(record_next(&r, &entry, &packet)) {
+		unsigned int tick = (uint64_t)entry.time * SIM_TICK_RATE / 1000;
+
+		// kept whole, sim_packet() counts the ones it does not understand as ignored
+		if(entry.length > 0)
+			simulate_event_add(events, tick, packet[0], packet + 1, entry.length - 1);
+	}
+
+	record_free(&r);
+	return true;
+}
+
+static int simulate_action(const char* name) {
+	if(!strcmp(name, "build"))
+		return ACTION_BUILD;
+	if(!strcmp(name, "destroy"))
+		return ACTION_DESTROY;
+	if(!strcmp(name, "spade"))
+		return ACTION_SPADE;
+	if(!strcmp(name, "grenade"))
+		return ACTION_GRENADE;
+	return -1;
+}
+
+struct simulate_config {
+	unsigned int seed, ticks, bots;
+	char map[256];
+};
+
+// one command per line, '#' starts a comment:
+//   seed <n>, ticks <n>, bots <n>, map <file.vxl>, replay <file>
+//   at <tick> spawn <id> <x> <y> <z>
+//   at <tick> input <id> <keys>
+//   at <tick> block <build|destroy|spade|grenade> <x> <y> <z>
+//   at <tick> kill <id>
+static bool simulate_script(struct simulate_config* config, struct simulate_events* events, const char* filename) {
+	FILE* f = fopen(filename, "r");
+
+	if(!f) {
+		fprintf(stderr, "could not open %s\n", filename);
+		return false;
+	}
+
+	char line[512];
+	int line_number = 0;
+
+	while(fgets(line, sizeof(line), f)) {
+		line_number++;
+
+		char* comment = strchr(line, '#');
+		if(comment)
+			*comment = 0;
+
+		char cmd[32], arg[256], action[32];
+		unsigned int tick;
+		int id, n, x, y, z;
+		float fx, fy, fz;
+
+		if(sscanf(line, " %31s", cmd) != 1)
+			continue;
+
+		bool ok = true;
+
+		if(!strcmp(cmd, "seed")) {
+			ok = sscanf(line, " seed %u", &config->seed) == 1;
+		} else if(!strcmp(cmd, "ticks")) {
+			ok = sscanf(line, " ticks %u", &config->ticks) == 1;
+		} else if(!strcmp(cmd, "bots")) {
+			ok = sscanf(line, " bots %u", &config->bots) == 1;
+		} else if(!strcmp(cmd, "map")) {
+			ok = sscanf(line, " map %255s", config->map) == 1;
+		} else if(!strcmp(cmd, "replay")) {
+			ok = sscanf(line, " replay %255s", arg) == 1 && simulate_replay(events, arg);
+		} else if(!strcmp(cmd, "at") && sscanf(line, " at %u %31s%n", &tick, cmd, &n) == 2) {
+			const char* rest = line + n;
+
+			if(!strcmp(cmd, "spawn") && sscanf(rest, "%i %f %f %f", &id, &fx, &fy, &fz) == 4) {
+				struct PacketCreatePlayer p = {.player_id = id, .x = fx, .y = fy, .z = fz};
+				simulate_event_add(events, tick, PACKET_CREATEPLAYER_ID, &p, sizeof(p));
+			} else if(!strcmp(cmd, "input") && sscanf(rest, "%i %i", &id, &x) == 2) {
+				struct PacketInputData p = {.player_id = id, .keys = x};
+				simulate_event_add(events, tick, PACKET_INPUTDATA_ID, &p, sizeof(p));
+			} else if(!strcmp(cmd, "block") && sscanf(rest, "%31s %i %i %i", action, &x, &y, &z) == 4
+					  && simulate_action(action) >= 0) {
+				struct PacketBlockAction p = {.action_type = simulate_action(action), .x = x, .y = y, .z = z};
+				simulate_event_add(events, tick, PACKET_BLOCKACTION_ID, &p, sizeof(p));
+			} else if(!strcmp(cmd, "kill") && sscanf(rest, "%i", &id) == 1) {
+				struct PacketKillAction p = {.player_id = id};
+				simulate_event_add(events, tick, PACKET_KILLACTION_ID, &p, sizeof(p));
+			} else {
+				ok = false;
+			}
+		} else {
+			ok = false;
+		}
+
+		if(!ok) {
+			fprintf(stderr, "%s:%i: could not parse command\n", filename, line_number);
+			fclose(f);
+			return false;
+		}
+	}
+
+	fclose(f);
+	return true;
+}
+
+// bots pick new keys and directions now and then and dig into the ground in front of them
+static void simulate_bots(struct sim_world* w, unsigned int count) {
+	for(unsigned int k = 0; k < count && k < SIM_PLAYERS; k++) {
+		struct sim_player* p = w->players + k;
+
+		if(!p->connected) {
+			float x = 32.0F + rng_float(&w->rng) * (w->map.width - 64);
+			float y = 32.0F + rng_float(&w->rng) * (w->map.depth - 64);
+			int top = occupancy_column_top(occupancy_column(&w->map, x, y));
+			sim_spawn(w, k, x, y, w->map.height - top - 2.5F);
+			continue;
+		}
+
+		uint32_t r = rng_next(&w->rng);
+
+		if(r % 30 == 0) {
+			float yaw = rng_float(&w->rng) * 6.2831853F;
+			float pitch = (rng_float(&w->rng) - 0.5F) * 1.5F;
+			unsigned char keys = 1 | (rng_next(&w->rng) & (4 | 8 | 32 | 128));
+
+			sim_packet(w, (unsigned char[]) {PACKET_INPUTDATA_ID, k, keys}, 3);
+			p->body.orientation.x = cosf(yaw) * cosf(pitch);
+			p->body.orientation.y = sinf(yaw) * cosf(pitch);
+			p->body.orientation.z = -sinf(pitch);
+		} else if(r % 90 == 1) {
+			sim_packet(w, (unsigned char[]) {PACKET_INPUTDATA_ID, k, 1 | 16}, 3);
+		} else if(r % 120 == 2) {
+			struct PacketBlockAction a = {
+				.player_id = k,
+				.action_type = (r & 0x100) ? ACTION_SPADE : ACTION_BUILD,
+				.x = p->body.pos.x + p->body.orientation.x * 2.0F,
+				.y = p->body.pos.y + p->body.orientation.y * 2.0F,
+				.z = p->body.pos.z + 2.0F,
+			};
+			unsigned char packet[1 + sizeof(a)] = {PACKET_BLOCKACTION_ID};
+			memcpy(packet + 1, &a, sizeof(a));
+			sim_packet(w, packet, sizeof(packet));
+		}
+	}
+}
+
+static int simulate_cmp_double(const void* a, const void* b) {
+	double A = *(const double*)a;
+	double B = *(const double*)b;
+	return (A > B) - (A < B);
+}
+
+// usage: simulate [script]
+int main(int argc, char** argv) {
+	struct simulate_config config = {
+		.seed = 1,
+		.ticks = 3600,
+		.bots = 64,
+	};
+	struct simulate_events events = {0};
+
+	if(argc > 1 && !simulate_script(&config, &events, argv[1]))
+		return 1;
+
+	qsort(events.list, events.count, sizeof(struct simulate_event), simulate_event_cmp);
+
+	struct sim_world* w = malloc(sizeof(struct sim_world));
+
+	if(!w)
+		return 1;
+
+	sim_create(w, 512, 512, 64, config.seed);
+
+	if(*config.map) {
+		size_t size;
+		void* data = simulate_read_file(config.map, &size);
+
+		if(!data || !sim_load_vxl(w, data, size)) {
+			fprintf(stderr, "could not load map %s\n", config.map);
+			return 1;
+		}
+
+		free(data);
+	} else {
+		bench_load_map(&w->map, NULL);
+	}
+
+	double* times = malloc(config.ticks * sizeof(double));
+
+	if(!times)
+		return 1;
+
+	size_t next = 0;
+	double total = 0.0;
+
+	for(unsigned int t = 0; t < config.ticks; t++) {
+		double start = bench_time();
+
+		for(; next < events.count && events.list[next].tick <= t; next++)
+			sim_packet(w, events.list[next].packet, events.list[next].length);
+
+		simulate_bots(w, config.bots);
+		sim_step(w, 1.0F / SIM_TICK_RATE);
+
+		times[t] = bench_time() - start;
+		total += times[t];
+	}
+
+	qsort(times, config.ticks, sizeof(double), simulate_cmp_double);
+
+	int players = 0;
+	for(int k = 0; k < SIM_PLAYERS; k++)
+		players += w->players[k].connected && w->players[k].alive;
+
+	struct sim_stats* s = &w->stats;
+	printf("%lu ticks, %i players, %lu packets (%lu ignored)\n", s->ticks, players, s->packets,
+		   s->packets_ignored);
+	printf("%lu landings, %lu climbs, %lu fall damage\n", s->landings, s->climbs, s->fall_damage);
+	printf("%lu blocks built, %lu destroyed, %lu structures (%lu voxels) fell, %zu particles\n", s->blocks_built,
+		   s->blocks_destroyed, s->structures_fallen, s->voxels_fallen, w->particles.count);
+
+	if(config.ticks > 0) {
+		printf("tick [us]: mean %.2f, median %.2f, 99%% %.2f, max %.2f\n", total / config.ticks * 1e6,
+			   times[config.ticks / 2] * 1e6, times[config.ticks * 99 / 100] * 1e6, times[config.ticks - 1] * 1e6);
+	}
+
+	free(times);
+	for(size_t k = 0; k < events.count; k++)
+		free(events.list[k].packet);
+	free(events.list);
+	sim_destroy(w);
+	free(w);
+
+	return 0;
+}
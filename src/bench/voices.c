@@ -0,0 +1,330 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if __APPLE__
+#include <OpenAL/al.h>
+#include <OpenAL/alc.h>
+#else
+#include <AL/al.h>
+#include <AL/alc.h>
+#endif
+
+#include "../voicepool.h"
+#include "../utils.h"
+#include "bench.h"
+
+// plays a firefight through OpenAL Soft's null backend in real time, once with a freshly generated
+// source per sound that is polled every frame (like sound.c used to) and once through a voicepool
+//
+// usage: bench_voices [players] [seconds]
+
+#define PLAYERS_MAX 256
+#define SOURCES_MAX 4096
+#define TICK (1.0 / 60.0)
+#define SCALE 0.6F // SOUND_SCALE
+
+enum bench_mode {
+	BENCH_SOURCES,
+	BENCH_POOL,
+};
+
+struct bench_sound {
+	const char* name;
+	float length;
+	float min, max;
+	enum voice_category category;
+	ALuint buffer;
+};
+
+// lengths and ranges of the client's wavs
+static struct bench_sound bench_sounds[] = {
+	{"footstep", 0.15F, 0.1F, 32.0F, VOICE_AMBIENT},
+	{"shotgun", 0.6F, 0.1F, 96.0F, VOICE_WEAPON},
+	{"smg", 0.25F, 0.1F, 96.0F, VOICE_WEAPON},
+	{"hitplayer", 0.3F, 0.1F, 32.0F, VOICE_WEAPON},
+	{"explode", 1.5F, 0.1F, 53.0F, VOICE_EFFECT},
+	{"beep", 0.2F, 0.1F, 1024.0F, VOICE_ALERT},
+};
+
+enum {
+	SOUND_FOOTSTEP,
+	SOUND_SHOTGUN,
+	SOUND_SMG,
+	SOUND_HITPLAYER,
+	SOUND_EXPLODE,
+	SOUND_BEEP,
+};
+
+struct bench_player {
+	float x, y, z;
+	float step, shot;
+	int weapon;
+};
+
+struct bench_state {
+	enum bench_mode mode;
+	struct voicepool pool;
+	ALuint sources[SOURCES_MAX];
+	size_t source_count, source_peak;
+	size_t requested, played, dropped, culled, stolen;
+};
+
+// decaying noise
+static void bench_buffer(struct bench_sound* s, struct rng* rng) {
+	size_t count = s->length * 22050.0F;
+	short* samples = malloc(count * sizeof(short));
+
+	for(size_t k = 0; k < count; k++)
+		samples[k] = (rng_float(rng) * 2.0F - 1.0F) * 16000.0F * (1.0F - (float)k / count);
+
+	alGenBuffers(1, &s->buffer);
+	alBufferData(s->buffer, AL_FORMAT_MONO16, samples, count * sizeof(short), 22050);
+	free(samples);
+}
+
+// what sound_createEx() did before the pool
+static void bench_source_play(struct bench_state* b, struct bench_sound* s, bool local, float x, float y, float z) {
+	if(b->source_count >= SOURCES_MAX) {
+		b->dropped++;
+		return;
+	}
+
+	ALuint source;
+
+	alGetError();
+	alGenSources(1, &source);
+
+	if(alGetError() != AL_NO_ERROR) {
+		b->dropped++;
+		return;
+	}
+
+	alSourcef(source, AL_PITCH, 1.0F);
+	alSourcef(source, AL_GAIN, 1.0F);
+	alSourcef(source, AL_REFERENCE_DISTANCE, local ? 0.0F : s->min * SCALE);
+	alSourcef(source, AL_MAX_DISTANCE, local ? 2048.0F : s->max * SCALE);
+	alSource3f(source, AL_POSITION, local ? 0.0F : x * SCALE, local ? 0.0F : y * SCALE, local ? 0.0F : z * SCALE);
+	alSource3f(source, AL_VELOCITY, 0.0F, 0.0F, 0.0F);
+	alSourcei(source, AL_SOURCE_RELATIVE, local);
+	alSourcei(source, AL_LOOPING, AL_FALSE);
+	alSourcei(source, AL_BUFFER, s->buffer);
+	alSourcePlay(source);
+
+	if(alGetError() != AL_NO_ERROR) {
+		alDeleteSources(1, &source);
+		b->dropped++;
+		return;
+	}
+
+	b->sources[b->source_count++] = source;
+	b->played++;
+
+	if(b->source_count > b->source_peak)
+		b->source_peak = b->source_count;
+}
+
+// what sound_update() did before the pool
+static void bench_source_update(struct bench_state* b) {
+	for(size_t k = 0; k < b->source_count;) {
+		ALint state;
+		alGetSourcei(b->sources[k], AL_SOURCE_STATE, &state);
+
+		if(state == AL_STOPPED) {
+			alDeleteSources(1, b->sources + k);
+			b->sources[k] = b->sources[--b->source_count];
+		} else {
+			k++;
+		}
+	}
+}
+
+static void bench_play(struct bench_state* b, int sound, bool local, float x, float y, float z) {
+	struct bench_sound* s = bench_sounds + sound;
+	b->requested++;
+
+	switch(b->mode) {
+		case BENCH_SOURCES: bench_source_play(b, s, local, x, y, z); break;
+		case BENCH_POOL:
+			voicepool_play(&b->pool, s->buffer, s->category, local, x * SCALE, y * SCALE, z * SCALE, s->min * SCALE,
+						   s->max * SCALE, -1);
+			break;
+	}
+}
+
+// players run around the listener, fire their weapon in bursts and now and then a grenade goes off
+static void bench_frame(struct bench_state* b, struct bench_player* players, int count, struct rng* rng) {
+	for(int k = 0; k < count; k++) {
+		struct bench_player* p = players + k;
+
+		p->x += (rng_float(rng) - 0.5F) * 0.5F;
+		p->z += (rng_float(rng) - 0.5F) * 0.5F;
+		p->step -= TICK;
+		p->shot -= TICK;
+
+		if(p->step <= 0.0F) {
+			bench_play(b, SOUND_FOOTSTEP, k == 0, p->x, p->y, p->z);
+			p->step = 0.35F;
+		}
+
+		if(p->shot <= 0.0F && rng_float(rng) < 0.3F) {
+			bench_play(b, p->weapon, k == 0, p->x, p->y, p->z);
+			p->shot = (p->weapon == SOUND_SHOTGUN) ? 1.0F : 0.1F;
+
+			if(rng_float(rng) < 0.1F)
+				bench_play(b, SOUND_HITPLAYER, false, p->x, p->y, p->z);
+		}
+	}
+
+	if(rng_float(rng) < 0.02F) {
+		struct bench_player* p = players + (rng_next(rng) % count);
+		bench_play(b, SOUND_EXPLODE, false, p->x, p->y, p->z);
+	}
+
+	if(rng_float(rng) < 0.005F)
+		bench_play(b, SOUND_BEEP, true, 0.0F, 0.0F, 0.0F);
+}
+
+static void bench_sleep(double seconds) {
+	if(seconds <= 0.0)
+		return;
+
+	struct timespec ts = {
+		.tv_sec = (time_t)seconds,
+		.tv_nsec = (long)((seconds - (time_t)seconds) * 1000000000.0),
+	};
+	nanosleep(&ts, NULL);
+}
+
+static double bench_run(enum bench_mode mode, int count, double seconds, struct bench_state* b) {
+	memset(b, 0, sizeof(struct bench_state));
+	b->mode = mode;
+
+	if(mode == BENCH_POOL)
+		voicepool_create(&b->pool, 64);
+
+	struct rng rng;
+	rng_seed(&rng, 1);
+
+	struct bench_player players[PLAYERS_MAX];
+
+	for(int k = 0; k < count; k++) {
+		players[k] = (struct bench_player) {
+			.x = 256.0F + (k ? (rng_float(&rng) - 0.5F) * 192.0F : 0.0F),
+			.y = 32.0F,
+			.z = 256.0F + (k ? (rng_float(&rng) - 0.5F) * 192.0F : 0.0F),
+			.step = rng_float(&rng) * 0.35F,
+			.weapon = SOUND_SHOTGUN + rng_next(&rng) % 2,
+		};
+	}
+
+	alListener3f(AL_POSITION, 256.0F * SCALE, 32.0F * SCALE, 256.0F * SCALE);
+
+	if(mode == BENCH_POOL)
+		voicepool_listener(&b->pool, 256.0F * SCALE, 32.0F * SCALE, 256.0F * SCALE);
+
+	int frames = seconds / TICK;
+	double busy = 0.0;
+	double next = bench_time();
+
+	for(int k = 0; k < frames; k++) {
+		double start = bench_time();
+
+		bench_frame(b, players, count, &rng);
+
+		switch(mode) {
+			case BENCH_SOURCES: bench_source_update(b); break;
+			case BENCH_POOL: voicepool_update(&b->pool, 8, NULL, NULL); break;
+		}
+
+		busy += bench_time() - start;
+
+		// playback runs in real time, so do the frames
+		next += TICK;
+		bench_sleep(next - bench_time());
+	}
+
+	if(mode == BENCH_POOL) {
+		b->played = b->pool.played;
+		b->dropped = b->pool.dropped;
+		b->culled = b->pool.culled;
+		b->stolen = b->pool.stolen;
+		b->source_peak = b->pool.count;
+		voicepool_destroy(&b->pool);
+	} else {
+		for(size_t k = 0; k < b->source_count; k++)
+			alSourceStop(b->sources[k]);
+		alDeleteSources(b->source_count, b->sources);
+	}
+
+	return busy / frames;
+}
+
+int main(int argc, char** argv) {
+	int count = (argc > 1) ? atoi(argv[1]) : 32;
+	double seconds = (argc > 2) ? atof(argv[2]) : 10.0;
+
+	if(count < 1 || count > PLAYERS_MAX) {
+		fprintf(stderr, "players must be between 1 and %i\n", PLAYERS_MAX);
+		return 1;
+	}
+
+	// mixes in real time without touching any audio hardware
+	setenv("ALSOFT_DRIVERS", "null", 1);
+
+	ALCdevice* device = alcOpenDevice(NULL);
+
+	if(!device) {
+		fprintf(stderr, "could not open the null output, is this OpenAL Soft?\n");
+		return 1;
+	}
+
+	ALCcontext* context = alcCreateContext(device, NULL);
+	alcMakeContextCurrent(context);
+	alDistanceModel(AL_LINEAR_DISTANCE_CLAMPED);
+
+	struct rng rng;
+	rng_seed(&rng, 2);
+
+	for(size_t k = 0; k < sizeof(bench_sounds) / sizeof(*bench_sounds); k++)
+		bench_buffer(bench_sounds + k, &rng);
+
+	printf("%i players for %.0fs\n", count, seconds);
+
+	const char* names[] = {"sources", "pool"};
+
+	for(int mode = BENCH_SOURCES; mode <= BENCH_POOL; mode++) {
+		struct bench_state b;
+		double per_frame = bench_run(mode, count, seconds, &b);
+		printf("%-8s %.1fus per frame, %zu requested, %zu played, %zu culled, %zu stolen, %zu dropped, %zu sources\n",
+			   names[mode], per_frame * 1000000.0, b.requested, b.played, b.culled, b.stolen, b.dropped, b.source_peak);
+	}
+
+	alcMakeContextCurrent(NULL);
+	alcDestroyContext(context);
+	alcCloseDevice(device);
+
+	return 0;
+}
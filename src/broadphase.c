@@ -0,0 +1,255 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "broadphase.h"
+
+static int broadphase_clamp(int v, int lo, int hi) {
+	return (v < lo) ? lo : ((v > hi) ? hi : v);
+}
+
+void broadphase_create(struct broadphase* bp, int width, int depth, int capacity) {
+	assert(bp != NULL && width > 0 && depth > 0 && capacity > 0);
+
+	bp->width = (width + BROADPHASE_CELL_SIZE - 1) / BROADPHASE_CELL_SIZE;
+	bp->depth = (depth + BROADPHASE_CELL_SIZE - 1) / BROADPHASE_CELL_SIZE;
+	bp->capacity = capacity;
+
+	// last head is the overflow list
+	size_t cells = bp->width * bp->depth + 1;
+	bp->cell_head = malloc(cells * sizeof(int));
+	assert(bp->cell_head != NULL);
+	bp->touched = malloc(cells * sizeof(int));
+	assert(bp->touched != NULL);
+
+	for(size_t k = 0; k < cells; k++)
+		bp->cell_head[k] = -1;
+	bp->touched_count = 0;
+
+	bp->entry_space = capacity * 4;
+	bp->entry_count = 0;
+	bp->entries = malloc(bp->entry_space * sizeof(struct broadphase_entry));
+	assert(bp->entries != NULL);
+
+	bp->bounds = calloc(capacity, sizeof(AABB));
+	assert(bp->bounds != NULL);
+	bp->inserted = calloc(capacity, sizeof(bool));
+	assert(bp->inserted != NULL);
+	bp->mask = calloc((capacity + 63) / 64, sizeof(uint64_t));
+	assert(bp->mask != NULL);
+}
+
+void broadphase_destroy(struct broadphase* bp) {
+	assert(bp != NULL);
+
+	free(bp->cell_head);
+	free(bp->touched);
+	free(bp->entries);
+	free(bp->bounds);
+	free(bp->inserted);
+	free(bp->mask);
+}
+
+void broadphase_clear(struct broadphase* bp) {
+	assert(bp != NULL);
+
+	for(int k = 0; k < bp->touched_count; k++)
+		bp->cell_head[bp->touched[k]] = -1;
+
+	bp->touched_count = 0;
+	bp->entry_count = 0;
+	memset(bp->inserted, 0, bp->capacity * sizeof(bool));
+}
+
+static void broadphase_link(struct broadphase* bp, int cell, int id) {
+	if(bp->entry_count >= bp->entry_space) {
+		bp->entry_space *= 2;
+		bp->entries = realloc(bp->entries, bp->entry_space * sizeof(struct broadphase_entry));
+		assert(bp->entries != NULL);
+	}
+
+	if(bp->cell_head[cell] < 0)
+		bp->touched[bp->touched_count++] = cell;
+
+	bp->entries[bp->entry_count] = (struct broadphase_entry) {
+		.id = id,
+		.next = bp->cell_head[cell],
+	};
+
+	bp->cell_head[cell] = bp->entry_count++;
+}
+
+void broadphase_insert(struct broadphase* bp, int id, const AABB* bounds) {
+	assert(bp != NULL && bounds != NULL && id >= 0 && id < bp->capacity && !bp->inserted[id]);
+
+	bp->bounds[id] = *bounds;
+	bp->inserted[id] = true;
+
+	int min_x = floor(bounds->min_x / BROADPHASE_CELL_SIZE);
+	int min_z = floor(bounds->min_z / BROADPHASE_CELL_SIZE);
+	int max_x = floor(bounds->max_x / BROADPHASE_CELL_SIZE);
+	int max_z = floor(bounds->max_z / BROADPHASE_CELL_SIZE);
+
+	if(min_x < 0 || min_z < 0 || max_x >= bp->width || max_z >= bp->depth)
+		broadphase_link(bp, bp->width * bp->depth, id);
+
+	min_x = broadphase_clamp(min_x, 0, bp->width - 1);
+	min_z = broadphase_clamp(min_z, 0, bp->depth - 1);
+	max_x = broadphase_clamp(max_x, 0, bp->width - 1);
+	max_z = broadphase_clamp(max_z, 0, bp->depth - 1);
+
+	for(int z = min_z; z <= max_z; z++)
+		for(int x = min_x; x <= max_x; x++)
+			broadphase_link(bp, x + z * bp->width, id);
+}
+
+static void broadphase_mark(struct broadphase* bp, int cell) {
+	for(int e = bp->cell_head[cell]; e >= 0; e = bp->entries[e].next) {
+		int id = bp->entries[e].id;
+		bp->mask[id / 64] |= (uint64_t)1 << (id % 64);
+	}
+}
+
+// forward ray against bounds, the ray has no end
+static bool broadphase_slab(const AABB* b, const Ray* r) {
+	float tmin = 0.0F;
+	float tmax = INFINITY;
+
+	for(int k = 0; k < 3; k++) {
+		if(fabsf(r->direction.coords[k]) < 1e-9F) {
+			if(r->origin.coords[k] < b->min[k] || r->origin.coords[k] > b->max[k])
+				return false;
+		} else {
+			float inv = 1.0F / r->direction.coords[k];
+			float t1 = (b->min[k] - r->origin.coords[k]) * inv;
+			float t2 = (b->max[k] - r->origin.coords[k]) * inv;
+			tmin = fmaxf(tmin, fminf(t1, t2));
+			tmax = fminf(tmax, fmaxf(t1, t2));
+
+			if(tmin > tmax)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+// 2D grid walk along the ray, see: Amanatides & Woo, "A Fast Voxel Traversal Algorithm"
+static void broadphase_traverse(struct broadphase* bp, const Ray* ray, float length) {
+	float ox = ray->origin.x / BROADPHASE_CELL_SIZE;
+	float oz = ray->origin.z / BROADPHASE_CELL_SIZE;
+	float dx = ray->direction.x;
+	float dz = ray->direction.z;
+	float len = sqrtf(dx * dx + dz * dz);
+
+	if(len < 1e-9F) {
+		int x = floor(ox);
+		int z = floor(oz);
+		if(x >= 0 && z >= 0 && x < bp->width && z < bp->depth)
+			broadphase_mark(bp, x + z * bp->width);
+		return;
+	}
+
+	dx /= len;
+	dz /= len;
+
+	// clip to the grid rectangle, t is measured in cells along the horizontal direction
+	float t0 = 0.0F;
+	float t1 = length / BROADPHASE_CELL_SIZE;
+	float o[2] = {ox, oz};
+	float d[2] = {dx, dz};
+	int size[2] = {bp->width, bp->depth};
+
+	for(int k = 0; k < 2; k++) {
+		if(fabsf(d[k]) < 1e-9F) {
+			if(o[k] < 0.0F || o[k] >= size[k])
+				return;
+		} else {
+			float a = (0.0F - o[k]) / d[k];
+			float b = (size[k] - o[k]) / d[k];
+			t0 = fmaxf(t0, fminf(a, b));
+			t1 = fminf(t1, fmaxf(a, b));
+		}
+	}
+
+	if(t0 > t1)
+		return;
+
+	int x = broadphase_clamp(floor(ox + dx * t0), 0, bp->width - 1);
+	int z = broadphase_clamp(floor(oz + dz * t0), 0, bp->depth - 1);
+
+	int step_x = (dx > 0.0F) ? 1 : -1;
+	int step_z = (dz > 0.0F) ? 1 : -1;
+
+	float delta_x = (fabsf(dx) < 1e-9F) ? INFINITY : fabsf(1.0F / dx);
+	float delta_z = (fabsf(dz) < 1e-9F) ? INFINITY : fabsf(1.0F / dz);
+
+	float next_x = (fabsf(dx) < 1e-9F) ? INFINITY : ((x + (step_x > 0)) - ox) / dx;
+	float next_z = (fabsf(dz) < 1e-9F) ? INFINITY : ((z + (step_z > 0)) - oz) / dz;
+
+	while(1) {
+		broadphase_mark(bp, x + z * bp->width);
+
+		if(next_x < next_z) {
+			if(next_x > t1)
+				break;
+			x += step_x;
+			next_x += delta_x;
+			if(x < 0 || x >= bp->width)
+				break;
+		} else {
+			if(next_z > t1)
+				break;
+			z += step_z;
+			next_z += delta_z;
+			if(z < 0 || z >= bp->depth)
+				break;
+		}
+	}
+}
+
+int broadphase_ray(struct broadphase* bp, const Ray* ray, float length, int* candidates) {
+	assert(bp != NULL && ray != NULL && candidates != NULL);
+
+	int words = (bp->capacity + 63) / 64;
+	memset(bp->mask, 0, words * sizeof(uint64_t));
+
+	broadphase_mark(bp, bp->width * bp->depth);
+	broadphase_traverse(bp, ray, length);
+
+	int count = 0;
+
+	for(int k = 0; k < words; k++) {
+		uint64_t bits = bp->mask[k];
+
+		while(bits) {
+			int id = k * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+
+			if(broadphase_slab(bp->bounds + id, ray))
+				candidates[count++] = id;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,60 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "aabb.h"
+
+#define BROADPHASE_CELL_SIZE 8
+
+// uniform grid over the horizontal map plane, objects are referenced by small integer ids
+// objects outside the grid go into an overflow list which every query returns
+struct broadphase {
+	int width, depth;
+	int capacity;
+	int* cell_head;
+	int* touched;
+	int touched_count;
+	struct broadphase_entry {
+		int id;
+		int next;
+	} * entries;
+	int entry_count;
+	int entry_space;
+	AABB* bounds;
+	bool* inserted;
+	uint64_t* mask;
+};
+
+// width and depth are given in blocks, capacity is the largest id + 1
+void broadphase_create(struct broadphase* bp, int width, int depth, int capacity);
+void broadphase_destroy(struct broadphase* bp);
+void broadphase_clear(struct broadphase* bp);
+void broadphase_insert(struct broadphase* bp, int id, const AABB* bounds);
+
+// writes the ids of all objects whose bounds the ray might hit (in ascending order) and returns their count,
+// only cells within the given horizontal length from the origin are visited
+int broadphase_ray(struct broadphase* bp, const Ray* ray, float length, int* candidates);
+
+#endif
@@ -20,11 +20,13 @@
 #include <math.h>
 #include <string.h>
 #include <float.h>
+#include <assert.h>
 
 #include "common.h"
 #include "cameracontroller.h"
 #include "player.h"
 #include "map.h"
+#include "raycast.h"
 #include "matrix.h"
 #include "camera.h"
 #include "config.h"
@@ -112,51 +114,91 @@ void camera_hit(struct Camera_HitType* hit, int exclude_player, float x, float y
 
 void camera_hit_mask(struct Camera_HitType* hit, int exclude_player, float x, float y, float z, float ray_x,
 					 float ray_y, float ray_z, float range) {
-	Ray dir = (Ray) {
-		.origin.coords = {x, y, z},
-		.direction.coords = {ray_x, ray_y, ray_z},
-	};
+	camera_hit_batch(hit, exclude_player, x, y, z, (float[]) {ray_x, ray_y, ray_z}, 1, range);
+}
+
+static void camera_hit_terrain(struct Camera_HitType* hit, Ray* dir, const struct raycast_result* pos, float range) {
+	float x = dir->origin.x;
+	float y = dir->origin.y;
+	float z = dir->origin.z;
 
 	hit->type = CAMERA_HITTYPE_NONE;
 	hit->distance = FLT_MAX;
 
-	int* pos = camera_terrain_pickEx(1, x, y, z, ray_x, ray_y, ray_z);
-	if(pos != NULL && distance3D(x, y, z, pos[0], pos[1], pos[2]) <= range * range) {
+	if(pos->hit && distance3D(x, y, z, pos->x, pos->y, pos->z) <= range * range) {
 		AABB block = (AABB) {
-			.min = {pos[0], pos[1], pos[2]},
-			.max = {pos[0] + 1, pos[1] + 1, pos[2] + 1},
+			.min = {pos->x, pos->y, pos->z},
+			.max = {pos->x + 1, pos->y + 1, pos->z + 1},
 		};
 
 		float d;
-		if(aabb_intersection_ray(&block, &dir, &d)) {
+		if(aabb_intersection_ray(&block, dir, &d)) {
 			hit->type = CAMERA_HITTYPE_BLOCK;
 			hit->distance = d;
-			hit->x = pos[0];
-			hit->y = pos[1];
-			hit->z = pos[2];
-			hit->xb = pos[3];
-			hit->yb = pos[4];
-			hit->zb = pos[5];
+			hit->x = pos->x;
+			hit->y = pos->y;
+			hit->z = pos->z;
+			hit->xb = pos->px;
+			hit->yb = pos->py;
+			hit->zb = pos->pz;
 		}
 	}
+}
+
+void camera_hit_batch(struct Camera_HitType* hits, int exclude_player, float x, float y, float z, const float* rays,
+					  int count, float range) {
+	assert(count > 0 && count <= CAMERA_HIT_BATCH);
+
+	Ray dir[CAMERA_HIT_BATCH];
+	struct raycast_ray terrain_rays[CAMERA_HIT_BATCH];
+	struct raycast_result terrain[CAMERA_HIT_BATCH];
+	bool candidate[PLAYERS_MAX] = {false};
+
+	for(int r = 0; r < count; r++) {
+		dir[r] = (Ray) {
+			.origin.coords = {x, y, z},
+			.direction.coords = {rays[r * 3 + 0], rays[r * 3 + 1], rays[r * 3 + 2]},
+		};
+
+		terrain_rays[r] = (struct raycast_ray) {
+			.origin = {x, y, z},
+			.direction = {rays[r * 3 + 0], rays[r * 3 + 1], rays[r * 3 + 2]},
+			.length = CAMERA_PICK_LENGTH,
+			.mode = RAYCAST_SOLID,
+		};
+	}
+
+	raycast_batch(&map_occupancy, terrain_rays, count, terrain);
+
+	for(int r = 0; r < count; r++) {
+		camera_hit_terrain(hits + r, dir + r, terrain + r, range);
+
+		// a player outside of every ray's candidate list can't be hit by any of them
+		int candidates[PLAYERS_MAX];
+		int n = player_hit_candidates(dir + r, range, candidates);
+		for(int k = 0; k < n; k++)
+			candidate[candidates[k]] = true;
+	}
 
 	for(int i = 0; i < PLAYERS_MAX; i++) {
 		float l = distance2D(x, z, players[i].pos.x, players[i].pos.z);
-		if(players[i].connected && players[i].alive && l < range * range
+		if(candidate[i] && players[i].connected && players[i].alive && l < range * range
 		   && (exclude_player < 0 || (exclude_player >= 0 && exclude_player != i))) {
-			struct player_intersection intersects = {0};
-			player_collision(players + i, &dir, &intersects);
-
-			float d;
-			int type = player_intersection_choose(&intersects, &d);
-			if(player_intersection_exists(&intersects) && d < hit->distance) {
-				hit->type = CAMERA_HITTYPE_PLAYER;
-				hit->distance = d;
-				hit->x = players[i].pos.x;
-				hit->y = players[i].pos.y;
-				hit->z = players[i].pos.z;
-				hit->player_id = i;
-				hit->player_section = type;
+			struct player_intersection intersects[CAMERA_HIT_BATCH] = {0};
+			player_collision_batch(players + i, dir, count, intersects);
+
+			for(int r = 0; r < count; r++) {
+				float d;
+				int type = player_intersection_choose(intersects + r, &d);
+				if(player_intersection_exists(intersects + r) && d < hits[r].distance) {
+					hits[r].type = CAMERA_HITTYPE_PLAYER;
+					hits[r].distance = d;
+					hits[r].x = players[i].pos.x;
+					hits[r].y = players[i].pos.y;
+					hits[r].z = players[i].pos.z;
+					hits[r].player_id = i;
+					hits[r].player_section = type;
+				}
 			}
 		}
 	}
@@ -167,105 +209,41 @@ int* camera_terrain_pick(unsigned char mode) {
 								 cos(camera_rot_y), cos(camera_rot_x) * sin(camera_rot_y));
 }
 
-// kindly borrowed from
-// https://stackoverflow.com/questions/16505905/walk-a-line-between-two-points-in-a-3d-voxel-space-visiting-all-cells
-// adapted, original code by Wivlaro
 int* camera_terrain_pickEx(unsigned char mode, float gx0, float gy0, float gz0, float ray_x, float ray_y, float ray_z) {
-	float gx1 = gx0 + ray_x * 128.0F;
-	float gy1 = gy0 + ray_y * 128.0F;
-	float gz1 = gz0 + ray_z * 128.0F;
-
-	int gx0idx = floor(gx0);
-	int gy0idx = floor(gy0);
-	int gz0idx = floor(gz0);
-
-	int gx1idx = floor(gx1);
-	int gy1idx = floor(gy1);
-	int gz1idx = floor(gz1);
-
-	int sx = gx1idx > gx0idx ? 1 : gx1idx < gx0idx ? -1 : 0;
-	int sy = gy1idx > gy0idx ? 1 : gy1idx < gy0idx ? -1 : 0;
-	int sz = gz1idx > gz0idx ? 1 : gz1idx < gz0idx ? -1 : 0;
-
-	int gx = gx0idx;
-	int gy = gy0idx;
-	int gz = gz0idx;
-
-	int gxp = gx0idx + (gx1idx > gx0idx ? 1 : 0);
-	int gyp = gy0idx + (gy1idx > gy0idx ? 1 : 0);
-	int gzp = gz0idx + (gz1idx > gz0idx ? 1 : 0);
-
-	float vx = gx1 == gx0 ? 1 : gx1 - gx0;
-	float vy = gy1 == gy0 ? 1 : gy1 - gy0;
-	float vz = gz1 == gz0 ? 1 : gz1 - gz0;
-
-	float vxvy = vx * vy;
-	float vxvz = vx * vz;
-	float vyvz = vy * vz;
-
-	float errx = (gxp - gx0) * vyvz;
-	float erry = (gyp - gy0) * vxvz;
-	float errz = (gzp - gz0) * vxvy;
-
-	float derrx = sx * vyvz;
-	float derry = sy * vxvz;
-	float derrz = sz * vxvy;
-
-	int gx_pre = gx, gy_pre = gy, gz_pre = gz;
+	struct raycast_result r;
+	raycast_voxel(&map_occupancy,
+				  &(struct raycast_ray) {
+					  .origin = {gx0, gy0, gz0},
+					  .direction = {ray_x, ray_y, ray_z},
+					  .length = CAMERA_PICK_LENGTH,
+					  .mode = (mode == 0) ? RAYCAST_AFTER_AIR : RAYCAST_SOLID,
+				  },
+				  &r);
+
+	if(!r.hit)
+		return NULL;
 
 	static int ret[6];
 	ret[0] = ret[1] = ret[2] = 0;
 	ret[3] = ret[4] = ret[5] = 0;
 
-	while(1) {
-		if(gx >= map_size_x || gx < 0 || gy < 0 || gz >= map_size_z || gz < 0) {
-			return NULL;
-		}
-		switch(mode) {
-			case 0:
-				if(!map_isair(gx, gy, gz) && map_isair(gx_pre, gy_pre, gz_pre)) {
-					ret[0] = gx_pre;
-					ret[1] = gy_pre;
-					ret[2] = gz_pre;
-					return ret;
-				}
-				break;
-			case 1:
-				if(!map_isair(gx, gy, gz)) {
-					ret[0] = gx;
-					ret[1] = gy;
-					ret[2] = gz;
-					ret[3] = gx_pre;
-					ret[4] = gy_pre;
-					ret[5] = gz_pre;
-					return ret;
-				}
-				break;
-		}
-		gx_pre = gx;
-		gy_pre = gy;
-		gz_pre = gz;
-
-		if(gx == gx1idx && gy == gy1idx && gz == gz1idx)
+	switch(mode) {
+		case 0: // air voxel in front of the first solid one
+			ret[0] = r.px;
+			ret[1] = r.py;
+			ret[2] = r.pz;
+			break;
+		case 1:
+			ret[0] = r.x;
+			ret[1] = r.y;
+			ret[2] = r.z;
+			ret[3] = r.px;
+			ret[4] = r.py;
+			ret[5] = r.pz;
 			break;
-
-		int xr = abs(errx);
-		int yr = abs(erry);
-		int zr = abs(errz);
-
-		if(sx != 0 && (sy == 0 || xr < yr) && (sz == 0 || xr < zr)) {
-			gx += sx;
-			errx += derrx;
-		} else if(sy != 0 && (sz == 0 || yr < zr)) {
-			gy += sy;
-			erry += derry;
-		} else if(sz != 0) {
-			gz += sz;
-			errz += derrz;
-		}
 	}
 
-	return NULL;
+	return ret;
 }
 
 void camera_ExtractFrustum() {
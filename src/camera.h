@@ -54,11 +54,17 @@ struct Camera_HitType {
 #define CAMERA_HITTYPE_BLOCK 1
 #define CAMERA_HITTYPE_PLAYER 2
 
+#define CAMERA_HIT_BATCH 16
+#define CAMERA_PICK_LENGTH 128.0F
+
 void camera_hit_fromplayer(struct Camera_HitType* hit, int player_id, float range);
 void camera_hit(struct Camera_HitType* hit, int exclude_player, float x, float y, float z, float ray_x, float ray_y,
 				float ray_z, float range);
 void camera_hit_mask(struct Camera_HitType* hit, int exclude_player, float x, float y, float z, float ray_x,
 					 float ray_y, float ray_z, float range);
+// several rays (x, y, z triples) from the same origin, e.g. shotgun pellets
+void camera_hit_batch(struct Camera_HitType* hits, int exclude_player, float x, float y, float z, const float* rays,
+					  int count, float range);
 
 float camera_fov_scaled();
 void camera_ExtractFrustum(void);
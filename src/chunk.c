@@ -27,7 +27,6 @@
 #include "common.h"
 #include "window.h"
 #include "config.h"
-#include "texture.h"
 #include "log.h"
 #include "matrix.h"
 #include "map.h"
@@ -36,6 +35,7 @@
 #include "chunk.h"
 #include "channel.h"
 #include "utils.h"
+#include "profiler.h"
 
 struct chunk chunks[CHUNKS_PER_DIM * CHUNKS_PER_DIM];
 
@@ -54,7 +54,6 @@ struct chunk_result_packet {
 	struct chunk* chunk;
 	int max_height;
 	struct tesselator tesselator;
-	uint32_t* minimap_data;
 };
 
 struct chunk_render_call {
@@ -115,6 +114,8 @@ void chunk_render(struct chunk_render_call* c) {
 }
 
 void chunk_draw_visible() {
+	PROFILE_SCOPE("chunk_draw_visible");
+
 	struct chunk_render_call chunks_draw[CHUNKS_PER_DIM * CHUNKS_PER_DIM * 2];
 	int index = 0;
 
@@ -174,6 +175,7 @@ static __attribute__((always_inline)) inline float solid_sunblock(struct libvxl_
 
 void* chunk_generate(void* data) {
 	pthread_detach(pthread_self());
+	PROFILE_THREAD("chunk worker");
 
 	while(1) {
 		struct chunk_work_packet work;
@@ -182,9 +184,10 @@ void* chunk_generate(void* data) {
 		if(!work.chunk)
 			break;
 
+		PROFILE_SCOPE("chunk_generate");
+
 		struct chunk_result_packet result;
 		result.chunk = work.chunk;
-		result.minimap_data = malloc(CHUNK_SIZE * CHUNK_SIZE * sizeof(uint32_t));
 		tesselator_create(&result.tesselator, VERTEX_INT, 0);
 
 		struct libvxl_chunk_copy blocks;
@@ -196,29 +199,6 @@ void* chunk_generate(void* data) {
 		else
 			chunk_generate_naive(&blocks, &result.tesselator, &result.max_height, settings.ambient_occlusion);
 
-		// use the fact that libvxl orders libvxl_blocks by top-down coordinate first in its data structure
-		size_t chunk_x = work.chunk_x * CHUNK_SIZE;
-		size_t chunk_y = work.chunk_y * CHUNK_SIZE;
-		uint32_t last_position = 0;
-		for(int k = blocks.blocks_sorted_count - 1; k >= 0; k--) {
-			struct libvxl_block* blk = blocks.blocks_sorted + k;
-
-			if(blk->position != last_position || k == blocks.blocks_sorted_count - 1) {
-				last_position = blk->position;
-
-				int x = key_getx(blk->position);
-				int z = key_gety(blk->position);
-
-				uint32_t* out = result.minimap_data + (x - chunk_x + (z - chunk_y) * CHUNK_SIZE);
-
-				if((x % 64) > 0 && (z % 64) > 0) {
-					*out = rgb2bgr(blk->color) | 0xFF000000;
-				} else {
-					*out = rgba(255, 255, 255, 255);
-				}
-			}
-		}
-
 		libvxl_copy_chunk_destroy(&blocks);
 
 		channel_put(&chunk_result_queue, &result);
@@ -768,6 +748,8 @@ void chunk_generate_naive(struct libvxl_chunk_copy* blocks, struct tesselator* t
 }
 
 void chunk_update_all() {
+	PROFILE_SCOPE("chunk_update_all");
+
 	size_t drain = channel_size(&chunk_result_queue);
 
 	if(drain > 0) {
@@ -792,15 +774,9 @@ void chunk_update_all() {
 				result->chunk->max_height = result->max_height;
 
 				tesselator_glx(&result->tesselator, &result->chunk->display_list);
-
-				glBindTexture(GL_TEXTURE_2D, texture_minimap.texture_id);
-				glTexSubImage2D(GL_TEXTURE_2D, 0, result->chunk->x * CHUNK_SIZE, result->chunk->y * CHUNK_SIZE,
-								CHUNK_SIZE, CHUNK_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, result->minimap_data);
-				glBindTexture(GL_TEXTURE_2D, 0);
 			}
 
 			tesselator_free(&result->tesselator);
-			free(result->minimap_data);
 		}
 	}
 }
@@ -104,6 +104,7 @@ void config_save() {
 	config_seti("client", "show_itemname", settings.show_itemname);
 	config_seti("client", "chat_sounds", settings.chat_sounds);
 	config_seti("client", "macro_sounds", settings.macro_sounds);
+	config_seti("client", "network_thread", settings.network_thread);
 
 	for(int k = 0; k < list_size(&config_keys); k++) {
 		struct config_key_pair* e = list_get(&config_keys, k);
@@ -210,6 +211,8 @@ static int config_read_key(void* user, const char* section, const char* name, co
 			settings.chat_sounds = atoi(value);
 		} else if(!strcmp(name, "macro_sounds")) {
 			settings.macro_sounds = atoi(value);
+		} else if(!strcmp(name, "network_thread")) {
+			settings.network_thread = atoi(value);
 		}
 	}
 	if(!strcmp(section, "controls")) {
@@ -377,6 +380,10 @@ void config_reload() {
 	config_register_key(WINDOW_KEY_LASTTOOL, SDLK_q, "last_tool", 0, "Last tool", "Tools & Weapons");
 	config_register_key(WINDOW_KEY_NETWORKSTATS, SDLK_F12, "network_stats", 1, "Network stats", "Information");
 	config_register_key(WINDOW_KEY_SAVE_MAP, SDLK_F9, "save_map", 0, "Save map", "Game");
+#ifdef USE_PROFILER
+	config_register_key(WINDOW_KEY_PROFILER, SDLK_F7, "profiler", 1, "Profiler", "Information");
+	config_register_key(WINDOW_KEY_PROFILER_TRACE, SDLK_F8, "profiler_trace", 0, "Save trace", "Information");
+#endif
 	config_register_key(WINDOW_KEY_SELECT1, SDLK_1, NULL, 0, NULL, NULL);
 	config_register_key(WINDOW_KEY_SELECT2, SDLK_2, NULL, 0, NULL, NULL);
 	config_register_key(WINDOW_KEY_SELECT3, SDLK_3, NULL, 0, NULL, NULL);
@@ -447,6 +454,10 @@ void config_reload() {
 	config_register_key(WINDOW_KEY_LASTTOOL, GLFW_KEY_Q, "last_tool", 0, "Last tool", "Tools & Weapons");
 	config_register_key(WINDOW_KEY_NETWORKSTATS, GLFW_KEY_F12, "network_stats", 1, "Network stats", "Information");
 	config_register_key(WINDOW_KEY_SAVE_MAP, GLFW_KEY_F9, "save_map", 0, "Save map", "Game");
+#ifdef USE_PROFILER
+	config_register_key(WINDOW_KEY_PROFILER, GLFW_KEY_F7, "profiler", 1, "Profiler", "Information");
+	config_register_key(WINDOW_KEY_PROFILER_TRACE, GLFW_KEY_F8, "profiler_trace", 0, "Save trace", "Information");
+#endif
 	config_register_key(WINDOW_KEY_SELECT1, GLFW_KEY_1, NULL, 0, NULL, NULL);
 	config_register_key(WINDOW_KEY_SELECT2, GLFW_KEY_2, NULL, 0, NULL, NULL);
 	config_register_key(WINDOW_KEY_SELECT3, GLFW_KEY_3, NULL, 0, NULL, NULL);
@@ -731,6 +742,15 @@ void config_reload() {
 				 .name = "Macro sounds",
 				 .help = "Sound when you use a macro",
 			 });
+	list_add(&config_settings,
+			 &(struct config_setting) {
+				 .value = &settings_tmp.network_thread,
+				 .type = CONFIG_TYPE_INT,
+				 .min = 0,
+				 .max = 1,
+				 .name = "Network thread",
+				 .help = "Receive packets off-frame",
+			 });
 	list_add(&config_settings,
 			 &(struct config_setting) {
 				 .value = settings_tmp.custom_macro,
@@ -81,6 +81,7 @@ extern struct RENDER_OPTIONS {
 	int show_itemname;
 	int chat_sounds;
 	int macro_sounds;
+	int network_thread;
 } settings, settings_tmp;
 
 extern struct list config_keys;
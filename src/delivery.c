@@ -0,0 +1,139 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "delivery.h"
+#include "network.h"
+
+// state that is stale as soon as the next update exists, everything else stays reliable
+static enum delivery_mode delivery_modes[256] = {
+	[PACKET_POSITIONDATA_ID] = DELIVERY_LATEST,
+	[PACKET_ORIENTATIONDATA_ID] = DELIVERY_LATEST,
+};
+
+enum delivery_mode delivery_policy(int id) {
+	assert(id >= 0 && id < 256);
+	return delivery_modes[id];
+}
+
+void delivery_set_policy(int id, enum delivery_mode mode) {
+	assert(id >= 0 && id < 256);
+	delivery_modes[id] = mode;
+}
+
+static enet_uint32 delivery_flags(enum delivery_mode mode) {
+	return (mode == DELIVERY_RELIABLE) ? ENET_PACKET_FLAG_RELIABLE : 0;
+}
+
+void delivery_create(struct delivery_batch* b) {
+	assert(b != NULL);
+
+	b->packets = NULL;
+	b->count = b->capacity = 0;
+	b->coalesced = 0;
+
+	for(int k = 0; k < 256; k++)
+		b->latest[k] = -1;
+}
+
+void delivery_destroy(struct delivery_batch* b) {
+	assert(b != NULL);
+
+	delivery_clear(b);
+	free(b->packets);
+	b->packets = NULL;
+	b->capacity = 0;
+}
+
+void delivery_clear(struct delivery_batch* b) {
+	assert(b != NULL);
+
+	for(size_t k = 0; k < b->count; k++) {
+		if(b->packets[k]) {
+			b->latest[b->packets[k]->data[0]] = -1;
+			enet_packet_destroy(b->packets[k]);
+		}
+	}
+
+	b->count = 0;
+}
+
+ENetPacket* delivery_packet(struct delivery_batch* b, int id, size_t length) {
+	assert(b != NULL && id >= 0 && id < 256);
+
+	enum delivery_mode mode = delivery_modes[id];
+	ENetPacket* previous = NULL;
+
+	// the old slot is left empty, the newest state is sent after everything queued before it
+	if(mode == DELIVERY_LATEST && b->latest[id] >= 0) {
+		previous = b->packets[b->latest[id]];
+		b->packets[b->latest[id]] = NULL;
+		b->latest[id] = -1;
+		b->coalesced++;
+
+		if(previous->dataLength != length + 1) {
+			enet_packet_destroy(previous);
+			previous = NULL;
+		}
+	}
+
+	if(b->count >= b->capacity) {
+		size_t capacity = b->capacity ? b->capacity * 2 : 64;
+		ENetPacket** packets = realloc(b->packets, capacity * sizeof(ENetPacket*));
+
+		if(!packets) {
+			if(previous)
+				enet_packet_destroy(previous);
+			return NULL;
+		}
+
+		b->packets = packets;
+		b->capacity = capacity;
+	}
+
+	ENetPacket* packet = previous ? previous : enet_packet_create(NULL, length + 1, delivery_flags(mode));
+
+	if(!packet)
+		return NULL;
+
+	packet->data[0] = id;
+
+	if(mode == DELIVERY_LATEST)
+		b->latest[id] = b->count;
+
+	b->packets[b->count++] = packet;
+	return packet;
+}
+
+void delivery_flush(struct delivery_batch* b, void (*send)(ENetPacket* packet, void* user), void* user) {
+	assert(b != NULL && send != NULL);
+
+	for(size_t k = 0; k < b->count; k++) {
+		if(b->packets[k]) {
+			b->latest[b->packets[k]->data[0]] = -1;
+			send(b->packets[k], user);
+		}
+	}
+
+	b->count = 0;
+}
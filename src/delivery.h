@@ -0,0 +1,57 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DELIVERY_H
+#define DELIVERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <enet/enet.h>
+
+enum delivery_mode {
+	DELIVERY_RELIABLE, // acknowledged and resent, ordered with all other reliable packets
+	DELIVERY_LATEST,   // never resent and dropped by enet if a newer one arrived first, one per tick is sent
+};
+
+// outgoing packets of one tick, handed to enet all at once so they share datagrams
+struct delivery_batch {
+	ENetPacket** packets; // NULL where a newer DELIVERY_LATEST packet took over
+	size_t count, capacity;
+	int latest[256]; // index into packets of the queued DELIVERY_LATEST packet per id, -1 if none
+	size_t coalesced;
+};
+
+enum delivery_mode delivery_policy(int id);
+void delivery_set_policy(int id, enum delivery_mode mode);
+
+void delivery_create(struct delivery_batch* b);
+void delivery_destroy(struct delivery_batch* b);
+// drops everything queued
+void delivery_clear(struct delivery_batch* b);
+
+// returns a packet of length + 1 bytes with the id already in front, the caller fills in the rest
+// a DELIVERY_LATEST id takes over the packet already queued for it this tick and moves it to the end of the queue
+ENetPacket* delivery_packet(struct delivery_batch* b, int id, size_t length);
+
+// hands every queued packet over in queue order, the callee takes ownership
+void delivery_flush(struct delivery_batch* b, void (*send)(ENetPacket* packet, void* user), void* user);
+
+#endif
@@ -25,203 +25,360 @@
 #include "file.h"
 #include "hashtable.h"
 #include "font.h"
+#include "batch.h"
 #include "stb_truetype.h"
 #include "utils.h"
+#include "pack.h"
+#include "log.h"
 
 #define FONT_BAKE_START 31
+#define FONT_ATLAS_SIZE 1024
+#define FONT_ATLAS_PADDING 1
+#define FONT_ATLAS_WHITE 2 // opaque block in the top left corner for untextured quads
+#define FONT_LAYOUT_MAX 512
 
-static short* font_vertex_buffer;
-static short* font_coords_buffer;
 static enum font_type font_current_type = FONT_FIXEDSYS;
 
 static void* font_data_fixedsys;
 static void* font_data_smallfnt;
+static stbtt_fontinfo font_info[2];
 
-static HashTable fonts_backed;
+// every glyph of every size shares one texture, rows are filled left to right
+static struct {
+	GLuint texture_id;
+	int size;
+	int x, y, row_height;
+	unsigned int generation; // bumped whenever the atlas is cleared
+} font_atlas;
 
-struct __attribute__((packed)) font_backed_id {
+struct __attribute__((packed)) font_glyph_id {
 	enum font_type type;
 	float size;
+	int codepoint;
 };
 
-struct font_backed_data {
-	stbtt_bakedchar* cdata;
-	GLuint texture_id;
-	int w, h;
+struct font_glyph {
+	short x0, y0, x1, y1; // in the atlas
+	float xoff, yoff, xadvance;
 };
 
-void font_init() {
-	font_vertex_buffer = malloc(512 * 8 * sizeof(short));
-	CHECK_ALLOCATION_ERROR(font_vertex_buffer)
-	font_coords_buffer = malloc(512 * 8 * sizeof(short));
-	CHECK_ALLOCATION_ERROR(font_coords_buffer)
+static HashTable font_glyphs;
+
+struct __attribute__((packed)) font_layout_id {
+	enum font_type type;
+	float size;
+	uint64_t hash;
+};
 
-	font_data_fixedsys = file_load("fonts/Fixedsys.ttf");
+// ready-made triangles of a whole string relative to its origin
+struct font_layout {
+	char* text;
+	short* vertices;
+	short* coords;
+	int count; // vertices
+	float length;
+	unsigned int generation;
+	unsigned int used;
+};
+
+static HashTable font_layouts;
+static unsigned int font_layout_clock = 0;
+
+// stays mapped for the whole run when it comes from the asset archive
+static void* font_load(const char* filename) {
+	const struct pack_entry* e = pack_find(filename, PACK_RAW);
+	return e ? (void*)pack_data(e) : file_load(filename);
+}
+
+void font_init() {
+	font_data_fixedsys = font_load("fonts/Fixedsys.ttf");
 	CHECK_ALLOCATION_ERROR(font_data_fixedsys)
-	font_data_smallfnt = file_load("fonts/Terminal.ttf");
+	font_data_smallfnt = font_load("fonts/Terminal.ttf");
 	CHECK_ALLOCATION_ERROR(font_data_smallfnt)
 
-	ht_setup(&fonts_backed, sizeof(struct font_backed_id), sizeof(struct font_backed_data), 8);
+	stbtt_InitFont(font_info + FONT_FIXEDSYS, font_data_fixedsys, stbtt_GetFontOffsetForIndex(font_data_fixedsys, 0));
+	stbtt_InitFont(font_info + FONT_SMALLFNT, font_data_smallfnt, stbtt_GetFontOffsetForIndex(font_data_smallfnt, 0));
+
+	ht_setup(&font_glyphs, sizeof(struct font_glyph_id), sizeof(struct font_glyph), 256);
+	ht_setup(&font_layouts, sizeof(struct font_layout_id), sizeof(struct font_layout), 64);
 }
 
 void font_select(enum font_type type) {
 	font_current_type = type;
 }
 
-static struct font_backed_data* font_find(float h) {
-	if(font_current_type == FONT_SMALLFNT)
-		h *= 1.5F;
-
-	struct font_backed_id id = (struct font_backed_id) {
-		.type = font_current_type,
-		.size = h,
-	};
-
-	struct font_backed_data* f_cached = ht_lookup(&fonts_backed, &id);
+static bool font_layout_remove_all(void* key, void* value, void* user) {
+	struct font_layout* l = (struct font_layout*)value;
 
-	if(f_cached)
-		return f_cached;
+	free(l->text);
+	free(l->vertices);
+	free(l->coords);
 
-	void* file;
-	switch(font_current_type) {
-		case FONT_FIXEDSYS: file = font_data_fixedsys; break;
-		case FONT_SMALLFNT: file = font_data_smallfnt; break;
-		default: return NULL;
-	}
+	return true;
+}
 
-	struct font_backed_data f;
-	f.w = 64;
-	f.h = 64;
-	f.cdata = malloc((0xFF - FONT_BAKE_START) * sizeof(stbtt_bakedchar));
-	CHECK_ALLOCATION_ERROR(f.cdata)
+static void font_atlas_reserve() {
+	font_atlas.x = font_atlas.row_height = FONT_ATLAS_WHITE + FONT_ATLAS_PADDING;
+	font_atlas.y = 0;
+}
 
-	void* temp_bitmap = NULL;
+// drops every glyph, layouts notice by their generation and are rebuilt on next use
+static void font_atlas_clear() {
+	ht_clear(&font_glyphs);
+	font_atlas_reserve();
+	font_atlas.generation++;
+}
 
+static void font_atlas_create() {
 	int max_size = 0;
 	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	font_atlas.size = min(max_size, FONT_ATLAS_SIZE);
 
-	while(1) {
-		temp_bitmap = realloc(temp_bitmap, f.w * f.h);
-		CHECK_ALLOCATION_ERROR(temp_bitmap)
-		int res = 0;
-		res = stbtt_BakeFontBitmap(file, 0, h, temp_bitmap, f.w, f.h, FONT_BAKE_START, 0xFF - FONT_BAKE_START, f.cdata);
-		if(res > 0 || (f.w == max_size && f.h == max_size))
-			break;
-		if(f.h > f.w)
-			f.w *= 2;
-		else
-			f.h *= 2;
-	}
+	unsigned char* empty = calloc(font_atlas.size * font_atlas.size, 1);
+	CHECK_ALLOCATION_ERROR(empty)
 
-	log_info("font texsize: %i:%ipx [size %f] type: %i", f.w, f.h, h, font_current_type);
+	for(int y = 0; y < FONT_ATLAS_WHITE; y++)
+		memset(empty + y * font_atlas.size, 0xFF, FONT_ATLAS_WHITE);
 
-	glGenTextures(1, &f.texture_id);
-	glBindTexture(GL_TEXTURE_2D, f.texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, f.w, f.h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, temp_bitmap);
+	glGenTextures(1, &font_atlas.texture_id);
+	glBindTexture(GL_TEXTURE_2D, font_atlas.texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, font_atlas.size, font_atlas.size, 0, GL_ALPHA, GL_UNSIGNED_BYTE, empty);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glBindTexture(GL_TEXTURE_2D, 0);
+	free(empty);
 
-	free(temp_bitmap);
+	font_atlas_reserve();
+}
 
-	ht_insert(&fonts_backed, &id, &f);
+static bool font_atlas_place(int w, int h, int* x, int* y) {
+	if(font_atlas.x + w > font_atlas.size) { // next row
+		font_atlas.x = 0;
+		font_atlas.y += font_atlas.row_height;
+		font_atlas.row_height = 0;
+	}
+
+	if(w > font_atlas.size || font_atlas.y + h > font_atlas.size)
+		return false;
 
-	return ht_lookup(&fonts_backed, &id);
+	*x = font_atlas.x;
+	*y = font_atlas.y;
+	font_atlas.x += w;
+	font_atlas.row_height = max(font_atlas.row_height, h);
+	return true;
 }
 
-float font_length(float h, char* text) {
-	struct font_backed_data* font = font_find(h);
+// rasterizes like stbtt_BakeFontBitmap() would, so text looks the same as before
+static bool font_glyph_find(enum font_type type, float size, int codepoint, struct font_glyph* out) {
+	struct font_glyph_id id = {
+		.type = type,
+		.size = size,
+		.codepoint = codepoint,
+	};
 
-	if(!font)
-		return 0.0F;
+	struct font_glyph* cached = ht_lookup(&font_glyphs, &id);
 
-	stbtt_aligned_quad q;
-	float y = h * 0.75F;
+	if(cached) {
+		*out = *cached;
+		return true;
+	}
+
+	if(!font_atlas.texture_id)
+		font_atlas_create();
+
+	stbtt_fontinfo* info = font_info + type;
+	float scale = stbtt_ScaleForPixelHeight(info, size);
+	int glyph = stbtt_FindGlyphIndex(info, codepoint);
+
+	int advance, lsb, x0, y0, x1, y1;
+	stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
+	stbtt_GetGlyphBitmapBox(info, glyph, scale, scale, &x0, &y0, &x1, &y1);
+
+	int w = x1 - x0;
+	int h = y1 - y0;
+	int x, y;
+
+	if(!font_atlas_place(w + FONT_ATLAS_PADDING, h + FONT_ATLAS_PADDING, &x, &y)) {
+		log_info("Font atlas full, clearing it");
+		font_atlas_clear();
+
+		if(!font_atlas_place(w + FONT_ATLAS_PADDING, h + FONT_ATLAS_PADDING, &x, &y))
+			return false;
+	}
+
+	if(w > 0 && h > 0) {
+		unsigned char* bitmap = malloc(w * h);
+		CHECK_ALLOCATION_ERROR(bitmap)
+		stbtt_MakeGlyphBitmap(info, bitmap, w, h, w, scale, scale, glyph);
+
+		glBindTexture(GL_TEXTURE_2D, font_atlas.texture_id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_ALPHA, GL_UNSIGNED_BYTE, bitmap);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		free(bitmap);
+	}
+
+	*out = (struct font_glyph) {
+		.x0 = x,
+		.y0 = y,
+		.x1 = x + w,
+		.y1 = y + h,
+		.xoff = x0,
+		.yoff = y0,
+		.xadvance = scale * advance,
+	};
+
+	ht_insert(&font_glyphs, &id, out);
+	return true;
+}
+
+// FNV-1a
+static uint64_t font_hash(const char* text) {
+	uint64_t hash = 14695981039346656037ULL;
+
+	while(*text)
+		hash = (hash ^ (unsigned char)*text++) * 1099511628211ULL;
+
+	return hash;
+}
+
+static void font_layout_build(struct font_layout* l, enum font_type type, float h, const char* text) {
+	size_t length = strlen(text);
+
+	l->vertices = realloc(l->vertices, length * 12 * sizeof(short));
+	CHECK_ALLOCATION_ERROR(l->vertices)
+	l->coords = realloc(l->coords, length * 12 * sizeof(short));
+	CHECK_ALLOCATION_ERROR(l->coords)
+
+	l->generation = font_atlas.generation;
+	l->count = 0;
+	l->length = 0.0F;
+
+	float scale = 8192.0F / font_atlas.size;
 	float x = 0.0F;
-	float length = 0.0F;
-	for(size_t k = 0; k < strlen(text); k++) {
+	float y = h * 0.75F;
+	short* v = l->vertices;
+	short* c = l->coords;
+
+	for(size_t k = 0; k < length; k++) {
 		if(text[k] == '\n') {
-			length = fmax(length, x);
+			l->length = fmax(l->length, x);
 			x = 0.0F;
+			y += h;
 		}
 
-		if(text[k] >= FONT_BAKE_START)
-			stbtt_GetBakedQuad(font->cdata, font->w, font->h, text[k] - FONT_BAKE_START, &x, &y, &q, 1);
+		struct font_glyph g;
+		if(text[k] < FONT_BAKE_START || !font_glyph_find(type, h, text[k], &g))
+			continue;
+
+		// an atlas that filled up meanwhile invalidated the glyphs placed so far
+		if(l->generation != font_atlas.generation)
+			return;
+
+		// as stbtt_GetBakedQuad() with the OpenGL fill rule
+		short x0 = floorf(x + g.xoff + 0.5F);
+		short y0 = floorf(y + g.yoff + 0.5F);
+		short x1 = x0 + g.x1 - g.x0;
+		short y1 = y0 + g.y1 - g.y0;
+		short s0 = g.x0 * scale, t0 = g.y0 * scale;
+		short s1 = g.x1 * scale, t1 = g.y1 * scale;
+
+		memcpy(v, (short[]) {x0, -y1, x1, -y1, x1, -y0, x0, -y1, x1, -y0, x0, -y0}, 12 * sizeof(short));
+		memcpy(c, (short[]) {s0, t1, s1, t1, s1, t0, s0, t1, s1, t0, s0, t0}, 12 * sizeof(short));
+		v += 12;
+		c += 12;
+		l->count += 6;
+
+		x += g.xadvance;
 	}
 
-	return fmax(length, x) + h * 0.125F;
+	l->length = fmax(l->length, x) + h * 0.125F;
 }
 
-bool font_remove_callback(void* key, void* value, void* user) {
-	struct font_backed_data* f = (struct font_backed_data*)value;
+// forgets layouts that were not used for a while
+static bool font_layout_remove_old(void* key, void* value, void* user) {
+	struct font_layout* l = (struct font_layout*)value;
 
-	glDeleteTextures(1, &f->texture_id);
-	free(f->cdata);
+	if(font_layout_clock - l->used < FONT_LAYOUT_MAX / 2)
+		return false;
 
-	return true;
+	return font_layout_remove_all(key, value, user);
 }
 
-void font_reset() {
-	ht_iterate_remove(&fonts_backed, NULL, font_remove_callback);
-}
+static struct font_layout* font_layout_find(float h, const char* text) {
+	if(font_current_type == FONT_SMALLFNT)
+		h *= 1.5F;
 
-void font_render(float x, float y, float h, char* text) {
-	struct font_backed_data* font = font_find(h);
+	struct font_layout_id id = {
+		.type = font_current_type,
+		.size = h,
+		.hash = font_hash(text),
+	};
 
-	if(!font)
-		return;
+	struct font_layout* l = ht_lookup(&font_layouts, &id);
 
-	size_t k = 0;
-	float x2 = x;
-	float y2 = h * 0.75F;
-	while(*text) {
-		if(*text == '\n') {
-			x2 = x;
-			y2 += h;
-		}
+	if(l && strcmp(l->text, text)) { // collision, the newer string takes over the slot
+		free(l->text);
+		l->text = strdup(text);
+		CHECK_ALLOCATION_ERROR(l->text)
+		l->generation = font_atlas.generation - 1;
+	}
 
-		if(*text >= FONT_BAKE_START) {
-			stbtt_aligned_quad q;
-			stbtt_GetBakedQuad(font->cdata, font->w, font->h, *text - FONT_BAKE_START, &x2, &y2, &q, 1);
-			font_coords_buffer[k + 0] = q.s0 * 8192.0F;
-			font_coords_buffer[k + 1] = q.t1 * 8192.0F;
-			font_coords_buffer[k + 2] = q.s1 * 8192.0F;
-			font_coords_buffer[k + 3] = q.t1 * 8192.0F;
-			font_coords_buffer[k + 4] = q.s1 * 8192.0F;
-			font_coords_buffer[k + 5] = q.t0 * 8192.0F;
-
-			font_coords_buffer[k + 6] = q.s0 * 8192.0F;
-			font_coords_buffer[k + 7] = q.t1 * 8192.0F;
-			font_coords_buffer[k + 8] = q.s1 * 8192.0F;
-			font_coords_buffer[k + 9] = q.t0 * 8192.0F;
-			font_coords_buffer[k + 10] = q.s0 * 8192.0F;
-			font_coords_buffer[k + 11] = q.t0 * 8192.0F;
-
-			font_vertex_buffer[k + 0] = q.x0;
-			font_vertex_buffer[k + 1] = -q.y1 + y;
-			font_vertex_buffer[k + 2] = q.x1;
-			font_vertex_buffer[k + 3] = -q.y1 + y;
-			font_vertex_buffer[k + 4] = q.x1;
-			font_vertex_buffer[k + 5] = -q.y0 + y;
-
-			font_vertex_buffer[k + 6] = q.x0;
-			font_vertex_buffer[k + 7] = -q.y1 + y;
-			font_vertex_buffer[k + 8] = q.x1;
-			font_vertex_buffer[k + 9] = -q.y0 + y;
-			font_vertex_buffer[k + 10] = q.x0;
-			font_vertex_buffer[k + 11] = -q.y0 + y;
-			k += 12;
-		}
+	if(!l) {
+		if(font_layouts.size >= FONT_LAYOUT_MAX)
+			ht_iterate_remove(&font_layouts, NULL, font_layout_remove_old);
+
+		struct font_layout empty = {
+			.text = strdup(text),
+			.generation = font_atlas.generation - 1,
+		};
+		CHECK_ALLOCATION_ERROR(empty.text)
+
+		ht_insert(&font_layouts, &id, &empty);
+		l = ht_lookup(&font_layouts, &id);
+	}
+
+	l->used = font_layout_clock++;
+
+	// a second attempt starts on an empty atlas
+	for(int k = 0; k < 2 && l->generation != font_atlas.generation; k++)
+		font_layout_build(l, font_current_type, h, text);
+
+	return l;
+}
+
+float font_length(float h, char* text) {
+	return font_layout_find(h, text)->length;
+}
 
-		text++;
+void font_reset() {
+	if(font_atlas.texture_id) {
+		glDeleteTextures(1, &font_atlas.texture_id);
+		font_atlas.texture_id = 0;
 	}
 
+	font_atlas_clear();
+	ht_iterate_remove(&font_layouts, NULL, font_layout_remove_all);
+}
+
+void font_render(float x, float y, float h, char* text) {
+	struct font_layout* l = font_layout_find(h, text);
+
+	if(!l->count)
+		return;
+
 	glMatrixMode(GL_TEXTURE);
 	glLoadIdentity();
 	glScalef(1.0F / 8192.0F, 1.0F / 8192.0F, 1.0F);
 	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glTranslatef((int)x, (int)y, 0.0F);
 
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, font->texture_id);
+	glBindTexture(GL_TEXTURE_2D, font_atlas.texture_id);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -231,9 +388,9 @@ void font_render(float x, float y, float h, char* text) {
 
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glVertexPointer(2, GL_SHORT, 0, font_vertex_buffer);
-	glTexCoordPointer(2, GL_SHORT, 0, font_coords_buffer);
-	glDrawArrays(GL_TRIANGLES, 0, k / 2);
+	glVertexPointer(2, GL_SHORT, 0, l->vertices);
+	glTexCoordPointer(2, GL_SHORT, 0, l->coords);
+	glDrawArrays(GL_TRIANGLES, 0, l->count);
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
 
@@ -241,6 +398,7 @@ void font_render(float x, float y, float h, char* text) {
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glDisable(GL_TEXTURE_2D);
 
+	glPopMatrix();
 	glMatrixMode(GL_TEXTURE);
 	glLoadIdentity();
 	glMatrixMode(GL_MODELVIEW);
@@ -250,3 +408,39 @@ void font_centered(float x, float y, float h, char* text) {
 	font_render(x - font_length(h, text) / 2.0F, y, h, text);
 }
 
+void font_batch(struct batch* b, float x, float y, float h, char* text) {
+	struct font_layout* l = font_layout_find(h, text);
+
+	if(!l->count)
+		return;
+
+	batch_texture(b, font_atlas.texture_id);
+
+	float scale = 1.0F / 8192.0F;
+
+	for(int k = 0; k < l->count; k += 6) {
+		short* v = l->vertices + k * 2;
+		short* c = l->coords + k * 2;
+
+		batch_rect(b, (int)x + v[0], (int)y + v[11], v[2] - v[0], v[11] - v[1], c[0] * scale, c[11] * scale,
+				   (c[2] - c[0]) * scale, (c[1] - c[11]) * scale);
+	}
+}
+
+void font_batch_centered(struct batch* b, float x, float y, float h, char* text) {
+	font_batch(b, x - font_length(h, text) / 2.0F, y, h, text);
+}
+
+void font_batch_rect(struct batch* b, float x, float y, float w, float h) {
+	if(!font_atlas.texture_id)
+		font_atlas_create();
+
+	float white = (float)FONT_ATLAS_WHITE / 2.0F / font_atlas.size;
+
+	batch_texture(b, font_atlas.texture_id);
+	batch_rect(b, x, y, w, h, white, white, 0.0F, 0.0F);
+}
+
+unsigned int font_generation() {
+	return font_atlas.generation;
+}
@@ -32,5 +32,14 @@ void font_render(float x, float y, float h, char* text);
 void font_centered(float x, float y, float h, char* text);
 void font_select(enum font_type type);
 
+struct batch;
+// same as font_render(), appended to a batch in the current color of the batch
+void font_batch(struct batch* b, float x, float y, float h, char* text);
+void font_batch_centered(struct batch* b, float x, float y, float h, char* text);
+// untextured quad from the glyph atlas, so it shares draw calls with text
+void font_batch_rect(struct batch* b, float x, float y, float w, float h);
+// changes whenever earlier font_batch() output became invalid
+unsigned int font_generation(void);
+
 #endif
 
@@ -19,6 +19,7 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "common.h"
 #include "camera.h"
@@ -220,6 +221,108 @@ void glx_displaylist_draw(struct glx_displaylist* x, int type) {
 #endif
 }
 
+static bool glx_stream_persistent() {
+#ifndef OPENGL_ES
+	return GLEW_ARB_buffer_storage;
+#else
+	return false;
+#endif
+}
+
+static void glx_stream_allocate(struct glx_stream* s) {
+	glGenBuffers(1, &s->buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, s->buffer);
+
+#ifndef OPENGL_ES
+	if(glx_stream_persistent()) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, s->size, NULL, flags);
+		s->mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, s->size, flags);
+	}
+#endif
+
+	if(!s->mapped)
+		glBufferData(GL_ARRAY_BUFFER, s->size, NULL, GL_STREAM_DRAW);
+
+	s->offset = 0;
+	for(int k = 0; k < GLX_STREAM_REGIONS; k++)
+		s->fences[k] = NULL;
+}
+
+void glx_stream_create(struct glx_stream* s, size_t size) {
+	s->size = (size + GLX_STREAM_REGIONS - 1) / GLX_STREAM_REGIONS * GLX_STREAM_REGIONS;
+	s->mapped = NULL;
+	glx_stream_allocate(s);
+}
+
+void glx_stream_destroy(struct glx_stream* s) {
+#ifndef OPENGL_ES
+	for(int k = 0; k < GLX_STREAM_REGIONS; k++) {
+		if(s->fences[k])
+			glDeleteSync(s->fences[k]);
+	}
+
+	if(s->mapped) {
+		glBindBuffer(GL_ARRAY_BUFFER, s->buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+#endif
+
+	glDeleteBuffers(1, &s->buffer);
+	s->mapped = NULL;
+}
+
+size_t glx_stream_upload(struct glx_stream* s, const void* data, size_t length) {
+	size_t region_size = s->size / GLX_STREAM_REGIONS;
+
+	if(length > region_size) {
+		glx_stream_destroy(s);
+		s->size = (length * 2 + region_size) * GLX_STREAM_REGIONS;
+		region_size = s->size / GLX_STREAM_REGIONS;
+		glx_stream_allocate(s);
+	}
+
+	size_t region = s->offset / region_size;
+
+	if(s->offset + length > (region + 1) * region_size) {
+		if(s->mapped) {
+#ifndef OPENGL_ES
+			// the gpu may still read from the region we left, remember when it is done
+			s->fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			region = (region + 1) % GLX_STREAM_REGIONS;
+
+			if(s->fences[region]) {
+				while(glClientWaitSync(s->fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+					;
+				glDeleteSync(s->fences[region]);
+				s->fences[region] = NULL;
+			}
+#endif
+		} else {
+			region = (region + 1) % GLX_STREAM_REGIONS;
+		}
+
+		s->offset = region * region_size;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, s->buffer);
+
+	if(s->mapped) {
+		memcpy((uint8_t*)s->mapped + s->offset, data, length);
+	} else {
+		// orphan the storage once all of it was used, the driver hands out fresh memory
+		if(s->offset == 0)
+			glBufferData(GL_ARRAY_BUFFER, s->size, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, s->offset, length, data);
+	}
+
+	size_t offset = s->offset;
+	s->offset += length;
+	return offset;
+}
+
 void glx_enable_sphericalfog() {
 #ifndef OPENGL_ES
 	if(!settings.smooth_fog) {
@@ -24,6 +24,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 extern int glx_version;
 extern int glx_fog;
@@ -37,6 +38,18 @@ struct glx_displaylist {
 	bool has_color;
 };
 
+#define GLX_STREAM_REGIONS 3
+
+// vertex buffer for data that is rewritten every frame, the gpu reads from one region
+// while the next one is filled, persistently mapped if the driver supports it
+struct glx_stream {
+	uint32_t buffer;
+	size_t size;
+	size_t offset;
+	void* mapped;
+	void* fences[GLX_STREAM_REGIONS];
+};
+
 enum {
 	GLX_DISPLAYLIST_NORMAL,
 	GLX_DISPLAYLIST_ENHANCED,
@@ -55,4 +68,9 @@ void glx_displaylist_destroy(struct glx_displaylist* x);
 void glx_displaylist_update(struct glx_displaylist* x, size_t size, int type, void* color, void* vertex, void* normal);
 void glx_displaylist_draw(struct glx_displaylist* x, int type);
 
+void glx_stream_create(struct glx_stream* s, size_t size);
+void glx_stream_destroy(struct glx_stream* s);
+// returns the byte offset of the copied data, the buffer is left bound to GL_ARRAY_BUFFER
+size_t glx_stream_upload(struct glx_stream* s, const void* data, size_t length);
+
 #endif
@@ -48,6 +48,8 @@
 #include "weapon.h"
 #include "tracer.h"
 #include "font.h"
+#include "asset.h"
+#include "batch.h"
 
 struct hud* hud_active;
 struct window_instance* hud_window;
@@ -60,11 +62,19 @@ static int is_inside(double mx, double my, int x, int y, int w, int h) {
 	return mx >= x && mx < x + w && my >= y && my < y + h;
 }
 
+static struct serverlist servers;
+static struct batch hud_minimap_batch;
+
 void hud_init() {
 	hud_serverlist.ctx = malloc(sizeof(mu_Context));
 	hud_settings.ctx = malloc(sizeof(mu_Context));
 	hud_controls.ctx = malloc(sizeof(mu_Context));
 
+	serverlist_create(&servers);
+	serverlist_load(&servers, SERVERLIST_CACHE);
+
+	batch_create(&hud_minimap_batch, 256);
+
 	hud_change(&hud_serverlist);
 }
 
@@ -116,6 +126,8 @@ static float hud_ingame_touch_y = 0.0F;
 int screen_current = SCREEN_NONE;
 int show_exit = 0;
 static void hud_ingame_init() {
+	asset_wait(ASSET_GROUP_GAME);
+
 	window_textinput(0);
 	chat_input_mode = CHAT_NO_INPUT;
 	show_exit = 0;
@@ -448,6 +460,259 @@ static int hud_ingame_onscreencontrol(int index, char* str, int activate) {
 	return 0;
 }
 
+static void hud_ingame_minimap(struct batch* b, float scalef) {
+	// large
+	if(window_key_down(WINDOW_KEY_MAP)) {
+		float minimap_x = (settings.window_width - (map_size_x + 1) * scalef) / 2.0F;
+		float minimap_y = ((600 - map_size_z - 1) / 2.0F + map_size_z + 1) * scalef;
+
+		texture_batch(b, &texture_minimap, minimap_x, minimap_y, 512 * scalef, 512 * scalef);
+
+		font_select(FONT_SMALLFNT);
+		char c[2] = {0};
+		for(int k = 0; k < 8; k++) {
+			c[0] = 'A' + k;
+			font_batch_centered(b, minimap_x + (64 * k + 32) * scalef, minimap_y + 8.0F * scalef, 8.0F * scalef,
+								c);
+			c[0] = '1' + k;
+			font_batch_centered(b, minimap_x - 8 * scalef, minimap_y - (64 * k + 32 - 4) * scalef,
+								8.0F * scalef, c);
+		}
+		font_select(FONT_FIXEDSYS);
+
+		tracer_minimap(b, 1, scalef, minimap_x, minimap_y);
+
+		if(gamestate.gamemode_type == GAMEMODE_CTF) {
+			if(!gamestate.gamemode.ctf.team_1_intel) {
+				batch_color(b, gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue, 255);
+				texture_batch_rotated(
+					b, &texture_intel,
+					minimap_x + gamestate.gamemode.ctf.team_1_intel_location.dropped.x * scalef,
+					minimap_y - gamestate.gamemode.ctf.team_1_intel_location.dropped.y * scalef, 12 * scalef,
+					12 * scalef, 0.0F);
+			}
+			if(map_object_visible(gamestate.gamemode.ctf.team_1_base.x, 0.0F,
+								  gamestate.gamemode.ctf.team_1_base.y)) {
+				batch_color(b, gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
+							gamestate.team_1.blue * 0.94F, 255);
+				texture_batch_rotated(b, NULL, minimap_x + gamestate.gamemode.ctf.team_1_base.x * scalef,
+									  minimap_y - gamestate.gamemode.ctf.team_1_base.y * scalef, 12 * scalef,
+									  12 * scalef, 0.0F);
+				batch_color(b, 255, 255, 255, 255);
+				texture_batch_rotated(b, &texture_medical,
+									  minimap_x + gamestate.gamemode.ctf.team_1_base.x * scalef,
+									  minimap_y - gamestate.gamemode.ctf.team_1_base.y * scalef, 12 * scalef,
+									  12 * scalef, 0.0F);
+			}
+
+			if(!gamestate.gamemode.ctf.team_2_intel) {
+				batch_color(b, gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue, 255);
+				texture_batch_rotated(
+					b, &texture_intel,
+					minimap_x + gamestate.gamemode.ctf.team_2_intel_location.dropped.x * scalef,
+					minimap_y - gamestate.gamemode.ctf.team_2_intel_location.dropped.y * scalef, 12 * scalef,
+					12 * scalef, 0.0F);
+			}
+			if(map_object_visible(gamestate.gamemode.ctf.team_2_base.x, 0.0F,
+								  gamestate.gamemode.ctf.team_2_base.y)) {
+				batch_color(b, gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
+							gamestate.team_2.blue * 0.94F, 255);
+				texture_batch_rotated(b, NULL, minimap_x + gamestate.gamemode.ctf.team_2_base.x * scalef,
+									  minimap_y - gamestate.gamemode.ctf.team_2_base.y * scalef, 12 * scalef,
+									  12 * scalef, 0.0F);
+				batch_color(b, 255, 255, 255, 255);
+				texture_batch_rotated(b, &texture_medical,
+									  minimap_x + gamestate.gamemode.ctf.team_2_base.x * scalef,
+									  minimap_y - gamestate.gamemode.ctf.team_2_base.y * scalef, 12 * scalef,
+									  12 * scalef, 0.0F);
+			}
+		}
+		if(gamestate.gamemode_type == GAMEMODE_TC) {
+			for(int k = 0; k < gamestate.gamemode.tc.territory_count; k++) {
+				switch(gamestate.gamemode.tc.territory[k].team) {
+					case TEAM_1:
+						batch_color(b, gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
+									gamestate.team_1.blue * 0.94F, 255);
+						break;
+					case TEAM_2:
+						batch_color(b, gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
+									gamestate.team_2.blue * 0.94F, 255);
+						break;
+					default:
+					case TEAM_SPECTATOR: batch_color(b, 0, 0, 0, 255);
+				}
+				texture_batch_rotated(b, &texture_command,
+									  minimap_x + gamestate.gamemode.tc.territory[k].x * scalef,
+									  minimap_y - gamestate.gamemode.tc.territory[k].y * scalef, 12 * scalef,
+									  12 * scalef, 0.0F);
+			}
+		}
+
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			if(players[k].connected && players[k].alive && k != local_player_id
+			   && players[k].team != TEAM_SPECTATOR
+			   && (players[k].team == players[local_player_id].team || camera_mode == CAMERAMODE_SPECTATOR)) {
+				switch(players[k].team) {
+					case TEAM_1:
+						batch_color(b, gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue,
+									255);
+						break;
+					case TEAM_2:
+						batch_color(b, gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue,
+									255);
+						break;
+				}
+				float ang = -atan2(players[k].orientation.z, players[k].orientation.x) - HALFPI;
+				texture_batch_rotated(b, &texture_player, minimap_x + players[k].pos.x * scalef,
+									  minimap_y - players[k].pos.z * scalef, 12 * scalef, 12 * scalef, ang);
+			}
+		}
+
+		batch_color(b, 0, 255, 255, 255);
+		texture_batch_rotated(b, &texture_player, minimap_x + camera_x * scalef, minimap_y - camera_z * scalef,
+							  12 * scalef, 12 * scalef, camera_rot_x + PI);
+		batch_color(b, 255, 255, 255, 255);
+	} else {
+		// minimized, top right
+		float view_x = camera_x - 64.0F; // min(max(camera_x-64.0F,0.0F),map_size_x+1-128.0F);
+		float view_z = camera_z - 64.0F; // min(max(camera_z-64.0F,0.0F),map_size_z+1-128.0F);
+
+		switch(players[local_player_id].team) {
+			case TEAM_1:
+				batch_color(b, gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue, 255);
+				break;
+			case TEAM_2:
+				batch_color(b, gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue, 255);
+				break;
+			case TEAM_SPECTATOR:
+			default: batch_color(b, 255, 255, 255, 255); // same as chat
+		}
+
+		char sector_str[3] = {(int)(camera_x / 64.0F) + 'A', (int)(camera_z / 64.0F) + '1', 0};
+		font_batch_centered(b, settings.window_width - 79 * scalef, 456 * scalef, 20.0F * scalef, sector_str);
+
+		batch_color(b, 0, 0, 0, 255);
+		texture_batch(b, NULL, settings.window_width - 144 * scalef, 586 * scalef, 130 * scalef, 130 * scalef);
+		batch_color(b, 255, 255, 255, 255);
+
+		texture_batch_sector(b, &texture_minimap, settings.window_width - 143 * scalef, 585 * scalef,
+							 128 * scalef, 128 * scalef, (camera_x - 64.0F) / 512.0F,
+							 (camera_z - 64.0F) / 512.0F, 0.25F, 0.25F);
+
+		tracer_minimap(b, 0, scalef, view_x, view_z);
+
+		if(gamestate.gamemode_type == GAMEMODE_CTF) {
+			float tent1_x = min(max(gamestate.gamemode.ctf.team_1_base.x, view_x), view_x + 128.0F) - view_x;
+			float tent1_y = min(max(gamestate.gamemode.ctf.team_1_base.y, view_z), view_z + 128.0F) - view_z;
+
+			float tent2_x = min(max(gamestate.gamemode.ctf.team_2_base.x, view_x), view_x + 128.0F) - view_x;
+			float tent2_y = min(max(gamestate.gamemode.ctf.team_2_base.y, view_z), view_z + 128.0F) - view_z;
+
+			if(map_object_visible(gamestate.gamemode.ctf.team_1_base.x, 0.0F,
+								  gamestate.gamemode.ctf.team_1_base.y)) {
+				batch_color(b, gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
+							gamestate.team_1.blue * 0.94F, 255);
+				texture_batch_rotated(b, NULL, settings.window_width - 143 * scalef + tent1_x * scalef,
+									  (585 - tent1_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+				batch_color(b, 255, 255, 255, 255);
+				texture_batch_rotated(b, &texture_medical,
+									  settings.window_width - 143 * scalef + tent1_x * scalef,
+									  (585 - tent1_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+			}
+			if(!gamestate.gamemode.ctf.team_1_intel) {
+				float intel_x
+					= min(max(gamestate.gamemode.ctf.team_1_intel_location.dropped.x, view_x), view_x + 128.0F)
+					- view_x;
+				float intel_y
+					= min(max(gamestate.gamemode.ctf.team_1_intel_location.dropped.y, view_z), view_z + 128.0F)
+					- view_z;
+				batch_color(b, gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue, 255);
+				texture_batch_rotated(b, &texture_intel,
+									  settings.window_width - 137 * scalef + intel_x * scalef,
+									  (585 - intel_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+			}
+
+			if(map_object_visible(gamestate.gamemode.ctf.team_2_base.x, 0.0F,
+								  gamestate.gamemode.ctf.team_2_base.y)) {
+				batch_color(b, gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
+							gamestate.team_2.blue * 0.94F, 255);
+				texture_batch_rotated(b, NULL, settings.window_width - 143 * scalef + tent2_x * scalef,
+									  (585 - tent2_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+				batch_color(b, 255, 255, 255, 255);
+				texture_batch_rotated(b, &texture_medical,
+									  settings.window_width - 143 * scalef + tent2_x * scalef,
+									  (585 - tent2_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+			}
+			if(!gamestate.gamemode.ctf.team_2_intel) {
+				float intel_x
+					= min(max(gamestate.gamemode.ctf.team_2_intel_location.dropped.x, view_x), view_x + 128.0F)
+					- view_x;
+				float intel_y
+					= min(max(gamestate.gamemode.ctf.team_2_intel_location.dropped.y, view_z), view_z + 128.0F)
+					- view_z;
+				batch_color(b, gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue, 255);
+				texture_batch_rotated(b, &texture_intel,
+									  settings.window_width - 143 * scalef + intel_x * scalef,
+									  (585 - intel_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+			}
+		}
+		if(gamestate.gamemode_type == GAMEMODE_TC) {
+			for(int k = 0; k < gamestate.gamemode.tc.territory_count; k++) {
+				switch(gamestate.gamemode.tc.territory[k].team) {
+					case TEAM_1:
+						batch_color(b, gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
+									gamestate.team_1.blue * 0.94F, 255);
+						break;
+					case TEAM_2:
+						batch_color(b, gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
+									gamestate.team_2.blue * 0.94F, 255);
+						break;
+					default:
+					case TEAM_SPECTATOR: batch_color(b, 0, 0, 0, 255);
+				}
+				float t_x = min(max(gamestate.gamemode.tc.territory[k].x, view_x), view_x + 128.0F) - view_x;
+				float t_y = min(max(gamestate.gamemode.tc.territory[k].y, view_z), view_z + 128.0F) - view_z;
+				texture_batch_rotated(b, &texture_command, settings.window_width - 143 * scalef + t_x * scalef,
+									  (585 - t_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
+			}
+		}
+
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			if(players[k].connected && players[k].alive
+			&& (players[k].team == players[local_player_id].team
+			|| (camera_mode == CAMERAMODE_SPECTATOR
+			&& (k == local_player_id || players[k].team != TEAM_SPECTATOR)))) {
+				if(k == local_player_id) {
+					batch_color(b, 0, 255, 255, 255);
+				} else {
+					switch(players[k].team) {
+						case TEAM_1:
+							batch_color(b, gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue,
+										255);
+							break;
+						case TEAM_2:
+							batch_color(b, gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue,
+										255);
+							break;
+					}
+				}
+
+				float player_x = ((k == local_player_id) ? camera_x : players[k].pos.x) - view_x;
+				float player_y = ((k == local_player_id) ? camera_z : players[k].pos.z) - view_z;
+				if(player_x > 0.0F && player_x < 128.0F && player_y > 0.0F && player_y < 128.0F) {
+					float ang = (k == local_player_id) ?
+						camera_rot_x + PI :
+						-atan2(players[k].orientation.z, players[k].orientation.x) - HALFPI;
+					texture_batch_rotated(b, &texture_player,
+										  settings.window_width - 143 * scalef + player_x * scalef,
+										  (585 - player_y) * scalef, 12 * scalef, 12 * scalef, ang);
+				}
+			}
+		}
+	}
+
+}
+
 static void hud_ingame_render(mu_Context* ctx, float scalex, float scalef) {
 	// window_mousemode(camera_mode==CAMERAMODE_SELECTION?WINDOW_CURSOR_ENABLED:WINDOW_CURSOR_DISABLED);
 	hud_active->render_localplayer = players[local_player_id].team != TEAM_SPECTATOR
@@ -497,8 +762,44 @@ static void hud_ingame_render(mu_Context* ctx, float scalex, float scalef) {
 				font_render(8.0F * scalex, 202.0F * scalef, 8.0F * scalef, dbg_str);
 				sprintf(dbg_str, "FPS: %i", (int)fps);
 				font_render(8.0F * scalex, 192.0F * scalef, 8.0F * scalef, dbg_str);
+				if(settings.network_thread) {
+					sprintf(dbg_str, "Latency: %.1f/%.1f ms", network_stats[1].avg_latency,
+							network_stats[1].max_latency);
+					font_render(8.0F * scalex, 182.0F * scalef, 8.0F * scalef, dbg_str);
+					sprintf(dbg_str, "Queues: %i/%i", network_stats[1].max_inbound, network_stats[1].max_outbound);
+					font_render(8.0F * scalex, 172.0F * scalef, 8.0F * scalef, dbg_str);
+				}
 			}
 		}
+
+		// packet types that took the most handler time during this connection
+		int top[8];
+		int top_count = 0;
+		for(int id = 0; id < 256; id++) {
+			if(!network_packet_stats[id].count)
+				continue;
+
+			int k = (top_count < 8) ? top_count++ : 8;
+			while(k > 0 && network_packet_stats[top[k - 1]].handler_time < network_packet_stats[id].handler_time) {
+				if(k < 8)
+					top[k] = top[k - 1];
+				k--;
+			}
+			if(k < 8)
+				top[k] = id;
+		}
+
+		char line[96];
+		glColor3f(1.0F, 1.0F, 0.0F);
+		font_render(8.0F * scalex + 150 * scalef, 320.0F * scalef, 8.0F * scalef,
+					"packet           count    KiB  total ms  max us  queue ms");
+		for(int k = 0; k < top_count; k++) {
+			struct network_packet_stat* p = network_packet_stats + top[k];
+			sprintf(line, "%-16s %6lu %6lu %9.1f %7.0f %9.2f", network_packet_name(top[k]), p->count, p->bytes / 1024,
+					p->handler_time * 1000.0, p->handler_max * 1000000.0, p->latency * 1000.0 / p->count);
+			font_render(8.0F * scalex + 150 * scalef, (310.0F - 10.0F * k) * scalef, 8.0F * scalef, line);
+		}
+
 		font_select(FONT_FIXEDSYS);
 		glColor3f(1.0F, 1.0F, 1.0F);
 	}
@@ -1014,239 +1315,20 @@ static void hud_ingame_render(mu_Context* ctx, float scalex, float scalef) {
 			}
 		}
 
-		// draw the minimap
+		// draw the minimap, markers of the same kind end up in one draw call
 		if(camera_mode != CAMERAMODE_SELECTION) {
-			glColor3f(1.0F, 1.0F, 1.0F);
-			// large
-			if(window_key_down(WINDOW_KEY_MAP)) {
-				float minimap_x = (settings.window_width - (map_size_x + 1) * scalef) / 2.0F;
-				float minimap_y = ((600 - map_size_z - 1) / 2.0F + map_size_z + 1) * scalef;
-
-				texture_draw(&texture_minimap, minimap_x, minimap_y, 512 * scalef, 512 * scalef);
-
-				font_select(FONT_SMALLFNT);
-				char c[2] = {0};
-				for(int k = 0; k < 8; k++) {
-					c[0] = 'A' + k;
-					font_centered(minimap_x + (64 * k + 32) * scalef, minimap_y + 8.0F * scalef, 8.0F * scalef, c);
-					c[0] = '1' + k;
-					font_centered(minimap_x - 8 * scalef, minimap_y - (64 * k + 32 - 4) * scalef, 8.0F * scalef, c);
-				}
-				font_select(FONT_FIXEDSYS);
-
-				tracer_minimap(1, scalef, minimap_x, minimap_y);
-
-				if(gamestate.gamemode_type == GAMEMODE_CTF) {
-					if(!gamestate.gamemode.ctf.team_1_intel) {
-						glColor3ub(gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue);
-						texture_draw_rotated(
-							&texture_intel, minimap_x + gamestate.gamemode.ctf.team_1_intel_location.dropped.x * scalef,
-							minimap_y - gamestate.gamemode.ctf.team_1_intel_location.dropped.y * scalef, 12 * scalef,
-							12 * scalef, 0.0F);
-					}
-					if(map_object_visible(gamestate.gamemode.ctf.team_1_base.x, 0.0F,
-										  gamestate.gamemode.ctf.team_1_base.y)) {
-						glColor3ub(gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
-								   gamestate.team_1.blue * 0.94F);
-						texture_draw_empty_rotated(minimap_x + gamestate.gamemode.ctf.team_1_base.x * scalef,
-												   minimap_y - gamestate.gamemode.ctf.team_1_base.y * scalef,
-												   12 * scalef, 12 * scalef, 0.0F);
-						glColor3f(1.0F, 1.0F, 1.0F);
-						texture_draw_rotated(
-							&texture_medical, minimap_x + gamestate.gamemode.ctf.team_1_base.x * scalef,
-							minimap_y - gamestate.gamemode.ctf.team_1_base.y * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-
-					if(!gamestate.gamemode.ctf.team_2_intel) {
-						glColor3ub(gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue);
-						texture_draw_rotated(
-							&texture_intel, minimap_x + gamestate.gamemode.ctf.team_2_intel_location.dropped.x * scalef,
-							minimap_y - gamestate.gamemode.ctf.team_2_intel_location.dropped.y * scalef, 12 * scalef,
-							12 * scalef, 0.0F);
-					}
-					if(map_object_visible(gamestate.gamemode.ctf.team_2_base.x, 0.0F,
-										  gamestate.gamemode.ctf.team_2_base.y)) {
-						glColor3ub(gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
-								   gamestate.team_2.blue * 0.94F);
-						texture_draw_empty_rotated(minimap_x + gamestate.gamemode.ctf.team_2_base.x * scalef,
-												   minimap_y - gamestate.gamemode.ctf.team_2_base.y * scalef,
-												   12 * scalef, 12 * scalef, 0.0F);
-						glColor3f(1.0F, 1.0F, 1.0F);
-						texture_draw_rotated(
-							&texture_medical, minimap_x + gamestate.gamemode.ctf.team_2_base.x * scalef,
-							minimap_y - gamestate.gamemode.ctf.team_2_base.y * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-				}
-				if(gamestate.gamemode_type == GAMEMODE_TC) {
-					for(int k = 0; k < gamestate.gamemode.tc.territory_count; k++) {
-						switch(gamestate.gamemode.tc.territory[k].team) {
-							case TEAM_1:
-								glColor3f(gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
-										  gamestate.team_1.blue * 0.94F);
-								break;
-							case TEAM_2:
-								glColor3f(gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
-										  gamestate.team_2.blue * 0.94F);
-								break;
-							default:
-							case TEAM_SPECTATOR: glColor3ub(0, 0, 0);
-						}
-						texture_draw_rotated(
-							&texture_command, minimap_x + gamestate.gamemode.tc.territory[k].x * scalef,
-							minimap_y - gamestate.gamemode.tc.territory[k].y * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-				}
-
-				for(int k = 0; k < PLAYERS_MAX; k++) {
-					if(players[k].connected && players[k].alive && k != local_player_id
-					   && players[k].team != TEAM_SPECTATOR
-					   && (players[k].team == players[local_player_id].team || camera_mode == CAMERAMODE_SPECTATOR)) {
-						switch(players[k].team) {
-							case TEAM_1:
-								glColor3ub(gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue);
-								break;
-							case TEAM_2:
-								glColor3ub(gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue);
-								break;
-						}
-						float ang = -atan2(players[k].orientation.z, players[k].orientation.x) - HALFPI;
-						texture_draw_rotated(&texture_player, minimap_x + players[k].pos.x * scalef,
-											 minimap_y - players[k].pos.z * scalef, 12 * scalef, 12 * scalef, ang);
-					}
-				}
-
-				glColor3f(0.0F, 1.0F, 1.0F);
-				texture_draw_rotated(&texture_player, minimap_x + camera_x * scalef, minimap_y - camera_z * scalef,
-									 12 * scalef, 12 * scalef, camera_rot_x + PI);
-				glColor3f(1.0F, 1.0F, 1.0F);
-			} else {
-				// minimized, top right
-				float view_x = camera_x - 64.0F; // min(max(camera_x-64.0F,0.0F),map_size_x+1-128.0F);
-				float view_z = camera_z - 64.0F; // min(max(camera_z-64.0F,0.0F),map_size_z+1-128.0F);
-
-				switch(players[local_player_id].team) {
-					case TEAM_1: glColor3ub(gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue); break;
-					case TEAM_2: glColor3ub(gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue); break;
-					case TEAM_SPECTATOR:
-					default: glColor3f(1.0F, 1.0F, 1.0F); // same as chat
-				}
-
-				char sector_str[3] = {(int)(camera_x / 64.0F) + 'A', (int)(camera_z / 64.0F) + '1', 0};
-				font_centered(settings.window_width - 79 * scalef, 456 * scalef, 20.0F * scalef, sector_str);
-
-				glColor3ub(0, 0, 0);
-				texture_draw_empty(settings.window_width - 144 * scalef, 586 * scalef, 130 * scalef, 130 * scalef);
-				glColor3f(1.0F, 1.0F, 1.0F);
-
-				texture_draw_sector(&texture_minimap, settings.window_width - 143 * scalef, 585 * scalef, 128 * scalef,
-									128 * scalef, (camera_x - 64.0F) / 512.0F, (camera_z - 64.0F) / 512.0F, 0.25F,
-									0.25F);
-
-				tracer_minimap(0, scalef, view_x, view_z);
-
-				if(gamestate.gamemode_type == GAMEMODE_CTF) {
-					float tent1_x = min(max(gamestate.gamemode.ctf.team_1_base.x, view_x), view_x + 128.0F) - view_x;
-					float tent1_y = min(max(gamestate.gamemode.ctf.team_1_base.y, view_z), view_z + 128.0F) - view_z;
-
-					float tent2_x = min(max(gamestate.gamemode.ctf.team_2_base.x, view_x), view_x + 128.0F) - view_x;
-					float tent2_y = min(max(gamestate.gamemode.ctf.team_2_base.y, view_z), view_z + 128.0F) - view_z;
-
-					if(map_object_visible(gamestate.gamemode.ctf.team_1_base.x, 0.0F,
-										  gamestate.gamemode.ctf.team_1_base.y)) {
-						glColor3ub(gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
-								   gamestate.team_1.blue * 0.94F);
-						texture_draw_empty_rotated(settings.window_width - 143 * scalef + tent1_x * scalef,
-												   (585 - tent1_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-						glColor3f(1.0F, 1.0F, 1.0F);
-						texture_draw_rotated(&texture_medical, settings.window_width - 143 * scalef + tent1_x * scalef,
-											 (585 - tent1_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-					if(!gamestate.gamemode.ctf.team_1_intel) {
-						float intel_x
-							= min(max(gamestate.gamemode.ctf.team_1_intel_location.dropped.x, view_x), view_x + 128.0F)
-							- view_x;
-						float intel_y
-							= min(max(gamestate.gamemode.ctf.team_1_intel_location.dropped.y, view_z), view_z + 128.0F)
-							- view_z;
-						glColor3ub(gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue);
-						texture_draw_rotated(&texture_intel, settings.window_width - 137 * scalef + intel_x * scalef,
-											 (585 - intel_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-
-					if(map_object_visible(gamestate.gamemode.ctf.team_2_base.x, 0.0F,
-										  gamestate.gamemode.ctf.team_2_base.y)) {
-						glColor3ub(gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
-								   gamestate.team_2.blue * 0.94F);
-						texture_draw_empty_rotated(settings.window_width - 143 * scalef + tent2_x * scalef,
-												   (585 - tent2_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-						glColor3f(1.0F, 1.0F, 1.0F);
-						texture_draw_rotated(&texture_medical, settings.window_width - 143 * scalef + tent2_x * scalef,
-											 (585 - tent2_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-					if(!gamestate.gamemode.ctf.team_2_intel) {
-						float intel_x
-							= min(max(gamestate.gamemode.ctf.team_2_intel_location.dropped.x, view_x), view_x + 128.0F)
-							- view_x;
-						float intel_y
-							= min(max(gamestate.gamemode.ctf.team_2_intel_location.dropped.y, view_z), view_z + 128.0F)
-							- view_z;
-						glColor3ub(gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue);
-						texture_draw_rotated(&texture_intel, settings.window_width - 143 * scalef + intel_x * scalef,
-											 (585 - intel_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-				}
-				if(gamestate.gamemode_type == GAMEMODE_TC) {
-					for(int k = 0; k < gamestate.gamemode.tc.territory_count; k++) {
-						switch(gamestate.gamemode.tc.territory[k].team) {
-							case TEAM_1:
-								glColor3f(gamestate.team_1.red * 0.94F, gamestate.team_1.green * 0.94F,
-										  gamestate.team_1.blue * 0.94F);
-								break;
-							case TEAM_2:
-								glColor3f(gamestate.team_2.red * 0.94F, gamestate.team_2.green * 0.94F,
-										  gamestate.team_2.blue * 0.94F);
-								break;
-							default:
-							case TEAM_SPECTATOR: glColor3ub(0, 0, 0);
-						}
-						float t_x = min(max(gamestate.gamemode.tc.territory[k].x, view_x), view_x + 128.0F) - view_x;
-						float t_y = min(max(gamestate.gamemode.tc.territory[k].y, view_z), view_z + 128.0F) - view_z;
-						texture_draw_rotated(&texture_command, settings.window_width - 143 * scalef + t_x * scalef,
-											 (585 - t_y) * scalef, 12 * scalef, 12 * scalef, 0.0F);
-					}
-				}
-
-				for(int k = 0; k < PLAYERS_MAX; k++) {
-					if(players[k].connected && players[k].alive
-					&& (players[k].team == players[local_player_id].team
-					|| (camera_mode == CAMERAMODE_SPECTATOR
-					&& (k == local_player_id || players[k].team != TEAM_SPECTATOR)))) {
-						if(k == local_player_id) {
-							glColor3ub(0, 255, 255);
-						} else {
-							switch(players[k].team) {
-								case TEAM_1:
-									glColor3ub(gamestate.team_1.red, gamestate.team_1.green, gamestate.team_1.blue);
-									break;
-								case TEAM_2:
-									glColor3ub(gamestate.team_2.red, gamestate.team_2.green, gamestate.team_2.blue);
-									break;
-							}
-						}
-
-						float player_x = ((k == local_player_id) ? camera_x : players[k].pos.x) - view_x;
-						float player_y = ((k == local_player_id) ? camera_z : players[k].pos.z) - view_z;
-						if(player_x > 0.0F && player_x < 128.0F && player_y > 0.0F && player_y < 128.0F) {
-							float ang = (k == local_player_id) ?
-								camera_rot_x + PI :
-								-atan2(players[k].orientation.z, players[k].orientation.x) - HALFPI;
-							texture_draw_rotated(&texture_player,
-												 settings.window_width - 143 * scalef + player_x * scalef,
-												 (585 - player_y) * scalef, 12 * scalef, 12 * scalef, ang);
-						}
-					}
-				}
+			struct batch* b = &hud_minimap_batch;
+			for(int k = 0; k < 2; k++) {
+				unsigned int generation = font_generation();
+				batch_clear(b);
+				hud_ingame_minimap(b, scalef);
+
+				// glyphs placed before the atlas was cleared are gone, another attempt starts on an empty atlas
+				if(generation == font_generation())
+					break;
 			}
+
+			batch_draw(b);
 		}
 
 		struct Camera_HitType hit;
@@ -1423,7 +1505,7 @@ static void hud_ingame_mouseclick(double x, double y, int button, int action, in
 			int* pos = camera_terrain_pick(0);
 			if(pos != NULL && pos[1] > 1
 			   && (pow(pos[0] - camera_x, 2) + pow(pos[1] - camera_y, 2) + pow(pos[2] - camera_z, 2)) < 5 * 5) {
-				int amount = map_cube_line(local_player_drag_x, local_player_drag_z, 63 - local_player_drag_y, pos[0],
+				int amount = sim_cube_line(local_player_drag_x, local_player_drag_z, 63 - local_player_drag_y, pos[0],
 										   pos[2], 63 - pos[1], NULL);
 				if(amount <= local_player_blocks) {
 					struct PacketBlockLine line;
@@ -2219,15 +2301,9 @@ struct hud hud_ingame = {
 
 /*         HUD_SERVERLIST START        */
 
-static http_t* request_serverlist = NULL;
 static http_t* request_version = NULL;
 static http_t* request_news = NULL;
-static int server_count = 0;
-static int player_count = 0;
-static struct serverlist_entry* serverlist;
 static int serverlist_is_outdated;
-static int serverlist_con_established;
-static pthread_mutex_t serverlist_lock;
 
 static struct serverlist_news_entry {
 	struct texture image;
@@ -2241,6 +2317,26 @@ static struct serverlist_news_entry {
 static int serverlist_news_exists = 0;
 static char serverlist_input[128];
 
+static void hud_serverlist_pingupdate(void* e, float time_delta, char* aos) {
+	if(!e) {
+		serverlist_set_ping(&servers, aos, ceil(time_delta * 1000.0F));
+	} else {
+		serverlist_add(&servers, e);
+	}
+}
+
+static void hud_serverlist_ping() {
+	ping_start(hud_serverlist_pingupdate);
+
+	for(int k = 0; k < servers.count; k++) {
+		int port;
+		char ip[32];
+		if(strcmp(servers.entries[k].country, "LAN")
+		   && network_identifier_split(servers.entries[k].identifier, ip, &port))
+			ping_check(ip, port, servers.entries[k].identifier);
+	}
+}
+
 static void hud_serverlist_init() {
 	ping_stop();
 	network_disconnect();
@@ -2249,93 +2345,22 @@ static void hud_serverlist_init() {
 
 	window_mousemode(WINDOW_CURSOR_ENABLED);
 
-	player_count = 0;
-	server_count = 0;
+	// the cached list is shown right away, a stale one is replaced once the fetch is done
+	int age = serverlist_age(&servers);
+	if(age < 0 || age >= SERVERLIST_CACHE_FRESH)
+		serverlist_fetch(&servers, SERVERLIST_URL, SERVERLIST_CACHE);
+	hud_serverlist_ping();
+
 	serverlist_is_outdated = 0;
-	request_serverlist = http_get("http://services.buildandshoot.com/serverlist.json", NULL);
 	request_version = http_get("http://aos.party/bs/version/", NULL);
 	if(!serverlist_news_exists)
 		request_news = http_get("http://aos.party/bs/news/", NULL);
 
-	serverlist_con_established = request_serverlist != NULL;
 	*serverlist_input = 0;
 
-	pthread_mutex_init(&serverlist_lock, NULL);
 	window_textinput(1);
 }
 
-static int hud_serverlist_sort(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	if(strcmp(aa->country, "LAN") == 0) {
-		return -1;
-	}
-	if(strcmp(bb->country, "LAN") == 0) {
-		return 1;
-	}
-
-	if(abs(aa->current - bb->current) == 0)
-		if(abs(aa->ping - bb->ping) == 0)
-			return strcmp(aa->name, bb->name);
-		else
-			return aa->ping - bb->ping;
-
-	return bb->current - aa->current;
-}
-
-static int hud_serverlist_sort_players(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	return bb->current - aa->current;
-}
-
-static int hud_serverlist_sort_name(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	return strcmp(aa->name, bb->name);
-}
-
-static int hud_serverlist_sort_map(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	return strcmp(aa->map, bb->map);
-}
-
-static int hud_serverlist_sort_mode(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	return strcmp(aa->gamemode, bb->gamemode);
-}
-
-static int hud_serverlist_sort_ping(const void* a, const void* b) {
-	struct serverlist_entry* aa = (struct serverlist_entry*)a;
-	struct serverlist_entry* bb = (struct serverlist_entry*)b;
-
-	return aa->ping - bb->ping;
-}
-
-static void hud_serverlist_pingupdate(void* e, float time_delta, char* aos) {
-	pthread_mutex_lock(&serverlist_lock);
-	if(!e) {
-		for(int k = 0; k < server_count; k++)
-			if(!strcmp(serverlist[k].identifier, aos)) {
-				serverlist[k].ping = ceil(time_delta * 1000.0F);
-				break;
-			}
-	} else {
-		serverlist = realloc(serverlist, (++server_count) * sizeof(struct serverlist_entry));
-		memcpy(serverlist + server_count - 1, e, sizeof(struct serverlist_entry));
-	}
-
-	qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort);
-	pthread_mutex_unlock(&serverlist_lock);
-}
-
 static void server_c(char* address, char* name) {
 	if(file_exists(address)) {
 		void* data = file_load(address);
@@ -2357,8 +2382,7 @@ static void server_c(char* address, char* name) {
 		} else {
 			rpc_seti(RPC_VALUE_SLOTS, 0);
 		}
-  		if(network_connect_string(address, VERSION_075))
-			hud_change(&hud_ingame);
+		network_connect_string(address, VERSION_075);
 	}
 }
 
@@ -2386,6 +2410,8 @@ static struct texture* hud_serverlist_ui_images(int icon_id, bool* resize) {
 }
 
 static void hud_serverlist_render(mu_Context* ctx, float scalex, float scaley) {
+	ping_poll();
+
 	glColor3f(0.5F, 0.5F, 0.5F);
 	float t = window_time() * 0.03125F;
 	texture_draw_sector(&texture_ui_bg, 0.0F, settings.window_height, settings.window_width, settings.window_height, t,
@@ -2415,7 +2441,12 @@ static void hud_serverlist_render(mu_Context* ctx, float scalex, float scaley) {
 		mu_text_color_default(ctx);
 
 		char total_str[128];
-		sprintf(total_str, (server_count > 0) ? "%i players on %i servers" : "No servers", player_count, server_count);
+		if(network_get_state() == NETWORK_STATE_CONNECTING || network_get_state() == NETWORK_STATE_CONFIRMING) {
+			sprintf(total_str, "Connecting... %.1fs", network_state_duration());
+		} else {
+			sprintf(total_str, (servers.count > 0) ? "%i players on %i servers%s" : "No servers", servers.players,
+					servers.count, (serverlist_status(&servers) == SERVERLIST_STATUS_FETCHING) ? ", updating" : "");
+		}
 		mu_button_ex(ctx, total_str, 0, MU_OPT_ALIGNRIGHT | MU_OPT_NOINTERACT);
 
 		mu_layout_row(ctx, 1, (int[]) {-1}, settings.window_height * 0.3F);
@@ -2456,8 +2487,8 @@ static void hud_serverlist_render(mu_Context* ctx, float scalex, float scaley) {
 		if(mu_button_ex(ctx, "Join", 16, MU_OPT_ALIGNRIGHT))
 			server_c(serverlist_input, NULL);
 
-		if(mu_button_ex(ctx, "Refresh", 17, MU_OPT_ALIGNRIGHT) && !request_serverlist)
-			hud_serverlist_init();
+		if(mu_button_ex(ctx, "Refresh", 17, MU_OPT_ALIGNRIGHT))
+			serverlist_fetch(&servers, SERVERLIST_URL, SERVERLIST_CACHE);
 
 		mu_layout_row(ctx, 1, (int[]) {-1}, -1);
 
@@ -2467,95 +2498,76 @@ static void hud_serverlist_render(mu_Context* ctx, float scalex, float scaley) {
 		int flag_width = ctx->style->size.y + ctx->style->padding * 2;
 		mu_layout_row(ctx, 5, (int[]) {0.12F * width, 0.418F * width, 0.22F * width, 0.117F * width, -1}, 0);
 
-		if(mu_button(ctx, "Players")) {
-			pthread_mutex_lock(&serverlist_lock);
-			qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort_players);
-			pthread_mutex_unlock(&serverlist_lock);
-		}
-		if(mu_button(ctx, "Name")) {
-			pthread_mutex_lock(&serverlist_lock);
-			qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort_name);
-			pthread_mutex_unlock(&serverlist_lock);
-		}
-		if(mu_button(ctx, "Map")) {
-			pthread_mutex_lock(&serverlist_lock);
-			qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort_map);
-			pthread_mutex_unlock(&serverlist_lock);
-		}
-		if(mu_button(ctx, "Mode")) {
-			pthread_mutex_lock(&serverlist_lock);
-			qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort_mode);
-			pthread_mutex_unlock(&serverlist_lock);
-		}
-		if(mu_button(ctx, "Ping")) {
-			pthread_mutex_lock(&serverlist_lock);
-			qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort_ping);
-			pthread_mutex_unlock(&serverlist_lock);
-		}
+		if(mu_button(ctx, "Players"))
+			serverlist_sort(&servers, SERVERLIST_ORDER_PLAYERS);
+		if(mu_button(ctx, "Name"))
+			serverlist_sort(&servers, SERVERLIST_ORDER_NAME);
+		if(mu_button(ctx, "Map"))
+			serverlist_sort(&servers, SERVERLIST_ORDER_MAP);
+		if(mu_button(ctx, "Mode"))
+			serverlist_sort(&servers, SERVERLIST_ORDER_MODE);
+		if(mu_button(ctx, "Ping"))
+			serverlist_sort(&servers, SERVERLIST_ORDER_PING);
 
 		mu_layout_row(ctx, 6,
 					  (int[]) {0.12F * width, flag_width, 0.418F * width - flag_width - ctx->style->spacing * 2,
 							   0.22F * width, 0.117F * width, -1},
 					  0);
 
-		pthread_mutex_lock(&serverlist_lock);
-		if(server_count > 0) {
-			for(int k = 0; k < server_count; k++) {
-				if(strstr(serverlist[k].name, serverlist_input) || strstr(serverlist[k].identifier, serverlist_input)
-				   || strstr(serverlist[k].map, serverlist_input) || strstr(serverlist[k].gamemode, serverlist_input)) {
-					if(serverlist[k].current >= 0)
-						sprintf(total_str, "%i/%i", serverlist[k].current, serverlist[k].max);
+		serverlist_filter(&servers, serverlist_input);
+
+		if(servers.count > 0) {
+			for(int k = 0; k < serverlist_visible_count(&servers); k++) {
+				struct serverlist_entry* e = serverlist_visible(&servers, k);
+
+				if(e->current >= 0)
+					sprintf(total_str, "%i/%i", e->current, e->max);
+				else
+					strcpy(total_str, "-");
+
+				int f = ((e->current && e->current < e->max) || e->current < 0) ? 1 : 2;
+
+				mu_push_id(ctx, e->identifier, strlen(e->identifier));
+
+				mu_text_color(ctx, 230 / f, 230 / f, 230 / f);
+				bool join = false;
+				if(mu_button_ex(ctx, total_str, 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
+					join = true;
+				if(mu_button_ex(ctx, "", texture_flag_index(e->country) + HUD_FLAG_INDEX_START, MU_OPT_NOFRAME))
+					join = true;
+				if(mu_button_ex(ctx, e->name, 0, MU_OPT_NOFRAME))
+					join = true;
+				if(mu_button_ex(ctx, e->map, 0, MU_OPT_NOFRAME))
+					join = true;
+				if(mu_button_ex(ctx, e->gamemode, 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
+					join = true;
+
+				if(e->ping >= 0) {
+					if(e->ping < 110)
+						mu_text_color(ctx, 0, 255 / f, 0);
+					else if(e->ping < 200)
+						mu_text_color(ctx, 255 / f, 255 / f, 0);
 					else
-						strcpy(total_str, "-");
-
-					int f = ((serverlist[k].current && serverlist[k].current < serverlist[k].max)
-							 || serverlist[k].current < 0) ?
-						1 :
-						2;
-
-					mu_push_id(ctx, &serverlist[k].identifier, strlen(serverlist[k].identifier));
-
-					mu_text_color(ctx, 230 / f, 230 / f, 230 / f);
-					bool join = false;
-					if(mu_button_ex(ctx, total_str, 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
-						join = true;
-					if(mu_button_ex(ctx, "", texture_flag_index(serverlist[k].country) + HUD_FLAG_INDEX_START,
-									MU_OPT_NOFRAME))
-						join = true;
-					if(mu_button_ex(ctx, serverlist[k].name, 0, MU_OPT_NOFRAME))
-						join = true;
-					if(mu_button_ex(ctx, serverlist[k].map, 0, MU_OPT_NOFRAME))
-						join = true;
-					if(mu_button_ex(ctx, serverlist[k].gamemode, 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
-						join = true;
-
-					if(serverlist[k].ping >= 0) {
-						if(serverlist[k].ping < 110)
-							mu_text_color(ctx, 0, 255 / f, 0);
-						else if(serverlist[k].ping < 200)
-							mu_text_color(ctx, 255 / f, 255 / f, 0);
-						else
-							mu_text_color(ctx, 255 / f, 0, 0);
-					}
+						mu_text_color(ctx, 255 / f, 0, 0);
+				}
 
-					sprintf(total_str, "%ims", serverlist[k].ping);
-					if(mu_button_ex(ctx, (serverlist[k].ping >= 0) ? total_str : "?", 0,
-									MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
-						join = true;
+				sprintf(total_str, "%ims", e->ping);
+				if(mu_button_ex(ctx, (e->ping >= 0) ? total_str : "?", 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER))
+					join = true;
 
-					mu_pop_id(ctx);
+				mu_pop_id(ctx);
 
-					if(join) {
-						server_c(serverlist[k].identifier, serverlist[k].name);
-						break;
-					}
+				if(join) {
+					server_c(e->identifier, e->name);
+					break;
 				}
 			}
 		} else {
 			mu_layout_row(ctx, 1, (int[]) {-1}, 0);
-			mu_button_ex(ctx, "Fetching servers...", 0, MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER);
+			bool failed = serverlist_status(&servers) == SERVERLIST_STATUS_FAILED;
+			mu_button_ex(ctx, failed ? "Could not fetch servers" : "Fetching servers...", 0,
+						 MU_OPT_NOFRAME | MU_OPT_ALIGNCENTER);
 		}
-		pthread_mutex_unlock(&serverlist_lock);
 		mu_text_color_default(ctx);
 		mu_end_panel(ctx);
 
@@ -2654,61 +2666,8 @@ static void hud_serverlist_render(mu_Context* ctx, float scalex, float scaley) {
 		}
 	}
 
-	int render_status_icon = !serverlist_con_established;
-	if(request_serverlist) {
-		switch(http_process(request_serverlist)) {
-			case HTTP_STATUS_PENDING: render_status_icon = 1; break;
-			case HTTP_STATUS_COMPLETED: {
-				JSON_Value* js = json_parse_string(request_serverlist->response_data);
-				JSON_Array* servers = json_value_get_array(js);
-				server_count = json_array_get_count(servers);
-
-				pthread_mutex_lock(&serverlist_lock);
-				serverlist = realloc(serverlist, server_count * sizeof(struct serverlist_entry));
-				CHECK_ALLOCATION_ERROR(serverlist)
-
-				ping_start(hud_serverlist_pingupdate);
-
-				player_count = 0;
-				for(int k = 0; k < server_count; k++) {
-					JSON_Object* s = json_array_get_object(servers, k);
-					memset(&serverlist[k], 0, sizeof(struct serverlist_entry));
-
-					serverlist[k].current = (int)json_object_get_number(s, "players_current");
-					serverlist[k].max = (int)json_object_get_number(s, "players_max");
-					serverlist[k].ping = -1;
-
-					strncpy(serverlist[k].name, json_object_get_string(s, "name"), sizeof(serverlist[k].name) - 1);
-					strncpy(serverlist[k].map, json_object_get_string(s, "map"), sizeof(serverlist[k].map) - 1);
-					strncpy(serverlist[k].gamemode, json_object_get_string(s, "game_mode"),
-							sizeof(serverlist[k].gamemode) - 1);
-					strncpy(serverlist[k].identifier, json_object_get_string(s, "identifier"),
-							sizeof(serverlist[k].identifier) - 1);
-					strncpy(serverlist[k].country, json_object_get_string(s, "country"),
-							sizeof(serverlist[k].country) - 1);
-
-					int port;
-					char ip[32];
-					if(network_identifier_split(serverlist[k].identifier, ip, &port))
-						ping_check(ip, port, serverlist[k].identifier);
-
-					player_count += serverlist[k].current;
-				}
-
-				qsort(serverlist, server_count, sizeof(struct serverlist_entry), hud_serverlist_sort);
-				pthread_mutex_unlock(&serverlist_lock);
-
-				http_release(request_serverlist);
-				json_value_free(js);
-				request_serverlist = NULL;
-				break;
-			}
-			case HTTP_STATUS_FAILED:
-				http_release(request_serverlist);
-				hud_serverlist_init();
-				break;
-		}
-	}
+	if(serverlist_update(&servers))
+		hud_serverlist_ping();
 }
 
 static void hud_serverlist_touch(void* finger, int action, float x, float y, float dx, float dy) {
@@ -2720,6 +2679,11 @@ static void hud_serverlist_touch(void* finger, int action, float x, float y, flo
 	}*/
 }
 
+static void hud_serverlist_network_progress(enum network_state state, const char* reason) {
+	if(state == NETWORK_STATE_CONNECTED)
+		hud_change(&hud_ingame);
+}
+
 struct hud hud_serverlist = {
 	hud_serverlist_init,
 	NULL,
@@ -2733,6 +2697,7 @@ struct hud hud_serverlist = {
 	0,
 	0,
 	NULL,
+	hud_serverlist_network_progress,
 };
 
 /*         HUD_SETTINGS START        */
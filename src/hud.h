@@ -25,6 +25,8 @@
 #include "microui.h"
 #include "texture.h"
 #include "window.h"
+#include "network.h"
+#include "serverlist.h"
 
 struct hud {
 	void (*init)();
@@ -39,16 +41,7 @@ struct hud {
 	char render_world;
 	char render_localplayer;
 	mu_Context* ctx;
-};
-
-struct serverlist_entry {
-	int current, max;
-	char name[32];
-	char map[21];
-	char gamemode[8];
-	int ping;
-	char identifier[32];
-	char country[4];
+	void (*network_progress)(enum network_state state, const char* reason);
 };
 
 extern int screen_current;
@@ -0,0 +1,292 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "kv6mesh.h"
+
+#define KV6MESH_MAGIC 0x4D36564B // "KV6M"
+#define KV6MESH_VERSION 1
+
+struct kv6mesh_grid {
+	int width, height;	// padded
+	uint32_t* cell;		// voxel index + 1, zero is empty
+	uint8_t* marked;	// faces already merged into a quad
+};
+
+static inline int kv6mesh_cell(const struct kv6mesh_grid* g, int x, int y, int z) {
+	return (x + 1) + g->width * ((y + 1) + g->height * (z + 1));
+}
+
+static void kv6mesh_add(struct kv6_mesh* mesh, int* capacity, struct kv6_quad q) {
+	if(mesh->count == *capacity) {
+		*capacity = *capacity ? *capacity * 2 : 64;
+		mesh->quads = realloc(mesh->quads, *capacity * sizeof(struct kv6_quad));
+		assert(mesh->quads != NULL);
+	}
+
+	mesh->quads[mesh->count++] = q;
+}
+
+// grows a rectangle from origin, first along b until the first row ends, then row by row along a
+static void kv6mesh_merge(struct kv6mesh_grid* g, const struct kv6_voxel* voxels, int origin, uint8_t face,
+						  int step_a, int step_b, int* max_a, int* max_b) {
+	uint32_t rgb = voxels[g->cell[origin] - 1].color & 0xFFFFFF;
+
+	for(int a = 0; a < *max_a; a++) {
+		int row = origin + a * step_a;
+		int b;
+
+		for(b = 0; b < *max_b; b++) {
+			int c = row + b * step_b;
+			uint32_t v = g->cell[c];
+
+			if(!v || !(voxels[v - 1].visfaces & face) || (voxels[v - 1].color & 0xFFFFFF) != rgb
+			   || g->marked[c] & face)
+				break;
+
+			g->marked[c] |= face;
+		}
+
+		if(a == 0)
+			*max_b = b;
+
+		if(b < *max_b) { // early abort, this row stays free for other quads
+			*max_a = a;
+
+			for(int k = 0; k < b; k++)
+				g->marked[row + k * step_b] &= ~face;
+
+			break;
+		}
+	}
+}
+
+void kv6mesh_build(struct kv6_mesh* mesh, const struct kv6_voxel* voxels, int voxel_count, int xsiz, int ysiz,
+				   int zsiz, bool greedy) {
+	assert(mesh != NULL && (voxels != NULL || voxel_count == 0));
+
+	*mesh = (struct kv6_mesh) {
+		.greedy = greedy,
+	};
+
+	struct kv6mesh_grid g = {
+		.width = xsiz + 2,
+		.height = ysiz + 2,
+	};
+
+	size_t cells = (size_t)g.width * g.height * (zsiz + 2);
+	g.cell = calloc(cells, sizeof(uint32_t));
+	g.marked = calloc(cells, sizeof(uint8_t));
+	assert(g.cell != NULL && g.marked != NULL);
+
+	for(int k = 0; k < voxel_count; k++) {
+		if(voxels[k].x < xsiz && voxels[k].y < ysiz && voxels[k].z < zsiz)
+			g.cell[kv6mesh_cell(&g, voxels[k].x, voxels[k].y, voxels[k].z)] = k + 1;
+	}
+
+	int step_x = 1;
+	int step_y = g.width;
+	int step_z = g.width * g.height;
+	int capacity = 0;
+
+	// same face order as before, later faces only merge what earlier ones left over
+	static const uint8_t faces[6] = {
+		KV6_VIS_POS_Y, KV6_VIS_NEG_Y, KV6_VIS_NEG_Z, KV6_VIS_POS_Z, KV6_VIS_NEG_X, KV6_VIS_POS_X,
+	};
+
+	for(int k = 0; k < voxel_count; k++) {
+		const struct kv6_voxel* v = voxels + k;
+
+		if(v->x >= xsiz || v->y >= ysiz || v->z >= zsiz)
+			continue;
+
+		int origin = kv6mesh_cell(&g, v->x, v->y, v->z);
+
+		for(int f = 0; f < 6; f++) {
+			uint8_t face = faces[f];
+
+			if(!(v->visfaces & face) || g.marked[origin] & face)
+				continue;
+
+			int a = 1, b = 1;
+			struct kv6_quad q = {
+				.x = v->x,
+				.y = v->z,
+				.z = v->y,
+				.color = v->color,
+				.face = face,
+			};
+
+			switch(face) {
+				case KV6_VIS_POS_Y:
+				case KV6_VIS_NEG_Y:
+					if(greedy) {
+						a = xsiz;
+						b = ysiz;
+						kv6mesh_merge(&g, voxels, origin, face, step_x, step_y, &a, &b);
+					}
+
+					q.sx = a;
+					q.sy = 1;
+					q.sz = b;
+					break;
+				case KV6_VIS_NEG_Z:
+				case KV6_VIS_POS_Z:
+					if(greedy) {
+						a = xsiz;
+						b = zsiz;
+						kv6mesh_merge(&g, voxels, origin, face, step_x, -step_z, &a, &b);
+					}
+
+					q.y -= b - 1;
+					q.sx = a;
+					q.sy = b;
+					q.sz = 1;
+					break;
+				case KV6_VIS_NEG_X:
+				case KV6_VIS_POS_X:
+					if(greedy) {
+						a = ysiz;
+						b = zsiz;
+						kv6mesh_merge(&g, voxels, origin, face, -step_z, step_y, &a, &b);
+					}
+
+					q.y -= a - 1;
+					q.sx = 1;
+					q.sy = a;
+					q.sz = b;
+					break;
+			}
+
+			kv6mesh_add(mesh, &capacity, q);
+		}
+	}
+
+	free(g.cell);
+	free(g.marked);
+}
+
+void kv6mesh_destroy(struct kv6_mesh* mesh) {
+	assert(mesh != NULL);
+
+	free(mesh->quads);
+	mesh->quads = NULL;
+	mesh->count = 0;
+}
+
+static uint32_t kv6mesh_hash(uint32_t hash, uint32_t value) {
+	for(int k = 0; k < 4; k++, value >>= 8)
+		hash = (hash ^ (value & 0xFF)) * 16777619u;
+
+	return hash;
+}
+
+uint32_t kv6mesh_key(const struct kv6_voxel* voxels, int voxel_count, int xsiz, int ysiz, int zsiz, bool greedy) {
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	hash = kv6mesh_hash(hash, KV6MESH_VERSION);
+	hash = kv6mesh_hash(hash, greedy);
+	hash = kv6mesh_hash(hash, xsiz);
+	hash = kv6mesh_hash(hash, ysiz);
+	hash = kv6mesh_hash(hash, zsiz);
+
+	for(int k = 0; k < voxel_count; k++) {
+		hash = kv6mesh_hash(hash, voxels[k].x | (voxels[k].y << 16));
+		hash = kv6mesh_hash(hash, voxels[k].z | (voxels[k].visfaces << 16));
+		hash = kv6mesh_hash(hash, voxels[k].color);
+	}
+
+	return hash;
+}
+
+struct kv6mesh_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t key;
+	uint32_t count;
+	uint32_t greedy;
+};
+
+bool kv6mesh_load(struct kv6_mesh* mesh, const char* filename, uint32_t key) {
+	assert(mesh != NULL && filename != NULL);
+
+	FILE* f = fopen(filename, "rb");
+	if(!f)
+		return false;
+
+	struct kv6mesh_header header;
+	bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == KV6MESH_MAGIC
+		&& header.version == KV6MESH_VERSION && header.key == key;
+
+	*mesh = (struct kv6_mesh) {0};
+
+	if(ok && header.count > 0) {
+		mesh->quads = malloc(header.count * sizeof(struct kv6_quad));
+		ok = mesh->quads && fread(mesh->quads, sizeof(struct kv6_quad), header.count, f) == header.count;
+	}
+
+	fclose(f);
+
+	if(!ok) {
+		kv6mesh_destroy(mesh);
+		return false;
+	}
+
+	mesh->count = header.count;
+	mesh->greedy = header.greedy;
+	return true;
+}
+
+bool kv6mesh_save(const struct kv6_mesh* mesh, const char* filename, uint32_t key) {
+	assert(mesh != NULL && filename != NULL);
+
+	char tmp[strlen(filename) + 5];
+	sprintf(tmp, "%s.tmp", filename);
+
+	FILE* f = fopen(tmp, "wb");
+	if(!f)
+		return false;
+
+	struct kv6mesh_header header = {
+		.magic = KV6MESH_MAGIC,
+		.version = KV6MESH_VERSION,
+		.key = key,
+		.count = mesh->count,
+		.greedy = mesh->greedy,
+	};
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(mesh->quads, sizeof(struct kv6_quad), mesh->count, f) == (size_t)mesh->count;
+	ok = !fclose(f) && ok;
+
+	// another client may have written the same mesh meanwhile, the content is identical
+	remove(filename);
+
+	if(!ok || rename(tmp, filename)) {
+		remove(tmp);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,65 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef KV6MESH_H
+#define KV6MESH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define KV6_VIS_NEG_X (1 << 0)
+#define KV6_VIS_POS_X (1 << 1)
+#define KV6_VIS_NEG_Z (1 << 2)
+#define KV6_VIS_POS_Z (1 << 3)
+#define KV6_VIS_POS_Y (1 << 4)
+#define KV6_VIS_NEG_Y (1 << 5)
+
+struct kv6_voxel {
+	uint16_t x, y, z;
+	uint8_t visfaces;
+	uint32_t color;
+};
+
+// one merged face in model space (x, kv6 z, kv6 y) with its extent, ready for the tesselator
+struct kv6_quad {
+	int16_t x, y, z;
+	int16_t sx, sy, sz;
+	uint32_t color; // of the first voxel, normal index in the upper byte
+	uint8_t face;	// one of KV6_VIS_*
+};
+
+struct kv6_mesh {
+	struct kv6_quad* quads;
+	int count;
+	bool greedy;
+};
+
+// merges faces of equal color like the old per voxel greedy mesher did, voxel order matters,
+// neighbours come from a dense grid with one empty cell of padding around the model
+void kv6mesh_build(struct kv6_mesh* mesh, const struct kv6_voxel* voxels, int voxel_count, int xsiz, int ysiz,
+				   int zsiz, bool greedy);
+void kv6mesh_destroy(struct kv6_mesh* mesh);
+
+// identifies a model and mesher setting for the mesh cache
+uint32_t kv6mesh_key(const struct kv6_voxel* voxels, int voxel_count, int xsiz, int ysiz, int zsiz, bool greedy);
+bool kv6mesh_load(struct kv6_mesh* mesh, const char* filename, uint32_t key);
+bool kv6mesh_save(const struct kv6_mesh* mesh, const char* filename, uint32_t key);
+
+#endif
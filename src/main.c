@@ -45,7 +45,12 @@
 #include "matrix.h"
 #include "texture.h"
 #include "chunk.h"
+#include "minimap.h"
 #include "main.h"
+#include "asset.h"
+#include "pack.h"
+#include "batch.h"
+#include "profiler.h"
 
 int fps = 0;
 
@@ -85,6 +90,8 @@ void chat_showpopup(const char* msg, float duration, int color) {
 }
 
 void drawScene() {
+	PROFILE_SCOPE("drawScene");
+
 	if(settings.ambient_occlusion) {
 		glShadeModel(GL_SMOOTH);
 	} else {
@@ -174,7 +181,79 @@ void drawScene() {
 	}
 }
 
+static struct batch display_ui_batch;
+
+static uint64_t display_ui_key(mu_Context* ctx) {
+	uint64_t key = batch_hash(BATCH_HASH_START, &settings.window_height, sizeof(settings.window_height));
+	key = batch_hash(key, (unsigned int[]) {font_generation()}, sizeof(unsigned int));
+
+	mu_Command* cmd = NULL;
+	while(mu_next_command(ctx, &cmd))
+		key = batch_hash(key, cmd, cmd->base.size);
+
+	return key;
+}
+
+static void display_ui_build(mu_Context* ctx, struct batch* b) {
+	mu_Command* cmd = NULL;
+	while(mu_next_command(ctx, &cmd)) {
+		switch(cmd->type) {
+			case MU_COMMAND_TEXT:
+				batch_color(b, cmd->text.color.r, cmd->text.color.g, cmd->text.color.b, cmd->text.color.a);
+				font_batch(b, cmd->text.pos.x, settings.window_height - cmd->text.pos.y,
+						   ctx->text_height(cmd->text.font), cmd->text.str);
+				break;
+			case MU_COMMAND_RECT:
+				batch_color(b, cmd->rect.color.r, cmd->rect.color.g, cmd->rect.color.b, cmd->rect.color.a);
+				font_batch_rect(b, cmd->rect.rect.x, settings.window_height - cmd->rect.rect.y, cmd->rect.rect.w,
+								cmd->rect.rect.h);
+				break;
+			case MU_COMMAND_ICON:
+				batch_color(b, cmd->icon.color.r, cmd->icon.color.g, cmd->icon.color.b, cmd->icon.color.a);
+				int size = min(cmd->icon.rect.w, cmd->icon.rect.h);
+
+				if(cmd->icon.id >= HUD_FLAG_INDEX_START - 1) {
+					float u, v;
+					texture_flag_offset(cmd->icon.id - HUD_FLAG_INDEX_START, &u, &v);
+
+					texture_batch_sector(b, &texture_ui_flags, cmd->icon.rect.x,
+										 settings.window_height - cmd->icon.rect.y - size * 0.167F, size,
+										 size * 0.667F, u, v, 18.0F / 256.0F, 12.0F / 256.0F);
+				} else if(hud_active->ui_images) {
+					bool resize = false;
+					struct texture* img = hud_active->ui_images(cmd->icon.id, &resize);
+
+					if(img)
+						texture_batch(b, img, cmd->icon.rect.x, settings.window_height - cmd->icon.rect.y,
+									  resize ? size : cmd->icon.rect.w, resize ? size : cmd->icon.rect.h);
+				}
+
+				break;
+			case MU_COMMAND_CLIP:
+				batch_scissor(b, cmd->clip.rect.x, settings.window_height - (cmd->clip.rect.y + cmd->clip.rect.h),
+							  cmd->clip.rect.w, cmd->clip.rect.h);
+				break;
+		}
+	}
+}
+
+// menus mostly look the same from one frame to the next, then the previous batch is drawn again
+static void display_ui(mu_Context* ctx) {
+	for(int k = 0; k < 2 && !batch_retained(&display_ui_batch, display_ui_key(ctx)); k++) {
+		unsigned int generation = font_generation();
+		display_ui_build(ctx, &display_ui_batch);
+
+		// glyphs placed before the atlas was cleared are gone, another attempt starts on an empty atlas
+		if(generation == font_generation())
+			break;
+	}
+
+	batch_draw(&display_ui_batch);
+}
+
 void display() {
+	PROFILE_SCOPE("display");
+
 	if(network_map_transfer) {
 		glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
 	} else {
@@ -186,6 +265,7 @@ void display() {
 		glDepthRange(0.0F, 1.0F);
 
 		chunk_update_all();
+		minimap_upload();
 
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -209,7 +289,9 @@ void display() {
 
 		if(!network_map_transfer) {
 			glx_enable_sphericalfog();
+			PROFILE_GPU_BEGIN("scene");
 			drawScene();
+			PROFILE_GPU_END();
 
 			int render_fpv = (camera_mode == CAMERAMODE_FPS)
 				|| ((camera_mode == CAMERAMODE_BODYVIEW || camera_mode == CAMERAMODE_SPECTATOR)
@@ -282,7 +364,7 @@ void display() {
 				int amount = 0;
 				if(is_local && local_player_drag_active && players[local_player_id].input.buttons.rmb
 				   && players[local_player_id].held_item == TOOL_BLOCK) {
-					amount = map_cube_line(local_player_drag_x, local_player_drag_z, 63 - local_player_drag_y, pos[0],
+					amount = sim_cube_line(local_player_drag_x, local_player_drag_z, 63 - local_player_drag_y, pos[0],
 										   pos[2], 63 - pos[1], cubes);
 				} else {
 					amount = 1;
@@ -394,6 +476,8 @@ void display() {
 	float scalex = settings.window_width / 800.0F;
 	float scalef = settings.window_height / 600.0F;
 
+	PROFILE_GPU_BEGIN("hud");
+
 	if(hud_active->render_2D) {
 		mu_Context* ctx = hud_active->ctx;
 
@@ -412,58 +496,17 @@ void display() {
 		if(ctx) {
 			mu_end(ctx);
 
-			glEnable(GL_BLEND);
-			glEnable(GL_SCISSOR_TEST);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			mu_Command* cmd = NULL;
-			while(mu_next_command(ctx, &cmd)) {
-				switch(cmd->type) {
-					case MU_COMMAND_TEXT:
-						glColor4ub(cmd->text.color.r, cmd->text.color.g, cmd->text.color.b, cmd->text.color.a);
-						font_render(cmd->text.pos.x, settings.window_height - cmd->text.pos.y,
-									ctx->text_height(cmd->text.font), cmd->text.str);
-						glEnable(GL_BLEND);
-						break;
-					case MU_COMMAND_RECT:
-						glColor4ub(cmd->rect.color.r, cmd->rect.color.g, cmd->rect.color.b, cmd->rect.color.a);
-						texture_draw_empty(cmd->rect.rect.x, settings.window_height - cmd->rect.rect.y,
-										   cmd->rect.rect.w, cmd->rect.rect.h);
-						break;
-					case MU_COMMAND_ICON:
-						glColor4ub(cmd->icon.color.r, cmd->icon.color.g, cmd->icon.color.b, cmd->icon.color.a);
-						int size = min(cmd->icon.rect.w, cmd->icon.rect.h);
-
-						if(cmd->icon.id >= HUD_FLAG_INDEX_START - 1) {
-							float u, v;
-							texture_flag_offset(cmd->icon.id - HUD_FLAG_INDEX_START, &u, &v);
-
-							texture_draw_sector(&texture_ui_flags, cmd->icon.rect.x,
-												settings.window_height - cmd->icon.rect.y - size * 0.167F, size,
-												size * 0.667F, u, v, 18.0F / 256.0F, 12.0F / 256.0F);
-							glEnable(GL_BLEND);
-						} else if(hud_active->ui_images) {
-							bool resize = false;
-							struct texture* img = hud_active->ui_images(cmd->icon.id, &resize);
-
-							if(img) {
-								texture_draw(img, cmd->icon.rect.x, settings.window_height - cmd->icon.rect.y,
-											 resize ? size : cmd->icon.rect.w, resize ? size : cmd->icon.rect.h);
-								glEnable(GL_BLEND);
-							}
-						}
-
-						break;
-					case MU_COMMAND_CLIP:
-						glScissor(cmd->clip.rect.x, settings.window_height - (cmd->clip.rect.y + cmd->clip.rect.h),
-								  cmd->clip.rect.w, cmd->clip.rect.h);
-						break;
-				}
-			}
-			glDisable(GL_SCISSOR_TEST);
-			glDisable(GL_BLEND);
+			display_ui(ctx);
 		}
 	}
 
+#ifdef USE_PROFILER
+	if(window_key_down(WINDOW_KEY_PROFILER))
+		profiler_render(0.0F, settings.window_height, settings.window_width, scalef);
+#endif
+
+	PROFILE_GPU_END();
+
 	if(settings.multisamples > 0)
 		glEnable(GL_MULTISAMPLE);
 }
@@ -486,20 +529,30 @@ void init() {
 	map_init();
 
 	glx_init();
+#ifdef USE_PROFILER
+	profiler_init();
+#endif
 
+	pack_open("assets.pak");
+	asset_init();
 	font_init();
+	batch_create(&display_ui_batch, 1024);
 	player_init();
 	particle_init();
 	network_init();
 	ping_init();
 	kv6_init();
 	texture_init();
+	minimap_init();
 	sound_init();
 	tracer_init();
 	hud_init();
 	chunk_init();
 	grenade_init();
 
+	// everything else finishes in the background while the menu is shown
+	asset_wait(ASSET_GROUP_MENU);
+
 	weapon_set(false);
 
 	rpc_init();
@@ -627,6 +680,22 @@ void keys(struct window_instance* window, int key, int scancode, int action, int
 		sprintf(save_name, "Saved map as vxl/%ld.vxl", (long)save_time);
 		chat_add(0, 0x0000FF, save_name);
 	}
+
+#ifdef USE_PROFILER
+	if(key == WINDOW_KEY_PROFILER_TRACE && action == WINDOW_PRESS) { // save trace
+		time_t trace_time;
+		time(&trace_time);
+		char trace_name[128];
+		sprintf(trace_name, "profile_%ld.json", (long)trace_time);
+
+		if(profiler_export(trace_name)) {
+			sprintf(trace_name, "Saved trace as profile_%ld.json", (long)trace_time);
+			chat_add(0, 0x0000FF, trace_name);
+		} else {
+			chat_add(0, 0x0000FF, "Could not save trace");
+		}
+	}
+#endif
 }
 
 void mouse_click(struct window_instance* window, int button, int action, int mods) {
@@ -663,8 +732,9 @@ void mouse_scroll(struct window_instance* window, double xoffset, double yoffset
 void deinit() {
 	rpc_deinit();
 	ping_deinit();
-	if(network_connected)
-		network_disconnect();
+	network_disconnect();
+	network_deinit();
+	network_record_stop();
 	window_deinit();
 }
 
@@ -749,30 +819,64 @@ int main(int argc, char** argv) {
 	if(settings.vsync > 1)
 		window_swapping(0);
 
-	if(argc > 1) {
-		if(!strcmp(argv[1], "--help")) {
+	char* address = NULL;
+	char* record = NULL;
+	char* replay = NULL;
+	float replay_speed = 1.0F;
+	int render = 1;
+
+	for(int k = 1; k < argc; k++) {
+		if(!strcmp(argv[k], "--help")) {
 			log_info("Usage: client                     [server browser]");
 			log_info("       client -aos://<ip>:<port>  [custom address]");
+			log_info("       client --record <file> -aos://<ip>:<port>");
+			log_info("       client --replay <file> [--speed <factor>, 0 = unthrottled] [--no-render]");
 			exit(0);
+		} else if(!strcmp(argv[k], "--record") && k + 1 < argc) {
+			record = argv[++k];
+		} else if(!strcmp(argv[k], "--replay") && k + 1 < argc) {
+			replay = argv[++k];
+		} else if(!strcmp(argv[k], "--speed") && k + 1 < argc) {
+			replay_speed = atof(argv[++k]);
+		} else if(!strcmp(argv[k], "--no-render")) {
+			render = 0;
+		} else {
+			address = argv[k];
 		}
+	}
+
+	if(record && !network_record_start(record))
+		exit(1);
 
-  		if(!network_connect_string(argv[1] + 1, VERSION_075)) {
-			log_error("Error: Connection failed (use --help for instructions)");
+	if(replay) {
+		if(!network_replay_start(replay, replay_speed))
 			exit(1);
+		if(replay_speed <= 0.0F)
+			window_swapping(0);
+	} else if(address) {
+		if(network_connect_string(address, VERSION_075)) {
+			log_info("Connecting to %s", address);
 		} else {
-			log_info("Connection to %s successful", argv[1] + 1);
-			hud_change(&hud_ingame);
+			log_error("Error: Invalid address %s (use --help for instructions)", address);
+			exit(1);
 		}
 	}
 
 	double last_frame_start = 0.0F;
 	double physics_time_fixed = 0.0F;
 	double physics_time_fast = 0.0F;
+	bool first_frame = false;
 
 	while(!window_closed()) {
+		PROFILE_FRAME();
+
 		double dt = window_time() - last_frame_start;
 		last_frame_start = window_time();
 
+		// unthrottled replays advance by one fixed tick per frame
+		if(network_replay_unthrottled())
+			dt = NETWORK_REPLAY_STEP;
+
 		if(hud_active->render_world) {
 			physics_time_fast += dt;
 			physics_time_fixed += dt;
@@ -797,7 +901,15 @@ int main(int argc, char** argv) {
 			}
 		}
 
-		display();
+		asset_update();
+
+		if(render)
+			display();
+
+		if(!first_frame) {
+			first_frame = true;
+			log_info("First frame after %.0fms", window_time() * 1000.0);
+		}
 
 		sound_update();
 		network_update();
@@ -805,7 +917,12 @@ int main(int argc, char** argv) {
 
 		rpc_update();
 
-		if(settings.vsync > 1 && (window_time() - last_frame_start) < (1.0 / settings.vsync)) {
+		// nothing to look at once a replay without rendering is over
+		if(replay && !render && !network_status())
+			break;
+
+		if(settings.vsync > 1 && !network_replay_unthrottled()
+		   && (window_time() - last_frame_start) < (1.0 / settings.vsync)) {
 			double sleep_s = 1.0 / settings.vsync - (window_time() - last_frame_start);
 			struct timespec ts;
 			ts.tv_sec = (int)sleep_s;
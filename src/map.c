@@ -34,12 +34,19 @@
 #include "camera.h"
 #include "log.h"
 #include "particle.h"
-#include "minheap.h"
 #include "tesselator.h"
+#include "timerwheel.h"
 #include "utils.h"
 #include "config.h"
 #include "channel.h"
 #include "entitysystem.h"
+#include "minimap.h"
+#include "profiler.h"
+
+#define pos_key(x, y, z) (((z) << 20) | ((x) << 8) | (y))
+#define pos_keyx(key) (((key) >> 8) & 0xFFF)
+#define pos_keyy(key) ((key)&0xFF)
+#define pos_keyz(key) (((key) >> 20) & 0xFFF)
 
 int map_size_x = 512;
 int map_size_y = 64;
@@ -48,21 +55,147 @@ int map_size_z = 512;
 static struct libvxl_map map;
 static pthread_rwlock_t map_lock;
 
+struct occupancy map_occupancy;
+
 float fog_color[4] = {0.5F, 0.9098F, 1.0F, 1.0F};
 
+#ifdef TESSELATE_QUADS
+#define DAMAGE_VERTICES (6 * 4)
+#endif
+
+#ifdef TESSELATE_TRIANGLES
+#define DAMAGE_VERTICES (6 * 6)
+#endif
+
+#define DAMAGE_TIMEOUT 10.0F
+#define DAMAGE_SLOT_FREE UINT32_MAX
+
 struct damaged_voxel {
 	int damage;
 	float timer;
 	float action_timer;
+	uint32_t slot;
+};
+
+// every damaged voxel owns one slot of cube faces in a vertex buffer that persists across frames,
+// slots are only written when damage changes and a freed slot is collapsed to a degenerate cube
+struct damage_overlay {
+	struct tesselator scratch;
+	int16_t* vertices;
+	uint32_t* colors;
+	uint32_t* keys; // position of the voxel that owns a slot
+	uint32_t* free;
+	uint32_t free_count;
+	uint32_t used; // nothing at or above is drawn
+	uint32_t capacity;
+	uint32_t dirty_start, dirty_end;
+	uint32_t buffer_capacity;
+	GLuint buffers[2];
+	struct timerwheel expiry; // ids are slots
 };
 
 HashTable map_damaged_voxels;
-struct tesselator map_damaged_tesselator;
+static struct damage_overlay map_damage_overlay;
 
 int map_object_visible(float x, float y, float z) {
 	return !(x <= 0.0F && z <= 0.0F);
 }
 
+static void map_damage_slot_write(uint32_t slot, int damage) {
+	struct damage_overlay* o = &map_damage_overlay;
+	uint32_t pos = o->keys[slot];
+
+	tesselator_clear(&o->scratch);
+	tesselator_set_color(&o->scratch, rgba(0, 0, 0, damage * 1.9125F));
+
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_Z_N, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_Z_P, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_X_N, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_X_P, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_Y_P, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+	tesselator_addi_cube_face(&o->scratch, CUBE_FACE_Y_N, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos));
+
+	memcpy(o->vertices + slot * DAMAGE_VERTICES * 3, o->scratch.vertices, DAMAGE_VERTICES * 3 * sizeof(int16_t));
+	memcpy(o->colors + slot * DAMAGE_VERTICES, o->scratch.colors, DAMAGE_VERTICES * sizeof(uint32_t));
+
+	o->dirty_start = min(o->dirty_start, slot);
+	o->dirty_end = max(o->dirty_end, slot + 1);
+}
+
+static uint32_t map_damage_slot_alloc(uint32_t pos) {
+	struct damage_overlay* o = &map_damage_overlay;
+	uint32_t slot = DAMAGE_SLOT_FREE;
+
+	// entries above the high water mark are left over from shrinking it
+	while(o->free_count > 0 && slot == DAMAGE_SLOT_FREE) {
+		uint32_t candidate = o->free[--o->free_count];
+		if(candidate < o->used)
+			slot = candidate;
+	}
+
+	if(slot == DAMAGE_SLOT_FREE) {
+		if(o->used >= o->capacity) {
+			o->capacity *= 2;
+			o->vertices = realloc(o->vertices, o->capacity * DAMAGE_VERTICES * 3 * sizeof(int16_t));
+			CHECK_ALLOCATION_ERROR(o->vertices)
+			o->colors = realloc(o->colors, o->capacity * DAMAGE_VERTICES * sizeof(uint32_t));
+			CHECK_ALLOCATION_ERROR(o->colors)
+			o->keys = realloc(o->keys, o->capacity * sizeof(uint32_t));
+			CHECK_ALLOCATION_ERROR(o->keys)
+			o->free = realloc(o->free, o->capacity * sizeof(uint32_t));
+			CHECK_ALLOCATION_ERROR(o->free)
+			timerwheel_reserve(&o->expiry, o->capacity);
+		}
+
+		slot = o->used++;
+	}
+
+	o->keys[slot] = pos;
+	return slot;
+}
+
+static void map_damage_slot_free(uint32_t slot) {
+	struct damage_overlay* o = &map_damage_overlay;
+
+	timerwheel_cancel(&o->expiry, slot);
+	o->keys[slot] = DAMAGE_SLOT_FREE;
+
+	if(slot + 1 == o->used) {
+		while(o->used > 0 && o->keys[o->used - 1] == DAMAGE_SLOT_FREE)
+			o->used--;
+	} else {
+		memset(o->vertices + slot * DAMAGE_VERTICES * 3, 0, DAMAGE_VERTICES * 3 * sizeof(int16_t));
+		o->free[o->free_count++] = slot;
+		o->dirty_start = min(o->dirty_start, slot);
+		o->dirty_end = max(o->dirty_end, slot + 1);
+	}
+}
+
+static void map_damage_expired(uint32_t slot, void* user) {
+	uint32_t pos = map_damage_overlay.keys[slot];
+	map_damage_slot_free(slot);
+	ht_erase(&map_damaged_voxels, &pos);
+}
+
+static void map_damage_remove(int x, int y, int z) {
+	uint32_t key = pos_key(x, y, z);
+	struct damaged_voxel* voxel = ht_lookup(&map_damaged_voxels, &key);
+
+	if(voxel) {
+		map_damage_slot_free(voxel->slot);
+		ht_erase(&map_damaged_voxels, &key);
+	}
+}
+
+static void map_damage_clear() {
+	struct damage_overlay* o = &map_damage_overlay;
+
+	ht_clear(&map_damaged_voxels);
+	timerwheel_clear(&o->expiry);
+	o->used = 0;
+	o->free_count = 0;
+}
+
 int map_damage(int x, int y, int z, int damage) {
 	uint32_t key = pos_key(x, y, z);
 	struct damaged_voxel* voxel = ht_lookup(&map_damaged_voxels, &key);
@@ -70,18 +203,21 @@ int map_damage(int x, int y, int z, int damage) {
 	if(voxel) {
 		voxel->damage = min(damage + voxel->damage, 100);
 		voxel->timer = window_time();
-
-		return voxel->damage;
 	} else {
 		ht_insert(&map_damaged_voxels, &key,
 				  &(struct damaged_voxel) {
 					  .damage = damage,
 					  .timer = window_time(),
 					  .action_timer = -FLT_MAX,
+					  .slot = map_damage_slot_alloc(key),
 				  });
-
-		return damage;
+		voxel = ht_lookup(&map_damaged_voxels, &key);
 	}
+
+	map_damage_slot_write(voxel->slot, voxel->damage);
+	timerwheel_schedule(&map_damage_overlay.expiry, voxel->slot, voxel->timer + DAMAGE_TIMEOUT);
+
+	return voxel->damage;
 }
 
 bool map_damage_action(int x, int y, int z) {
@@ -105,30 +241,56 @@ int map_damage_get(int x, int y, int z) {
 	return voxel ? voxel->damage : 0;
 }
 
-static bool damaged_voxel_update(void* key, void* value, void* user) {
-	uint32_t pos = *(uint32_t*)key;
-	struct damaged_voxel* voxel = (struct damaged_voxel*)value;
-	struct tesselator* tess = (struct tesselator*)user;
-	int x = pos_keyx(pos);
-	int y = pos_keyy(pos);
-	int z = pos_keyz(pos);
+static bool map_damage_buffered() {
+#ifdef OPENGL_ES
+	return true;
+#else
+	return glx_version && !settings.force_displaylist;
+#endif
+}
 
-	if(window_time() - voxel->timer > 10.0F || map_isair(x, y, z))
-		return true;
+// only slots written since the last frame are sent, the buffer is reallocated when the slot array grew
+static void map_damage_upload() {
+	struct damage_overlay* o = &map_damage_overlay;
+	size_t vertex_size = DAMAGE_VERTICES * 3 * sizeof(int16_t);
+	size_t color_size = DAMAGE_VERTICES * sizeof(uint32_t);
+
+	if(o->buffer_capacity < o->capacity) {
+		o->buffer_capacity = o->capacity;
+		o->dirty_start = 0;
+		o->dirty_end = o->used;
+
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, o->capacity * vertex_size, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[1]);
+		glBufferData(GL_ARRAY_BUFFER, o->capacity * color_size, NULL, GL_DYNAMIC_DRAW);
+	}
 
-	tesselator_set_color(tess, rgba(0, 0, 0, voxel->damage * 1.9125F));
+	o->dirty_end = min(o->dirty_end, o->used);
 
-	tesselator_addi_cube_face(tess, CUBE_FACE_Z_N, x, y, z);
-	tesselator_addi_cube_face(tess, CUBE_FACE_Z_P, x, y, z);
-	tesselator_addi_cube_face(tess, CUBE_FACE_X_N, x, y, z);
-	tesselator_addi_cube_face(tess, CUBE_FACE_X_P, x, y, z);
-	tesselator_addi_cube_face(tess, CUBE_FACE_Y_P, x, y, z);
-	tesselator_addi_cube_face(tess, CUBE_FACE_Y_N, x, y, z);
+	if(o->dirty_start < o->dirty_end) {
+		size_t count = o->dirty_end - o->dirty_start;
 
-	return false;
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[0]);
+		glBufferSubData(GL_ARRAY_BUFFER, o->dirty_start * vertex_size, count * vertex_size,
+						o->vertices + o->dirty_start * DAMAGE_VERTICES * 3);
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[1]);
+		glBufferSubData(GL_ARRAY_BUFFER, o->dirty_start * color_size, count * color_size,
+						o->colors + o->dirty_start * DAMAGE_VERTICES);
+	}
+
+	o->dirty_start = UINT32_MAX;
+	o->dirty_end = 0;
 }
 
 void map_damaged_voxels_render() {
+	struct damage_overlay* o = &map_damage_overlay;
+
+	timerwheel_advance(&o->expiry, window_time(), map_damage_expired, NULL);
+
+	if(!o->used)
+		return;
+
 	matrix_identity(matrix_model);
 	matrix_upload();
 	// glEnable(GL_POLYGON_OFFSET_FILL);
@@ -137,11 +299,32 @@ void map_damaged_voxels_render() {
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	tesselator_clear(&map_damaged_tesselator);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	if(map_damage_buffered()) {
+		map_damage_upload();
 
-	ht_iterate_remove(&map_damaged_voxels, &map_damaged_tesselator, damaged_voxel_update);
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[0]);
+		glVertexPointer(3, GL_SHORT, 0, NULL);
+		glBindBuffer(GL_ARRAY_BUFFER, o->buffers[1]);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, NULL);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	} else {
+		glVertexPointer(3, GL_SHORT, 0, o->vertices);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, o->colors);
+	}
+
+#ifdef TESSELATE_QUADS
+	glDrawArrays(GL_QUADS, 0, o->used * DAMAGE_VERTICES);
+#endif
+
+#ifdef TESSELATE_TRIANGLES
+	glDrawArrays(GL_TRIANGLES, 0, o->used * DAMAGE_VERTICES);
+#endif
 
-	tesselator_draw(&map_damaged_tesselator, 1);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
 
 	glDepthFunc(GL_LEQUAL);
 	glDisable(GL_BLEND);
@@ -221,7 +404,8 @@ static bool falling_blocks_pivot(void* key, void* value, void* user) {
 	float* pivot = (float*)user;
 	uint32_t pos = *(uint32_t*)key;
 
-	map_set(pos_keyx(pos), pos_keyy(pos), pos_keyz(pos), 0xFFFFFFFF);
+	// later searches must already see air, the map itself is only changed on the main thread
+	occupancy_set(&map_occupancy, pos_keyx(pos), pos_keyy(pos), pos_keyz(pos), false);
 	pivot[0] += pos_keyx(pos);
 	pivot[1] += pos_keyy(pos);
 	pivot[2] += pos_keyz(pos);
@@ -229,64 +413,25 @@ static bool falling_blocks_pivot(void* key, void* value, void* user) {
 	return true;
 }
 
-static const int DIRECTION_MASK[][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
-
-static bool map_update_physics_sub(struct map_collapsing* collapsing, int x, int y, int z) {
-	if(y <= 1)
-		return false;
+// runs on the physics worker, see sim_search_floating()
+static bool map_update_physics_sub(struct sim_search* search, struct map_collapsing* collapsing, int x, int y, int z) {
+	size_t count = sim_search_floating(search, &map_occupancy, x, y, z);
 
-	if(map_isair(x, y, z))
+	if(!count)
 		return false;
 
-	struct minheap openlist;
-	minheap_create(&openlist);
-
 	HashTable closedlist;
-	ht_setup(&closedlist, sizeof(uint32_t), sizeof(uint32_t), 256);
+	ht_setup(&closedlist, sizeof(uint32_t), sizeof(uint32_t), count);
 	closedlist.compare = int_cmp;
 	closedlist.hash = int_hash;
 
-	struct minheap_block start = (struct minheap_block) {
-		.pos = pos_key(x, y, z),
-	};
-
-	uint32_t start_color = map_get(x, y, z);
-
-	minheap_put(&openlist, &start);
-	ht_insert(&closedlist, &start.pos, &start_color);
-
-	while(!minheap_isempty(&openlist)) { // find all connected blocks
-		struct minheap_block current = minheap_extract(&openlist);
-
-		if(pos_keyy(current.pos) <= 1) { // stop at indestructible ground layer
-			minheap_destroy(&openlist);
-			ht_destroy(&closedlist);
-			return false;
-		}
-
-		for(size_t k = 0; k < sizeof(DIRECTION_MASK) / sizeof(*DIRECTION_MASK); k++) {
-			int dir_block[3] = {
-				pos_keyx(current.pos) + DIRECTION_MASK[k][0],
-				pos_keyy(current.pos) + DIRECTION_MASK[k][1],
-				pos_keyz(current.pos) + DIRECTION_MASK[k][2],
-			};
-
-			struct minheap_block block = (struct minheap_block) {
-				.pos = pos_key(dir_block[0], dir_block[1], dir_block[2]),
-			};
-
-			if(dir_block[0] >= 0 && dir_block[1] >= 0 && dir_block[2] >= 0 && dir_block[0] < map_size_x
-			   && dir_block[1] < map_size_y && dir_block[2] < map_size_z && !ht_contains(&closedlist, &block.pos)
-			   && !map_isair(dir_block[0], dir_block[1], dir_block[2])) {
-				minheap_put(&openlist, &block);
-				uint32_t color = map_get(dir_block[0], dir_block[1], dir_block[2]);
-				ht_insert(&closedlist, &block.pos, &color);
-			}
-		}
+	for(size_t k = 0; k < count; k++) {
+		uint32_t key = search->voxels[k];
+		uint32_t pos = pos_key(SIM_KEY_X(key), SIM_KEY_Y(key), SIM_KEY_Z(key));
+		uint32_t color = map_get(SIM_KEY_X(key), SIM_KEY_Y(key), SIM_KEY_Z(key));
+		ht_insert(&closedlist, &pos, &color);
 	}
 
-	minheap_destroy(&openlist);
-
 	float pivot[3] = {0, 0, 0};
 	ht_iterate(&closedlist, pivot, falling_blocks_pivot);
 
@@ -432,6 +577,12 @@ static bool falling_blocks_update(void* obj, void* user) {
 	return false;
 }
 
+static bool falling_blocks_remove(void* key, void* value, void* user) {
+	uint32_t pos = *(uint32_t*)key;
+	map_set(pos_keyx(pos), pos_keyy(pos), pos_keyz(pos), 0xFFFFFFFF);
+	return true;
+}
+
 void map_collapsing_update(float dt) {
 	size_t drain = channel_size(&map_result_queue);
 
@@ -439,6 +590,7 @@ void map_collapsing_update(float dt) {
 		struct map_collapsing res;
 		channel_await(&map_result_queue, &res);
 
+		ht_iterate(&res.voxels, NULL, falling_blocks_remove);
 		sound_create(SOUND_WORLD, &sound_debris, res.p.x, res.p.y, res.p.z);
 
 		entitysys_add(&map_collapsing_structures, &res);
@@ -448,18 +600,12 @@ void map_collapsing_update(float dt) {
 }
 
 void map_update_physics(int x, int y, int z) {
-	if(x + 1 < map_size_x && !map_isair(x + 1, y, z))
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x + 1, .y = y, .z = z});
-	if(x >= 1 && !map_isair(x - 1, y, z))
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x - 1, .y = y, .z = z});
-	if(z + 1 < map_size_z && !map_isair(x, y, z + 1))
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x, .y = y, .z = z + 1});
-	if(z >= 1 && !map_isair(x, y, z - 1))
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x, .y = y, .z = z - 1});
-	if(y >= 3 && !map_isair(x, y - 1, z)) // don't check ground layers
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x, .y = y - 1, .z = z});
-	if(y + 1 < map_size_y && !map_isair(x, y + 1, z))
-		channel_put(&map_work_queue, &(struct map_work_packet) {.x = x, .y = y + 1, .z = z});
+	int candidates[6][3];
+	int count = sim_collapse_candidates(&map_occupancy, x, y, z, candidates);
+
+	for(int k = 0; k < count; k++)
+		channel_put(&map_work_queue,
+					&(struct map_work_packet) {.x = candidates[k][0], .y = candidates[k][1], .z = candidates[k][2]});
 }
 
 // see this for details: https://github.com/infogulch/pyspades/blob/protocol075/pyspades/vxl_c.cpp#L380
@@ -476,12 +622,19 @@ float map_sunblock(int x, int y, int z) {
 }
 
 void* falling_blocks_worker(void* user) {
+	PROFILE_THREAD("physics worker");
+
+	struct sim_search search;
+	sim_search_create(&search, map_size_x, map_size_z);
+
 	while(1) {
 		struct map_work_packet work;
 		channel_await(&map_work_queue, &work);
 
+		PROFILE_SCOPE("map_update_physics");
+
 		struct map_collapsing collapsing;
-		if(map_update_physics_sub(&collapsing, work.x, work.y, work.z))
+		if(map_update_physics_sub(&search, &collapsing, work.x, work.y, work.z))
 			channel_put(&map_result_queue, &collapsing);
 	}
 
@@ -490,13 +643,32 @@ void* falling_blocks_worker(void* user) {
 
 void map_init() {
 	libvxl_create(&map, 512, 512, 64, NULL, 0);
-	tesselator_create(&map_damaged_tesselator, VERTEX_INT, 0);
+	occupancy_create(&map_occupancy, 512, 512, 64);
 	pthread_rwlock_init(&map_lock, NULL);
 
 	ht_setup(&map_damaged_voxels, sizeof(uint32_t), sizeof(struct damaged_voxel), 16);
 	map_damaged_voxels.compare = int_cmp;
 	map_damaged_voxels.hash = int_hash;
 
+	struct damage_overlay* o = &map_damage_overlay;
+	tesselator_create(&o->scratch, VERTEX_INT, 0);
+	o->capacity = 16;
+	o->vertices = malloc(o->capacity * DAMAGE_VERTICES * 3 * sizeof(int16_t));
+	CHECK_ALLOCATION_ERROR(o->vertices)
+	o->colors = malloc(o->capacity * DAMAGE_VERTICES * sizeof(uint32_t));
+	CHECK_ALLOCATION_ERROR(o->colors)
+	o->keys = malloc(o->capacity * sizeof(uint32_t));
+	CHECK_ALLOCATION_ERROR(o->keys)
+	o->free = malloc(o->capacity * sizeof(uint32_t));
+	CHECK_ALLOCATION_ERROR(o->free)
+	o->free_count = 0;
+	o->used = 0;
+	o->dirty_start = UINT32_MAX;
+	o->dirty_end = 0;
+	o->buffer_capacity = 0;
+	glGenBuffers(2, o->buffers);
+	timerwheel_create(&o->expiry, 0.125F, 256, o->capacity);
+
 	entitysys_create(&map_collapsing_structures, sizeof(struct map_collapsing), 32);
 
 	channel_create(&map_work_queue, sizeof(struct map_work_packet), 16);
@@ -514,6 +686,21 @@ int map_height_at(int x, int z) {
 	return map_size_y - 1 - result[1];
 }
 
+// color of the highest voxel of every column in a rectangle, stored row by row
+void map_top_colors(int x, int z, int width, int depth, uint32_t* out) {
+	pthread_rwlock_rdlock(&map_lock);
+
+	for(int k = 0; k < depth; k++) {
+		for(int i = 0; i < width; i++) {
+			int result[2];
+			libvxl_map_gettop(&map, x + i, z + k, result);
+			out[i + k * width] = rgb2bgr(libvxl_map_get(&map, x + i, z + k, result[1]));
+		}
+	}
+
+	pthread_rwlock_unlock(&map_lock);
+}
+
 bool map_isair(int x, int y, int z) {
 	pthread_rwlock_rdlock(&map_lock);
 	bool result = !libvxl_map_issolid(&map, x, z, map_size_y - 1 - y);
@@ -541,8 +728,15 @@ void map_set(int x, int y, int z, unsigned int color) {
 		libvxl_map_set(&map, x, z, map_size_y - 1 - y, rgb2bgr(color));
 	}
 
+	occupancy_set(&map_occupancy, x, y, z, color != 0xFFFFFFFF);
+
 	pthread_rwlock_unlock(&map_lock);
 
+	if(color == 0xFFFFFFFF)
+		map_damage_remove(x, y, z);
+
+	minimap_update(x, z);
+
 	chunk_block_update(x, y, z);
 
 	int x_off = x % CHUNK_SIZE;
@@ -578,94 +772,6 @@ void map_set(int x, int y, int z, unsigned int color) {
 		chunk_block_update(x, y, 0);
 }
 
-// Copyright (c) Mathias Kaerlev 2011-2012 (but might be original code by Ben himself)
-int map_cube_line(int x1, int y1, int z1, int x2, int y2, int z2, struct Point* cube_array) {
-	struct Point c, d;
-	long ixi, iyi, izi, dx, dy, dz, dxi, dyi, dzi;
-	int count = 0;
-
-	// Note: positions MUST be rounded towards -inf
-	c.x = x1;
-	c.y = y1;
-	c.z = z1;
-
-	d.x = x2 - x1;
-	d.y = y2 - y1;
-	d.z = z2 - z1;
-
-	if(d.x < 0)
-		ixi = -1;
-	else
-		ixi = 1;
-	if(d.y < 0)
-		iyi = -1;
-	else
-		iyi = 1;
-	if(d.z < 0)
-		izi = -1;
-	else
-		izi = 1;
-
-	if((abs(d.x) >= abs(d.y)) && (abs(d.x) >= abs(d.z))) {
-		dxi = 1024;
-		dx = 512;
-		dyi = (long)(!d.y ? 0x3fffffff / 512 : abs(d.x * 1024 / d.y));
-		dy = dyi / 2;
-		dzi = (long)(!d.z ? 0x3fffffff / 512 : abs(d.x * 1024 / d.z));
-		dz = dzi / 2;
-	} else if(abs(d.y) >= abs(d.z)) {
-		dyi = 1024;
-		dy = 512;
-		dxi = (long)(!d.x ? 0x3fffffff / 512 : abs(d.y * 1024 / d.x));
-		dx = dxi / 2;
-		dzi = (long)(!d.z ? 0x3fffffff / 512 : abs(d.y * 1024 / d.z));
-		dz = dzi / 2;
-	} else {
-		dzi = 1024;
-		dz = 512;
-		dxi = (long)(!d.x ? 0x3fffffff / 512 : abs(d.z * 1024 / d.x));
-		dx = dxi / 2;
-		dyi = (long)(!d.y ? 0x3fffffff / 512 : abs(d.z * 1024 / d.y));
-		dy = dyi / 2;
-	}
-	if(ixi >= 0)
-		dx = dxi - dx;
-	if(iyi >= 0)
-		dy = dyi - dy;
-	if(izi >= 0)
-		dz = dzi - dz;
-
-	while(1) {
-		if(cube_array != NULL)
-			cube_array[count] = c;
-
-		if(count++ == 63)
-			return count;
-
-		if(c.x == x2 && c.y == y2 && c.z == z2)
-			return count;
-
-		if(dz <= dx && dz <= dy) {
-			c.z += izi;
-			if(c.z < 0 || c.z >= 64)
-				return count;
-			dz += dzi;
-		} else {
-			if(dx < dy) {
-				c.x += ixi;
-				if((unsigned long)c.x >= 512)
-					return count;
-				dx += dxi;
-			} else {
-				c.y += iyi;
-				if((unsigned long)c.y >= 512)
-					return count;
-				dy += dyi;
-			}
-		}
-	}
-}
-
 static int lerp(int a, int b, int amt) { // amt from 0 to 8
 	return a + (b - a) * amt / 8;
 }
@@ -703,7 +809,26 @@ void map_vxl_load(void* v, size_t size) {
 	pthread_rwlock_wrlock(&map_lock);
 	libvxl_free(&map);
 	libvxl_create(&map, 512, 512, 64, v, size);
+
+	for(int z = 0; z < map_size_z; z++) {
+		for(int x = 0; x < map_size_x; x++) {
+			uint64_t column = 0;
+
+			for(int y = 0; y < map_size_y; y++) {
+				if(libvxl_map_issolid(&map, x, z, map_size_y - 1 - y))
+					column |= (uint64_t)1 << y;
+			}
+
+			occupancy_set_column(&map_occupancy, x, z, column);
+		}
+	}
+
+	occupancy_update_tiles(&map_occupancy);
+
 	pthread_rwlock_unlock(&map_lock);
+
+	map_damage_clear();
+	minimap_rebuild();
 }
 
 void map_save_file(const char* filename) {
@@ -25,15 +25,17 @@
 #include <libvxl.h>
 #undef pos_key
 
+#include "occupancy.h"
+#include "sim.h"
+
 extern int map_size_x;
 extern int map_size_y;
 extern int map_size_z;
 
 extern float fog_color[4];
 
-struct Point {
-	int x, y, z;
-};
+// lock-free copy of the map geometry, kept in sync by map_set() and map_vxl_load()
+extern struct occupancy map_occupancy;
 
 void map_init();
 int map_object_visible(float x, float y, float z);
@@ -46,7 +48,6 @@ float map_sunblock(int x, int y, int z);
 bool map_isair(int x, int y, int z);
 unsigned int map_get(int x, int y, int z);
 void map_set(int x, int y, int z, unsigned int color);
-int map_cube_line(int x1, int y1, int z1, int x2, int y2, int z2, struct Point* cube_array);
 void map_vxl_setgeom(int x, int y, int z, unsigned int t, unsigned int* map);
 void map_vxl_setcolor(int x, int y, int z, unsigned int t, unsigned int* map);
 int map_dirt_color(int x, int y, int z);
@@ -55,6 +56,7 @@ void map_vxl_load(void* v, size_t size);
 void map_collapsing_render(void);
 void map_collapsing_update(float dt);
 int map_height_at(int x, int z);
+void map_top_colors(int x, int z, int width, int depth, uint32_t* out);
 void map_save_file(const char* filename);
 void map_copy_blocks(struct libvxl_chunk_copy* copy, size_t x, size_t y);
 
@@ -0,0 +1,216 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "map.h"
+#include "glx.h"
+#include "texture.h"
+#include "minimap.h"
+
+struct minimap_rect {
+	int x, z;
+	int width, depth;
+};
+
+static uint32_t* minimap_pixels = NULL;
+static uint32_t* minimap_staging;
+static bool* minimap_dirty; // one per tile
+static bool minimap_changed = false;
+static struct minimap_rect* minimap_rects;
+static int minimap_tiles_x, minimap_tiles_z;
+static GLuint minimap_pbo = 0;
+static pthread_t minimap_thread; // the only one allowed to touch any of the above
+
+// grid lines every 64 blocks
+static uint32_t minimap_color(int x, int z, uint32_t color) {
+	return (x % 64 == 0 || z % 64 == 0) ? rgba(255, 255, 255, 255) : color | 0xFF000000;
+}
+
+void minimap_init() {
+	minimap_thread = pthread_self();
+	minimap_tiles_x = (map_size_x + MINIMAP_TILE - 1) / MINIMAP_TILE;
+	minimap_tiles_z = (map_size_z + MINIMAP_TILE - 1) / MINIMAP_TILE;
+
+	minimap_pixels = malloc(map_size_x * map_size_z * sizeof(uint32_t));
+	CHECK_ALLOCATION_ERROR(minimap_pixels)
+	minimap_staging = malloc(map_size_x * map_size_z * sizeof(uint32_t));
+	CHECK_ALLOCATION_ERROR(minimap_staging)
+	minimap_dirty = calloc(minimap_tiles_x * minimap_tiles_z, sizeof(bool));
+	CHECK_ALLOCATION_ERROR(minimap_dirty)
+	minimap_rects = malloc(minimap_tiles_x * minimap_tiles_z * sizeof(struct minimap_rect));
+	CHECK_ALLOCATION_ERROR(minimap_rects)
+
+#ifndef OPENGL_ES
+	if(glx_version && GLEW_ARB_pixel_buffer_object)
+		glGenBuffers(1, &minimap_pbo);
+#endif
+
+	minimap_rebuild();
+}
+
+void minimap_update(int x, int z) {
+	if(!minimap_pixels || x < 0 || z < 0 || x >= map_size_x || z >= map_size_z)
+		return;
+
+	assert(pthread_equal(pthread_self(), minimap_thread));
+
+	uint32_t color;
+	map_top_colors(x, z, 1, 1, &color);
+	color = minimap_color(x, z, color);
+
+	uint32_t* pixel = minimap_pixels + x + z * map_size_x;
+
+	if(*pixel != color) {
+		*pixel = color;
+		minimap_dirty[x / MINIMAP_TILE + z / MINIMAP_TILE * minimap_tiles_x] = true;
+		minimap_changed = true;
+	}
+}
+
+void minimap_rebuild() {
+	if(!minimap_pixels)
+		return;
+
+	map_top_colors(0, 0, map_size_x, map_size_z, minimap_pixels);
+
+	for(int z = 0; z < map_size_z; z++)
+		for(int x = 0; x < map_size_x; x++)
+			minimap_pixels[x + z * map_size_x] = minimap_color(x, z, minimap_pixels[x + z * map_size_x]);
+
+	memset(minimap_dirty, true, minimap_tiles_x * minimap_tiles_z * sizeof(bool));
+	minimap_changed = true;
+}
+
+// runs of dirty tiles in a row, a run is merged into the one above if it covers the same columns
+static size_t minimap_collect(void) {
+	size_t count = 0;
+
+	for(int tz = 0; tz < minimap_tiles_z; tz++) {
+		int z = tz * MINIMAP_TILE;
+		int depth = min(MINIMAP_TILE, map_size_z - z);
+
+		for(int tx = 0; tx < minimap_tiles_x; tx++) {
+			if(!minimap_dirty[tx + tz * minimap_tiles_x])
+				continue;
+
+			int start = tx;
+
+			while(tx < minimap_tiles_x && minimap_dirty[tx + tz * minimap_tiles_x])
+				minimap_dirty[tx++ + tz * minimap_tiles_x] = false;
+
+			int x = start * MINIMAP_TILE;
+			int width = min(tx * MINIMAP_TILE, map_size_x) - x;
+			struct minimap_rect* above = NULL;
+
+			for(size_t k = 0; k < count && !above; k++) {
+				struct minimap_rect* r = minimap_rects + k;
+				if(r->x == x && r->width == width && r->z + r->depth == z)
+					above = r;
+			}
+
+			if(above) {
+				above->depth += depth;
+			} else {
+				minimap_rects[count++] = (struct minimap_rect) {
+					.x = x,
+					.z = z,
+					.width = width,
+					.depth = depth,
+				};
+			}
+		}
+	}
+
+	return count;
+}
+
+void minimap_upload() {
+	if(!minimap_changed)
+		return;
+
+	minimap_changed = false;
+
+	size_t count = minimap_collect();
+	size_t length = 0;
+
+	for(size_t k = 0; k < count; k++)
+		length += minimap_rects[k].width * minimap_rects[k].depth;
+
+	uint32_t* staging = NULL;
+
+#ifndef OPENGL_ES
+	if(minimap_pbo) {
+		// orphan last frame's storage so mapping never waits on a pending transfer
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, minimap_pbo);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, length * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+		staging = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+
+		if(!staging)
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+#endif
+
+	bool buffered = staging != NULL;
+
+	if(!buffered)
+		staging = minimap_staging;
+
+	size_t offset = 0;
+
+	for(size_t k = 0; k < count; k++) {
+		struct minimap_rect* r = minimap_rects + k;
+
+		for(int z = 0; z < r->depth; z++)
+			memcpy(staging + offset + z * r->width, minimap_pixels + r->x + (r->z + z) * map_size_x,
+				   r->width * sizeof(uint32_t));
+
+		offset += r->width * r->depth;
+	}
+
+#ifndef OPENGL_ES
+	if(buffered)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+#endif
+
+	glBindTexture(GL_TEXTURE_2D, texture_minimap.texture_id);
+	offset = 0;
+
+	for(size_t k = 0; k < count; k++) {
+		struct minimap_rect* r = minimap_rects + k;
+		// with a bound unpack buffer the pointer is an offset into it
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r->x, r->z, r->width, r->depth, GL_RGBA, GL_UNSIGNED_BYTE,
+						buffered ? (void*)(offset * sizeof(uint32_t)) : minimap_staging + offset);
+		offset += r->width * r->depth;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+#ifndef OPENGL_ES
+	if(buffered)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+#endif
+}
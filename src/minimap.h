@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#define MINIMAP_TILE 16
+
+// keeps a copy of the top view of the map and sends changed tiles of it to texture_minimap
+// nothing here is locked, all of it belongs to the main thread just like map_set() and the texture
+void minimap_init(void);
+// recolors one column after a map edit, the physics worker leaves these to map_collapsing_update()
+void minimap_update(int x, int z);
+// recolors every column, e.g. after a new map was loaded
+void minimap_rebuild(void);
+// call once per frame
+void minimap_upload(void);
+
+#endif
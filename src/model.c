@@ -32,6 +32,8 @@
 #include "model.h"
 #include "model_normals.h"
 #include "texture.h"
+#include "asset.h"
+#include "pack.h"
 
 struct kv6_t model_playerdead;
 struct kv6_t model_playerhead;
@@ -58,12 +60,6 @@ struct kv6_t model_semi_casing;
 struct kv6_t model_smg_casing;
 struct kv6_t model_shotgun_casing;
 
-static void kv6_load_file(struct kv6_t* kv6, char* filename, float scale) {
-	void* data = file_load(filename);
-	kv6_load(kv6, data, scale);
-	free(data);
-}
-
 static void kv6_check_dimensions(struct kv6_t* kv6, float max) {
 	if(max(max(kv6->xsiz, kv6->ysiz), kv6->zsiz) * kv6->scale > max) {
 		log_error("Model dimensions too large");
@@ -71,47 +67,122 @@ static void kv6_check_dimensions(struct kv6_t* kv6, float max) {
 	}
 }
 
+static void kv6_load_packed(struct kv6_t* kv6, const struct pack_kv6* packed, float scale) {
+	const struct pack_kv6_voxel* voxels = (const struct pack_kv6_voxel*)(packed + 1);
+
+	*kv6 = (struct kv6_t) {
+		.xsiz = packed->xsiz,
+		.ysiz = packed->ysiz,
+		.zsiz = packed->zsiz,
+		.xpiv = packed->xpiv,
+		.ypiv = packed->ypiv,
+		.zpiv = packed->zpiv,
+		.voxel_count = packed->voxel_count,
+		.scale = scale,
+	};
+
+	kv6->voxels = malloc(sizeof(struct kv6_voxel) * kv6->voxel_count);
+	CHECK_ALLOCATION_ERROR(kv6->voxels)
+
+	for(int k = 0; k < kv6->voxel_count; k++) {
+		kv6->voxels[k] = (struct kv6_voxel) {
+			.x = voxels[k].x,
+			.y = voxels[k].y,
+			.z = voxels[k].z,
+			.visfaces = voxels[k].visfaces,
+			.color = voxels[k].color,
+		};
+	}
+}
+
+// meshes are cached by content, a changed model or setting simply gets a new file
+static void kv6_mesh(struct kv6_t* kv6, bool cache) {
+	bool greedy = settings.greedy_meshing;
+	uint32_t key = kv6mesh_key(kv6->voxels, kv6->voxel_count, kv6->xsiz, kv6->ysiz, kv6->zsiz, greedy);
+
+	char filename[32];
+	sprintf(filename, "cache/%08X.kv6m", key);
+
+	kv6mesh_destroy(&kv6->mesh);
+
+	if(cache && kv6mesh_load(&kv6->mesh, filename, key))
+		return;
+
+	kv6mesh_build(&kv6->mesh, kv6->voxels, kv6->voxel_count, kv6->xsiz, kv6->ysiz, kv6->zsiz, greedy);
+
+	if(cache)
+		kv6mesh_save(&kv6->mesh, filename, key);
+}
+
+static void kv6_decode(struct asset* a) {
+	a->data = malloc(sizeof(struct kv6_t));
+	CHECK_ALLOCATION_ERROR(a->data)
+
+	const struct pack_entry* e = pack_find(a->filename, PACK_KV6);
+
+	if(e) {
+		kv6_load_packed(a->data, pack_data(e), a->param[0]);
+	} else {
+		void* data = file_load(a->filename);
+		kv6_load(a->data, data, a->param[0]);
+		free(data);
+	}
+
+	// meshed right away, the first draw only has to upload
+	kv6_mesh(a->data, true);
+}
+
+static void kv6_upload(struct asset* a) {
+	struct kv6_t* kv6 = a->target;
+	bool colorize = kv6->colorize;
+
+	*kv6 = *(struct kv6_t*)a->data;
+	kv6->colorize = colorize;
+	free(a->data);
+
+	if(a->param[1] > 0.0F)
+		kv6_check_dimensions(kv6, a->param[1]);
+}
+
+// decoded in the background, see asset.h, max_size of zero skips the dimension check
+static void kv6_load_file(struct kv6_t* kv6, char* filename, float scale, float max_size) {
+	asset_load(&(struct asset) {
+		.group = ASSET_GROUP_GAME,
+		.filename = filename,
+		.target = kv6,
+		.param = {scale, max_size},
+		.decode = kv6_decode,
+		.upload = kv6_upload,
+	});
+}
+
 void kv6_init() {
-	kv6_load_file(&model_playerdead, "kv6/playerdead.kv6", 0.1F);
-	kv6_load_file(&model_playerhead, "kv6/playerhead.kv6", 0.1F);
-	kv6_load_file(&model_playertorso, "kv6/playertorso.kv6", 0.1F);
-	kv6_load_file(&model_playertorsoc, "kv6/playertorsoc.kv6", 0.1F);
-	kv6_load_file(&model_playerarms, "kv6/playerarms.kv6", 0.1F);
-	kv6_load_file(&model_playerleg, "kv6/playerleg.kv6", 0.1F);
-	kv6_load_file(&model_playerlegc, "kv6/playerlegc.kv6", 0.1F);
-
-	kv6_load_file(&model_intel, "kv6/intel.kv6", 0.2F);
-	kv6_load_file(&model_tent, "kv6/cp.kv6", 0.278F);
-
-	kv6_load_file(&model_semi, "kv6/semi.kv6", 0.05F);
-	kv6_load_file(&model_smg, "kv6/smg.kv6", 0.05F);
-	kv6_load_file(&model_shotgun, "kv6/shotgun.kv6", 0.05F);
-	kv6_load_file(&model_spade, "kv6/spade.kv6", 0.05F);
-	kv6_load_file(&model_block, "kv6/block.kv6", 0.05F);
+	kv6_load_file(&model_playerdead, "kv6/playerdead.kv6", 0.1F, 0.0F);
+	kv6_load_file(&model_playerhead, "kv6/playerhead.kv6", 0.1F, 1.2F);
+	kv6_load_file(&model_playertorso, "kv6/playertorso.kv6", 0.1F, 1.8F);
+	kv6_load_file(&model_playertorsoc, "kv6/playertorsoc.kv6", 0.1F, 1.6F);
+	kv6_load_file(&model_playerarms, "kv6/playerarms.kv6", 0.1F, 2.0F);
+	kv6_load_file(&model_playerleg, "kv6/playerleg.kv6", 0.1F, 2.0F);
+	kv6_load_file(&model_playerlegc, "kv6/playerlegc.kv6", 0.1F, 1.6F);
+
+	kv6_load_file(&model_intel, "kv6/intel.kv6", 0.2F, 0.0F);
+	kv6_load_file(&model_tent, "kv6/cp.kv6", 0.278F, 0.0F);
+
+	kv6_load_file(&model_semi, "kv6/semi.kv6", 0.05F, 2.25F);
+	kv6_load_file(&model_smg, "kv6/smg.kv6", 0.05F, 2.25F);
+	kv6_load_file(&model_shotgun, "kv6/shotgun.kv6", 0.05F, 2.25F);
+	kv6_load_file(&model_spade, "kv6/spade.kv6", 0.05F, 2.25F);
+	kv6_load_file(&model_block, "kv6/block.kv6", 0.05F, 2.25F);
 	model_block.colorize = true;
-	kv6_load_file(&model_grenade, "kv6/grenade.kv6", 0.05F);
-
-	kv6_load_file(&model_semi_tracer, "kv6/semitracer.kv6", 0.05F);
-	kv6_load_file(&model_smg_tracer, "kv6/smgtracer.kv6", 0.05F);
-	kv6_load_file(&model_shotgun_tracer, "kv6/shotguntracer.kv6", 0.05F);
-
-	kv6_load_file(&model_semi_casing, "kv6/semicasing.kv6", 0.0125F);
-	kv6_load_file(&model_smg_casing, "kv6/smgcasing.kv6", 0.0125F);
-	kv6_load_file(&model_shotgun_casing, "kv6/shotguncasing.kv6", 0.0125F);
-
-	kv6_check_dimensions(&model_playerhead, 1.2F);
-	kv6_check_dimensions(&model_playertorso, 1.8F);
-	kv6_check_dimensions(&model_playertorsoc, 1.6F);
-	kv6_check_dimensions(&model_playerarms, 2.0F);
-	kv6_check_dimensions(&model_playerleg, 2.0F);
-	kv6_check_dimensions(&model_playerlegc, 1.6F);
-
-	kv6_check_dimensions(&model_semi, 2.25F);
-	kv6_check_dimensions(&model_smg, 2.25F);
-	kv6_check_dimensions(&model_shotgun, 2.25F);
-	kv6_check_dimensions(&model_spade, 2.25F);
-	kv6_check_dimensions(&model_block, 2.25F);
-	kv6_check_dimensions(&model_grenade, 2.25F);
+	kv6_load_file(&model_grenade, "kv6/grenade.kv6", 0.05F, 2.25F);
+
+	kv6_load_file(&model_semi_tracer, "kv6/semitracer.kv6", 0.05F, 0.0F);
+	kv6_load_file(&model_smg_tracer, "kv6/smgtracer.kv6", 0.05F, 0.0F);
+	kv6_load_file(&model_shotgun_tracer, "kv6/shotguntracer.kv6", 0.05F, 0.0F);
+
+	kv6_load_file(&model_semi_casing, "kv6/semicasing.kv6", 0.0125F, 0.0F);
+	kv6_load_file(&model_smg_casing, "kv6/smgcasing.kv6", 0.0125F, 0.0F);
+	kv6_load_file(&model_shotgun_casing, "kv6/shotguncasing.kv6", 0.0125F, 0.0F);
 }
 
 void kv6_rebuild_complete() {
@@ -139,6 +210,7 @@ void kv6_rebuild_complete() {
 }
 
 void kv6_load(struct kv6_t* kv6, void* bytes, float scale) {
+	kv6->mesh = (struct kv6_mesh) {0};
 	kv6->colorize = false;
 	kv6->has_display_list = false;
 	kv6->scale = scale;
@@ -224,97 +296,6 @@ void kv6_calclight(int x, int y, int z) {
 	glLightfv(GL_LIGHT0, GL_DIFFUSE, ldiffuse);
 }
 
-static int kv6_voxel_cmp(const void* a, const void* b) {
-	const struct kv6_voxel* A = a;
-	const struct kv6_voxel* B = b;
-
-	if(A->x == B->x) {
-		if(A->y == B->y) {
-			return B->z - A->z;
-		} else {
-			return A->y - B->y;
-		}
-	} else {
-		return A->x - B->x;
-	}
-}
-
-static void greedy_mesh(struct kv6_t* kv6, struct kv6_voxel* voxel, uint8_t* marked, size_t* max_a, size_t* max_b,
-						uint8_t face) {
-	if(!settings.greedy_meshing) {
-		*max_a = 1;
-		*max_b = 1;
-	} else {
-		switch(face) {
-			case KV6_VIS_POS_X:
-			case KV6_VIS_NEG_X:
-				*max_a = kv6->ysiz;
-				*max_b = kv6->zsiz;
-				break;
-			case KV6_VIS_POS_Y:
-			case KV6_VIS_NEG_Y:
-				*max_a = kv6->xsiz;
-				*max_b = kv6->ysiz;
-				break;
-			case KV6_VIS_POS_Z:
-			case KV6_VIS_NEG_Z:
-				*max_a = kv6->xsiz;
-				*max_b = kv6->zsiz;
-				break;
-		}
-
-		struct kv6_voxel lookup = *voxel;
-
-		for(size_t a = 0; a < *max_a; a++) {
-			struct kv6_voxel* recent[*max_b];
-			size_t b;
-			for(b = 0; b < *max_b; b++) {
-				switch(face) {
-					case KV6_VIS_POS_X:
-					case KV6_VIS_NEG_X:
-						lookup.y = voxel->y + b;
-						lookup.z = voxel->z - a;
-						break;
-					case KV6_VIS_POS_Y:
-					case KV6_VIS_NEG_Y:
-						lookup.x = voxel->x + a;
-						lookup.y = voxel->y + b;
-						break;
-					case KV6_VIS_POS_Z:
-					case KV6_VIS_NEG_Z:
-						lookup.x = voxel->x + a;
-						lookup.z = voxel->z - b;
-						break;
-				}
-
-				struct kv6_voxel* neighbour
-					= bsearch(&lookup, kv6->voxels, kv6->voxel_count, sizeof(struct kv6_voxel), kv6_voxel_cmp);
-
-				if(!neighbour || !(neighbour->visfaces & face)
-				   || (neighbour->color & 0xFFFFFF) != (voxel->color & 0xFFFFFF)
-				   || marked[neighbour - kv6->voxels] & face) {
-					break;
-				} else {
-					marked[neighbour - kv6->voxels] |= face;
-					recent[b] = neighbour;
-				}
-			}
-
-			if(a == 0)
-				*max_b = b;
-
-			if(b < *max_b) { // early abort
-				*max_a = a;
-
-				for(size_t k = 0; k < b; k++)
-					marked[recent[k] - kv6->voxels] &= ~face;
-
-				break;
-			}
-		}
-	}
-}
-
 static int kv6_program = -1;
 void kv6_render(struct kv6_t* kv6, unsigned char team) {
 	if(!kv6)
@@ -336,15 +317,16 @@ void kv6_render(struct kv6_t* kv6, unsigned char team) {
 			glx_displaylist_create(kv6->display_list + 0, true, true);
 			glx_displaylist_create(kv6->display_list + 1, true, true);
 
-			uint8_t marked[kv6->voxel_count];
-			memset(marked, 0, sizeof(uint8_t) * kv6->voxel_count);
+			// the setting changed since loading
+			if(!kv6->mesh.quads || kv6->mesh.greedy != settings.greedy_meshing)
+				kv6_mesh(kv6, false);
 
-			struct kv6_voxel* voxel = kv6->voxels;
-			for(size_t k = 0; k < kv6->voxel_count; k++, voxel++) {
-				int b = red(voxel->color);
-				int g = green(voxel->color);
-				int r = blue(voxel->color);
-				int a = alpha(voxel->color);
+			for(int k = 0; k < kv6->mesh.count; k++) {
+				struct kv6_quad* q = kv6->mesh.quads + k;
+				int b = red(q->color);
+				int g = green(q->color);
+				int r = blue(q->color);
+				int a = alpha(q->color);
 
 				struct tesselator* tess = &tess_color;
 
@@ -355,59 +337,36 @@ void kv6_render(struct kv6_t* kv6, unsigned char team) {
 					r = g = b = 255;
 				}
 
-				tesselator_set_normal(tess, kv6_normals[a][0] * 128, -kv6_normals[a][2] * 128, kv6_normals[a][1] * 128);
-
-				if(voxel->visfaces & KV6_VIS_POS_Y) {
-					size_t max_x, max_z;
-					greedy_mesh(kv6, voxel, marked, &max_x, &max_z, KV6_VIS_POS_Y);
-
-					tesselator_set_color(tess, rgba(r, g, b, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_Y_P, voxel->x, voxel->z, voxel->y, max_x, 1, max_z);
-				}
+				float shade = 1.0F;
+				enum tesselator_cube_face face;
 
-				if(voxel->visfaces & KV6_VIS_NEG_Y) {
-					size_t max_x, max_z;
-					greedy_mesh(kv6, voxel, marked, &max_x, &max_z, KV6_VIS_NEG_Y);
-
-					tesselator_set_color(tess, rgba(r * 0.6F, g * 0.6F, b * 0.6F, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_Y_N, voxel->x, voxel->z, voxel->y, max_x, 1, max_z);
-				}
-
-				if(voxel->visfaces & KV6_VIS_NEG_Z) {
-					size_t max_x, max_y;
-					greedy_mesh(kv6, voxel, marked, &max_x, &max_y, KV6_VIS_NEG_Z);
-
-					tesselator_set_color(tess, rgba(r * 0.95F, g * 0.95F, b * 0.95F, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_Z_N, voxel->x, voxel->z - (max_y - 1), voxel->y,
-												  max_x, max_y, 1);
-				}
-
-				if(voxel->visfaces & KV6_VIS_POS_Z) {
-					size_t max_x, max_y;
-					greedy_mesh(kv6, voxel, marked, &max_x, &max_y, KV6_VIS_POS_Z);
-
-					tesselator_set_color(tess, rgba(r * 0.9F, g * 0.9F, b * 0.9F, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_Z_P, voxel->x, voxel->z - (max_y - 1), voxel->y,
-												  max_x, max_y, 1);
-				}
-
-				if(voxel->visfaces & KV6_VIS_NEG_X) {
-					size_t max_y, max_z;
-					greedy_mesh(kv6, voxel, marked, &max_y, &max_z, KV6_VIS_NEG_X);
-
-					tesselator_set_color(tess, rgba(r * 0.85F, g * 0.85F, b * 0.85F, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_X_N, voxel->x, voxel->z - (max_y - 1), voxel->y, 1,
-												  max_y, max_z);
+				switch(q->face) {
+					case KV6_VIS_POS_Y: face = CUBE_FACE_Y_P; break;
+					case KV6_VIS_NEG_Y:
+						face = CUBE_FACE_Y_N;
+						shade = 0.6F;
+						break;
+					case KV6_VIS_NEG_Z:
+						face = CUBE_FACE_Z_N;
+						shade = 0.95F;
+						break;
+					case KV6_VIS_POS_Z:
+						face = CUBE_FACE_Z_P;
+						shade = 0.9F;
+						break;
+					case KV6_VIS_NEG_X:
+						face = CUBE_FACE_X_N;
+						shade = 0.85F;
+						break;
+					default:
+						face = CUBE_FACE_X_P;
+						shade = 0.8F;
+						break;
 				}
 
-				if(voxel->visfaces & KV6_VIS_POS_X) {
-					size_t max_y, max_z;
-					greedy_mesh(kv6, voxel, marked, &max_y, &max_z, KV6_VIS_POS_X);
-
-					tesselator_set_color(tess, rgba(r * 0.8F, g * 0.8F, b * 0.8F, 0));
-					tesselator_addi_cube_face_adv(tess, CUBE_FACE_X_P, voxel->x, voxel->z - (max_y - 1), voxel->y, 1,
-												  max_y, max_z);
-				}
+				tesselator_set_normal(tess, kv6_normals[a][0] * 128, -kv6_normals[a][2] * 128, kv6_normals[a][1] * 128);
+				tesselator_set_color(tess, rgba(r * shade, g * shade, b * shade, 0));
+				tesselator_addi_cube_face_adv(tess, face, q->x, q->y, q->z, q->sx, q->sy, q->sz);
 			}
 
 			tesselator_glx(&tess_color, kv6->display_list + 0);
@@ -26,19 +26,7 @@
 #include "aabb.h"
 #include "glx.h"
 #include "tesselator.h"
-
-#define KV6_VIS_NEG_X (1 << 0)
-#define KV6_VIS_POS_X (1 << 1)
-#define KV6_VIS_NEG_Z (1 << 2)
-#define KV6_VIS_POS_Z (1 << 3)
-#define KV6_VIS_POS_Y (1 << 4)
-#define KV6_VIS_NEG_Y (1 << 5)
-
-struct kv6_voxel {
-	uint16_t x, y, z;
-	uint8_t visfaces;
-	uint32_t color;
-};
+#include "kv6mesh.h"
 
 struct kv6_t {
 	uint16_t xsiz, ysiz, zsiz;
@@ -47,6 +35,7 @@ struct kv6_t {
 	struct glx_displaylist display_list[2];
 	struct kv6_voxel* voxels;
 	int voxel_count;
+	struct kv6_mesh mesh;
 	float scale;
 	float red, green, blue;
 };
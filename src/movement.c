@@ -0,0 +1,235 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <assert.h>
+
+#include "movement.h"
+
+#define FALL_DAMAGE_VELOCITY 0.58F
+#define FALL_SLOW_DOWN 0.24F
+#define SQRT 0.70710678F
+#define FALL_DAMAGE_SCALAR 4096
+
+void movement_cache_gather(struct movement_cache* cache, const struct occupancy* occ, float x, float y) {
+	assert(cache != NULL && occ != NULL);
+
+	cache->occ = occ;
+	cache->x = (int)x - MOVEMENT_CACHE_RADIUS;
+	cache->y = (int)y - MOVEMENT_CACHE_RADIUS;
+
+	uint64_t* column = cache->columns;
+
+	for(int cy = cache->y; cy < cache->y + MOVEMENT_CACHE_SIZE; cy++) {
+		for(int cx = cache->x; cx < cache->x + MOVEMENT_CACHE_SIZE; cx++) {
+			// never read, movement_clipbox() checks the map borders first
+			if(cx < 0 || cy < 0 || cx >= occ->width || cy >= occ->depth)
+				*column++ = 0;
+			else
+				*column++ = occupancy_column(occ, cx, cy);
+		}
+	}
+}
+
+bool movement_clipbox(const struct movement_cache* cache, float x, float y, float z) {
+	const struct occupancy* occ = cache->occ;
+	int sz;
+
+	if(x < 0 || x >= occ->width || y < 0 || y >= occ->depth)
+		return true;
+	else if(z < 0)
+		return false;
+	sz = (int)z;
+	if(sz == 63)
+		sz = 62;
+	else if(sz >= 64)
+		return true;
+
+	unsigned int cx = (int)x - cache->x;
+	unsigned int cy = (int)y - cache->y;
+	uint64_t column = (cx < MOVEMENT_CACHE_SIZE && cy < MOVEMENT_CACHE_SIZE)
+		? cache->columns[cx + cy * MOVEMENT_CACHE_SIZE]
+		: occupancy_column(occ, (int)x, (int)y);
+
+	return (column >> (63 - sz)) & 1;
+}
+
+void movement_boxclipmove(struct movement_body* b, const struct movement_cache* cache, float fsynctics) {
+	float offset, m, f, nx, ny, nz, z;
+	long climb = 0;
+
+	f = fsynctics * 32.f;
+	nx = f * b->velocity.x + b->pos.x;
+	ny = f * b->velocity.y + b->pos.y;
+
+	if(b->crouch) {
+		offset = 0.45f;
+		m = 0.9f;
+	} else {
+		offset = 0.9f;
+		m = 1.35f;
+	}
+
+	nz = b->pos.z + offset;
+
+	if(b->velocity.x < 0)
+		f = -0.45f;
+	else
+		f = 0.45f;
+	z = m;
+	while(z >= -1.36f && !movement_clipbox(cache, nx + f, b->pos.y - 0.45f, nz + z)
+		  && !movement_clipbox(cache, nx + f, b->pos.y + 0.45f, nz + z))
+		z -= 0.9f;
+	if(z < -1.36f)
+		b->pos.x = nx;
+	else if(!b->crouch && b->orientation.z < 0.5f && !b->sprint) {
+		z = 0.35f;
+		while(z >= -2.36f && !movement_clipbox(cache, nx + f, b->pos.y - 0.45f, nz + z)
+			  && !movement_clipbox(cache, nx + f, b->pos.y + 0.45f, nz + z))
+			z -= 0.9f;
+		if(z < -2.36f) {
+			b->pos.x = nx;
+			climb = 1;
+		} else
+			b->velocity.x = 0;
+	} else
+		b->velocity.x = 0;
+
+	if(b->velocity.y < 0)
+		f = -0.45f;
+	else
+		f = 0.45f;
+	z = m;
+	while(z >= -1.36f && !movement_clipbox(cache, b->pos.x - 0.45f, ny + f, nz + z)
+		  && !movement_clipbox(cache, b->pos.x + 0.45f, ny + f, nz + z))
+		z -= 0.9f;
+	if(z < -1.36f)
+		b->pos.y = ny;
+	else if(!b->crouch && b->orientation.z < 0.5f && !b->sprint && !climb) {
+		z = 0.35f;
+		while(z >= -2.36f && !movement_clipbox(cache, b->pos.x - 0.45f, ny + f, nz + z)
+			  && !movement_clipbox(cache, b->pos.x + 0.45f, ny + f, nz + z))
+			z -= 0.9f;
+		if(z < -2.36f) {
+			b->pos.y = ny;
+			climb = 1;
+		} else
+			b->velocity.y = 0;
+	} else if(!climb)
+		b->velocity.y = 0;
+
+	b->climbed = climb;
+
+	if(climb) {
+		b->velocity.x *= 0.5f;
+		b->velocity.y *= 0.5f;
+		nz--;
+		m = -1.35f;
+	} else {
+		if(b->velocity.z < 0)
+			m = -m;
+		nz += b->velocity.z * fsynctics * 32.f;
+	}
+
+	b->airborne = true;
+
+	if(movement_clipbox(cache, b->pos.x - 0.45f, b->pos.y - 0.45f, nz + m)
+	   || movement_clipbox(cache, b->pos.x - 0.45f, b->pos.y + 0.45f, nz + m)
+	   || movement_clipbox(cache, b->pos.x + 0.45f, b->pos.y - 0.45f, nz + m)
+	   || movement_clipbox(cache, b->pos.x + 0.45f, b->pos.y + 0.45f, nz + m)) {
+		if(b->velocity.z >= 0) {
+			b->wade = b->pos.z > 61;
+			b->airborne = false;
+		}
+		b->velocity.z = 0;
+	} else
+		b->pos.z = nz - offset;
+}
+
+int movement_step(struct movement_body* b, const struct movement_cache* cache, float fsynctics) {
+	assert(b != NULL && cache != NULL);
+
+	float f, f2;
+
+	// move player and perform simple physics (gravity, momentum, friction)
+	f = fsynctics; // player acceleration scalar
+	if(b->airborne)
+		f *= 0.1f;
+	else if(b->crouch)
+		f *= 0.3f;
+	else if(b->aiming || b->sneak)
+		f *= 0.5f;
+	else if(b->sprint)
+		f *= 1.3f;
+
+	if((b->up || b->down) && (b->left || b->right))
+		f *= SQRT; // if strafe + forward/backwards then limit diagonal velocity
+
+	float len = sqrt(pow(b->orientation.x, 2.0F) + pow(b->orientation.y, 2.0F));
+	float sx = -b->orientation.y / len;
+	float sy = b->orientation.x / len;
+
+	if(b->up) {
+		b->velocity.x += b->orientation.x * f;
+		b->velocity.y += b->orientation.y * f;
+	} else if(b->down) {
+		b->velocity.x -= b->orientation.x * f;
+		b->velocity.y -= b->orientation.y * f;
+	}
+	if(b->left) {
+		b->velocity.x -= sx * f;
+		b->velocity.y -= sy * f;
+	} else if(b->right) {
+		b->velocity.x += sx * f;
+		b->velocity.y += sy * f;
+	}
+
+	f = fsynctics + 1;
+	b->velocity.z += fsynctics;
+	b->velocity.z /= f; // air friction
+	if(b->wade)
+		f = fsynctics * 6.0F + 1; // water friction
+	else if(!b->airborne)
+		f = fsynctics * 4.0F + 1; // ground friction
+	b->velocity.x /= f;
+	b->velocity.y /= f;
+	f2 = b->velocity.z;
+	movement_boxclipmove(b, cache, fsynctics);
+	// hit ground... check if hurt
+
+	int ret = 0;
+	b->landed = false;
+
+	if(!b->velocity.z && (f2 > FALL_SLOW_DOWN)) {
+		// slow down on landing
+		b->velocity.x *= 0.5F;
+		b->velocity.y *= 0.5F;
+		b->landed = true;
+
+		// return fall damage
+		if(f2 > FALL_DAMAGE_VELOCITY) {
+			f2 -= FALL_DAMAGE_VELOCITY;
+			ret = f2 * f2 * FALL_DAMAGE_SCALAR;
+		} else {
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,57 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "occupancy.h"
+
+#define MOVEMENT_CACHE_RADIUS 2
+#define MOVEMENT_CACHE_SIZE (MOVEMENT_CACHE_RADIUS * 2 + 1)
+
+// occupancy columns around a player, gathered once per tick
+// probes outside of it read the map directly
+struct movement_cache {
+	const struct occupancy* occ;
+	int x, y;
+	uint64_t columns[MOVEMENT_CACHE_SIZE * MOVEMENT_CACHE_SIZE];
+};
+
+// everything the voxlap physics touch, in voxlap coordinates (z is down)
+struct movement_body {
+	struct {
+		float x, y, z;
+	} pos, orientation, velocity;
+	bool up, down, left, right;
+	bool crouch, sneak, sprint, aiming;
+	bool airborne, wade;
+	bool climbed; // stepped up a block during the last step
+	bool landed;  // hit the ground fast enough to slow down
+};
+
+void movement_cache_gather(struct movement_cache* cache, const struct occupancy* occ, float x, float y);
+bool movement_clipbox(const struct movement_cache* cache, float x, float y, float z);
+void movement_boxclipmove(struct movement_body* b, const struct movement_cache* cache, float fsynctics);
+// returns fall damage, -1 for a soft landing and 0 otherwise
+int movement_step(struct movement_body* b, const struct movement_cache* cache, float fsynctics);
+
+#endif
@@ -20,6 +20,9 @@
 #include <enet/enet.h>
 #include <math.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
 
 #include "libdeflate.h"
 #include "texture.h"
@@ -38,6 +41,10 @@
 #include "texture.h"
 #include "chunk.h"
 #include "config.h"
+#include "spsc.h"
+#include "delivery.h"
+#include "record.h"
+#include "profiler.h"
 
 void (*packets[256])(void* data, int len) = {NULL};
 
@@ -62,15 +69,221 @@ int compressed_chunk_data_estimate = 0;
 
 struct network_stat network_stats[40];
 float network_stats_last = 0.0F;
+struct network_packet_stat network_packet_stats[256];
+
+// as received from the server, ids that are only ever sent have no name here
+static const char* network_packet_names[256] = {
+	[PACKET_POSITIONDATA_ID] = "PositionData",
+	[PACKET_ORIENTATIONDATA_ID] = "OrientationData",
+	[PACKET_WORLDUPDATE_ID] = "WorldUpdate",
+	[PACKET_INPUTDATA_ID] = "InputData",
+	[PACKET_WEAPONINPUT_ID] = "WeaponInput",
+	[PACKET_SETHP_ID] = "SetHP",
+	[PACKET_GRENADE_ID] = "Grenade",
+	[PACKET_SETTOOL_ID] = "SetTool",
+	[PACKET_SETCOLOR_ID] = "SetColor",
+	[PACKET_EXISTINGPLAYER_ID] = "ExistingPlayer",
+	[PACKET_SHORTPLAYERDATA_ID] = "ShortPlayerData",
+	[PACKET_MOVEOBJECT_ID] = "MoveObject",
+	[PACKET_CREATEPLAYER_ID] = "CreatePlayer",
+	[PACKET_BLOCKACTION_ID] = "BlockAction",
+	[PACKET_BLOCKLINE_ID] = "BlockLine",
+	[PACKET_STATEDATA_ID] = "StateData",
+	[PACKET_KILLACTION_ID] = "KillAction",
+	[PACKET_CHATMESSAGE_ID] = "ChatMessage",
+	[PACKET_MAPSTART_ID] = "MapStart",
+	[PACKET_MAPCHUNK_ID] = "MapChunk",
+	[PACKET_PLAYERLEFT_ID] = "PlayerLeft",
+	[PACKET_TERRITORYCAPTURE_ID] = "TerritoryCapture",
+	[PACKET_PROGRESSBAR_ID] = "ProgressBar",
+	[PACKET_INTELCAPTURE_ID] = "IntelCapture",
+	[PACKET_INTELPICKUP_ID] = "IntelPickup",
+	[PACKET_INTELDROP_ID] = "IntelDrop",
+	[PACKET_RESTOCK_ID] = "Restock",
+	[PACKET_FOGCOLOR_ID] = "FogColor",
+	[PACKET_WEAPONRELOAD_ID] = "WeaponReload",
+	[PACKET_CHANGETEAM_ID] = "ChangeTeam",
+	[PACKET_CHANGEWEAPON_ID] = "ChangeWeapon",
+	[PACKET_HANDSHAKEINIT_ID] = "HandshakeInit",
+	[PACKET_VERSIONGET_ID] = "VersionGet",
+	[PACKET_EXTINFO_ID] = "ExtInfo",
+	[PACKET_EXT_BASE + EXT_PLAYER_PROPERTIES] = "PlayerProperties",
+};
+
+const char* network_packet_name(int id) {
+	return network_packet_names[id & 0xFF] ? network_packet_names[id & 0xFF] : "Unknown";
+}
+
+static int network_histogram_bucket(double seconds) {
+	int us = seconds * 1000000.0;
+	int bucket = 0;
+
+	while(us > 0 && bucket < NETWORK_HISTOGRAM_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+bool network_packet_stats_dump(const char* filename) {
+	FILE* f = fopen(filename, "w");
+
+	if(!f)
+		return false;
+
+	fprintf(f, "{\n\t\"histogram_us\": [0");
+	for(int k = 1; k < NETWORK_HISTOGRAM_BUCKETS; k++)
+		fprintf(f, ", %i", 1 << (k - 1));
+	fprintf(f, "],\n\t\"packets\": [");
+
+	bool first = true;
+	for(int id = 0; id < 256; id++) {
+		struct network_packet_stat* s = network_packet_stats + id;
+
+		if(!s->count)
+			continue;
+
+		fprintf(f,
+				"%s\n\t\t{\"id\": %i, \"name\": \"%s\", \"count\": %lu, \"bytes\": %lu, \"handler_ms\": %.3f, "
+				"\"handler_max_ms\": %.3f, \"latency_ms\": %.3f, \"latency_max_ms\": %.3f, \"histogram\": [",
+				first ? "" : ",", id, network_packet_name(id), s->count, s->bytes, s->handler_time * 1000.0,
+				s->handler_max * 1000.0, s->latency * 1000.0, s->latency_max * 1000.0);
+
+		for(int k = 0; k < NETWORK_HISTOGRAM_BUCKETS; k++)
+			fprintf(f, k ? ", %lu" : "%lu", s->histogram[k]);
+
+		fprintf(f, "]}");
+		first = false;
+	}
+
+	fprintf(f, "\n\t]\n}\n");
+	fclose(f);
+	return true;
+}
+
+// called whenever a session ends
+static void network_packet_stats_finish() {
+	unsigned long total = 0;
+	for(int id = 0; id < 256; id++)
+		total += network_packet_stats[id].count;
+
+	if(!total)
+		return;
+
+	time_t t = time(NULL);
+	char filename[64];
+	strftime(filename, sizeof(filename), "logs/packets-%Y-%m-%d-%H%M%S.json", localtime(&t));
+
+	if(network_packet_stats_dump(filename))
+		log_info("Packet statistics written to %s", filename);
+
+	memset(network_packet_stats, 0, sizeof(network_packet_stats));
+}
 
 ENetHost* client;
 ENetPeer* peer;
 
+#define NETWORK_INBOUND_LENGTH 4096
+#define NETWORK_OUTBOUND_LENGTH 1024
+
+struct network_message {
+	ENetEventType type;
+	ENetPacket* packet;
+	enet_uint8 channel;
+	enet_uint32 data;
+	ENetAddress address;
+	double time; // network_clock()
+};
+
+// owns the host while running, the game thread only talks to it through the queues
+static struct network_thread {
+	bool active;
+	bool running;
+	pthread_t thread;
+	struct spsc_queue inbound;	// of struct network_message
+	struct spsc_queue outbound; // of ENetPacket*
+	unsigned int round_trip_time;
+	// packets the outbound queue had no room for, handed over before anything newer
+	ENetPacket** backlog;
+	size_t backlog_length, backlog_capacity;
+	unsigned long stalls;
+} network_thread;
+
+// everything sent during a tick, flushed at the end of network_update()
+static struct delivery_batch network_batch;
+
+// every inbound packet is written to the recording while active
+static struct network_recording {
+	bool active;
+	struct record_writer writer;
+	double start; // network_clock()
+} network_recording;
+
+// feeds a recording into the packet handlers instead of a server
+static struct network_replay {
+	bool active;
+	struct record_reader reader;
+	float speed; // zero: one tick of recorded time per frame, as fast as possible
+	double time; // recorded time played so far in seconds
+	double start, last_frame;
+	size_t packets, bytes;
+	int frames;
+	double frame_max;
+} network_replay;
+
+static enum network_state network_state = NETWORK_STATE_IDLE;
+static double network_state_start = 0.0;
+static double network_connect_start = 0.0;
+
+static float network_latency_sum = 0.0F;
+static int network_latency_count = 0;
+
 char network_custom_reason[17];
 
 void network_init_host() {
 	client = enet_host_create(NULL, 1, 1, 0, 0); // limit bandwidth here if you want to
-	enet_host_compress_with_range_coder(client);
+	if(client)
+		enet_host_compress_with_range_coder(client);
+}
+
+static void network_host_destroy() {
+	if(client)
+		enet_host_destroy(client);
+	client = NULL;
+	peer = NULL;
+}
+
+enum network_state network_get_state() {
+	return network_state;
+}
+
+float network_state_duration() {
+	return window_time() - network_state_start;
+}
+
+static void network_set_state(enum network_state state, const char* reason) {
+	double now = window_time();
+
+	switch(state) {
+		case NETWORK_STATE_CONFIRMING:
+			log_info("Connection established after %.0fms", (now - network_connect_start) * 1000.0);
+			break;
+		case NETWORK_STATE_CONNECTED:
+			log_info("Connection confirmed after %.0fms", (now - network_connect_start) * 1000.0);
+			break;
+		case NETWORK_STATE_IDLE:
+			if(network_state == NETWORK_STATE_DISCONNECTING)
+				log_info("Disconnected after %.0fms", (now - network_state_start) * 1000.0);
+			break;
+		default: break;
+	}
+
+	network_state = state;
+	network_state_start = now;
+
+	if(hud_active && hud_active->network_progress)
+		hud_active->network_progress(state, reason);
 }
 
 const char* network_reason_disconnect(int code) {
@@ -171,58 +384,41 @@ void read_PacketChatMessage(void* data, int len) {
 	chat_add(0, color, m);
 }
 
+static void network_block_edits(int player_id, const struct sim_edit* edits, int count, bool fill) {
+	for(int k = 0; k < count; k++) {
+		const struct sim_edit* e = edits + k;
+
+		if(e->solid) {
+			// lines only fill air, single blocks also recolor
+			if(!fill || map_isair(e->x, e->y, e->z))
+				map_set(e->x, e->y, e->z,
+						players[player_id].block.red | (players[player_id].block.green << 8)
+							| (players[player_id].block.blue << 16));
+		} else {
+			int col = map_get(e->x, e->y, e->z);
+			map_set(e->x, e->y, e->z, 0xFFFFFFFF);
+			map_update_physics(e->x, e->y, e->z);
+
+			if(e->debris)
+				particle_create(col, e->x + 0.5F, e->y + 0.5F, e->z + 0.5F, 2.5F, 1.0F, 8, 0.1F, 0.25F);
+		}
+	}
+}
+
 void read_PacketBlockAction(void* data, int len) {
 	struct PacketBlockAction* p = (struct PacketBlockAction*)data;
-	switch(p->action_type) {
-		case ACTION_DESTROY:
-			if((63 - p->z) > 0) {
-				int col = map_get(p->x, 63 - p->z, p->y);
-				map_set(p->x, 63 - p->z, p->y, 0xFFFFFFFF);
-				map_update_physics(p->x, 63 - p->z, p->y);
-				particle_create(col, p->x + 0.5F, 63 - p->z + 0.5F, p->y + 0.5F, 2.5F, 1.0F, 8, 0.1F, 0.25F);
-			}
-			break;
-		case ACTION_GRENADE:
-			for(int y = (63 - (p->z)) - 1; y <= (63 - (p->z)) + 1; y++) {
-				for(int z = (p->y) - 1; z <= (p->y) + 1; z++) {
-					for(int x = (p->x) - 1; x <= (p->x) + 1; x++) {
-						if(y > 1) {
-							map_set(x, y, z, 0xFFFFFFFF);
-							map_update_physics(x, y, z);
-						}
-					}
-				}
-			}
-			break;
-		case ACTION_SPADE:
-			if((63 - p->z - 1) > 1) {
-				map_set(p->x, 63 - p->z - 1, p->y, 0xFFFFFFFF);
-				map_update_physics(p->x, 63 - p->z - 1, p->y);
-			}
-			if((63 - p->z + 0) > 1) {
-				int col = map_get(p->x, 63 - p->z, p->y);
-				map_set(p->x, 63 - p->z + 0, p->y, 0xFFFFFFFF);
-				map_update_physics(p->x, 63 - p->z + 0, p->y);
-				particle_create(col, p->x + 0.5F, 63 - p->z + 0.5F, p->y + 0.5F, 2.5F, 1.0F, 8, 0.1F, 0.25F);
-			}
-			if((63 - p->z + 1) > 1) {
-				map_set(p->x, 63 - p->z + 1, p->y, 0xFFFFFFFF);
-				map_update_physics(p->x, 63 - p->z + 1, p->y);
-			}
-			break;
-		case ACTION_BUILD:
-			if(p->player_id < PLAYERS_MAX) {
-				bool play_sound = map_isair(p->x, 63 - p->z, p->y);
 
-				map_set(p->x, 63 - p->z, p->y,
-						players[p->player_id].block.red | (players[p->player_id].block.green << 8)
-							| (players[p->player_id].block.blue << 16));
+	if(p->action_type == ACTION_BUILD && p->player_id >= PLAYERS_MAX)
+		return;
 
-				if(play_sound)
-					sound_create(SOUND_WORLD, &sound_build, p->x + 0.5F, 63 - p->z + 0.5F, p->y + 0.5F);
-			}
-			break;
-	}
+	struct sim_edit edits[SIM_ACTION_EDITS];
+	int count = sim_block_action_edits(p->action_type, p->x, p->y, p->z, map_size_y, edits);
+	bool play_sound = p->action_type == ACTION_BUILD && map_isair(p->x, 63 - p->z, p->y);
+
+	network_block_edits(p->player_id, edits, count, false);
+
+	if(play_sound)
+		sound_create(SOUND_WORLD, &sound_build, p->x + 0.5F, 63 - p->z + 0.5F, p->y + 0.5F);
 }
 
 void read_PacketBlockLine(void* data, int len) {
@@ -230,22 +426,11 @@ void read_PacketBlockLine(void* data, int len) {
 	if(p->player_id >= PLAYERS_MAX) {
 		return;
 	}
-	if(p->sx == p->ex && p->sy == p->ey && p->sz == p->ez) {
-		map_set(p->sx, 63 - p->sz, p->sy,
-				players[p->player_id].block.red | (players[p->player_id].block.green << 8)
-					| (players[p->player_id].block.blue << 16));
-	} else {
-		struct Point blocks[64];
-		int len = map_cube_line(p->sx, p->sy, p->sz, p->ex, p->ey, p->ez, blocks);
-		while(len > 0) {
-			if(map_isair(blocks[len - 1].x, 63 - blocks[len - 1].z, blocks[len - 1].y)) {
-				map_set(blocks[len - 1].x, 63 - blocks[len - 1].z, blocks[len - 1].y,
-						players[p->player_id].block.red | (players[p->player_id].block.green << 8)
-							| (players[p->player_id].block.blue << 16));
-			}
-			len--;
-		}
-	}
+
+	struct sim_edit edits[SIM_LINE_LENGTH];
+	int count = sim_block_line_edits(p->sx, p->sy, p->sz, p->ex, p->ey, p->ez, map_size_y, edits);
+	network_block_edits(p->player_id, edits, count, count > 1);
+
 	sound_create(SOUND_WORLD, &sound_build, (p->sx + p->ex) * 0.5F + 0.5F, (63 - p->sz + 63 - p->ez) * 0.5F + 0.5F,
 				 (p->sy + p->ey) * 0.5F + 0.5F);
 }
@@ -950,69 +1135,275 @@ void network_updateColor() {
 	network_send(PACKET_SETCOLOR_ID, &c, sizeof(c));
 }
 
-unsigned char network_send_tmp[512];
+// window_time() is a float and too coarse for handler times after some uptime
+static double network_clock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* network_thread_run(void* user) {
+	PROFILE_THREAD("network thread");
+
+	struct network_message pending;
+	bool has_pending = false;
+
+	while(__atomic_load_n(&network_thread.running, __ATOMIC_ACQUIRE)) {
+		PROFILE_SCOPE("network_service");
+
+		ENetPacket* packet;
+		while(spsc_pop(&network_thread.outbound, &packet))
+			enet_peer_send(peer, 0, packet);
+
+		if(has_pending) {
+			if(!spsc_push(&network_thread.inbound, &pending)) { // game thread is stalled, keep the packet
+				enet_host_flush(client);
+				usleep(1000);
+				continue;
+			}
+
+			has_pending = false;
+
+			if(pending.type == ENET_EVENT_TYPE_DISCONNECT)
+				break;
+		}
+
+		ENetEvent event;
+		if(enet_host_service(client, &event, 1) > 0
+		   && (event.type == ENET_EVENT_TYPE_RECEIVE || event.type == ENET_EVENT_TYPE_DISCONNECT)) {
+			pending = (struct network_message) {
+				.type = event.type,
+				.packet = event.packet,
+				.channel = event.channelID,
+				.data = event.data,
+				.address = event.peer->address,
+				.time = network_clock(),
+			};
+			has_pending = true;
+		}
+
+		__atomic_store_n(&network_thread.round_trip_time, peer->roundTripTime, __ATOMIC_RELAXED);
+	}
+
+	// stopped while the game thread was stalled
+	if(has_pending && pending.type == ENET_EVENT_TYPE_RECEIVE)
+		enet_packet_destroy(pending.packet);
+
+	return NULL;
+}
+
+static void network_thread_start() {
+	if(!spsc_create(&network_thread.inbound, sizeof(struct network_message), NETWORK_INBOUND_LENGTH))
+		return;
+
+	if(!spsc_create(&network_thread.outbound, sizeof(ENetPacket*), NETWORK_OUTBOUND_LENGTH)) {
+		spsc_destroy(&network_thread.inbound);
+		return;
+	}
+
+	network_thread.round_trip_time = peer->roundTripTime;
+	network_thread.running = true;
+	network_thread.backlog_length = 0;
+	network_thread.stalls = 0;
+
+	if(pthread_create(&network_thread.thread, NULL, network_thread_run, NULL)) {
+		spsc_destroy(&network_thread.inbound);
+		spsc_destroy(&network_thread.outbound);
+		return;
+	}
+
+	network_thread.active = true;
+}
+
+// hands the host back to the game thread, anything still queued is dropped
+static void network_thread_stop() {
+	if(!network_thread.active)
+		return;
+
+	__atomic_store_n(&network_thread.running, false, __ATOMIC_RELEASE);
+	pthread_join(network_thread.thread, NULL);
+
+	struct network_message msg;
+	while(spsc_pop(&network_thread.inbound, &msg)) {
+		if(msg.packet)
+			enet_packet_destroy(msg.packet);
+	}
+
+	ENetPacket* packet;
+	while(spsc_pop(&network_thread.outbound, &packet))
+		enet_packet_destroy(packet);
+
+	for(size_t k = 0; k < network_thread.backlog_length; k++)
+		enet_packet_destroy(network_thread.backlog[k]);
+
+	if(network_thread.stalls > 0)
+		log_warn("Outbound queue was full %lu times", network_thread.stalls);
+
+	free(network_thread.backlog);
+	network_thread.backlog = NULL;
+	network_thread.backlog_length = network_thread.backlog_capacity = 0;
+
+	spsc_destroy(&network_thread.inbound);
+	spsc_destroy(&network_thread.outbound);
+	network_thread.active = false;
+}
+
 void network_send(int id, void* data, int len) {
-	if(network_connected) {
-		network_stats[0].outgoing += len + 1;
-		network_send_tmp[0] = id;
-		memcpy(network_send_tmp + 1, data, len);
-		enet_peer_send(peer, 0, enet_packet_create(network_send_tmp, len + 1, ENET_PACKET_FLAG_RELIABLE));
+	if(network_connected && !network_replay.active) {
+		ENetPacket* packet = delivery_packet(&network_batch, id, len);
+
+		if(packet)
+			memcpy(packet->data + 1, data, len);
+	}
+}
+
+// the game thread never waits for the network thread, a stalled thread only grows the backlog
+static void network_backlog_drain() {
+	size_t k = 0;
+
+	while(k < network_thread.backlog_length && spsc_push(&network_thread.outbound, network_thread.backlog + k))
+		k++;
+
+	network_thread.backlog_length -= k;
+	memmove(network_thread.backlog, network_thread.backlog + k, network_thread.backlog_length * sizeof(ENetPacket*));
+}
+
+static void network_send_packet(ENetPacket* packet, void* user) {
+	network_stats[0].outgoing += packet->dataLength;
+
+	if(!network_thread.active) {
+		enet_peer_send(peer, 0, packet);
+		return;
+	}
+
+	if(!network_thread.backlog_length && spsc_push(&network_thread.outbound, &packet))
+		return;
+
+	if(network_thread.backlog_length == network_thread.backlog_capacity) {
+		network_thread.backlog_capacity = max(network_thread.backlog_capacity * 2, 64);
+		network_thread.backlog
+			= realloc(network_thread.backlog, network_thread.backlog_capacity * sizeof(ENetPacket*));
+		CHECK_ALLOCATION_ERROR(network_thread.backlog)
 	}
+
+	if(!network_thread.backlog_length)
+		network_thread.stalls++;
+
+	network_thread.backlog[network_thread.backlog_length++] = packet;
+}
+
+// one handover per tick, so that enet can pack everything into as few datagrams as possible
+static void network_flush() {
+	if(network_thread.active)
+		network_backlog_drain();
+
+	delivery_flush(&network_batch, network_send_packet, NULL);
+
+	if(!network_thread.active)
+		enet_host_flush(client);
 }
 
 unsigned int network_ping() {
-	return network_connected ? peer->roundTripTime : 0;
+	if(!network_connected || network_replay.active)
+		return 0;
+
+	return network_thread.active ? __atomic_load_n(&network_thread.round_trip_time, __ATOMIC_RELAXED)
+								 : peer->roundTripTime;
+}
+
+// drops whatever connection there is without waiting for the server
+static void network_close() {
+	network_thread_stop();
+
+	if(peer && network_state != NETWORK_STATE_DISCONNECTING) {
+		if(network_connected)
+			enet_peer_disconnect_now(peer, 0);
+		else
+			enet_peer_reset(peer);
+	}
+
+	network_host_destroy();
+	network_connected = 0;
+	network_logged_in = 0;
+	delivery_clear(&network_batch);
+
+	if(network_state != NETWORK_STATE_IDLE)
+		network_set_state(NETWORK_STATE_IDLE, NULL);
 }
 
 void network_disconnect() {
-	if(network_connected) {
-		enet_peer_disconnect(peer, 0);
-		network_connected = 0;
-		network_logged_in = 0;
+	if(network_replay.active) {
+		network_replay_stop();
+		return;
+	}
 
-		ENetEvent event;
-		while(enet_host_service(client, &event, 3000) > 0) {
-			switch(event.type) {
-				case ENET_EVENT_TYPE_RECEIVE: enet_packet_destroy(event.packet); break;
-				case ENET_EVENT_TYPE_DISCONNECT:
-					enet_host_destroy(client);
+	switch(network_state) {
+		case NETWORK_STATE_CONNECTING: network_close(); break;
+		case NETWORK_STATE_CONFIRMING:
+		case NETWORK_STATE_CONNECTED:
+			network_thread_stop();
+			network_flush();
+			network_packet_stats_finish();
+			enet_peer_disconnect(peer, 0);
+			network_connected = 0;
+			network_logged_in = 0;
+			network_set_state(NETWORK_STATE_DISCONNECTING, NULL);
+			break;
+		default: break;
+	}
+}
+
+// waits for the server to acknowledge, gives up after NETWORK_DISCONNECT_TIMEOUT
+static void network_update_disconnecting() {
+	ENetEvent event;
+	while(enet_host_service(client, &event, 0) > 0) {
+		switch(event.type) {
+			case ENET_EVENT_TYPE_RECEIVE: enet_packet_destroy(event.packet); break;
+			case ENET_EVENT_TYPE_DISCONNECT:
+				network_host_destroy();
+				network_set_state(NETWORK_STATE_IDLE, NULL);
 				return;
-			}
+			default: break;
 		}
+	}
 
+	if(network_state_duration() >= NETWORK_DISCONNECT_TIMEOUT) {
 		enet_peer_reset(peer);
-		enet_host_destroy(client);
+		network_host_destroy();
+		network_set_state(NETWORK_STATE_IDLE, NULL);
+	}
+}
+
+void network_deinit() {
+	double start = window_time();
+	while(network_state == NETWORK_STATE_DISCONNECTING && window_time() - start < 1.0) {
+		network_update_disconnecting();
+		usleep(1000);
 	}
+
+	network_close();
 }
 
+// only starts the attempt, network_update() carries it on from there
 int network_connect_sub(char* ip, int port, int version) {
 	ENetAddress address;
-	ENetEvent event;
+	network_close();
 	network_init_host();
+	if(!client)
+		return 0;
 	enet_address_set_host(&address, ip);
 	address.port = port;
 	peer = enet_host_connect(client, &address, 1, version);
-	network_logged_in = 0;
 	*network_custom_reason = 0;
 	memset(network_stats, 0, sizeof(struct network_stat) * 40);
-	if(peer == NULL)
+	memset(network_packet_stats, 0, sizeof(network_packet_stats));
+	if(peer == NULL) {
+		network_host_destroy();
 		return 0;
-	if(enet_host_service(client, &event, 2500) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
-		network_received_packets = 0;
-		network_connected = 1;
-
-		float start = window_time();
-		while(window_time() - start < 1.0F) { // listen connection for 1s, check if server disconnects
-			if(!network_update()) {
-				enet_peer_reset(peer);
-				return 0;
-			}
-		}
-		return 1;
 	}
-	chat_showpopup("No response", 3.0F, rgb(255, 0, 0));
-	enet_peer_reset(peer);
-	return 0;
+	network_connect_start = window_time();
+	network_set_state(NETWORK_STATE_CONNECTING, NULL);
+	return 1;
 }
 
 int network_identifier_split(char* addr, char* ip_out, int* port_out) {
@@ -1045,50 +1436,274 @@ int network_connect_string(char* addr, int version) {
   	return network_connect_sub(ip, port, version);
 }
 
+static void network_dispatch(unsigned char* data, size_t length, double latency) {
+	int id = data[0];
+	struct network_packet_stat* s = network_packet_stats + id;
+
+	double start = network_clock();
+
+	if(*packets[id]) {
+		log_debug("Packet id %i", id);
+		(*packets[id])(data + 1, length - 1);
+	} else {
+		log_error("Invalid packet id %i, length: %i", id, (int)length - 1);
+	}
+	network_received_packets++;
+
+	double handler = network_clock() - start;
+	s->count++;
+	s->bytes += length;
+	s->handler_time += handler;
+	s->handler_max = fmax(s->handler_max, handler);
+	s->histogram[network_histogram_bucket(handler)]++;
+	s->latency += latency;
+	s->latency_max = fmax(s->latency_max, latency);
+}
+
+// time is when the packet arrived, which can be a bit earlier than now with the network thread
+static void network_receive(ENetPacket* packet, int channel, double time) {
+	network_stats[0].ingoing += packet->dataLength;
+
+	if(network_recording.active) {
+		uint32_t ms = fmax(time - network_recording.start, 0.0) * 1000.0;
+		if(!record_write(&network_recording.writer, ms, channel, packet->data, packet->dataLength)) {
+			log_error("Could not write to the recording, stopping it");
+			network_record_stop();
+		}
+	}
+
+	if(packet->dataLength > 0)
+		network_dispatch(packet->data, packet->dataLength, fmax(network_clock() - time, 0.0));
+	enet_packet_destroy(packet);
+}
+
+bool network_record_start(const char* filename) {
+	network_record_stop();
+
+	if(!record_create(&network_recording.writer, filename)) {
+		record_close(&network_recording.writer);
+		log_error("Could not create recording %s", filename);
+		return false;
+	}
+
+	network_recording.start = network_clock();
+	network_recording.active = true;
+	log_info("Recording to %s", filename);
+	return true;
+}
+
+void network_record_stop() {
+	if(!network_recording.active)
+		return;
+
+	log_info("Recorded %zu packets, %zu bytes", network_recording.writer.packets, network_recording.writer.bytes);
+	record_close(&network_recording.writer);
+	network_recording.active = false;
+}
+
+bool network_replay_start(const char* filename, float speed) {
+	network_replay_stop();
+	network_close();
+
+	if(!record_open(&network_replay.reader, filename)) {
+		log_error("Could not read recording %s", filename);
+		return false;
+	}
+
+	network_replay.active = true;
+	network_replay.speed = fmax(speed, 0.0F);
+	network_replay.time = 0.0;
+	network_replay.start = network_replay.last_frame = window_time();
+	network_replay.packets = network_replay.bytes = 0;
+	network_replay.frames = 0;
+	network_replay.frame_max = 0.0;
+
+	network_connected = 1;
+	network_logged_in = 0;
+	network_received_packets = 0;
+	memset(network_stats, 0, sizeof(struct network_stat) * 40);
+	memset(network_packet_stats, 0, sizeof(network_packet_stats));
+	log_info("Replaying %s", filename);
+
+	// like a live connection once it is established, so that the world is simulated and drawn
+	hud_change(&hud_ingame);
+	return true;
+}
+
+void network_replay_stop() {
+	if(!network_replay.active)
+		return;
+
+	double wall = window_time() - network_replay.start;
+	log_info("Replayed %zu packets, %zu bytes, %.1fs of recording in %.1fs, %i frames, avg %.2fms max %.2fms",
+			 network_replay.packets, network_replay.bytes, network_replay.time, wall, network_replay.frames,
+			 network_replay.frames ? wall * 1000.0 / network_replay.frames : 0.0, network_replay.frame_max * 1000.0);
+
+	record_free(&network_replay.reader);
+	network_replay.active = false;
+	network_packet_stats_finish();
+	network_connected = 0;
+	network_logged_in = 0;
+}
+
+bool network_replay_unthrottled() {
+	return network_replay.active && network_replay.speed <= 0.0F;
+}
+
+// returns false once the recording has ended
+static bool network_replay_update() {
+	double now = window_time();
+	network_replay.frame_max = fmax(network_replay.frame_max, now - network_replay.last_frame);
+	network_replay.last_frame = now;
+	network_replay.frames++;
+
+	if(network_replay.speed > 0.0F) {
+		network_replay.time = (now - network_replay.start) * network_replay.speed;
+	} else {
+		network_replay.time += NETWORK_REPLAY_STEP;
+	}
+
+	struct record_entry entry;
+	unsigned char* packet;
+
+	while(record_peek(&network_replay.reader, &entry) && entry.time <= network_replay.time * 1000.0) {
+		record_next(&network_replay.reader, &entry, &packet);
+		network_stats[0].ingoing += entry.length;
+		network_replay.packets++;
+		network_replay.bytes += entry.length;
+
+		if(entry.length > 0)
+			network_dispatch(packet, entry.length, 0.0);
+	}
+
+	if(record_peek(&network_replay.reader, &entry))
+		return true;
+
+	network_replay_stop();
+	hud_change(&hud_serverlist);
+	return false;
+}
+
+static void network_disconnected(enet_uint32 reason, ENetAddress* address) {
+	ENetAddress from = *address;
+
+	network_packet_stats_finish();
+	network_host_destroy();
+	network_connected = 0;
+	delivery_clear(&network_batch);
+
+	// If the disconnect reason is wrong protocol, he will try the 0.76
+	if(reason == 3) {
+		network_logged_in = 0;
+		char addr[32];
+		sprintf(addr, "aos://%i:%i", from.host, from.port);
+		if(network_connect_string(addr, VERSION_076))
+			return;
+	}
+
+	if(network_logged_in) {
+		network_logged_in = 0;
+		hud_change(&hud_serverlist);
+	}
+	chat_showpopup(network_reason_disconnect(reason), 6.0F, rgb(255, 0, 0));
+	log_error("server disconnected! reason: %s", network_reason_disconnect(reason));
+	network_set_state(NETWORK_STATE_IDLE, network_reason_disconnect(reason));
+}
+
+// returns false if the attempt failed
+static bool network_update_connecting() {
+	ENetEvent event;
+	while(enet_host_service(client, &event, 0) > 0) {
+		switch(event.type) {
+			case ENET_EVENT_TYPE_CONNECT:
+				network_received_packets = 0;
+				network_connected = 1;
+				network_set_state(NETWORK_STATE_CONFIRMING, NULL);
+
+				if(settings.network_thread)
+					network_thread_start();
+				return true;
+			case ENET_EVENT_TYPE_DISCONNECT: network_disconnected(event.data, &event.peer->address); return false;
+			case ENET_EVENT_TYPE_RECEIVE: enet_packet_destroy(event.packet); break;
+			default: break;
+		}
+	}
+
+	if(network_state_duration() >= NETWORK_CONNECT_TIMEOUT) {
+		chat_showpopup("No response", 3.0F, rgb(255, 0, 0));
+		log_error("No response after %.1fs", NETWORK_CONNECT_TIMEOUT);
+		enet_peer_reset(peer);
+		network_host_destroy();
+		network_set_state(NETWORK_STATE_IDLE, "No response");
+		return false;
+	}
+
+	return true;
+}
+
 int network_update() {
+	PROFILE_SCOPE("network_update");
+
+	switch(network_state) {
+		case NETWORK_STATE_CONNECTING:
+			if(!network_update_connecting())
+				return 0;
+			break;
+		case NETWORK_STATE_DISCONNECTING: network_update_disconnecting(); break;
+		default: break;
+	}
+
 	if(network_connected) {
 		if(window_time() - network_stats_last >= 1.0F) {
+			if(network_latency_count > 0)
+				network_stats[0].avg_latency = network_latency_sum / network_latency_count;
+			network_latency_sum = 0.0F;
+			network_latency_count = 0;
+
 			for(int k = 39; k > 0; k--)
 				network_stats[k] = network_stats[k - 1];
-			network_stats[0].ingoing = 0;
-			network_stats[0].outgoing = 0;
-			network_stats[0].avg_ping = network_ping();
+			network_stats[0] = (struct network_stat) {
+				.avg_ping = network_ping(),
+			};
 			network_stats_last = window_time();
 		}
 
-		ENetEvent event;
-		while(enet_host_service(client, &event, 0) > 0) {
-			switch(event.type) {
-				case ENET_EVENT_TYPE_RECEIVE: {
-					network_stats[0].ingoing += event.packet->dataLength;
-					int id = event.packet->data[0];
-					if(*packets[id]) {
-						log_debug("Packet id %i", id);
-						(*packets[id])(event.packet->data + 1, event.packet->dataLength - 1);
-					} else {
-						log_error("Invalid packet id %i, length: %i", id, (int)event.packet->dataLength - 1);
-					}
-					network_received_packets++;
-					enet_packet_destroy(event.packet);
-					break;
+		if(network_replay.active) {
+			if(!network_replay_update())
+				return 0;
+		} else if(network_thread.active) {
+			network_stats[0].max_inbound
+				= max(network_stats[0].max_inbound, (int)spsc_size(&network_thread.inbound));
+			network_stats[0].max_outbound
+				= max(network_stats[0].max_outbound, (int)spsc_size(&network_thread.outbound));
+
+			struct network_message msg;
+			while(network_thread.active && spsc_pop(&network_thread.inbound, &msg)) {
+				float latency = (network_clock() - msg.time) * 1000.0F;
+				network_stats[0].max_latency = fmax(network_stats[0].max_latency, latency);
+				network_latency_sum += latency;
+				network_latency_count++;
+
+				if(msg.type == ENET_EVENT_TYPE_RECEIVE) {
+					network_receive(msg.packet, msg.channel, msg.time);
+				} else {
+					network_thread_stop();
+					network_disconnected(msg.data, &msg.address);
+					return 0;
 				}
-				case ENET_EVENT_TYPE_DISCONNECT:
-					// If the disconnect reason is wrong protocol, he will try the 0.76
-					if(event.data == 3) {
-						char addr[32];
-						sprintf(addr, "aos://%i:%i", event.peer->address.host, event.peer->address.port);
-						network_connect_string(addr, VERSION_076);
+			}
+		} else {
+			ENetEvent event;
+			while(enet_host_service(client, &event, 0) > 0) {
+				switch(event.type) {
+					case ENET_EVENT_TYPE_RECEIVE:
+						network_receive(event.packet, event.channelID, network_clock());
 						break;
-					}
-
-					if(network_logged_in)
-						hud_change(&hud_serverlist);
-					chat_showpopup(network_reason_disconnect(event.data), 6.0F, rgb(255, 0, 0));
-					log_error("server disconnected! reason: %s", network_reason_disconnect(event.data));
-					event.peer->data = NULL;
-					network_connected = 0;
-					network_logged_in = 0;
-					return 0;
+					case ENET_EVENT_TYPE_DISCONNECT:
+						event.peer->data = NULL;
+						network_disconnected(event.data, &event.peer->address);
+						return 0;
+				}
 			}
 		}
 
@@ -1146,6 +1761,13 @@ int network_update() {
 				network_send(PACKET_ORIENTATIONDATA_ID, &orient, sizeof(orient));
 			}
 		}
+
+		if(!network_replay.active)
+			network_flush();
+
+		// the server had its chance to turn us away
+		if(network_state == NETWORK_STATE_CONFIRMING && network_state_duration() >= NETWORK_CONFIRM_TIME)
+			network_set_state(NETWORK_STATE_CONNECTED, NULL);
 	}
 
 	chunk_queue_blocks();
@@ -1159,6 +1781,7 @@ int network_status() {
 
 void network_init() {
 	enet_initialize();
+	delivery_create(&network_batch);
 
 	packets[PACKET_POSITIONDATA_ID] = read_PacketPositionData;
 	packets[PACKET_ORIENTATIONDATA_ID] = read_PacketOrientationData;
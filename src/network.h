@@ -20,8 +20,28 @@
 #ifndef NETWORK_H
 #define NETWORK_H
 
+#include <stdbool.h>
+
+enum network_state {
+	NETWORK_STATE_IDLE,
+	NETWORK_STATE_CONNECTING,	 // waiting for enet to establish the connection
+	NETWORK_STATE_CONFIRMING,	 // connected, but the server may still turn us away during the first second
+	NETWORK_STATE_CONNECTED,
+	NETWORK_STATE_DISCONNECTING, // waiting for the server to acknowledge
+};
+
+#define NETWORK_CONNECT_TIMEOUT 2.5F
+#define NETWORK_CONFIRM_TIME 1.0F
+#define NETWORK_DISCONNECT_TIMEOUT 3.0F
+
 const char* network_reason_disconnect(int code);
 
+// connecting and disconnecting never block, both advance in network_update()
+// every state change is passed to hud_active->network_progress, reason is set when an attempt failed
+enum network_state network_get_state(void);
+// seconds spent in the current state
+float network_state_duration(void);
+
 unsigned int network_ping(void);
 void network_send(int id, void* data, int len);
 void network_updateColor(void);
@@ -32,6 +52,19 @@ int network_update(void);
 int network_status(void);
 void network_init_host(void);
 void network_init(void);
+// finishes a pending disconnect, waits for at most a second
+void network_deinit(void);
+
+// writes every inbound packet to a file until stopped, across reconnects
+bool network_record_start(const char* filename);
+void network_record_stop(void);
+
+// plays a recorded session into the packet handlers instead of connecting to a server, nothing is sent
+// with speed zero every frame plays exactly NETWORK_REPLAY_STEP seconds of the recording
+#define NETWORK_REPLAY_STEP (1.0 / 60.0)
+bool network_replay_start(const char* filename, float speed);
+void network_replay_stop(void);
+bool network_replay_unthrottled(void);
 
 void read_PacketMapChunk(void* data, int len);
 void read_PacketChatMessage(void* data, int len);
@@ -90,10 +123,30 @@ extern struct network_stat {
 	int outgoing;
 	int ingoing;
 	int avg_ping;
+	// only with the network thread: time from arrival until handled in ms, highest queue depths
+	float avg_latency, max_latency;
+	int max_inbound, max_outbound;
 } network_stats[40];
 
 extern float network_stats_last;
 
+#define NETWORK_HISTOGRAM_BUCKETS 12
+
+// per received packet id over one connection, all times in seconds
+extern struct network_packet_stat {
+	unsigned long count;
+	unsigned long bytes;
+	double handler_time, handler_max;
+	// handler time: bucket 0 is below 1us, bucket k is [2^(k-1), 2^k) us and the last one is everything above
+	unsigned long histogram[NETWORK_HISTOGRAM_BUCKETS];
+	// from arrival until handled, only with the network thread
+	double latency, latency_max;
+} network_packet_stats[256];
+
+const char* network_packet_name(int id);
+// machine readable copy of network_packet_stats, written to logs/ at every disconnect
+bool network_packet_stats_dump(const char* filename);
+
 #pragma pack(push, 1)
 
 #define PACKET_HANDSHAKEINIT_ID 31
@@ -0,0 +1,153 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "obb.h"
+#include "simd.h"
+
+void obb_set_create(struct obb_set* set, size_t capacity) {
+	assert(set != NULL && capacity > 0);
+
+	set->capacity = (capacity + LANES - 1) / LANES * LANES;
+
+	for(int k = 0; k < 12; k++) {
+		set->m[k] = calloc(set->capacity, sizeof(float));
+		assert(set->m[k] != NULL);
+	}
+
+	for(int k = 0; k < 3; k++) {
+		set->min[k] = calloc(set->capacity, sizeof(float));
+		assert(set->min[k] != NULL);
+		set->max[k] = calloc(set->capacity, sizeof(float));
+		assert(set->max[k] != NULL);
+	}
+}
+
+void obb_set_destroy(struct obb_set* set) {
+	assert(set != NULL);
+
+	for(int k = 0; k < 12; k++)
+		free(set->m[k]);
+
+	for(int k = 0; k < 3; k++) {
+		free(set->min[k]);
+		free(set->max[k]);
+	}
+}
+
+void obb_set_box(struct obb_set* set, size_t index, const float inverse[4][4], const float min[3], const float max[3]) {
+	assert(set != NULL && index < set->capacity);
+
+	// row major 3x4, the last row of an affine transform is not needed
+	for(int row = 0; row < 3; row++) {
+		for(int col = 0; col < 4; col++)
+			set->m[row * 4 + col][index] = inverse[col][row];
+
+		set->min[row][index] = min[row];
+		set->max[row][index] = max[row];
+	}
+}
+
+// four boxes kept in registers while rays are tested against them
+struct obb_group {
+	v4f m[12];
+	v4f min[3];
+	v4f max[3];
+};
+
+static inline void obb_group_load(const struct obb_set* set, size_t k, struct obb_group* g) {
+	for(int i = 0; i < 12; i++)
+		g->m[i] = v4f_load(set->m[i] + k);
+
+	for(int i = 0; i < 3; i++) {
+		g->min[i] = v4f_load(set->min[i] + k);
+		g->max[i] = v4f_load(set->max[i] + k);
+	}
+}
+
+static inline void obb_group_raycast(const struct obb_group* g, const Ray* ray, float* distance) {
+	v4f ox = v4f_splat(ray->origin.x);
+	v4f oy = v4f_splat(ray->origin.y);
+	v4f oz = v4f_splat(ray->origin.z);
+	v4f dx = v4f_splat(ray->direction.x);
+	v4f dy = v4f_splat(ray->direction.y);
+	v4f dz = v4f_splat(ray->direction.z);
+	v4f zero = v4f_splat(0.0F);
+
+	v4f tmin = v4f_splat(-INFINITY);
+	v4f tmax = v4f_splat(INFINITY);
+	v4f len = zero;
+
+	for(int axis = 0; axis < 3; axis++) {
+		// ray in box space
+		v4f o = g->m[axis * 4 + 0] * ox + g->m[axis * 4 + 1] * oy + g->m[axis * 4 + 2] * oz + g->m[axis * 4 + 3];
+		v4f d = g->m[axis * 4 + 0] * dx + g->m[axis * 4 + 1] * dy + g->m[axis * 4 + 2] * dz;
+		len += d * d;
+
+		v4f inv = v4f_splat(1.0F) / d;
+		v4f t1 = (g->min[axis] - o) * inv;
+		v4f t2 = (g->max[axis] - o) * inv;
+
+		tmin = v4f_max(tmin, v4f_min(t1, t2));
+		tmax = v4f_min(tmax, v4f_max(t1, t2));
+	}
+
+	tmin = v4f_max(tmin, zero);
+	v4i hit = tmax > tmin;
+
+	float t[LANES], l[LANES];
+	uint32_t h[LANES];
+	v4f_store(t, tmin);
+	v4f_store(l, len);
+	v4i_store(h, hit);
+
+	for(int lane = 0; lane < LANES; lane++)
+		distance[lane] = h[lane] ? t[lane] * sqrtf(l[lane]) : INFINITY;
+}
+
+void obb_raycast(const struct obb_set* set, size_t first, size_t count, const Ray* ray, float* distance) {
+	assert(set != NULL && ray != NULL && distance != NULL);
+	assert(first % LANES == 0 && count % LANES == 0 && first + count <= set->capacity);
+
+	struct obb_group g;
+
+	for(size_t k = first; k < first + count; k += LANES) {
+		obb_group_load(set, k, &g);
+		obb_group_raycast(&g, ray, distance + (k - first));
+	}
+}
+
+void obb_raycast_batch(const struct obb_set* set, size_t first, size_t count, const Ray* rays, size_t ray_count,
+					   float* distance) {
+	assert(set != NULL && rays != NULL && distance != NULL);
+	assert(first % LANES == 0 && count % LANES == 0 && first + count <= set->capacity);
+
+	struct obb_group g;
+
+	for(size_t k = first; k < first + count; k += LANES) {
+		obb_group_load(set, k, &g);
+
+		for(size_t r = 0; r < ray_count; r++)
+			obb_group_raycast(&g, rays + r, distance + r * count + (k - first));
+	}
+}
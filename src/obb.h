@@ -0,0 +1,52 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OBB_H
+#define OBB_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "aabb.h"
+
+// oriented boxes stored as a world to box space transform plus box space bounds,
+// structure of arrays so four boxes are tested against a ray at once
+struct obb_set {
+	size_t capacity;
+	float* m[12];
+	float* min[3];
+	float* max[3];
+};
+
+// capacity is rounded up to a multiple of four
+void obb_set_create(struct obb_set* set, size_t capacity);
+void obb_set_destroy(struct obb_set* set);
+
+// inverse is the column major (cglm) inverse of the box model matrix
+void obb_set_box(struct obb_set* set, size_t index, const float inverse[4][4], const float min[3], const float max[3]);
+
+// tests boxes [first, first + count) against one ray, first and count must be multiples of four,
+// writes the distance in box space like aabb_intersection_ray() or INFINITY on a miss
+void obb_raycast(const struct obb_set* set, size_t first, size_t count, const Ray* ray, float* distance);
+
+// same for several rays, distance has room for ray_count * count results (ray major)
+void obb_raycast_batch(const struct obb_set* set, size_t first, size_t count, const Ray* rays, size_t ray_count,
+					   float* distance);
+
+#endif
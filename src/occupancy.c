@@ -0,0 +1,126 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "occupancy.h"
+
+void occupancy_create(struct occupancy* occ, int width, int depth, int height) {
+	assert(occ != NULL && width > 0 && depth > 0 && height > 0 && height <= 64);
+
+	occ->width = width;
+	occ->depth = depth;
+	occ->height = height;
+	occ->columns = calloc((size_t)width * depth, sizeof(uint64_t));
+	assert(occ->columns != NULL);
+
+	occ->tiles_width = (width + OCCUPANCY_TILE_SIZE - 1) / OCCUPANCY_TILE_SIZE;
+	occ->tiles_depth = (depth + OCCUPANCY_TILE_SIZE - 1) / OCCUPANCY_TILE_SIZE;
+	occ->tiles = calloc((size_t)occ->tiles_width * occ->tiles_depth, sizeof(uint32_t));
+	assert(occ->tiles != NULL);
+}
+
+void occupancy_destroy(struct occupancy* occ) {
+	assert(occ != NULL);
+
+	free(occ->columns);
+	free(occ->tiles);
+	occ->columns = NULL;
+	occ->tiles = NULL;
+}
+
+void occupancy_clear(struct occupancy* occ) {
+	assert(occ != NULL);
+
+	memset(occ->columns, 0, (size_t)occ->width * occ->depth * sizeof(uint64_t));
+	memset(occ->tiles, 0, (size_t)occ->tiles_width * occ->tiles_depth * sizeof(uint32_t));
+}
+
+static int occupancy_tile_compute(const struct occupancy* occ, int tx, int tz) {
+	int x0 = tx * OCCUPANCY_TILE_SIZE;
+	int z0 = tz * OCCUPANCY_TILE_SIZE;
+	int x1 = (x0 + OCCUPANCY_TILE_SIZE < occ->width) ? x0 + OCCUPANCY_TILE_SIZE : occ->width;
+	int z1 = (z0 + OCCUPANCY_TILE_SIZE < occ->depth) ? z0 + OCCUPANCY_TILE_SIZE : occ->depth;
+
+	uint64_t any = 0;
+	for(int z = z0; z < z1; z++)
+		for(int x = x0; x < x1; x++)
+			any |= occupancy_column(occ, x, z);
+
+	return occupancy_column_top(any);
+}
+
+// the column was written before this is called: a writer that stored its column after our
+// compute already bumped the version, so the compare-exchange fails and we compute again
+static void occupancy_tile_update(struct occupancy* occ, int x, int z) {
+	int tx = x >> OCCUPANCY_TILE_SHIFT;
+	int tz = z >> OCCUPANCY_TILE_SHIFT;
+	uint32_t* tile = occ->tiles + tx + tz * occ->tiles_width;
+
+	uint32_t old = __atomic_load_n(tile, __ATOMIC_ACQUIRE);
+
+	while(1) {
+		uint32_t top = occupancy_tile_compute(occ, tx, tz);
+		uint32_t new = ((old & ~0xFFu) + 0x100u) | top;
+
+		if(__atomic_compare_exchange_n(tile, &old, new, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			break;
+	}
+}
+
+void occupancy_update_tiles(struct occupancy* occ) {
+	assert(occ != NULL);
+
+	for(int tz = 0; tz < occ->tiles_depth; tz++)
+		for(int tx = 0; tx < occ->tiles_width; tx++)
+			occupancy_tile_update(occ, tx * OCCUPANCY_TILE_SIZE, tz * OCCUPANCY_TILE_SIZE);
+}
+
+void occupancy_set(struct occupancy* occ, int x, int y, int z, bool solid) {
+	assert(occ != NULL);
+
+	if(x < 0 || y < 0 || z < 0 || x >= occ->width || y >= occ->height || z >= occ->depth)
+		return;
+
+	uint64_t* column = occ->columns + x + z * occ->width;
+
+	if(solid) {
+		__atomic_fetch_or(column, (uint64_t)1 << y, __ATOMIC_RELEASE);
+	} else {
+		__atomic_fetch_and(column, ~((uint64_t)1 << y), __ATOMIC_RELEASE);
+	}
+
+	occupancy_tile_update(occ, x, z);
+}
+
+void occupancy_set_column(struct occupancy* occ, int x, int z, uint64_t column) {
+	assert(occ != NULL && x >= 0 && z >= 0 && x < occ->width && z < occ->depth);
+
+	__atomic_store_n(occ->columns + x + z * occ->width, column, __ATOMIC_RELAXED);
+}
+
+void occupancy_query(const struct occupancy* occ, const float* x, const float* y, const float* z, size_t count,
+					 uint32_t* solid) {
+	assert(occ != NULL && x != NULL && y != NULL && z != NULL && solid != NULL);
+
+	for(size_t k = 0; k < count; k++)
+		solid[k] = occupancy_isair(occ, (int)x[k], (int)y[k], (int)z[k]) ? 0 : 0xFFFFFFFF;
+}
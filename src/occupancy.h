@@ -0,0 +1,75 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define OCCUPANCY_TILE_SHIFT 3
+#define OCCUPANCY_TILE_SIZE (1 << OCCUPANCY_TILE_SHIFT)
+
+// one bit per voxel, one 64-bit word per map column (bit y set = solid)
+// readers never lock, writers use atomic read-modify-write on single columns
+// tiles of 8x8 columns keep the highest top height of their columns (low 8 bits)
+// and a version counter that every writer bumps (upper 24 bits)
+struct occupancy {
+	int width, depth, height;
+	uint64_t* columns;
+	int tiles_width, tiles_depth;
+	uint32_t* tiles;
+};
+
+void occupancy_create(struct occupancy* occ, int width, int depth, int height);
+void occupancy_destroy(struct occupancy* occ);
+void occupancy_clear(struct occupancy* occ);
+void occupancy_set(struct occupancy* occ, int x, int y, int z, bool solid);
+// bulk update, tiles are not touched until occupancy_update_tiles() is called
+void occupancy_set_column(struct occupancy* occ, int x, int z, uint64_t column);
+void occupancy_update_tiles(struct occupancy* occ);
+
+// writes ~0 for every solid position and 0 for air, coordinates are truncated like map_isair() does
+void occupancy_query(const struct occupancy* occ, const float* x, const float* y, const float* z, size_t count,
+					 uint32_t* solid);
+
+static inline uint64_t occupancy_column(const struct occupancy* occ, int x, int z) {
+	return __atomic_load_n(occ->columns + x + z * occ->width, __ATOMIC_RELAXED);
+}
+
+// one above the highest solid voxel, zero for an empty column
+static inline int occupancy_column_top(uint64_t column) {
+	return column ? 64 - __builtin_clzll(column) : 0;
+}
+
+static inline int occupancy_tile_top(const struct occupancy* occ, int tx, int tz) {
+	return __atomic_load_n(occ->tiles + tx + tz * occ->tiles_width, __ATOMIC_ACQUIRE) & 0xFF;
+}
+
+// same border behaviour as libvxl: above the map is air, everything else outside is solid
+static inline bool occupancy_isair(const struct occupancy* occ, int x, int y, int z) {
+	if(y >= occ->height)
+		return true;
+	if(x < 0 || y < 0 || z < 0 || x >= occ->width || z >= occ->depth)
+		return false;
+	return !((occupancy_column(occ, x, z) >> y) & 1);
+}
+
+#endif
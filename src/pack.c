@@ -0,0 +1,198 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "pack.h"
+#include "log.h"
+
+#ifdef OS_WINDOWS
+#include <windows.h>
+#elif !defined(USE_ANDROID_FILE)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+enum {
+	PACK_UNCHECKED,
+	PACK_VALID,
+	PACK_INVALID,
+};
+
+static const uint8_t* pack_base = NULL;
+static size_t pack_length = 0;
+static const struct pack_entry* pack_entries;
+static uint8_t* pack_state; // one of the above per entry, entries are checked on first use
+
+static const void* pack_map(const char* filename, size_t* length) {
+#ifdef OS_WINDOWS
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	void* data = NULL;
+
+	if(GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if(mapping) {
+		data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+
+	CloseHandle(file);
+	*length = size.QuadPart;
+	return data;
+#elif defined(USE_ANDROID_FILE)
+	return NULL;
+#else
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+
+	struct stat s;
+	void* data = NULL;
+
+	if(!fstat(fd, &s) && s.st_size > 0) {
+		data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(data == MAP_FAILED)
+			data = NULL;
+	}
+
+	close(fd);
+	*length = s.st_size;
+	return data;
+#endif
+}
+
+static void pack_unmap(const void* data, size_t length) {
+#ifdef OS_WINDOWS
+	UnmapViewOfFile(data);
+#elif !defined(USE_ANDROID_FILE)
+	munmap((void*)data, length);
+#endif
+}
+
+bool pack_open(const char* filename) {
+	if(pack_base)
+		pack_close();
+
+	pack_base = pack_map(filename, &pack_length);
+
+	if(!pack_base) {
+		log_info("No asset archive %s, using loose files", filename);
+		return false;
+	}
+
+	const struct pack_header* header = (const struct pack_header*)pack_base;
+	bool valid = pack_length >= sizeof(struct pack_header) && header->magic == PACK_MAGIC
+		&& header->version == PACK_VERSION
+		&& header->count <= (pack_length - sizeof(struct pack_header)) / sizeof(struct pack_entry);
+
+	pack_entries = (const struct pack_entry*)(header + 1);
+
+	for(uint32_t k = 0; valid && k < header->count; k++) {
+		const struct pack_entry* e = pack_entries + k;
+		valid = e->name[PACK_NAME_LENGTH - 1] == 0 && e->offset % PACK_ALIGNMENT == 0 && e->offset <= pack_length
+			&& e->size <= pack_length - e->offset;
+	}
+
+	if(!valid) {
+		log_warn("Asset archive %s is damaged or outdated, using loose files", filename);
+		pack_unmap(pack_base, pack_length);
+		pack_base = NULL;
+		return false;
+	}
+
+	pack_state = calloc(header->count, sizeof(uint8_t));
+	CHECK_ALLOCATION_ERROR(pack_state)
+
+	log_info("Mapped asset archive %s with %u entries", filename, header->count);
+	return true;
+}
+
+void pack_close() {
+	if(!pack_base)
+		return;
+
+	pack_unmap(pack_base, pack_length);
+	free(pack_state);
+	pack_base = NULL;
+}
+
+static int pack_entry_cmp(const void* name, const void* e) {
+	return strcmp(name, ((const struct pack_entry*)e)->name);
+}
+
+// was the loose file replaced after packing? a missing loose file is fine
+static bool pack_outdated(const struct pack_entry* e) {
+	struct stat s;
+
+	if(stat(e->name, &s))
+		return false;
+
+	return (uint64_t)s.st_size != e->source_size || (int64_t)s.st_mtime != e->source_mtime;
+}
+
+const struct pack_entry* pack_find(const char* name, enum pack_type type) {
+	if(!pack_base)
+		return NULL;
+
+	const struct pack_header* header = (const struct pack_header*)pack_base;
+	const struct pack_entry* e
+		= bsearch(name, pack_entries, header->count, sizeof(struct pack_entry), pack_entry_cmp);
+
+	if(!e || e->type != type)
+		return NULL;
+
+	uint8_t* state = pack_state + (e - pack_entries);
+
+	switch(__atomic_load_n(state, __ATOMIC_ACQUIRE)) {
+		case PACK_VALID: return e;
+		case PACK_INVALID: return NULL;
+	}
+
+	// two threads asking for the same entry both compute the checksum, which is harmless
+	if(pack_outdated(e)) {
+		log_info("Using changed loose file %s", name);
+		__atomic_store_n(state, PACK_INVALID, __ATOMIC_RELEASE);
+		return NULL;
+	}
+
+	if(pack_checksum(pack_base + e->offset, e->size) != e->checksum) {
+		log_warn("Checksum mismatch for %s in asset archive", name);
+		__atomic_store_n(state, PACK_INVALID, __ATOMIC_RELEASE);
+		return NULL;
+	}
+
+	__atomic_store_n(state, PACK_VALID, __ATOMIC_RELEASE);
+	return e;
+}
+
+const void* pack_data(const struct pack_entry* e) {
+	return pack_base + e->offset;
+}
@@ -0,0 +1,93 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PACK_MAGIC 0x4B505342 // "BSPK"
+#define PACK_VERSION 1
+#define PACK_NAME_LENGTH 56
+#define PACK_ALIGNMENT 16
+
+enum pack_type {
+	PACK_RAW,	// file contents as is
+	PACK_IMAGE, // RGBA8 pixels, info = width, height
+	PACK_KV6,	// struct pack_kv6 followed by its voxels
+	PACK_SOUND, // mono 16-bit PCM, info = sample rate
+};
+
+// everything is little endian, the entry table follows the header and is sorted by name,
+// data offsets are aligned to PACK_ALIGNMENT so the mapping can be used in place
+struct pack_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct pack_entry {
+	char name[PACK_NAME_LENGTH]; // relative path of the loose file, zero terminated
+	uint32_t type;
+	uint32_t checksum; // of the data
+	uint64_t offset;
+	uint64_t size;
+	uint32_t info[2];
+	// the loose file wins once it no longer matches these
+	uint64_t source_size;
+	int64_t source_mtime;
+};
+
+struct pack_kv6 {
+	uint16_t xsiz, ysiz, zsiz, reserved;
+	float xpiv, ypiv, zpiv;
+	uint32_t voxel_count;
+};
+
+// already in model space: z is flipped and zpiv measured from the bottom
+struct pack_kv6_voxel {
+	uint32_t color; // lighting index in the upper byte
+	uint16_t x, y, z;
+	uint8_t visfaces;
+	uint8_t reserved;
+};
+
+bool pack_open(const char* filename);
+void pack_close(void);
+// NULL when the entry is missing, corrupt or out of date, the caller then loads the loose file,
+// safe to call from any thread, data stays valid until pack_close()
+const struct pack_entry* pack_find(const char* name, enum pack_type type);
+const void* pack_data(const struct pack_entry* e);
+
+// FNV-1a
+static inline uint32_t pack_checksum(const void* data, size_t length) {
+	const uint8_t* bytes = data;
+	uint32_t hash = 2166136261u;
+
+	for(size_t k = 0; k < length; k++)
+		hash = (hash ^ bytes[k]) * 16777619u;
+
+	return hash;
+}
+
+#endif
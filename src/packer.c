@@ -0,0 +1,339 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "pack.h"
+#include "lodepng/lodepng.c"
+
+extern short* drwav_open_and_read_file_s16(const char* filename, unsigned int* channels, unsigned int* sampleRate,
+										   uint64_t* totalFrameCount);
+
+// build time tool, run from the resource directory: decodes every png, kv6 and wav below it
+// and stores the results next to the fonts in one archive the client maps at startup
+//
+// usage: packer <output.pak>
+
+#define PACKER_MAX 512
+
+struct packer_item {
+	struct pack_entry entry;
+	void* data;
+};
+
+static struct packer_item items[PACKER_MAX];
+static int item_count = 0;
+
+static void* packer_file(const char* name, size_t* size) {
+	FILE* f = fopen(name, "rb");
+	if(!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	void* data = malloc(*size + 1);
+	if(data && fread(data, 1, *size, f) != *size) {
+		free(data);
+		data = NULL;
+	}
+
+	fclose(f);
+	return data;
+}
+
+static bool packer_image(const char* name, struct packer_item* item) {
+	size_t size;
+	unsigned char* png = packer_file(name, &size);
+	if(!png)
+		return false;
+
+	unsigned char* pixels;
+	unsigned int width, height;
+	unsigned int error = lodepng_decode32(&pixels, &width, &height, png, size);
+	free(png);
+
+	if(error) {
+		fprintf(stderr, "%s: %s\n", name, lodepng_error_text(error));
+		return false;
+	}
+
+	item->data = pixels;
+	item->entry.size = (uint64_t)width * height * 4;
+	item->entry.info[0] = width;
+	item->entry.info[1] = height;
+	return true;
+}
+
+static uint32_t packer_read32(const uint8_t* data, size_t index) {
+	return data[index] | (data[index + 1] << 8) | (data[index + 2] << 16) | ((uint32_t)data[index + 3] << 24);
+}
+
+static float packer_readf(const uint8_t* data, size_t index) {
+	uint32_t bits = packer_read32(data, index);
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+// same transformation as kv6_load()
+static bool packer_kv6(const char* name, struct packer_item* item) {
+	size_t size;
+	uint8_t* kv6 = packer_file(name, &size);
+	if(!kv6)
+		return false;
+
+	if(size < 32 || packer_read32(kv6, 0) != 0x6C78764B) { //"Kvxl"
+		fprintf(stderr, "%s: not in kv6 format\n", name);
+		free(kv6);
+		return false;
+	}
+
+	struct pack_kv6 header = {
+		.xsiz = packer_read32(kv6, 4),
+		.ysiz = packer_read32(kv6, 8),
+		.zsiz = packer_read32(kv6, 12),
+		.xpiv = packer_readf(kv6, 16),
+		.ypiv = packer_readf(kv6, 20),
+		.voxel_count = packer_read32(kv6, 28),
+	};
+
+	header.zpiv = header.zsiz - packer_readf(kv6, 24);
+
+	size_t columns = 32 + header.voxel_count * 8 + header.xsiz * 4;
+
+	if(columns + header.xsiz * header.ysiz * 2 > size) {
+		fprintf(stderr, "%s: truncated\n", name);
+		free(kv6);
+		return false;
+	}
+
+	item->entry.size = sizeof(struct pack_kv6) + header.voxel_count * sizeof(struct pack_kv6_voxel);
+	item->data = malloc(item->entry.size);
+	memcpy(item->data, &header, sizeof(struct pack_kv6));
+
+	struct pack_kv6_voxel* voxels = (struct pack_kv6_voxel*)((struct pack_kv6*)item->data + 1);
+
+	for(size_t k = 0; k < header.voxel_count; k++) {
+		const uint8_t* v = kv6 + 32 + k * 8;
+		voxels[k] = (struct pack_kv6_voxel) {
+			.color = (packer_read32(v, 0) & 0xFFFFFF) | (v[7] << 24),
+			.z = (header.zsiz - 1) - (v[4] | (v[5] << 8)),
+			.visfaces = v[6],
+		};
+	}
+
+	struct pack_kv6_voxel* voxel = voxels;
+
+	for(size_t x = 0; x < header.xsiz; x++) {
+		for(size_t y = 0; y < header.ysiz; y++) {
+			size_t index = columns + (x * header.ysiz + y) * 2;
+			uint16_t length = kv6[index] | (kv6[index + 1] << 8);
+
+			for(size_t z = 0; z < length && voxel < voxels + header.voxel_count; z++, voxel++) {
+				voxel->x = x;
+				voxel->y = y;
+			}
+		}
+	}
+
+	free(kv6);
+	return true;
+}
+
+// same conversion as sound_load()
+static bool packer_sound(const char* name, struct packer_item* item) {
+	unsigned int channels, samplerate;
+	uint64_t samplecount;
+	short* samples = drwav_open_and_read_file_s16(name, &channels, &samplerate, &samplecount);
+
+	if(!samples) {
+		fprintf(stderr, "%s: could not decode\n", name);
+		return false;
+	}
+
+	if(channels > 1) { // convert stereo to mono
+		short* audio = malloc(samplecount * sizeof(short) / 2);
+		for(size_t k = 0; k < samplecount / 2; k++)
+			audio[k] = ((int)samples[k * 2] + (int)samples[k * 2 + 1]) / 2;
+		free(samples);
+		samples = audio;
+	}
+
+	item->data = samples;
+	item->entry.size = samplecount * sizeof(short) / channels;
+	item->entry.info[0] = samplerate;
+	return true;
+}
+
+static bool packer_raw(const char* name, struct packer_item* item) {
+	size_t size;
+	item->data = packer_file(name, &size);
+	item->entry.size = size;
+	return item->data != NULL;
+}
+
+static void packer_add(const char* name, const struct stat* s) {
+	const char* ext = strrchr(name, '.');
+	if(!ext)
+		return;
+
+	if(strlen(name) >= PACK_NAME_LENGTH) {
+		fprintf(stderr, "%s: name too long, skipped\n", name);
+		return;
+	}
+
+	if(item_count >= PACKER_MAX) {
+		fprintf(stderr, "%s: too many files, raise PACKER_MAX\n", name);
+		exit(1);
+	}
+
+	struct packer_item* item = items + item_count;
+	*item = (struct packer_item) {
+		.entry.source_size = s->st_size,
+		.entry.source_mtime = s->st_mtime,
+	};
+	strcpy(item->entry.name, name);
+
+	bool ok;
+	if(!strcmp(ext, ".png")) {
+		item->entry.type = PACK_IMAGE;
+		ok = packer_image(name, item);
+	} else if(!strcmp(ext, ".kv6")) {
+		item->entry.type = PACK_KV6;
+		ok = packer_kv6(name, item);
+	} else if(!strcmp(ext, ".wav")) {
+		item->entry.type = PACK_SOUND;
+		ok = packer_sound(name, item);
+	} else if(!strcmp(ext, ".ttf")) {
+		item->entry.type = PACK_RAW;
+		ok = packer_raw(name, item);
+	} else {
+		return;
+	}
+
+	// failed files stay loose, the client reports them when it loads them
+	if(ok) {
+		item->entry.checksum = pack_checksum(item->data, item->entry.size);
+		item_count++;
+	}
+}
+
+static void packer_walk(const char* path) {
+	DIR* d = opendir(path);
+	if(!d)
+		return;
+
+	struct dirent* ent;
+	while((ent = readdir(d))) {
+		if(ent->d_name[0] == '.')
+			continue;
+
+		char name[PATH_MAX];
+		snprintf(name, sizeof(name), "%s/%s", path, ent->d_name);
+
+		struct stat s;
+		if(stat(name, &s))
+			continue;
+
+		if(S_ISDIR(s.st_mode)) {
+			packer_walk(name);
+		} else {
+			packer_add(name, &s);
+		}
+	}
+
+	closedir(d);
+}
+
+static int packer_cmp(const void* a, const void* b) {
+	return strcmp(((const struct packer_item*)a)->entry.name, ((const struct packer_item*)b)->entry.name);
+}
+
+static uint64_t packer_align(uint64_t offset) {
+	return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+int main(int argc, char** argv) {
+	if(argc != 2) {
+		fprintf(stderr, "usage: packer <output.pak>\n");
+		return 1;
+	}
+
+	packer_walk("png");
+	packer_walk("kv6");
+	packer_walk("wav");
+	packer_walk("fonts");
+
+	qsort(items, item_count, sizeof(struct packer_item), packer_cmp);
+
+	uint64_t offset = packer_align(sizeof(struct pack_header) + item_count * sizeof(struct pack_entry));
+
+	for(int k = 0; k < item_count; k++) {
+		items[k].entry.offset = offset;
+		offset = packer_align(offset + items[k].entry.size);
+	}
+
+	// written next to the target first, a client starting meanwhile never sees half an archive
+	char tmp[PATH_MAX];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", argv[1]);
+
+	FILE* f = fopen(tmp, "wb");
+	if(!f) {
+		fprintf(stderr, "could not write %s\n", tmp);
+		return 1;
+	}
+
+	struct pack_header header = {
+		.magic = PACK_MAGIC,
+		.version = PACK_VERSION,
+		.count = item_count,
+	};
+
+	fwrite(&header, sizeof(header), 1, f);
+
+	for(int k = 0; k < item_count; k++)
+		fwrite(&items[k].entry, sizeof(struct pack_entry), 1, f);
+
+	for(int k = 0; k < item_count; k++) {
+		fseek(f, items[k].entry.offset, SEEK_SET);
+		fwrite(items[k].data, 1, items[k].entry.size, f);
+		free(items[k].data);
+	}
+
+	bool ok = !ferror(f);
+	ok = !fclose(f) && ok;
+	remove(argv[1]);
+
+	if(!ok || rename(tmp, argv[1])) {
+		fprintf(stderr, "could not write %s\n", argv[1]);
+		remove(tmp);
+		return 1;
+	}
+
+	printf("Packed %i files into %s (%.1f MiB)\n", item_count, argv[1], offset / 1048576.0);
+	return 0;
+}
@@ -22,15 +22,8 @@
 
 #include "player.h"
 
-struct Particle {
-	float x, y, z;
-	float vx, vy, vz;
-	float ox, oy, oz;
-	unsigned char type;
-	float size;
-	float fade;
-	unsigned int color;
-};
+// oldest particles are evicted beyond this
+#define PARTICLES_MAX 8192
 
 void particle_init(void);
 void particle_update(float dt);
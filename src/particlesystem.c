@@ -0,0 +1,283 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "particlesystem.h"
+#include "simd.h"
+
+#define BLOCK_SIZE 256
+
+struct particle_block {
+	float x[BLOCK_SIZE], y[BLOCK_SIZE], z[BLOCK_SIZE];
+	float vx[BLOCK_SIZE], vy[BLOCK_SIZE], vz[BLOCK_SIZE];
+	float mx[BLOCK_SIZE], my[BLOCK_SIZE], mz[BLOCK_SIZE];
+	float size[BLOCK_SIZE], fade[BLOCK_SIZE];
+	float px[BLOCK_SIZE], py[BLOCK_SIZE], pz[BLOCK_SIZE];
+	uint32_t solid[BLOCK_SIZE], ground[BLOCK_SIZE], alive[BLOCK_SIZE];
+};
+
+static void* particlesys_alloc(size_t capacity, size_t element) {
+	void* ptr = malloc(capacity * element);
+	assert(ptr != NULL);
+	return ptr;
+}
+
+void particlesys_create(struct particle_system* ps, size_t capacity) {
+	assert(ps != NULL && capacity > 0);
+
+	ps->capacity = capacity;
+	ps->head = 0;
+	ps->count = 0;
+	ps->evicted = 0;
+	ps->x = particlesys_alloc(capacity, sizeof(float));
+	ps->y = particlesys_alloc(capacity, sizeof(float));
+	ps->z = particlesys_alloc(capacity, sizeof(float));
+	ps->vx = particlesys_alloc(capacity, sizeof(float));
+	ps->vy = particlesys_alloc(capacity, sizeof(float));
+	ps->vz = particlesys_alloc(capacity, sizeof(float));
+	ps->ox = particlesys_alloc(capacity, sizeof(float));
+	ps->oy = particlesys_alloc(capacity, sizeof(float));
+	ps->oz = particlesys_alloc(capacity, sizeof(float));
+	ps->size = particlesys_alloc(capacity, sizeof(float));
+	ps->fade = particlesys_alloc(capacity, sizeof(float));
+	ps->color = particlesys_alloc(capacity, sizeof(uint32_t));
+	ps->type = particlesys_alloc(capacity, sizeof(uint8_t));
+	ps->scratch = particlesys_alloc(1, sizeof(struct particle_block));
+}
+
+void particlesys_destroy(struct particle_system* ps) {
+	assert(ps != NULL);
+
+	free(ps->x);
+	free(ps->y);
+	free(ps->z);
+	free(ps->vx);
+	free(ps->vy);
+	free(ps->vz);
+	free(ps->ox);
+	free(ps->oy);
+	free(ps->oz);
+	free(ps->size);
+	free(ps->fade);
+	free(ps->color);
+	free(ps->type);
+	free(ps->scratch);
+}
+
+void particlesys_clear(struct particle_system* ps) {
+	assert(ps != NULL);
+
+	ps->head = 0;
+	ps->count = 0;
+}
+
+void particlesys_add(struct particle_system* ps, const struct particle* p) {
+	assert(ps != NULL && p != NULL);
+
+	if(ps->count >= ps->capacity) { // evict oldest
+		ps->head = particlesys_slot(ps, 1);
+		ps->count--;
+		ps->evicted++;
+	}
+
+	size_t idx = particlesys_slot(ps, ps->count++);
+	ps->x[idx] = p->x;
+	ps->y[idx] = p->y;
+	ps->z[idx] = p->z;
+	ps->vx[idx] = p->vx;
+	ps->vy[idx] = p->vy;
+	ps->vz[idx] = p->vz;
+	ps->ox[idx] = p->ox;
+	ps->oy[idx] = p->oy;
+	ps->oz[idx] = p->oz;
+	ps->size[idx] = p->size;
+	ps->fade[idx] = p->fade;
+	ps->color[idx] = p->color;
+	ps->type[idx] = p->type;
+}
+
+void particlesys_burst(struct particle_system* ps, struct rng* rng, uint32_t color, float x, float y, float z,
+					   float velocity, float velocity_y, int amount, float min_size, float max_size, float now) {
+	assert(ps != NULL && rng != NULL);
+
+	for(int k = 0; k < amount; k++) {
+		float vx = rng_float(rng) * 2.0F - 1.0F;
+		float vy = rng_float(rng) * 2.0F - 1.0F;
+		float vz = rng_float(rng) * 2.0F - 1.0F;
+		float len = sqrtf(vx * vx + vy * vy + vz * vz);
+
+		if(len < 0.0001F) {
+			vy = len = 1.0F;
+		}
+
+		particlesys_add(ps,
+						&(struct particle) {
+							.size = rng_float(rng) * (max_size - min_size) + min_size,
+							.x = x,
+							.y = y,
+							.z = z,
+							.vx = (vx / len) * velocity,
+							.vy = (vy / len) * velocity * velocity_y,
+							.vz = (vz / len) * velocity,
+							.fade = now,
+							.color = color,
+							.type = PARTICLE_TYPE_CUBE,
+						});
+	}
+}
+
+// after a probe: cancel movement along one axis and bounce for every lane that hit terrain
+static inline void particlesys_bounce(struct particle_block* b, float* m, float* v, size_t k) {
+	v4i solid = v4i_load(b->solid + k);
+	v4f_store(m + k, v4f_select(solid, v4f_splat(0.0F), v4f_load(m + k)));
+	v4f_store(v + k, v4f_select(solid, v4f_load(v + k) * -0.6F, v4f_load(v + k)));
+	v4i_store(b->ground + k, v4i_load(b->ground + k) | solid);
+}
+
+static void particlesys_update_block(struct particle_block* b, size_t n, const struct occupancy* occ, float dt,
+									 float now) {
+	size_t lanes = (n + LANES - 1) / LANES * LANES;
+
+	for(size_t k = n; k < lanes; k++) { // padding lanes are dead and stay put
+		b->x[k] = b->y[k] = b->z[k] = 0.0F;
+		b->vx[k] = b->vy[k] = b->vz[k] = 0.0F;
+		b->size[k] = 0.0F;
+		b->fade[k] = now;
+	}
+
+	float acc_y = -32.0F * dt;
+
+	// fade out, probe below for gravity
+	for(size_t k = 0; k < lanes; k += LANES) {
+		v4f size = v4f_load(b->size + k);
+		v4i alive = (size * (1.0F - (now - v4f_load(b->fade + k)) / PARTICLE_LIFETIME)) >= 0.01F;
+
+		v4i_store(b->alive + k, alive);
+		v4i_store(b->ground + k, (v4i) {0});
+		v4f_store(b->size + k, v4f_select(alive, size, v4f_splat(0.0F)));
+		v4f_store(b->px + k, v4f_load(b->x + k));
+		v4f_store(b->py + k, v4f_load(b->y + k) + acc_y * dt - size * 0.5F);
+		v4f_store(b->pz + k, v4f_load(b->z + k));
+	}
+
+	occupancy_query(occ, b->px, b->py, b->pz, lanes, b->solid);
+
+	// integrate gravity, probe along x
+	for(size_t k = 0; k < lanes; k += LANES) {
+		v4f vy = v4f_load(b->vy + k) + v4f_select(v4i_load(b->solid + k), v4f_splat(0.0F), v4f_splat(acc_y));
+		v4f mx = v4f_load(b->vx + k) * dt;
+
+		v4f_store(b->vy + k, vy);
+		v4f_store(b->mx + k, mx);
+		v4f_store(b->my + k, vy * dt);
+		v4f_store(b->mz + k, v4f_load(b->vz + k) * dt);
+		v4f_store(b->px + k, v4f_load(b->x + k) + mx);
+		v4f_store(b->py + k, v4f_load(b->y + k));
+	}
+
+	occupancy_query(occ, b->px, b->py, b->pz, lanes, b->solid);
+
+	for(size_t k = 0; k < lanes; k += LANES) {
+		particlesys_bounce(b, b->mx, b->vx, k);
+		v4f_store(b->px + k, v4f_load(b->x + k) + v4f_load(b->mx + k));
+		v4f_store(b->py + k, v4f_load(b->y + k) + v4f_load(b->my + k));
+	}
+
+	occupancy_query(occ, b->px, b->py, b->pz, lanes, b->solid);
+
+	for(size_t k = 0; k < lanes; k += LANES) {
+		particlesys_bounce(b, b->my, b->vy, k);
+		v4f_store(b->py + k, v4f_load(b->y + k) + v4f_load(b->my + k));
+		v4f_store(b->pz + k, v4f_load(b->z + k) + v4f_load(b->mz + k));
+	}
+
+	occupancy_query(occ, b->px, b->py, b->pz, lanes, b->solid);
+
+	float pow1_tys = 0.999991F + (2.55114F * dt - 2.30093F) * dt; // pow(0.1F, dt)
+	float pow4_tys = 1.0F + (0.413432F * dt - 0.916185F) * dt;	  // pow(0.4F, dt)
+
+	// ground and air friction, then move
+	for(size_t k = 0; k < lanes; k += LANES) {
+		particlesys_bounce(b, b->mz, b->vz, k);
+
+		v4i ground = v4i_load(b->ground + k);
+		v4i alive = v4i_load(b->alive + k);
+		v4f friction = v4f_select(ground, v4f_splat(pow1_tys), v4f_splat(pow4_tys));
+		float* v[3] = {b->vx + k, b->vy + k, b->vz + k};
+		float* m[3] = {b->mx + k, b->my + k, b->mz + k};
+		float* p[3] = {b->x + k, b->y + k, b->z + k};
+
+		for(int axis = 0; axis < 3; axis++) {
+			v4f vel = v4f_load(v[axis]) * friction;
+			v4i resting = ground & (((v4i)vel & 0x7FFFFFFF) < (v4i)v4f_splat(1.0F)); // |v| < 1
+			v4f_store(v[axis], v4f_select(resting, v4f_splat(0.0F), vel));
+			v4f_store(p[axis], v4f_load(p[axis]) + v4f_select(alive, v4f_load(m[axis]), v4f_splat(0.0F)));
+		}
+	}
+}
+
+static void particlesys_update_range(struct particle_system* ps, struct particle_block* b, size_t start, size_t end,
+									 const struct occupancy* occ, float dt, float now) {
+	for(size_t offset = start; offset < end; offset += BLOCK_SIZE) {
+		size_t n = (end - offset < BLOCK_SIZE) ? end - offset : BLOCK_SIZE;
+		size_t bytes = n * sizeof(float);
+
+		memcpy(b->x, ps->x + offset, bytes);
+		memcpy(b->y, ps->y + offset, bytes);
+		memcpy(b->z, ps->z + offset, bytes);
+		memcpy(b->vx, ps->vx + offset, bytes);
+		memcpy(b->vy, ps->vy + offset, bytes);
+		memcpy(b->vz, ps->vz + offset, bytes);
+		memcpy(b->size, ps->size + offset, bytes);
+		memcpy(b->fade, ps->fade + offset, bytes);
+
+		particlesys_update_block(b, n, occ, dt, now);
+
+		memcpy(ps->x + offset, b->x, bytes);
+		memcpy(ps->y + offset, b->y, bytes);
+		memcpy(ps->z + offset, b->z, bytes);
+		memcpy(ps->vx + offset, b->vx, bytes);
+		memcpy(ps->vy + offset, b->vy, bytes);
+		memcpy(ps->vz + offset, b->vz, bytes);
+		memcpy(ps->size + offset, b->size, bytes);
+	}
+}
+
+void particlesys_update(struct particle_system* ps, const struct occupancy* occ, float dt, float now) {
+	assert(ps != NULL && occ != NULL);
+
+	size_t end = ps->head + ps->count;
+
+	if(end > ps->capacity) { // ring wraps around
+		particlesys_update_range(ps, ps->scratch, ps->head, ps->capacity, occ, dt, now);
+		particlesys_update_range(ps, ps->scratch, 0, end - ps->capacity, occ, dt, now);
+	} else {
+		particlesys_update_range(ps, ps->scratch, ps->head, end, occ, dt, now);
+	}
+
+	// faded particles in the middle are skipped until the head reaches them
+	while(ps->count > 0 && ps->size[ps->head] <= 0.0F) {
+		ps->head = particlesys_slot(ps, 1);
+		ps->count--;
+	}
+}
@@ -0,0 +1,86 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "occupancy.h"
+#include "utils.h"
+
+#define PARTICLE_TYPE_CUBE 255
+#define PARTICLE_LIFETIME 2.0F
+
+struct particle {
+	float x, y, z;
+	float vx, vy, vz;
+	float ox, oy, oz;
+	float size;
+	float fade;
+	uint32_t color;
+	uint8_t type;
+};
+
+// structure of arrays in a ring buffer ordered by spawn time,
+// when full the oldest (most faded) particle is overwritten
+struct particle_system {
+	size_t capacity;
+	size_t head;
+	size_t count;
+	size_t evicted;
+	float* x;
+	float* y;
+	float* z;
+	float* vx;
+	float* vy;
+	float* vz;
+	float* ox;
+	float* oy;
+	float* oz;
+	float* size;
+	float* fade;
+	uint32_t* color;
+	uint8_t* type;
+	struct particle_block* scratch; // per system, so that independent systems can update concurrently
+};
+
+void particlesys_create(struct particle_system* ps, size_t capacity);
+void particlesys_destroy(struct particle_system* ps);
+void particlesys_clear(struct particle_system* ps);
+void particlesys_add(struct particle_system* ps, const struct particle* p);
+void particlesys_burst(struct particle_system* ps, struct rng* rng, uint32_t color, float x, float y, float z,
+					   float velocity, float velocity_y, int amount, float min_size, float max_size, float now);
+void particlesys_update(struct particle_system* ps, const struct occupancy* occ, float dt, float now);
+
+// maps the k-th oldest particle to its slot
+static inline size_t particlesys_slot(const struct particle_system* ps, size_t k) {
+	size_t idx = ps->head + k;
+	return idx >= ps->capacity ? idx - ps->capacity : idx;
+}
+
+// current edge length, zero once the particle has faded out
+static inline float particlesys_size(const struct particle_system* ps, size_t idx, float now) {
+	float size = ps->size[idx] * (1.0F - (now - ps->fade[idx]) / PARTICLE_LIFETIME);
+	return size < 0.01F ? 0.0F : size;
+}
+
+#endif
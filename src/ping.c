@@ -20,40 +20,51 @@
 #include <enet/enet.h>
 #include <pthread.h>
 #include <math.h>
-#include <unistd.h>
+#include <time.h>
 #include <string.h>
 
 #include "window.h"
 #include "ping.h"
 #include "common.h"
 #include "parson.h"
-#include "list.h"
 #include "hud.h"
-#include "channel.h"
+#include "spsc.h"
 #include "hashtable.h"
 #include "utils.h"
-
-struct channel ping_queue;
-ENetSocket sock, lan;
-pthread_t ping_thread;
-void (*ping_result)(void*, float time_delta, char* aos);
-
-void ping_init() {
-	channel_create(&ping_queue, sizeof(struct ping_entry), 64);
-
-	sock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
-	enet_socket_set_option(sock, ENET_SOCKOPT_NONBLOCK, 1);
-
-	lan = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
-	enet_socket_set_option(lan, ENET_SOCKOPT_NONBLOCK, 1);
-	enet_socket_set_option(lan, ENET_SOCKOPT_BROADCAST, 1);
-
-	pthread_create(&ping_thread, NULL, ping_update, NULL);
+#include "profiler.h"
+
+struct ping_result {
+	unsigned int generation;
+	float time_delta;
+	char aos[64];
+	bool lan;
+	struct serverlist_entry entry;
+};
+
+static struct spsc_queue ping_requests; // of struct ping_entry, main thread to pinger
+static struct spsc_queue ping_results;	// of struct ping_result, pinger to main thread
+static ENetSocket sock, lan, wake;
+static ENetAddress wake_addr;
+static pthread_t ping_thread;
+static bool ping_running = false;
+static bool ping_wake_pending = false;
+// bumped by ping_start() and ping_stop(), anything tagged with an older one is dropped
+static unsigned int ping_generation = 0;
+static bool ping_active = false;
+static void (*ping_result)(void*, float time_delta, char* aos);
+
+#define IP_KEY(addr) (((uint64_t)(addr).host << 16) | (addr).port)
+
+static double ping_clock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
-void ping_deinit() {
-	enet_socket_destroy(sock);
-	enet_socket_destroy(lan);
+// one datagram on the loopback socket is enough to get the pinger out of select
+static void ping_wakeup() {
+	if(!__atomic_exchange_n(&ping_wake_pending, true, __ATOMIC_ACQ_REL))
+		enet_socket_send(sock, &wake_addr, &(ENetBuffer) {.data = "W", .dataLength = 1}, 1);
 }
 
 static void ping_lan() {
@@ -64,50 +75,127 @@ static void ping_lan() {
 		.dataLength = 8,
 	};
 
-	for(addr.port = 32882; addr.port < 32892; addr.port++)
+	for(addr.port = PING_LAN_PORT_START; addr.port < PING_LAN_PORT_END; addr.port++)
 		enet_socket_send(lan, &addr, &buffer, 1);
 }
 
+static void ping_push_result(struct ping_result* r) {
+	if(!spsc_push(&ping_results, r))
+		log_warn("Ping results are not collected, dropping %s", r->lan ? r->entry.identifier : r->aos);
+}
+
+static void ping_send(struct ping_entry* entry, double now) {
+	enet_socket_send(sock, &entry->addr, &(ENetBuffer) {.data = "HELLO", .dataLength = 5}, 1);
+	entry->time_start = now;
+	entry->deadline = now + PING_TIMEOUT * (1 << entry->trycount);
+}
+
+struct ping_timers {
+	double now;
+	double next; // earliest deadline still pending
+};
+
 static bool pings_retry(void* key, void* value, void* user) {
 	struct ping_entry* entry = (struct ping_entry*)value;
+	struct ping_timers* timers = (struct ping_timers*)user;
 
-	if(window_time() - entry->time_start > 2.0F) { // timeout
+	if(timers->now >= entry->deadline) { // timeout
 		// try up to 3 times after first failed attempt
-		if(entry->trycount >= 3) {
+		if(entry->trycount >= PING_RETRIES)
 			return true;
-		} else {
-			enet_socket_send(sock, &entry->addr, &(ENetBuffer) {.data = "HELLO", .dataLength = 5}, 1);
-			entry->time_start = window_time();
-			entry->trycount++;
-			log_warn("Ping timeout on %s, retrying", entry->aos);
-		}
+
+		entry->trycount++;
+		ping_send(entry, timers->now);
+		log_warn("Ping timeout on %s, retrying", entry->aos);
 	}
 
+	timers->next = fmin(timers->next, entry->deadline);
 	return false;
 }
 
-#define IP_KEY(addr) (((uint64_t)addr.host << 16) | (addr.port));
+static const char* ping_json_string(JSON_Object* root, const char* name) {
+	const char* str = json_object_get_string(root, name);
+	return str ? str : "";
+}
 
-void* ping_update(void* data) {
-	pthread_detach(pthread_self());
+static void ping_receive_lan(ENetAddress* from, char* data, double lan_start, unsigned int generation) {
+	JSON_Value* js = json_parse_string(data);
+	if(!js)
+		return;
 
-	ping_lan();
-	float ping_start = window_time();
+	JSON_Object* root = json_value_get_object(js);
 
-	HashTable pings;
-	ht_setup(&pings, sizeof(uint64_t), sizeof(struct ping_entry), 64);
+	struct ping_result r = {
+		.generation = generation,
+		.time_delta = ping_clock() - lan_start,
+		.lan = true,
+	};
+
+	strcpy(r.entry.country, "LAN");
+	r.entry.ping = ceil(r.time_delta * 1000.0F);
+	snprintf(r.entry.identifier, sizeof(r.entry.identifier) - 1, "aos://%u:%u", from->host, from->port);
+
+	strncpy(r.entry.name, ping_json_string(root, "name"), sizeof(r.entry.name) - 1);
+	strncpy(r.entry.gamemode, ping_json_string(root, "game_mode"), sizeof(r.entry.gamemode) - 1);
+	strncpy(r.entry.map, ping_json_string(root, "map"), sizeof(r.entry.map) - 1);
+	r.entry.current = json_object_get_number(root, "players_current");
+	r.entry.max = json_object_get_number(root, "players_max");
+	ping_push_result(&r);
+
+	json_value_free(js);
+}
+
+// forgets every pending ping and starts over with a new LAN broadcast
+static void ping_switch(HashTable* pings, unsigned int* generation, unsigned int next, double* lan_start) {
+	*generation = next;
+	ht_clear(pings);
+
+	if(__atomic_load_n(&ping_active, __ATOMIC_ACQUIRE)) {
+		ping_lan();
+		*lan_start = ping_clock();
+	}
+}
 
-	while(1) {
-		if (!ping_result)
-			continue;
+static void* ping_update(void* data) {
+	PROFILE_THREAD("ping thread");
 
-		size_t drain = channel_size(&ping_queue);
-		for(size_t k = 0; (k < drain) || (!pings.size && window_time() - ping_start >= 8.0F); k++) {
-			struct ping_entry entry;
-			channel_await(&ping_queue, &entry);
+	HashTable pings;
+	ht_setup(&pings, sizeof(uint64_t), sizeof(struct ping_entry), 64);
 
-			uint64_t ID = IP_KEY(entry.addr);
-			ht_insert(&pings, &ID, &entry);
+	unsigned int generation = 0;
+	double lan_start = 0.0;
+	ENetSocket max_socket = max(max(sock, lan), wake);
+	enet_uint32 timeout = 0;
+
+	while(__atomic_load_n(&ping_running, __ATOMIC_ACQUIRE)) {
+		// sleep until something arrives or the next probe times out, outside of the scope below
+		ENetSocketSet set;
+		ENET_SOCKETSET_EMPTY(set);
+		ENET_SOCKETSET_ADD(set, sock);
+		ENET_SOCKETSET_ADD(set, lan);
+		ENET_SOCKETSET_ADD(set, wake);
+		enet_socketset_select(max_socket, &set, NULL, timeout);
+
+		PROFILE_SCOPE("ping_update");
+
+		__atomic_store_n(&ping_wake_pending, false, __ATOMIC_RELEASE);
+
+		unsigned int current = __atomic_load_n(&ping_generation, __ATOMIC_ACQUIRE);
+		if(current != generation)
+			ping_switch(&pings, &generation, current, &lan_start);
+
+		// ping_start() may bump the generation and queue new requests after the load above,
+		// those requests are the first sign of the new generation, older ones are dropped
+		struct ping_entry entry;
+		while(spsc_pop(&ping_requests, &entry)) {
+			if((int)(entry.generation - generation) > 0)
+				ping_switch(&pings, &generation, entry.generation, &lan_start);
+
+			if(entry.generation == generation) {
+				uint64_t ID = IP_KEY(entry.addr);
+				ping_send(&entry, ping_clock());
+				ht_insert(&pings, &ID, &entry);
+			}
 		}
 
 		char tmp[512];
@@ -115,70 +203,103 @@ void* ping_update(void* data) {
 
 		ENetBuffer buf = {
 			.data = tmp,
-			.dataLength = sizeof(tmp),
+			.dataLength = sizeof(tmp) - 1,
 		};
 
+		while(enet_socket_receive(wake, &from, &buf, 1) > 0)
+			;
+
 		while(1) {
 			int recvLength = enet_socket_receive(sock, &from, &buf, 1);
 			uint64_t ID = IP_KEY(from);
 
-			if(recvLength != 0) {
-				struct ping_entry* entry = ht_lookup(&pings, &ID);
-
-				if(entry) {
-					if(recvLength > 0) { // received something!
-						if(!strncmp(buf.data, "HI", recvLength)) {
-							ping_result(NULL, window_time() - entry->time_start, entry->aos);
-							ht_erase(&pings, &ID);
-						} else {
-							entry->trycount++;
-						}
-					} else { // connection was closed
+			if(recvLength == 0) // would block
+				break;
+
+			struct ping_entry* entry = ht_lookup(&pings, &ID);
+
+			if(entry) {
+				if(recvLength > 0) { // received something!
+					if(!strncmp(buf.data, "HI", recvLength)) {
+						struct ping_result r = {
+							.generation = generation,
+							.time_delta = ping_clock() - entry->time_start,
+						};
+						strcpy(r.aos, entry->aos);
+						ping_push_result(&r);
 						ht_erase(&pings, &ID);
+					} else {
+						entry->trycount++;
 					}
+				} else { // connection was closed
+					ht_erase(&pings, &ID);
 				}
-			} else { // would block
+			} else if(recvLength < 0) {
 				break;
 			}
 		}
 
-		ht_iterate_remove(&pings, NULL, pings_retry);
+		int length;
+		while((length = enet_socket_receive(lan, &from, &buf, 1)) > 0) {
+			tmp[length] = 0;
+			ping_receive_lan(&from, tmp, lan_start, generation);
+		}
 
-		int length = enet_socket_receive(lan, &from, &buf, 1);
-		if(length) {
-			JSON_Value* js = json_parse_string(buf.data);
-			if(js) {
-				JSON_Object* root = json_value_get_object(js);
+		struct ping_timers timers = {
+			.now = ping_clock(),
+			.next = INFINITY,
+		};
 
-				struct serverlist_entry e;
+		ht_iterate_remove(&pings, &timers, pings_retry);
 
-				strcpy(e.country, "LAN");
-				e.ping = ceil((window_time() - ping_start) * 1000.0F);
-				snprintf(e.identifier, sizeof(e.identifier) - 1, "aos://%u:%u", from.host, from.port);
+		timeout = isinf(timers.next) ? 60000 : ceil(fmax(timers.next - ping_clock(), 0.0) * 1000.0);
+	}
 
-				strncpy(e.name, json_object_get_string(root, "name"), sizeof(e.name) - 1);
-				e.name[sizeof(e.name) - 1] = 0;
-				strncpy(e.gamemode, json_object_get_string(root, "game_mode"), sizeof(e.gamemode) - 1);
-				e.gamemode[sizeof(e.gamemode) - 1] = 0;
-				strncpy(e.map, json_object_get_string(root, "map"), sizeof(e.map) - 1);
-				e.map[sizeof(e.map) - 1] = 0;
-				e.current = json_object_get_number(root, "players_current");
-				e.max = json_object_get_number(root, "players_max");
-				ping_result(&e, window_time() - ping_start, NULL);
+	ht_destroy(&pings);
+	return NULL;
+}
 
-				json_value_free(js);
-			}
-		}
+void ping_init() {
+	spsc_create(&ping_requests, sizeof(struct ping_entry), PING_REQUEST_LENGTH);
+	spsc_create(&ping_results, sizeof(struct ping_result), PING_RESULT_LENGTH);
 
-		usleep(1000000);
+	sock = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	enet_socket_set_option(sock, ENET_SOCKOPT_NONBLOCK, 1);
+
+	lan = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	enet_socket_set_option(lan, ENET_SOCKOPT_NONBLOCK, 1);
+	enet_socket_set_option(lan, ENET_SOCKOPT_BROADCAST, 1);
+
+	wake = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	enet_socket_set_option(wake, ENET_SOCKOPT_NONBLOCK, 1);
+	enet_address_set_host(&wake_addr, "127.0.0.1");
+	wake_addr.port = ENET_PORT_ANY;
+	enet_socket_bind(wake, &wake_addr);
+	enet_socket_get_address(wake, &wake_addr);
+
+	ping_running = true;
+	if(pthread_create(&ping_thread, NULL, ping_update, NULL))
+		ping_running = false;
+}
+
+void ping_deinit() {
+	if(ping_running) {
+		__atomic_store_n(&ping_running, false, __ATOMIC_RELEASE);
+		__atomic_store_n(&ping_wake_pending, false, __ATOMIC_RELEASE);
+		ping_wakeup();
+		pthread_join(ping_thread, NULL);
 	}
+
+	enet_socket_destroy(sock);
+	enet_socket_destroy(lan);
+	enet_socket_destroy(wake);
 }
 
 void ping_check(char* addr, int port, char* aos) {
 	struct ping_entry entry = {
 		.trycount = 0,
 		.addr.port = port,
-		.time_start = window_time(),
+		.generation = __atomic_load_n(&ping_generation, __ATOMIC_ACQUIRE),
 	};
 
 	strncpy(entry.aos, aos, sizeof(entry.aos) - 1);
@@ -186,18 +307,34 @@ void ping_check(char* addr, int port, char* aos) {
 
 	enet_address_set_host(&entry.addr, addr);
 
-	channel_put(&ping_queue, &entry);
+	if(!ping_running || !spsc_push(&ping_requests, &entry)) {
+		log_warn("Too many pings pending, skipping %s", aos);
+		return;
+	}
 
-	enet_socket_send(sock, &entry.addr, &(ENetBuffer) {.data = "HELLO", .dataLength = 5}, 1);
+	ping_wakeup();
 }
 
 void ping_start(void (*result)(void*, float, char*)) {
-	ping_stop();
-
 	ping_result = result;
+	__atomic_store_n(&ping_active, true, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&ping_generation, 1, __ATOMIC_ACQ_REL);
+
+	if(ping_running)
+		ping_wakeup();
 }
 
 void ping_stop() {
-	channel_clear(&ping_queue);
+	__atomic_store_n(&ping_active, false, __ATOMIC_RELEASE);
+	__atomic_add_fetch(&ping_generation, 1, __ATOMIC_ACQ_REL);
 }
 
+void ping_poll() {
+	unsigned int generation = __atomic_load_n(&ping_generation, __ATOMIC_ACQUIRE);
+	struct ping_result r;
+
+	while(ping_running && spsc_pop(&ping_results, &r)) {
+		if(r.generation == generation && ping_result)
+			ping_result(r.lan ? &r.entry : NULL, r.time_delta, r.aos);
+	}
+}
@@ -20,20 +20,34 @@
 #ifndef PING_H
 #define PING_H
 
+#include <stdbool.h>
 #include <enet/enet.h>
 
+#define PING_REQUEST_LENGTH 1024
+#define PING_RESULT_LENGTH 1024
+#define PING_TIMEOUT 1.0 // doubles after every retry
+#define PING_RETRIES 3
+#define PING_LAN_PORT_START 32882
+#define PING_LAN_PORT_END 32892
+
 struct ping_entry {
 	ENetAddress addr;
 	char aos[64];
-	float time_start;
+	double time_start; // of the last probe, monotonic
+	double deadline;
 	int trycount;
+	unsigned int generation;
 };
 
+// the pinger runs on its own thread, which sleeps until a reply, a request or the next retry is due
 void ping_init();
 void ping_deinit();
+// queues a probe, results are collected by ping_poll()
 void ping_check(char* addr, int port, char* aos);
-void* ping_update(void* data);
+// forgets all probes, broadcasts to the LAN and sends every later result to result()
 void ping_start(void (*result)(void*, float, char*));
 void ping_stop();
+// hands all results that arrived since the last call to the function given to ping_start(), call from the main thread
+void ping_poll();
 
 #endif
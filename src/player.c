@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <limits.h>
+#include <assert.h>
 
 #include "common.h"
 #include "camera.h"
@@ -36,6 +37,10 @@
 #include "window.h"
 #include "particle.h"
 #include "http.h"
+#include "broadphase.h"
+#include "obb.h"
+#include "movement.h"
+#include "profiler.h"
 
 struct GameState gamestate;
 
@@ -66,19 +71,39 @@ int player_intersection_type = -1;
 int player_intersection_player = 0;
 float player_intersection_dist = 1024.0F;
 
+struct broadphase player_broadphase;
+static float player_broadphase_reach = 0.0F;
+
+static struct obb_set player_obbs;
+
+// boxes are rebuilt at most once per simulation tick, unless the player was moved in between
+static struct player_hitbox_cache {
+	bool valid;
+	unsigned int tick;
+	struct Position eye;
+	unsigned char keys;
+} player_hitbox_cache[PLAYERS_MAX];
+
+static unsigned int player_hitbox_tick = 0;
+
+// terrain around every player, gathered once per tick before anyone moves
+static struct movement_cache player_movement_cache[PLAYERS_MAX];
+
+static int player_move_cached(struct Player* p, const struct movement_cache* cache, float fsynctics, int id);
+static void player_broadphase_refresh(void);
+
 struct Player players[PLAYERS_MAX];
 
-#define FALL_DAMAGE_VELOCITY 0.58F
-#define FALL_SLOW_DOWN 0.24F
-#define SQRT 0.70710678F
 #define WEAPON_PRIMARY 1
-#define FALL_DAMAGE_SCALAR 4096
 
 void player_init() {
 	for(int k = 0; k < PLAYERS_MAX; k++) {
 		player_reset(&players[k]);
 		players[k].score = 0;
 	}
+
+	broadphase_create(&player_broadphase, map_size_x, map_size_z, PLAYERS_MAX);
+	obb_set_create(&player_obbs, PLAYERS_MAX * PLAYER_HITBOXES);
 }
 
 void player_reset(struct Player* p) {
@@ -280,10 +305,21 @@ int player_intersection_choose(struct player_intersection* s, float* dist) {
 }
 
 void player_update(float dt, int locked) {
+	PROFILE_SCOPE("player_update");
+
+	if(locked) {
+		player_hitbox_tick++;
+
+		for(int k = 0; k < PLAYERS_MAX; k++) {
+			if(players[k].connected && players[k].alive)
+				movement_cache_gather(player_movement_cache + k, &map_occupancy, players[k].pos.x, players[k].pos.z);
+		}
+	}
+
 	for(int k = 0; k < PLAYERS_MAX; k++) {
 		if(players[k].connected) {
 			if(locked) {
-				player_move(&players[k], dt, k);
+				player_move_cached(&players[k], player_movement_cache + k, dt, k);
 			} else {
 				if(k != local_player_id) {
 					// smooth out player orientation
@@ -297,6 +333,9 @@ void player_update(float dt, int locked) {
 			}
 		}
 	}
+
+	// at least once per frame, positions received since the last update are in by now
+	player_broadphase_refresh();
 }
 
 void player_render_all() {
@@ -511,30 +550,18 @@ static const struct hitbox box_legc = (struct hitbox) {
 	.scale = 0.1F,
 };
 
-static bool hitbox_intersection(mat4 model, const struct hitbox* box, Ray* r, float* distance) {
+static void player_hitbox_store(int index, mat4 model, const struct hitbox* box) {
 	mat4 inv_model;
 	glmc_mat4_inv(model, inv_model);
 
-	vec3 origin, dir;
-	glmc_mat4_mulv3(inv_model, r->origin.coords, 1.0F, origin);
-	glmc_mat4_mulv3(inv_model, r->direction.coords, 0.0F, dir);
-
-	return aabb_intersection_ray(
-		&(AABB) {
-			.min = {-box->pivot[0] * box->scale, -box->pivot[2] * box->scale, -box->pivot[1] * box->scale},
-			.max = {(box->size[0] - box->pivot[0]) * box->scale, (box->size[2] - box->pivot[2]) * box->scale,
-					(box->size[1] - box->pivot[1]) * box->scale},
-		},
-		&(Ray) {
-			.origin.coords = {origin[0], origin[1], origin[2]},
-			.direction.coords = {dir[0], dir[1], dir[2]},
-		},
-		distance);
+	obb_set_box(&player_obbs, index, inv_model,
+				(float[]) {-box->pivot[0] * box->scale, -box->pivot[2] * box->scale, -box->pivot[1] * box->scale},
+				(float[]) {(box->size[0] - box->pivot[0]) * box->scale, (box->size[2] - box->pivot[2]) * box->scale,
+						   (box->size[1] - box->pivot[1]) * box->scale});
 }
 
-void player_collision(const struct Player* p, Ray* ray, struct player_intersection* intersects) {
-	if(!p->alive || p->team == TEAM_SPECTATOR)
-		return;
+static void player_hitboxes_compute(const struct Player* p, int id) {
+	int base = id * PLAYER_HITBOXES;
 
 	float l = sqrt(distance3D(p->orientation_smooth.x, p->orientation_smooth.y, p->orientation_smooth.z, 0, 0, 0));
 	float ox = p->orientation_smooth.x / l;
@@ -555,83 +582,192 @@ void player_collision(const struct Player* p, Ray* ray, struct player_intersecti
 	a /= 0.25F;
 	b /= 0.25F;
 
-	float dist; // distance
-
-	matrix_push(matrix_model);
+	mat4 model, leg_model;
 
-	matrix_identity(matrix_model);
-	matrix_translate(matrix_model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
+	matrix_identity(model);
+	matrix_translate(model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
 	float head_scale = sqrt(pow(p->orientation.x, 2.0F) + pow(p->orientation.y, 2.0F) + pow(p->orientation.z, 2.0F));
-	matrix_translate(matrix_model, 0.0F, box_head.pivot[2] * (head_scale * box_head.scale - box_head.scale), 0.0F);
-	matrix_scale3(matrix_model, head_scale);
-	matrix_pointAt(matrix_model, ox, oy, oz);
-	matrix_rotate(matrix_model, 90.0F, 0.0F, 1.0F, 0.0F);
+	matrix_translate(model, 0.0F, box_head.pivot[2] * (head_scale * box_head.scale - box_head.scale), 0.0F);
+	matrix_scale3(model, head_scale);
+	matrix_pointAt(model, ox, oy, oz);
+	matrix_rotate(model, 90.0F, 0.0F, 1.0F, 0.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_HEAD, model, &box_head);
+
+	matrix_identity(model);
+	matrix_translate(model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
+	matrix_pointAt(model, ox, 0.0F, oz);
+	matrix_rotate(model, 90.0F, 0.0F, 1.0F, 0.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_TORSO, model, torso);
+
+	matrix_load(leg_model, model);
+	matrix_translate(leg_model, torso->size[0] * 0.1F * 0.5F - leg->size[0] * 0.1F * 0.5F,
+					 -torso->size[2] * 0.1F * (p->input.keys.crouch ? 0.6F : 1.0F),
+					 p->input.keys.crouch ? (-torso->size[2] * 0.1F * 0.75F) : 0.0F);
+	matrix_rotate(leg_model, 45.0F * foot_function(p) * a, 1.0F, 0.0F, 0.0F);
+	matrix_rotate(leg_model, 45.0F * foot_function(p) * b, 0.0F, 0.0F, 1.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_LEG_LEFT, leg_model, leg);
+
+	matrix_translate(model, -torso->size[0] * 0.1F * 0.5F + leg->size[0] * 0.1F * 0.5F,
+					 -torso->size[2] * 0.1F * (p->input.keys.crouch ? 0.6F : 1.0F),
+					 p->input.keys.crouch ? (-torso->size[2] * 0.1F * 0.75F) : 0.0F);
+	matrix_rotate(model, -45.0F * foot_function(p) * a, 1.0F, 0.0F, 0.0F);
+	matrix_rotate(model, -45.0F * foot_function(p) * b, 0.0F, 0.0F, 1.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_LEG_RIGHT, model, leg);
+
+	matrix_identity(model);
+	matrix_translate(model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
+	matrix_translate(model, 0.0F, p->input.keys.crouch * 0.1F - 0.1F * 2, 0.0F);
+	matrix_pointAt(model, ox, oy, oz);
+	matrix_rotate(model, 90.0F, 0.0F, 1.0F, 0.0F);
+
+	if(p->input.keys.sprint && !p->input.keys.crouch)
+		matrix_rotate(model, 45.0F, 1.0F, 0.0F, 0.0F);
+
+	float* angles = player_tool_func(p);
+	matrix_rotate(model, angles[0], 1.0F, 0.0F, 0.0F);
+	matrix_rotate(model, angles[1], 0.0F, 1.0F, 0.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_ARM_LEFT, model, &box_arm_left);
+
+	matrix_rotate(model, -45.0F, 0.0F, 1.0F, 0.0F);
+	player_hitbox_store(base + PLAYER_HITBOX_ARM_RIGHT, model, &box_arm_right);
+}
+
+static void player_hitboxes_refresh(const struct Player* p, int id) {
+	struct player_hitbox_cache* c = player_hitbox_cache + id;
 
-	if(hitbox_intersection(matrix_model, &box_head, ray, &dist)) {
+	if(c->valid && c->tick == player_hitbox_tick && c->keys == p->input.keys.packed && c->eye.x == p->physics.eye.x
+	   && c->eye.y == p->physics.eye.y && c->eye.z == p->physics.eye.z)
+		return;
+
+	player_hitboxes_compute(p, id);
+
+	*c = (struct player_hitbox_cache) {
+		.valid = true,
+		.tick = player_hitbox_tick,
+		.eye = p->physics.eye,
+		.keys = p->input.keys.packed,
+	};
+}
+
+static void player_hitbox_results(const float* distance, struct player_intersection* intersects) {
+	if(isfinite(distance[PLAYER_HITBOX_HEAD])) {
 		intersects->head = 1;
-		intersects->distance.head = dist;
+		intersects->distance.head = distance[PLAYER_HITBOX_HEAD];
 	}
 
-	matrix_identity(matrix_model);
-	matrix_translate(matrix_model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
-	matrix_pointAt(matrix_model, ox, 0.0F, oz);
-	matrix_rotate(matrix_model, 90.0F, 0.0F, 1.0F, 0.0F);
-
-	if(hitbox_intersection(matrix_model, torso, ray, &dist)) {
+	if(isfinite(distance[PLAYER_HITBOX_TORSO])) {
 		intersects->torso = 1;
-		intersects->distance.torso = dist;
+		intersects->distance.torso = distance[PLAYER_HITBOX_TORSO];
 	}
 
-	matrix_push(matrix_model);
-	matrix_translate(matrix_model, torso->size[0] * 0.1F * 0.5F - leg->size[0] * 0.1F * 0.5F,
-					 -torso->size[2] * 0.1F * (p->input.keys.crouch ? 0.6F : 1.0F),
-					 p->input.keys.crouch ? (-torso->size[2] * 0.1F * 0.75F) : 0.0F);
-	matrix_rotate(matrix_model, 45.0F * foot_function(p) * a, 1.0F, 0.0F, 0.0F);
-	matrix_rotate(matrix_model, 45.0F * foot_function(p) * b, 0.0F, 0.0F, 1.0F);
-
-	if(hitbox_intersection(matrix_model, leg, ray, &dist)) {
+	if(isfinite(distance[PLAYER_HITBOX_LEG_LEFT])) {
 		intersects->leg_left = 1;
-		intersects->distance.leg_left = dist;
+		intersects->distance.leg_left = distance[PLAYER_HITBOX_LEG_LEFT];
 	}
 
-	matrix_pop(matrix_model);
-	matrix_translate(matrix_model, -torso->size[0] * 0.1F * 0.5F + leg->size[0] * 0.1F * 0.5F,
-					 -torso->size[2] * 0.1F * (p->input.keys.crouch ? 0.6F : 1.0F),
-					 p->input.keys.crouch ? (-torso->size[2] * 0.1F * 0.75F) : 0.0F);
-	matrix_rotate(matrix_model, -45.0F * foot_function(p) * a, 1.0F, 0.0F, 0.0F);
-	matrix_rotate(matrix_model, -45.0F * foot_function(p) * b, 0.0F, 0.0F, 1.0F);
-
-	if(hitbox_intersection(matrix_model, leg, ray, &dist)) {
+	if(isfinite(distance[PLAYER_HITBOX_LEG_RIGHT])) {
 		intersects->leg_right = 1;
-		intersects->distance.leg_right = dist;
+		intersects->distance.leg_right = distance[PLAYER_HITBOX_LEG_RIGHT];
 	}
 
-	matrix_identity(matrix_model);
-	matrix_translate(matrix_model, p->physics.eye.x, p->physics.eye.y + height, p->physics.eye.z);
-	matrix_translate(matrix_model, 0.0F, p->input.keys.crouch * 0.1F - 0.1F * 2, 0.0F);
-	matrix_pointAt(matrix_model, ox, oy, oz);
-	matrix_rotate(matrix_model, 90.0F, 0.0F, 1.0F, 0.0F);
+	// right arm is tested last and wins
+	if(isfinite(distance[PLAYER_HITBOX_ARM_LEFT])) {
+		intersects->arms = 1;
+		intersects->distance.arms = distance[PLAYER_HITBOX_ARM_LEFT];
+	}
 
-	if(p->input.keys.sprint && !p->input.keys.crouch)
-		matrix_rotate(matrix_model, 45.0F, 1.0F, 0.0F, 0.0F);
+	if(isfinite(distance[PLAYER_HITBOX_ARM_RIGHT])) {
+		intersects->arms = 1;
+		intersects->distance.arms = distance[PLAYER_HITBOX_ARM_RIGHT];
+	}
+}
 
-	float* angles = player_tool_func(p);
-	matrix_rotate(matrix_model, angles[0], 1.0F, 0.0F, 0.0F);
-	matrix_rotate(matrix_model, angles[1], 0.0F, 1.0F, 0.0F);
+static bool player_hittable(const struct Player* p) {
+	return p->connected && p->alive && p->team != TEAM_SPECTATOR;
+}
 
-	if(hitbox_intersection(matrix_model, &box_arm_left, ray, &dist)) {
-		intersects->arms = 1;
-		intersects->distance.arms = dist;
+// box around the neck pivot of player_collision() that contains every hitbox
+static void player_hit_bounds(const struct Player* p, AABB* bounds) {
+	float head_scale = len3D(p->orientation.x, p->orientation.y, p->orientation.z);
+	float r = PLAYER_HIT_RADIUS * fmaxf(head_scale, 1.0F);
+	float y = p->physics.eye.y + player_height(p) - 0.25F;
+
+	*bounds = (AABB) {
+		.min = {p->physics.eye.x - r, y - r, p->physics.eye.z - r},
+		.max = {p->physics.eye.x + r, y + r, p->physics.eye.z + r},
+	};
+}
+
+// players are only reinserted once one of them left the padded bounds it was inserted with,
+// which happens every few ticks for moving players
+static void player_broadphase_refresh(void) {
+	bool rebuild = false;
+
+	for(int k = 0; k < PLAYERS_MAX && !rebuild; k++) {
+		if(!player_hittable(players + k))
+			continue;
+
+		if(!player_broadphase.inserted[k]) {
+			rebuild = true;
+		} else {
+			AABB b;
+			player_hit_bounds(players + k, &b);
+			AABB* stored = player_broadphase.bounds + k;
+			rebuild = b.min_x < stored->min_x || b.min_y < stored->min_y || b.min_z < stored->min_z
+				|| b.max_x > stored->max_x || b.max_y > stored->max_y || b.max_z > stored->max_z;
+		}
 	}
 
-	matrix_rotate(matrix_model, -45.0F, 0.0F, 1.0F, 0.0F);
+	if(!rebuild)
+		return;
 
-	if(hitbox_intersection(matrix_model, &box_arm_right, ray, &dist)) {
-		intersects->arms = 1;
-		intersects->distance.arms = dist;
+	broadphase_clear(&player_broadphase);
+	player_broadphase_reach = 0.0F;
+
+	for(int k = 0; k < PLAYERS_MAX; k++) {
+		if(!player_hittable(players + k))
+			continue;
+
+		AABB b;
+		player_hit_bounds(players + k, &b);
+
+		for(int i = 0; i < 3; i++) {
+			b.min[i] -= PLAYER_BROADPHASE_SLACK;
+			b.max[i] += PLAYER_BROADPHASE_SLACK;
+		}
+
+		broadphase_insert(&player_broadphase, k, &b);
+
+		// hit tests filter by the player position, which can lag behind the physics
+		float reach = (b.max_x - b.min_x) / 2.0F
+			+ sqrt(distance2D(players[k].pos.x, players[k].pos.z, players[k].physics.eye.x, players[k].physics.eye.z));
+		player_broadphase_reach = fmaxf(player_broadphase_reach, reach);
 	}
+}
 
-	matrix_pop(matrix_model);
+// read only, player_update() keeps the broadphase current
+int player_hit_candidates(Ray* ray, float range, int* candidates) {
+	return broadphase_ray(&player_broadphase, ray, range + player_broadphase_reach, candidates);
+}
+
+void player_collision(const struct Player* p, Ray* ray, struct player_intersection* intersects) {
+	player_collision_batch(p, ray, 1, intersects);
+}
+
+void player_collision_batch(const struct Player* p, const Ray* rays, int count, struct player_intersection* intersects) {
+	if(!p->alive || p->team == TEAM_SPECTATOR)
+		return;
+
+	int id = p - players;
+	assert(id >= 0 && id < PLAYERS_MAX);
+
+	player_hitboxes_refresh(p, id);
+
+	float distance[count * PLAYER_HITBOXES];
+	obb_raycast_batch(&player_obbs, id * PLAYER_HITBOXES, PLAYER_HITBOXES, rays, count, distance);
+
+	for(int k = 0; k < count; k++)
+		player_hitbox_results(distance + k * PLAYER_HITBOXES, intersects + k);
 }
 
 void player_render(struct Player* p, int id) {
@@ -905,21 +1041,6 @@ if(settings.toggle_teamname) {
 	matrix_pop(matrix_model);
 }
 
-int player_clipbox(float x, float y, float z) {
-	int sz;
-
-	if(x < 0 || x >= 512 || y < 0 || y >= 512)
-		return 1;
-	else if(z < 0)
-		return 0;
-	sz = (int)z;
-	if(sz == 63)
-		sz = 62;
-	else if(sz >= 64)
-		return 1;
-	return !map_isair((int)x, 63 - sz, (int)y);
-}
-
 void player_reposition(struct Player* p) {
 	p->physics.eye.x = p->pos.x;
 	p->physics.eye.y = p->pos.y;
@@ -973,100 +1094,42 @@ void player_coordsystem_adjust2(struct Player* p) {
 	p->orientation.z = tmp;
 }
 
-void player_boxclipmove(struct Player* p, float fsynctics) {
-	float offset, m, f, nx, ny, nz, z;
-	long climb = 0;
-
-	f = fsynctics * 32.f;
-	nx = f * p->physics.velocity.x + p->pos.x;
-	ny = f * p->physics.velocity.y + p->pos.y;
-
-	if(p->input.keys.crouch) {
-		offset = 0.45f;
-		m = 0.9f;
-	} else {
-		offset = 0.9f;
-		m = 1.35f;
-	}
-
-	nz = p->pos.z + offset;
-
-	if(p->physics.velocity.x < 0)
-		f = -0.45f;
-	else
-		f = 0.45f;
-	z = m;
-	while(z >= -1.36f && !player_clipbox(nx + f, p->pos.y - 0.45f, nz + z)
-		  && !player_clipbox(nx + f, p->pos.y + 0.45f, nz + z))
-		z -= 0.9f;
-	if(z < -1.36f)
-		p->pos.x = nx;
-	else if(!p->input.keys.crouch && p->orientation.z < 0.5f && !p->input.keys.sprint) {
-		z = 0.35f;
-		while(z >= -2.36f && !player_clipbox(nx + f, p->pos.y - 0.45f, nz + z)
-			  && !player_clipbox(nx + f, p->pos.y + 0.45f, nz + z))
-			z -= 0.9f;
-		if(z < -2.36f) {
-			p->pos.x = nx;
-			climb = 1;
-		} else
-			p->physics.velocity.x = 0;
-	} else
-		p->physics.velocity.x = 0;
-
-	if(p->physics.velocity.y < 0)
-		f = -0.45f;
-	else
-		f = 0.45f;
-	z = m;
-	while(z >= -1.36f && !player_clipbox(p->pos.x - 0.45f, ny + f, nz + z)
-		  && !player_clipbox(p->pos.x + 0.45f, ny + f, nz + z))
-		z -= 0.9f;
-	if(z < -1.36f)
-		p->pos.y = ny;
-	else if(!p->input.keys.crouch && p->orientation.z < 0.5f && !p->input.keys.sprint && !climb) {
-		z = 0.35f;
-		while(z >= -2.36f && !player_clipbox(p->pos.x - 0.45f, ny + f, nz + z)
-			  && !player_clipbox(p->pos.x + 0.45f, ny + f, nz + z))
-			z -= 0.9f;
-		if(z < -2.36f) {
-			p->pos.y = ny;
-			climb = 1;
-		} else
-			p->physics.velocity.y = 0;
-	} else if(!climb)
-		p->physics.velocity.y = 0;
-
-	if(climb) {
-		p->physics.velocity.x *= 0.5f;
-		p->physics.velocity.y *= 0.5f;
-		p->physics.lastclimb = window_time();
-		nz--;
-		m = -1.35f;
-	} else {
-		if(p->physics.velocity.z < 0)
-			m = -m;
-		nz += p->physics.velocity.z * fsynctics * 32.f;
-	}
-
-	p->physics.airborne = 1;
-
-	if(player_clipbox(p->pos.x - 0.45f, p->pos.y - 0.45f, nz + m)
-	   || player_clipbox(p->pos.x - 0.45f, p->pos.y + 0.45f, nz + m)
-	   || player_clipbox(p->pos.x + 0.45f, p->pos.y - 0.45f, nz + m)
-	   || player_clipbox(p->pos.x + 0.45f, p->pos.y + 0.45f, nz + m)) {
-		if(p->physics.velocity.z >= 0) {
-			p->physics.wade = p->pos.z > 61;
-			p->physics.airborne = 0;
-		}
-		p->physics.velocity.z = 0;
-	} else
-		p->pos.z = nz - offset;
+static void player_body_load(const struct Player* p, struct movement_body* b) {
+	*b = (struct movement_body) {
+		.pos = {p->pos.x, p->pos.y, p->pos.z},
+		.orientation = {p->orientation.x, p->orientation.y, p->orientation.z},
+		.velocity = {p->physics.velocity.x, p->physics.velocity.y, p->physics.velocity.z},
+		.up = p->input.keys.up,
+		.down = p->input.keys.down,
+		.left = p->input.keys.left,
+		.right = p->input.keys.right,
+		.crouch = p->input.keys.crouch,
+		.sneak = p->input.keys.sneak,
+		.sprint = p->input.keys.sprint,
+		.aiming = p->input.buttons.rmb && p->held_item == TOOL_GUN,
+		.airborne = p->physics.airborne,
+		.wade = p->physics.wade,
+	};
+}
 
-	player_reposition(p);
+static void player_body_store(struct Player* p, const struct movement_body* b) {
+	p->pos.x = b->pos.x;
+	p->pos.y = b->pos.y;
+	p->pos.z = b->pos.z;
+	p->physics.velocity.x = b->velocity.x;
+	p->physics.velocity.y = b->velocity.y;
+	p->physics.velocity.z = b->velocity.z;
+	p->physics.airborne = b->airborne;
+	p->physics.wade = b->wade;
 }
 
 int player_move(struct Player* p, float fsynctics, int id) {
+	struct movement_cache cache;
+	movement_cache_gather(&cache, &map_occupancy, p->pos.x, p->pos.z);
+	return player_move_cached(p, &cache, fsynctics, id);
+}
+
+static int player_move_cached(struct Player* p, const struct movement_cache* cache, float fsynctics, int id) {
 	if(!p->alive) {
 		p->physics.velocity.y -= fsynctics;
 		AABB dead_bb = {0};
@@ -1089,9 +1152,7 @@ int player_move(struct Player* p, float fsynctics, int id) {
 	int local = (id == local_player_id && camera_mode == CAMERAMODE_FPS);
 
 	player_coordsystem_adjust1(p);
-	float f, f2;
 
-	// move player and perform simple physics (gravity, momentum, friction)
 	if(p->physics.jump) {
 		sound_create(local ? SOUND_LOCAL : SOUND_WORLD, p->physics.wade ? &sound_jump_water : &sound_jump, p->pos.x,
 					 63.0F - p->pos.z, p->pos.y);
@@ -1099,67 +1160,22 @@ int player_move(struct Player* p, float fsynctics, int id) {
 		p->physics.velocity.z = -0.36f;
 	}
 
-	f = fsynctics; // player acceleration scalar
-	if(p->physics.airborne)
-		f *= 0.1f;
-	else if(p->input.keys.crouch)
-		f *= 0.3f;
-	else if((p->input.buttons.rmb && p->held_item == TOOL_GUN) || p->input.keys.sneak)
-		f *= 0.5f;
-	else if(p->input.keys.sprint)
-		f *= 1.3f;
-
-	if((p->input.keys.up || p->input.keys.down) && (p->input.keys.left || p->input.keys.right))
-		f *= SQRT; // if strafe + forward/backwards then limit diagonal velocity
-
-	float len = sqrt(pow(p->orientation.x, 2.0F) + pow(p->orientation.y, 2.0F));
-	float sx = -p->orientation.y / len;
-	float sy = p->orientation.x / len;
-
-	if(p->input.keys.up) {
-		p->physics.velocity.x += p->orientation.x * f;
-		p->physics.velocity.y += p->orientation.y * f;
-	} else if(p->input.keys.down) {
-		p->physics.velocity.x -= p->orientation.x * f;
-		p->physics.velocity.y -= p->orientation.y * f;
-	}
-	if(p->input.keys.left) {
-		p->physics.velocity.x -= sx * f;
-		p->physics.velocity.y -= sy * f;
-	} else if(p->input.keys.right) {
-		p->physics.velocity.x += sx * f;
-		p->physics.velocity.y += sy * f;
-	}
+	struct movement_body body;
+	player_body_load(p, &body);
+	int ret = movement_step(&body, cache, fsynctics);
+	player_body_store(p, &body);
+
+	if(body.climbed)
+		p->physics.lastclimb = window_time();
+
+	player_reposition(p);
 
-	f = fsynctics + 1;
-	p->physics.velocity.z += fsynctics;
-	p->physics.velocity.z /= f; // air friction
-	if(p->physics.wade)
-		f = fsynctics * 6.0F + 1; // water friction
-	else if(!p->physics.airborne)
-		f = fsynctics * 4.0F + 1; // ground friction
-	p->physics.velocity.x /= f;
-	p->physics.velocity.y /= f;
-	f2 = p->physics.velocity.z;
-	player_boxclipmove(p, fsynctics);
-	// hit ground... check if hurt
-
-	int ret = 0;
-
-	if(!p->physics.velocity.z && (f2 > FALL_SLOW_DOWN)) {
-		// slow down on landing
-		p->physics.velocity.x *= 0.5F;
-		p->physics.velocity.y *= 0.5F;
-
-		// return fall damage
-		if(f2 > FALL_DAMAGE_VELOCITY) {
-			f2 -= FALL_DAMAGE_VELOCITY;
-			ret = f2 * f2 * FALL_DAMAGE_SCALAR;
+	if(body.landed) {
+		if(ret >= 0) {
 			sound_create(local ? SOUND_LOCAL : SOUND_WORLD, &sound_hurt_fall, p->pos.x, 63.0F - p->pos.z, p->pos.y);
 		} else {
 			sound_create(local ? SOUND_LOCAL : SOUND_WORLD, p->physics.wade ? &sound_land_water : &sound_land, p->pos.x,
 						 63.0F - p->pos.z, p->pos.y);
-			ret = -1;
 		}
 	}
 
@@ -1193,6 +1209,8 @@ int player_move(struct Player* p, float fsynctics, int id) {
 
 int player_uncrouch(struct Player* p) {
 	player_coordsystem_adjust1(p);
+	struct movement_cache cache;
+	movement_cache_gather(&cache, &map_occupancy, p->pos.x, p->pos.y);
 	float x1 = p->pos.x + 0.45F;
 	float x2 = p->pos.x - 0.45F;
 	float y1 = p->pos.y + 0.45F;
@@ -1202,13 +1220,13 @@ int player_uncrouch(struct Player* p) {
 
 	// first check if player can lower feet (in midair)
 	if(p->physics.airborne
-	   && !(player_clipbox(x1, y1, z1) || player_clipbox(x1, y2, z1) || player_clipbox(x2, y1, z1)
-			|| player_clipbox(x2, y2, z1))) {
+	   && !(movement_clipbox(&cache, x1, y1, z1) || movement_clipbox(&cache, x1, y2, z1)
+			|| movement_clipbox(&cache, x2, y1, z1) || movement_clipbox(&cache, x2, y2, z1))) {
 		player_coordsystem_adjust2(p);
 		return 1;
 		// then check if they can raise their head
-	} else if(!(player_clipbox(x1, y1, z2) || player_clipbox(x1, y2, z2) || player_clipbox(x2, y1, z2)
-				|| player_clipbox(x2, y2, z2))) {
+	} else if(!(movement_clipbox(&cache, x1, y1, z2) || movement_clipbox(&cache, x1, y2, z2)
+				|| movement_clipbox(&cache, x2, y1, z2) || movement_clipbox(&cache, x2, y2, z2))) {
 		p->pos.z -= 0.9F;
 		p->physics.eye.z -= 0.9F;
 		if(&players[local_player_id] == p) {
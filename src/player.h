@@ -30,6 +30,18 @@
 #define TEAM_2 1
 #define TEAM_SPECTATOR 255
 
+#define PLAYER_HIT_RADIUS 2.5F
+#define PLAYER_BROADPHASE_SLACK 1.0F
+
+// six boxes, padded to a multiple of the simd width
+#define PLAYER_HITBOXES 8
+#define PLAYER_HITBOX_HEAD 0
+#define PLAYER_HITBOX_TORSO 1
+#define PLAYER_HITBOX_LEG_LEFT 2
+#define PLAYER_HITBOX_LEG_RIGHT 3
+#define PLAYER_HITBOX_ARM_LEFT 4
+#define PLAYER_HITBOX_ARM_RIGHT 5
+
 extern struct GameState {
 	struct Team {
 		char name[11];
@@ -174,6 +186,9 @@ void player_update(float dt, int locked);
 void player_render_all(void);
 void player_render(struct Player* p, int id);
 void player_collision(const struct Player* p, Ray* ray, struct player_intersection* intersects);
+void player_collision_batch(const struct Player* p, const Ray* rays, int count, struct player_intersection* intersects);
+// ascending ids of all players the ray might hit, see camera_hit_mask()
+int player_hit_candidates(Ray* ray, float range, int* candidates);
 void player_reset(struct Player* p);
 int player_move(struct Player* p, float fsynctics, int id);
 int player_uncrouch(struct Player* p);
@@ -0,0 +1,435 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "glx.h"
+#include "batch.h"
+#include "font.h"
+#include "profiler.h"
+
+#define PROFILER_GPU_FRAMES 4 // results are read this many frames after the queries were issued
+#define PROFILER_GPU_SCOPES 8
+
+struct profiler_event {
+	const char* name;
+	uint64_t start, end; // nanoseconds, end stays 0 while the scope is open
+	uint32_t depth;
+};
+
+// only ever written by its own thread, read by profiler_export() from the main thread
+struct profiler_ring {
+	char name[32];
+	struct profiler_event events[PROFILER_EVENTS];
+	uint64_t head;
+	uint64_t first; // events before belong to an earlier thread of another name
+	uint64_t stack[PROFILER_DEPTH];
+	int depth;
+	bool idle; // its thread ended, the next new thread takes it over
+};
+
+static struct profiler_ring* profiler_rings[PROFILER_THREADS];
+static int profiler_ring_count = 0;
+static pthread_mutex_t profiler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t profiler_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profiler_key; // releases the ring of an exiting thread
+static __thread struct profiler_ring* profiler_self = NULL;
+static __thread bool profiler_full = false;
+
+// last complete frame of the main thread
+static struct profiler_ring* profiler_main = NULL;
+static uint64_t profiler_frame_start, profiler_frame_first;
+static uint64_t profiler_last_start, profiler_last_end, profiler_last_first, profiler_last_head;
+
+static bool profiler_gpu_supported = false;
+static bool profiler_gpu_open = false;
+static int profiler_gpu_current = 0;
+static GLuint profiler_gpu_queries[PROFILER_GPU_FRAMES][PROFILER_GPU_SCOPES];
+static struct profiler_event profiler_gpu_issued[PROFILER_GPU_FRAMES][PROFILER_GPU_SCOPES];
+static int profiler_gpu_count[PROFILER_GPU_FRAMES];
+static struct profiler_event profiler_gpu_last[PROFILER_GPU_SCOPES];
+static int profiler_gpu_last_count = 0;
+static struct profiler_ring* profiler_gpu_ring = NULL;
+
+static struct batch profiler_batch;
+
+static uint64_t profiler_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void profiler_ring_release(void* ring) {
+	struct profiler_ring* r = (struct profiler_ring*)ring;
+
+	pthread_mutex_lock(&profiler_lock);
+	r->depth = 0;
+	r->idle = true;
+	pthread_mutex_unlock(&profiler_lock);
+}
+
+static void profiler_key_create() {
+	pthread_key_create(&profiler_key, profiler_ring_release);
+}
+
+// short-lived threads like the serverlist worker come and go, their rings are reused
+static struct profiler_ring* profiler_ring_reuse(const char* name) {
+	int index = -1;
+
+	for(int k = 0; k < profiler_ring_count; k++) {
+		struct profiler_ring* candidate = profiler_rings[k];
+
+		if(candidate->idle && (index < 0 || (name && !strcmp(candidate->name, name))))
+			index = k;
+	}
+
+	if(index < 0)
+		return NULL;
+
+	struct profiler_ring* r = profiler_rings[index];
+
+	// keeps the history of an earlier thread of the same name on one track
+	if(!name || strcmp(r->name, name)) {
+		__atomic_store_n(&r->first, r->head, __ATOMIC_RELEASE);
+
+		if(name) {
+			snprintf(r->name, sizeof(r->name), "%s", name);
+		} else {
+			snprintf(r->name, sizeof(r->name), "thread %i", index);
+		}
+	}
+
+	r->idle = false;
+	return r;
+}
+
+static struct profiler_ring* profiler_ring_create(const char* name) {
+	pthread_mutex_lock(&profiler_lock);
+
+	struct profiler_ring* r = profiler_ring_reuse(name);
+
+	if(!r && profiler_ring_count < PROFILER_THREADS) {
+		r = calloc(1, sizeof(struct profiler_ring));
+		CHECK_ALLOCATION_ERROR(r)
+
+		if(name) {
+			snprintf(r->name, sizeof(r->name), "%s", name);
+		} else {
+			snprintf(r->name, sizeof(r->name), "thread %i", profiler_ring_count);
+		}
+
+		profiler_rings[profiler_ring_count] = r;
+		__atomic_store_n(&profiler_ring_count, profiler_ring_count + 1, __ATOMIC_RELEASE);
+	}
+
+	pthread_mutex_unlock(&profiler_lock);
+
+	return r;
+}
+
+// threads beyond PROFILER_THREADS running at once are not recorded
+static struct profiler_ring* profiler_ring_self(const char* name) {
+	if(!profiler_self && !profiler_full) {
+		pthread_once(&profiler_key_once, profiler_key_create);
+		profiler_self = profiler_ring_create(name);
+		profiler_full = !profiler_self;
+
+		if(profiler_self)
+			pthread_setspecific(profiler_key, profiler_self);
+	}
+
+	return profiler_self;
+}
+
+void profiler_init() {
+	profiler_ring_self("main");
+	profiler_gpu_ring = profiler_ring_create("GPU");
+	batch_create(&profiler_batch, 256);
+
+#ifndef OPENGL_ES
+	profiler_gpu_supported = GLEW_ARB_timer_query;
+
+	if(profiler_gpu_supported)
+		glGenQueries(PROFILER_GPU_FRAMES * PROFILER_GPU_SCOPES, &profiler_gpu_queries[0][0]);
+#endif
+}
+
+void profiler_thread(const char* name) {
+	struct profiler_ring* r = profiler_ring_self(name);
+
+	if(r)
+		snprintf(r->name, sizeof(r->name), "%s", name);
+}
+
+int profiler_begin(const char* name) {
+	struct profiler_ring* r = profiler_ring_self(NULL);
+
+	if(!r)
+		return 0;
+
+	// deeper scopes are only counted, so that profiler_end() stays balanced
+	if(r->depth < PROFILER_DEPTH) {
+		uint64_t index = r->head;
+		r->events[index & (PROFILER_EVENTS - 1)] = (struct profiler_event) {
+			.name = name,
+			.start = profiler_now(),
+			.end = 0,
+			.depth = r->depth,
+		};
+		r->stack[r->depth] = index;
+		__atomic_store_n(&r->head, index + 1, __ATOMIC_RELEASE);
+	}
+
+	return r->depth++;
+}
+
+void profiler_end() {
+	struct profiler_ring* r = profiler_self;
+
+	if(!r || !r->depth)
+		return;
+
+	r->depth--;
+
+	if(r->depth < PROFILER_DEPTH) {
+		uint64_t index = r->stack[r->depth];
+
+		// a scope that outlived a whole ring of nested events was already overwritten
+		if(r->head - index <= PROFILER_EVENTS)
+			__atomic_store_n(&r->events[index & (PROFILER_EVENTS - 1)].end, profiler_now(), __ATOMIC_RELEASE);
+	}
+}
+
+static void profiler_gpu_collect(int frame) {
+#ifndef OPENGL_ES
+	if(!profiler_gpu_supported || !profiler_gpu_count[frame])
+		return;
+
+	profiler_gpu_last_count = profiler_gpu_count[frame];
+
+	for(int k = 0; k < profiler_gpu_count[frame]; k++) {
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(profiler_gpu_queries[frame][k], GL_QUERY_RESULT, &elapsed);
+
+		// shown on its own track, starting where the commands were issued
+		struct profiler_event* e = profiler_gpu_last + k;
+		*e = profiler_gpu_issued[frame][k];
+		e->end = e->start + elapsed;
+
+		if(profiler_gpu_ring) {
+			profiler_gpu_ring->events[profiler_gpu_ring->head & (PROFILER_EVENTS - 1)] = *e;
+			__atomic_store_n(&profiler_gpu_ring->head, profiler_gpu_ring->head + 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	profiler_gpu_count[frame] = 0;
+#endif
+}
+
+void profiler_frame() {
+	struct profiler_ring* r = profiler_ring_self(NULL);
+
+	if(!r)
+		return;
+
+	if(!profiler_main)
+		profiler_main = r;
+
+	uint64_t now = profiler_now();
+
+	if(profiler_frame_start) {
+		profiler_last_start = profiler_frame_start;
+		profiler_last_end = now;
+		profiler_last_first = profiler_frame_first;
+		profiler_last_head = r->head;
+	}
+
+	profiler_frame_start = now;
+	profiler_frame_first = r->head;
+
+	profiler_gpu_current = (profiler_gpu_current + 1) % PROFILER_GPU_FRAMES;
+	profiler_gpu_collect(profiler_gpu_current);
+}
+
+void profiler_gpu_begin(const char* name) {
+#ifndef OPENGL_ES
+	int frame = profiler_gpu_current;
+
+	if(!profiler_gpu_supported || profiler_gpu_open || profiler_gpu_count[frame] >= PROFILER_GPU_SCOPES)
+		return;
+
+	profiler_gpu_issued[frame][profiler_gpu_count[frame]] = (struct profiler_event) {
+		.name = name,
+		.start = profiler_now(),
+	};
+
+	glBeginQuery(GL_TIME_ELAPSED, profiler_gpu_queries[frame][profiler_gpu_count[frame]]);
+	profiler_gpu_open = true;
+#endif
+}
+
+void profiler_gpu_end() {
+#ifndef OPENGL_ES
+	if(!profiler_gpu_open)
+		return;
+
+	glEndQuery(GL_TIME_ELAPSED);
+	profiler_gpu_count[profiler_gpu_current]++;
+	profiler_gpu_open = false;
+#endif
+}
+
+static void profiler_color(struct batch* b, const char* name) {
+	static const uint8_t palette[][3] = {
+		{214, 96, 77}, {244, 165, 130}, {146, 197, 222}, {67, 147, 195}, {153, 213, 148}, {254, 224, 139},
+	};
+
+	uint64_t hash = batch_hash(BATCH_HASH_START, name, strlen(name));
+	const uint8_t* c = palette[hash % (sizeof(palette) / sizeof(*palette))];
+	batch_color(b, c[0], c[1], c[2], 220);
+}
+
+static void profiler_bar(struct batch* b, const struct profiler_event* e, uint64_t origin, float x, float y,
+						 float width, float ns_per_px, float row) {
+	float bar_x = x + (e->start - origin) / ns_per_px;
+	float bar_w = max((e->end - e->start) / ns_per_px, 1.0F);
+
+	if(bar_x >= x + width)
+		return;
+
+	bar_w = min(bar_w, x + width - bar_x);
+
+	profiler_color(b, e->name);
+	font_batch_rect(b, bar_x, y - e->depth * row, bar_w, row - 1.0F);
+
+	char label[64];
+	snprintf(label, sizeof(label), "%s %.2fms", e->name, (e->end - e->start) / 1000000.0F);
+
+	if(font_length(row * 0.8F, label) < bar_w - 4.0F) {
+		batch_color(b, 0, 0, 0, 255);
+		font_batch(b, bar_x + 2.0F, y - e->depth * row - row * 0.1F, row * 0.8F, label);
+	}
+}
+
+static void profiler_build(struct batch* b, float x, float y, float width, float scalef) {
+	float row = 12.0F * scalef;
+	uint64_t length = profiler_last_end - profiler_last_start;
+	// a 60fps frame fills at most the full width, slower frames are squeezed in
+	float ns_per_px = max(length, 16666667ULL) / width;
+	int depth = 1;
+
+	struct profiler_ring* r = profiler_main;
+	uint64_t oldest = profiler_last_head > PROFILER_EVENTS ? profiler_last_head - PROFILER_EVENTS : 0;
+	uint64_t first = max(profiler_last_first, oldest);
+
+	for(uint64_t k = first; k < profiler_last_head; k++)
+		depth = max(depth, (int)r->events[k & (PROFILER_EVENTS - 1)].depth + 1);
+
+	batch_color(b, 0, 0, 0, 160);
+	font_batch_rect(b, x, y, width, row * (depth + 2) + 4.0F);
+
+	char info[64];
+	snprintf(info, sizeof(info), "frame %.2fms", length / 1000000.0F);
+	batch_color(b, 255, 255, 255, 255);
+	font_batch(b, x + 2.0F, y - 2.0F, row * 0.8F, info);
+
+	for(uint64_t k = first; k < profiler_last_head; k++) {
+		struct profiler_event e = r->events[k & (PROFILER_EVENTS - 1)];
+
+		if(e.end && e.end <= profiler_last_end)
+			profiler_bar(b, &e, profiler_last_start, x, y - row - 2.0F, width, ns_per_px, row);
+	}
+
+	// gpu times of an older frame on the last row
+	float gpu_x = x + 2.0F;
+
+	for(int k = 0; k < profiler_gpu_last_count; k++) {
+		struct profiler_event* e = profiler_gpu_last + k;
+		snprintf(info, sizeof(info), "gpu %s %.2fms", e->name, (e->end - e->start) / 1000000.0F);
+		batch_color(b, 255, 255, 255, 255);
+		font_batch(b, gpu_x, y - row * (depth + 1) - 2.0F, row * 0.8F, info);
+		gpu_x += font_length(row * 0.8F, info) + row;
+	}
+}
+
+void profiler_render(float x, float y, float width, float scalef) {
+	if(!profiler_main || !profiler_last_end)
+		return;
+
+	font_select(FONT_SMALLFNT);
+
+	// glyphs placed before the atlas was cleared are gone, see display_ui()
+	for(int attempt = 0; attempt < 2; attempt++) {
+		unsigned int generation = font_generation();
+
+		batch_clear(&profiler_batch);
+		profiler_build(&profiler_batch, x, y, width, scalef);
+
+		if(generation == font_generation())
+			break;
+	}
+
+	batch_draw(&profiler_batch);
+}
+
+bool profiler_export(const char* filename) {
+	FILE* f = fopen(filename, "w");
+
+	if(!f)
+		return false;
+
+	fprintf(f, "{\"traceEvents\":[");
+
+	int count = __atomic_load_n(&profiler_ring_count, __ATOMIC_ACQUIRE);
+	bool first = true;
+
+	for(int t = 0; t < count; t++) {
+		struct profiler_ring* r = profiler_rings[t];
+
+		fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%i,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",", t, r->name);
+		first = false;
+
+		uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		// leave some room to the oldest events, the thread may be overwriting them right now
+		uint64_t start = (head > PROFILER_EVENTS / 2) ? head - PROFILER_EVENTS / 2 : 0;
+		start = max(start, __atomic_load_n(&r->first, __ATOMIC_ACQUIRE));
+
+		for(uint64_t k = start; k < head; k++) {
+			struct profiler_event* e = r->events + (k & (PROFILER_EVENTS - 1));
+			uint64_t end = __atomic_load_n(&e->end, __ATOMIC_ACQUIRE);
+
+			if(end > e->start)
+				fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%i,\"ts\":%.3f,\"dur\":%.3f}", e->name,
+						t, e->start / 1000.0, (end - e->start) / 1000.0);
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+
+	return fclose(f) == 0;
+}
@@ -0,0 +1,75 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// nested CPU scopes per thread and GL_TIME_ELAPSED queries, recorded into per thread rings,
+// shown as bars of the last frame and written as Chrome trace JSON (chrome://tracing, Perfetto)
+// without ENABLE_PROFILER every macro expands to nothing
+
+#ifdef USE_PROFILER
+
+#include <stdbool.h>
+
+#define PROFILER_EVENTS 16384 // per thread, power of two
+#define PROFILER_THREADS 32 // running at once, a ring is handed on once its thread has ended
+#define PROFILER_DEPTH 16
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// ends with the enclosing block, early returns included
+#define PROFILE_SCOPE(name)                                                                                            \
+	int PROFILE_CONCAT(profiler_scope_, __LINE__) __attribute__((cleanup(profiler_scope_end), unused))               \
+		= profiler_begin(name)
+#define PROFILE_THREAD(name) profiler_thread(name)
+#define PROFILE_FRAME() profiler_frame()
+// not nested, GL_TIME_ELAPSED queries can not overlap
+#define PROFILE_GPU_BEGIN(name) profiler_gpu_begin(name)
+#define PROFILE_GPU_END() profiler_gpu_end()
+
+void profiler_init(void);
+void profiler_thread(const char* name);
+int profiler_begin(const char* name);
+void profiler_end(void);
+void profiler_frame(void);
+void profiler_gpu_begin(const char* name);
+void profiler_gpu_end(void);
+// bars of the last complete frame of the thread that calls profiler_frame(), one row per nesting level
+void profiler_render(float x, float y, float width, float scalef);
+// everything still held in the rings, false if the file could not be written
+bool profiler_export(const char* filename);
+
+static inline void profiler_scope_end(int* depth) {
+	profiler_end();
+}
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_THREAD(name)
+#define PROFILE_FRAME()
+#define PROFILE_GPU_BEGIN(name)
+#define PROFILE_GPU_END()
+
+#endif
+
+#endif
@@ -0,0 +1,214 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <assert.h>
+
+#include "raycast.h"
+
+#define RAYCAST_NONE (-1000)
+
+static int raycast_floor(float v) {
+	int i = (int)v;
+	return (v < i) ? i - 1 : i;
+}
+
+// first voxel in [from, to] (walked from -> to) that is solid, or air if solid is false
+static int raycast_scan(uint64_t column, int height, int from, int to, bool solid) {
+	int lo = (from < to) ? from : to;
+	int hi = (from < to) ? to : from;
+
+	// above the map is air, below is handled by the caller
+	int bits_lo = (lo < 0) ? 0 : lo;
+	int bits_hi = (hi >= height) ? height - 1 : hi;
+
+	uint64_t mask = 0;
+	if(bits_lo <= bits_hi) {
+		mask = solid ? column : ~column;
+		mask &= (~(uint64_t)0) << bits_lo;
+		mask &= (~(uint64_t)0) >> (63 - bits_hi);
+	}
+
+	if(from <= to) {
+		if(mask)
+			return __builtin_ctzll(mask);
+		if(!solid && hi >= height)
+			return (lo > height) ? lo : height;
+	} else {
+		if(!solid && hi >= height)
+			return hi;
+		if(mask)
+			return 63 - __builtin_clzll(mask);
+	}
+
+	return RAYCAST_NONE;
+}
+
+bool raycast_voxel(const struct occupancy* occ, const struct raycast_ray* ray, struct raycast_result* r) {
+	assert(occ != NULL && ray != NULL && r != NULL);
+
+	float ox = ray->origin[0], oy = ray->origin[1], oz = ray->origin[2];
+	float dx = ray->direction[0], dy = ray->direction[1], dz = ray->direction[2];
+	float length = ray->length;
+
+	r->hit = false;
+	r->steps = 0;
+
+	int cx = raycast_floor(ox);
+	int cz = raycast_floor(oz);
+	int yc = raycast_floor(oy);
+
+	int sx = (dx > 0.0F) ? 1 : -1;
+	int sy = (dy > 0.0F) ? 1 : -1;
+	int sz = (dz > 0.0F) ? 1 : -1;
+
+	float delta_x = (dx != 0.0F) ? fabsf(1.0F / dx) : INFINITY;
+	float delta_z = (dz != 0.0F) ? fabsf(1.0F / dz) : INFINITY;
+	float next_x = (dx != 0.0F) ? ((cx + (sx > 0)) - ox) / dx : INFINITY;
+	float next_z = (dz != 0.0F) ? ((cz + (sz > 0)) - oz) / dz : INFINITY;
+
+	float t = 0.0F;
+	bool want_air = (ray->mode == RAYCAST_AFTER_AIR);
+	int enter_axis = -1;
+	int tile_x = -1, tile_z = -1;
+
+	while(1) {
+		if(cx < 0 || cz < 0 || cx >= occ->width || cz >= occ->depth || yc < 0)
+			return false;
+
+		// whole tile below the ray? jump to where the ray leaves it
+		int tx = cx >> OCCUPANCY_TILE_SHIFT;
+		int tz = cz >> OCCUPANCY_TILE_SHIFT;
+
+		if(!want_air && (tx != tile_x || tz != tile_z)) {
+			tile_x = tx;
+			tile_z = tz;
+			r->steps++;
+
+			float tile_next_x
+				= (dx != 0.0F) ? (((tx + (sx > 0)) << OCCUPANCY_TILE_SHIFT) - ox) / dx : INFINITY;
+			float tile_next_z
+				= (dz != 0.0F) ? (((tz + (sz > 0)) << OCCUPANCY_TILE_SHIFT) - oz) / dz : INFINITY;
+			float t_exit = fminf(tile_next_x, tile_next_z);
+			float y_low = fminf(oy + dy * t, oy + dy * fminf(t_exit, length));
+
+			if(raycast_floor(y_low) >= occupancy_tile_top(occ, tx, tz)) {
+				if(t_exit >= length)
+					return false;
+
+				t = t_exit;
+
+				if(tile_next_x < tile_next_z) {
+					cx = (sx > 0) ? (tx + 1) << OCCUPANCY_TILE_SHIFT : (tx << OCCUPANCY_TILE_SHIFT) - 1;
+					cz = raycast_floor(oz + dz * t);
+					if(cz < (tz << OCCUPANCY_TILE_SHIFT))
+						cz = tz << OCCUPANCY_TILE_SHIFT;
+					if(cz > (tz << OCCUPANCY_TILE_SHIFT) + OCCUPANCY_TILE_SIZE - 1)
+						cz = (tz << OCCUPANCY_TILE_SHIFT) + OCCUPANCY_TILE_SIZE - 1;
+					enter_axis = 0;
+				} else {
+					cz = (sz > 0) ? (tz + 1) << OCCUPANCY_TILE_SHIFT : (tz << OCCUPANCY_TILE_SHIFT) - 1;
+					cx = raycast_floor(ox + dx * t);
+					if(cx < (tx << OCCUPANCY_TILE_SHIFT))
+						cx = tx << OCCUPANCY_TILE_SHIFT;
+					if(cx > (tx << OCCUPANCY_TILE_SHIFT) + OCCUPANCY_TILE_SIZE - 1)
+						cx = (tx << OCCUPANCY_TILE_SHIFT) + OCCUPANCY_TILE_SIZE - 1;
+					enter_axis = 2;
+				}
+
+				next_x = (dx != 0.0F) ? ((cx + (sx > 0)) - ox) / dx : INFINITY;
+				next_z = (dz != 0.0F) ? ((cz + (sz > 0)) - oz) / dz : INFINITY;
+				yc = raycast_floor(oy + dy * t);
+				continue;
+			}
+		}
+
+		// all voxels of this column the ray passes through
+		r->steps++;
+		float t_out = fminf(fminf(next_x, next_z), length);
+		float y_out = oy + dy * t_out;
+		int yb = raycast_floor(y_out);
+		if(dy > 0.0F && yb > yc && y_out == (float)yb)
+			yb--;
+
+		uint64_t column = occupancy_column(occ, cx, cz);
+		int from = yc;
+
+		while(1) {
+			int y = raycast_scan(column, occ->height, from, yb, !want_air);
+
+			if(y == RAYCAST_NONE)
+				break;
+
+			if(want_air) {
+				want_air = false;
+				if(y == yb)
+					break;
+				from = y + sy;
+				continue;
+			}
+
+			r->hit = true;
+			r->x = cx;
+			r->y = y;
+			r->z = cz;
+
+			if(y != yc) {
+				r->px = cx;
+				r->py = y - sy;
+				r->pz = cz;
+			} else {
+				r->px = cx - ((enter_axis == 0) ? sx : 0);
+				r->py = y;
+				r->pz = cz - ((enter_axis == 2) ? sz : 0);
+			}
+
+			return true;
+		}
+
+		// went through the bottom of the map
+		if(yb < 0)
+			return false;
+
+		if(t_out >= length)
+			return false;
+
+		if(next_x < next_z) {
+			cx += sx;
+			t = next_x;
+			next_x += delta_x;
+			enter_axis = 0;
+		} else {
+			cz += sz;
+			t = next_z;
+			next_z += delta_z;
+			enter_axis = 2;
+		}
+
+		yc = yb;
+	}
+}
+
+void raycast_batch(const struct occupancy* occ, const struct raycast_ray* rays, size_t count,
+				   struct raycast_result* results) {
+	assert(occ != NULL && rays != NULL && results != NULL);
+
+	for(size_t k = 0; k < count; k++)
+		raycast_voxel(occ, rays + k, results + k);
+}
@@ -0,0 +1,54 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "occupancy.h"
+
+// voxel the ray stopped at and the voxel it came from (equal if the ray started inside it)
+struct raycast_result {
+	bool hit;
+	int x, y, z;
+	int px, py, pz;
+	int steps;
+};
+
+enum raycast_mode {
+	RAYCAST_SOLID,
+	RAYCAST_AFTER_AIR, // ignores solid voxels until the ray passed through air, for rays starting inside terrain
+};
+
+struct raycast_ray {
+	float origin[3];
+	float direction[3];
+	float length;
+	enum raycast_mode mode;
+};
+
+// length is in units of the (not necessarily normalized) direction, visits the same voxels as a 3D DDA
+// but scans whole columns at once and leaps over 8x8 column tiles the ray passes above
+bool raycast_voxel(const struct occupancy* occ, const struct raycast_ray* ray, struct raycast_result* result);
+void raycast_batch(const struct occupancy* occ, const struct raycast_ray* rays, size_t count,
+				   struct raycast_result* results);
+
+#endif
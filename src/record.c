@@ -0,0 +1,123 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "record.h"
+
+bool record_create(struct record_writer* w, const char* filename) {
+	assert(w != NULL && filename != NULL);
+
+	w->packets = w->bytes = 0;
+	w->file = fopen(filename, "wb");
+
+	if(!w->file)
+		return false;
+
+	setvbuf(w->file, NULL, _IOFBF, 64 * 1024);
+	return fwrite(RECORD_MAGIC, strlen(RECORD_MAGIC), 1, w->file) == 1;
+}
+
+bool record_write(struct record_writer* w, uint32_t time, int channel, const void* packet, size_t length) {
+	assert(w != NULL && w->file != NULL && packet != NULL);
+
+	struct record_entry entry = {
+		.time = time,
+		.channel = channel,
+		.length = length,
+	};
+
+	if(fwrite(&entry, sizeof(entry), 1, w->file) != 1 || fwrite(packet, 1, length, w->file) != length)
+		return false;
+
+	w->packets++;
+	w->bytes += sizeof(entry) + length;
+	return true;
+}
+
+void record_close(struct record_writer* w) {
+	assert(w != NULL);
+
+	if(w->file)
+		fclose(w->file);
+	w->file = NULL;
+}
+
+bool record_open(struct record_reader* r, const char* filename) {
+	assert(r != NULL && filename != NULL);
+
+	r->data = NULL;
+	r->size = r->offset = 0;
+
+	FILE* f = fopen(filename, "rb");
+
+	if(!f)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	size_t magic = strlen(RECORD_MAGIC);
+	r->data = (size > 0) ? malloc(size) : NULL;
+
+	if(!r->data || fread(r->data, 1, size, f) != (size_t)size || (size_t)size < magic
+	   || memcmp(r->data, RECORD_MAGIC, magic)) {
+		fclose(f);
+		record_free(r);
+		return false;
+	}
+
+	fclose(f);
+	r->size = size;
+	r->offset = magic;
+	return true;
+}
+
+void record_free(struct record_reader* r) {
+	assert(r != NULL);
+
+	free(r->data);
+	r->data = NULL;
+	r->size = r->offset = 0;
+}
+
+bool record_peek(const struct record_reader* r, struct record_entry* entry) {
+	assert(r != NULL && entry != NULL);
+
+	if(r->offset + sizeof(struct record_entry) > r->size)
+		return false;
+
+	memcpy(entry, r->data + r->offset, sizeof(struct record_entry));
+	return entry->length <= r->size - r->offset - sizeof(struct record_entry);
+}
+
+bool record_next(struct record_reader* r, struct record_entry* entry, unsigned char** packet) {
+	assert(r != NULL && entry != NULL && packet != NULL);
+
+	if(!record_peek(r, entry))
+		return false;
+
+	*packet = r->data + r->offset + sizeof(struct record_entry);
+	r->offset += sizeof(struct record_entry) + entry->length;
+	return true;
+}
@@ -0,0 +1,62 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// recorded session: the magic, then every inbound packet prefixed with when and where it arrived
+#define RECORD_MAGIC "BSREC2"
+
+#pragma pack(push, 1)
+struct record_entry {
+	uint32_t time; // milliseconds since the recording started
+	uint8_t channel;
+	uint32_t length; // of the packet that follows, its first byte is the packet id
+};
+#pragma pack(pop)
+
+struct record_writer {
+	FILE* file;
+	size_t packets, bytes;
+};
+
+bool record_create(struct record_writer* w, const char* filename);
+bool record_write(struct record_writer* w, uint32_t time, int channel, const void* packet, size_t length);
+void record_close(struct record_writer* w);
+
+// the whole recording is kept in memory
+struct record_reader {
+	unsigned char* data;
+	size_t size, offset;
+};
+
+bool record_open(struct record_reader* r, const char* filename);
+void record_free(struct record_reader* r);
+// returns false at the end or on a truncated entry, the packet points into the reader and may be modified
+bool record_next(struct record_reader* r, struct record_entry* entry, unsigned char** packet);
+// the entry that record_next() would return next, without consuming it
+bool record_peek(const struct record_reader* r, struct record_entry* entry);
+
+#endif
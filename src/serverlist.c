@@ -0,0 +1,471 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "serverlist.h"
+#include "parson.h"
+#include "http.h"
+#include "log.h"
+#include "profiler.h"
+
+static void serverlist_key(const char* identifier, char* key) {
+	memset(key, 0, sizeof(((struct serverlist_entry*)0)->identifier));
+	strncpy(key, identifier, sizeof(((struct serverlist_entry*)0)->identifier) - 1);
+}
+
+static int serverlist_find(struct serverlist* list, const char* identifier) {
+	char key[sizeof(((struct serverlist_entry*)0)->identifier)];
+	serverlist_key(identifier, key);
+
+	int* idx = ht_lookup(&list->index, key);
+	return idx ? *idx : -1;
+}
+
+static void serverlist_search_key(struct serverlist* list, int idx) {
+	struct serverlist_entry* e = list->entries + idx;
+	snprintf(list->search[idx], SERVERLIST_SEARCH_LENGTH, "%s\n%s\n%s\n%s", e->name, e->identifier, e->map,
+			 e->gamemode);
+}
+
+static bool serverlist_is_lan(const struct serverlist_entry* e) {
+	return !strcmp(e->country, "LAN");
+}
+
+static int serverlist_compare(struct serverlist* list, int a, int b) {
+	struct serverlist_entry* aa = list->entries + a;
+	struct serverlist_entry* bb = list->entries + b;
+	int cmp = 0;
+
+	switch(list->sort) {
+		case SERVERLIST_ORDER_DEFAULT:
+			cmp = serverlist_is_lan(bb) - serverlist_is_lan(aa);
+			if(!cmp)
+				cmp = bb->current - aa->current;
+			if(!cmp)
+				cmp = aa->ping - bb->ping;
+			if(!cmp)
+				cmp = strcmp(aa->name, bb->name);
+			break;
+		case SERVERLIST_ORDER_PLAYERS: cmp = bb->current - aa->current; break;
+		case SERVERLIST_ORDER_NAME: cmp = strcmp(aa->name, bb->name); break;
+		case SERVERLIST_ORDER_MAP: cmp = strcmp(aa->map, bb->map); break;
+		case SERVERLIST_ORDER_MODE: cmp = strcmp(aa->gamemode, bb->gamemode); break;
+		case SERVERLIST_ORDER_PING: cmp = aa->ping - bb->ping; break;
+	}
+
+	return cmp ? cmp : a - b; // total order, so that inserting a single entry finds the same place as qsort
+}
+
+static struct serverlist* serverlist_sorting;
+
+static int serverlist_compare_qsort(const void* a, const void* b) {
+	return serverlist_compare(serverlist_sorting, *(const int*)a, *(const int*)b);
+}
+
+static void serverlist_update_rank(struct serverlist* list, int start, int end) {
+	for(int k = start; k < end; k++)
+		list->rank[list->order[k]] = k;
+}
+
+static void serverlist_update_visible(struct serverlist* list) {
+	list->visible_count = 0;
+
+	for(int k = 0; k < list->count; k++) {
+		if(list->match[list->order[k]])
+			list->visible[list->visible_count++] = list->order[k];
+	}
+}
+
+static bool serverlist_matches(struct serverlist* list, int idx) {
+	return !*list->filter || strstr(list->search[idx], list->filter);
+}
+
+// place of idx in order, which must not contain idx right now
+static int serverlist_insert_position(struct serverlist* list, int idx, int length) {
+	int low = 0;
+	int high = length;
+
+	while(low < high) {
+		int mid = (low + high) / 2;
+		if(serverlist_compare(list, list->order[mid], idx) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+// moves a single entry after its sort key changed
+static void serverlist_reposition(struct serverlist* list, int idx) {
+	int old = list->rank[idx];
+	memmove(list->order + old, list->order + old + 1, (list->count - old - 1) * sizeof(int));
+
+	int pos = serverlist_insert_position(list, idx, list->count - 1);
+	memmove(list->order + pos + 1, list->order + pos, (list->count - 1 - pos) * sizeof(int));
+	list->order[pos] = idx;
+
+	serverlist_update_rank(list, old < pos ? old : pos, (old < pos ? pos : old) + 1);
+}
+
+static void serverlist_reserve(struct serverlist* list, int capacity) {
+	if(capacity <= list->capacity)
+		return;
+
+	list->capacity = capacity;
+	list->entries = realloc(list->entries, capacity * sizeof(*list->entries));
+	list->search = realloc(list->search, capacity * sizeof(*list->search));
+	list->order = realloc(list->order, capacity * sizeof(int));
+	list->rank = realloc(list->rank, capacity * sizeof(int));
+	list->match = realloc(list->match, capacity * sizeof(bool));
+	list->visible = realloc(list->visible, capacity * sizeof(int));
+	assert(list->entries && list->search && list->order && list->rank && list->match && list->visible);
+}
+
+static void serverlist_publish(struct serverlist* list, struct serverlist_entry* entries, int count, time_t fetched) {
+	// pings stay until the new entries are pinged again
+	for(int k = 0; k < count; k++) {
+		int old = serverlist_find(list, entries[k].identifier);
+		if(old >= 0 && entries[k].ping < 0)
+			entries[k].ping = list->entries[old].ping;
+	}
+
+	ht_clear(&list->index);
+	list->count = 0;
+	list->players = 0;
+	list->fetched = fetched;
+	serverlist_reserve(list, count);
+
+	for(int k = 0; k < count; k++) {
+		char key[sizeof(entries[k].identifier)];
+		serverlist_key(entries[k].identifier, key);
+
+		if(ht_contains(&list->index, key))
+			continue;
+
+		int idx = list->count++;
+		list->entries[idx] = entries[k];
+		list->order[idx] = idx;
+		list->players += entries[k].current;
+		serverlist_search_key(list, idx);
+		list->match[idx] = serverlist_matches(list, idx);
+		ht_insert(&list->index, key, &idx);
+	}
+
+	free(entries);
+
+	serverlist_sort(list, list->sort);
+}
+
+static struct serverlist_entry* serverlist_parse(JSON_Array* servers, int* count) {
+	*count = json_array_get_count(servers);
+	struct serverlist_entry* entries = calloc(*count > 0 ? *count : 1, sizeof(struct serverlist_entry));
+	assert(entries);
+
+	for(int k = 0; k < *count; k++) {
+		JSON_Object* s = json_array_get_object(servers, k);
+		struct serverlist_entry* e = entries + k;
+		const char* str;
+
+		e->current = (int)json_object_get_number(s, "players_current");
+		e->max = (int)json_object_get_number(s, "players_max");
+		e->ping = -1;
+
+		if((str = json_object_get_string(s, "name")))
+			strncpy(e->name, str, sizeof(e->name) - 1);
+		if((str = json_object_get_string(s, "map")))
+			strncpy(e->map, str, sizeof(e->map) - 1);
+		if((str = json_object_get_string(s, "game_mode")))
+			strncpy(e->gamemode, str, sizeof(e->gamemode) - 1);
+		if((str = json_object_get_string(s, "identifier")))
+			strncpy(e->identifier, str, sizeof(e->identifier) - 1);
+		if((str = json_object_get_string(s, "country")))
+			strncpy(e->country, str, sizeof(e->country) - 1);
+	}
+
+	return entries;
+}
+
+// takes ownership of servers, written next to the cache first so that a crash never leaves half a file
+static void serverlist_write_cache(const char* cache, JSON_Value* servers, time_t fetched) {
+	JSON_Value* root = json_value_init_object();
+	json_object_set_number(json_value_get_object(root), "fetched", (double)fetched);
+	json_object_set_value(json_value_get_object(root), "servers", servers);
+
+	char tmp[sizeof(((struct serverlist*)0)->cache) + 4];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", cache);
+
+	if(json_serialize_to_file(root, tmp) == JSONSuccess) {
+		remove(cache);
+		if(rename(tmp, cache))
+			log_warn("Could not write %s", cache);
+	}
+
+	json_value_free(root);
+}
+
+static void* serverlist_worker(void* user) {
+	PROFILE_THREAD("serverlist worker");
+
+	struct serverlist* list = (struct serverlist*)user;
+	struct serverlist_entry* entries = NULL;
+	int count = 0;
+	time_t now = time(NULL);
+
+	PROFILE_SCOPE("serverlist_fetch");
+
+	http_t* request = http_get(list->url, NULL);
+
+	if(request) {
+		http_status_t status;
+		while((status = http_process(request)) == HTTP_STATUS_PENDING)
+			usleep(1000);
+
+		if(status == HTTP_STATUS_COMPLETED) {
+			JSON_Value* js = json_parse_string(request->response_data);
+			JSON_Array* servers = json_value_get_array(js);
+
+			if(servers) {
+				entries = serverlist_parse(servers, &count);
+
+				if(*list->cache) {
+					serverlist_write_cache(list->cache, js, now);
+					js = NULL;
+				}
+			}
+
+			json_value_free(js);
+		}
+
+		http_release(request);
+	}
+
+	pthread_mutex_lock(&list->lock);
+	list->result = entries;
+	list->result_count = count;
+	list->result_time = now;
+	list->done = true;
+	pthread_mutex_unlock(&list->lock);
+
+	return NULL;
+}
+
+void serverlist_create(struct serverlist* list) {
+	assert(list != NULL);
+
+	memset(list, 0, sizeof(struct serverlist));
+	ht_setup(&list->index, sizeof(list->entries->identifier), sizeof(int), 64);
+	pthread_mutex_init(&list->lock, NULL);
+	list->sort = SERVERLIST_ORDER_DEFAULT;
+	list->status = SERVERLIST_STATUS_IDLE;
+}
+
+void serverlist_destroy(struct serverlist* list) {
+	assert(list != NULL);
+
+	if(list->fetching)
+		pthread_join(list->thread, NULL);
+
+	free(list->result);
+	free(list->entries);
+	free(list->search);
+	free(list->order);
+	free(list->rank);
+	free(list->match);
+	free(list->visible);
+	ht_destroy(&list->index);
+	pthread_mutex_destroy(&list->lock);
+}
+
+bool serverlist_load(struct serverlist* list, const char* cache) {
+	assert(list != NULL && cache != NULL);
+
+	JSON_Value* js = json_parse_file(cache);
+	JSON_Object* root = json_value_get_object(js);
+	JSON_Array* servers = json_object_get_array(root, "servers");
+
+	if(!servers) {
+		json_value_free(js);
+		return false;
+	}
+
+	int count;
+	struct serverlist_entry* entries = serverlist_parse(servers, &count);
+	serverlist_publish(list, entries, count, (time_t)json_object_get_number(root, "fetched"));
+	json_value_free(js);
+
+	log_info("Loaded %i cached servers, %is old", list->count, serverlist_age(list));
+	return true;
+}
+
+int serverlist_age(struct serverlist* list) {
+	assert(list != NULL);
+
+	return list->fetched ? (int)(time(NULL) - list->fetched) : -1;
+}
+
+bool serverlist_fetch(struct serverlist* list, const char* url, const char* cache) {
+	assert(list != NULL && url != NULL);
+
+	if(list->fetching)
+		return false;
+
+	strncpy(list->url, url, sizeof(list->url) - 1);
+	list->url[sizeof(list->url) - 1] = 0;
+	strncpy(list->cache, cache ? cache : "", sizeof(list->cache) - 1);
+	list->cache[sizeof(list->cache) - 1] = 0;
+	list->done = false;
+
+	if(pthread_create(&list->thread, NULL, serverlist_worker, list)) {
+		list->status = SERVERLIST_STATUS_FAILED;
+		return false;
+	}
+
+	list->fetching = true;
+	list->status = SERVERLIST_STATUS_FETCHING;
+	return true;
+}
+
+bool serverlist_update(struct serverlist* list) {
+	assert(list != NULL);
+
+	if(!list->fetching)
+		return false;
+
+	pthread_mutex_lock(&list->lock);
+	bool done = list->done;
+	pthread_mutex_unlock(&list->lock);
+
+	if(!done)
+		return false;
+
+	pthread_join(list->thread, NULL);
+	list->fetching = false;
+
+	if(!list->result) {
+		list->status = SERVERLIST_STATUS_FAILED;
+		return false;
+	}
+
+	serverlist_publish(list, list->result, list->result_count, list->result_time);
+	list->result = NULL;
+	list->status = SERVERLIST_STATUS_IDLE;
+	return true;
+}
+
+enum serverlist_status serverlist_status(struct serverlist* list) {
+	assert(list != NULL);
+
+	return list->status;
+}
+
+void serverlist_sort(struct serverlist* list, enum serverlist_order order) {
+	assert(list != NULL);
+
+	list->sort = order;
+	serverlist_sorting = list;
+	qsort(list->order, list->count, sizeof(int), serverlist_compare_qsort);
+	serverlist_update_rank(list, 0, list->count);
+	serverlist_update_visible(list);
+}
+
+void serverlist_filter(struct serverlist* list, const char* text) {
+	assert(list != NULL && text != NULL);
+
+	if(!strcmp(list->filter, text))
+		return;
+
+	// whatever contains the new text also contains the old one
+	bool narrower = strstr(text, list->filter) != NULL;
+
+	strncpy(list->filter, text, sizeof(list->filter) - 1);
+	list->filter[sizeof(list->filter) - 1] = 0;
+
+	if(narrower) {
+		int visible = 0;
+		for(int k = 0; k < list->visible_count; k++) {
+			int idx = list->visible[k];
+			list->match[idx] = serverlist_matches(list, idx);
+			if(list->match[idx])
+				list->visible[visible++] = idx;
+		}
+		list->visible_count = visible;
+	} else {
+		for(int k = 0; k < list->count; k++)
+			list->match[k] = serverlist_matches(list, k);
+		serverlist_update_visible(list);
+	}
+}
+
+void serverlist_add(struct serverlist* list, const struct serverlist_entry* e) {
+	assert(list != NULL && e != NULL);
+
+	int idx = serverlist_find(list, e->identifier);
+
+	if(idx >= 0) {
+		list->players += e->current - list->entries[idx].current;
+		list->entries[idx] = *e;
+		serverlist_reposition(list, idx);
+	} else {
+		serverlist_reserve(list, list->count < 16 ? 16 : list->count * 2);
+
+		idx = list->count;
+		list->entries[idx] = *e;
+		list->players += e->current;
+
+		int pos = serverlist_insert_position(list, idx, list->count);
+		memmove(list->order + pos + 1, list->order + pos, (list->count - pos) * sizeof(int));
+		list->order[pos] = idx;
+		list->count++;
+		serverlist_update_rank(list, pos, list->count);
+
+		char key[sizeof(e->identifier)];
+		serverlist_key(e->identifier, key);
+		ht_insert(&list->index, key, &idx);
+	}
+
+	serverlist_search_key(list, idx);
+	list->match[idx] = serverlist_matches(list, idx);
+	serverlist_update_visible(list);
+}
+
+bool serverlist_set_ping(struct serverlist* list, const char* identifier, int ping) {
+	assert(list != NULL && identifier != NULL);
+
+	int idx = serverlist_find(list, identifier);
+
+	if(idx < 0)
+		return false;
+
+	list->entries[idx].ping = ping;
+
+	if(list->sort == SERVERLIST_ORDER_DEFAULT || list->sort == SERVERLIST_ORDER_PING) {
+		serverlist_reposition(list, idx);
+		serverlist_update_visible(list);
+	}
+
+	return true;
+}
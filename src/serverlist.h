@@ -0,0 +1,122 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SERVERLIST_H
+#define SERVERLIST_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "hashtable.h"
+
+#define SERVERLIST_URL "http://services.buildandshoot.com/serverlist.json"
+#define SERVERLIST_CACHE "cache/serverlist.json"
+#define SERVERLIST_CACHE_FRESH 60 // seconds, a younger cache is shown without fetching again
+#define SERVERLIST_SEARCH_LENGTH 128
+
+struct serverlist_entry {
+	int current, max;
+	char name[32];
+	char map[21];
+	char gamemode[8];
+	int ping;
+	char identifier[32];
+	char country[4];
+};
+
+enum serverlist_order {
+	SERVERLIST_ORDER_DEFAULT, // LAN first, then by players, ping and name
+	SERVERLIST_ORDER_PLAYERS,
+	SERVERLIST_ORDER_NAME,
+	SERVERLIST_ORDER_MAP,
+	SERVERLIST_ORDER_MODE,
+	SERVERLIST_ORDER_PING,
+};
+
+enum serverlist_status {
+	SERVERLIST_STATUS_IDLE,
+	SERVERLIST_STATUS_FETCHING,
+	SERVERLIST_STATUS_FAILED,
+};
+
+// entries are never moved once published, the view is a sorted array of indices into them
+// which is only partially rebuilt when the filter gets narrower or a single ping changes
+struct serverlist {
+	struct serverlist_entry* entries;
+	char (*search)[SERVERLIST_SEARCH_LENGTH]; // all searchable fields of an entry, separated by newlines
+	int count, capacity;
+	int players;
+	time_t fetched; // zero if never
+
+	HashTable index; // identifier -> position in entries
+	int* order;		 // all entries, sorted
+	int* rank;		 // position of every entry in order
+	bool* match;	 // entry contains the filter
+	int* visible;	 // the part of order that matches the filter
+	int visible_count;
+	enum serverlist_order sort;
+	char filter[SERVERLIST_SEARCH_LENGTH];
+
+	// background fetch
+	enum serverlist_status status;
+	pthread_t thread;
+	bool fetching;
+	char url[256];
+	char cache[256];
+	pthread_mutex_t lock; // guards the results of the worker below
+	bool done;
+	struct serverlist_entry* result;
+	int result_count;
+	time_t result_time;
+};
+
+void serverlist_create(struct serverlist* list);
+void serverlist_destroy(struct serverlist* list);
+
+// shows the cached list written by the last successful fetch, returns false if there is none
+bool serverlist_load(struct serverlist* list, const char* cache);
+// seconds since the shown list was fetched, -1 if nothing was fetched yet
+int serverlist_age(struct serverlist* list);
+
+// downloads and parses url on a background thread and writes it to cache (may be NULL) on success
+// returns false if a fetch is already running
+bool serverlist_fetch(struct serverlist* list, const char* url, const char* cache);
+// call every frame, returns true if a fetched list replaced the shown one
+bool serverlist_update(struct serverlist* list);
+enum serverlist_status serverlist_status(struct serverlist* list);
+
+void serverlist_sort(struct serverlist* list, enum serverlist_order order);
+// shows entries containing text in any of their fields, a longer text only checks what is visible right now
+void serverlist_filter(struct serverlist* list, const char* text);
+// adds or replaces an entry with the same identifier
+void serverlist_add(struct serverlist* list, const struct serverlist_entry* e);
+// returns false for an unknown identifier
+bool serverlist_set_ping(struct serverlist* list, const char* identifier, int ping);
+
+static inline int serverlist_visible_count(struct serverlist* list) {
+	return list->visible_count;
+}
+
+static inline struct serverlist_entry* serverlist_visible(struct serverlist* list, int k) {
+	return list->entries + list->visible[k];
+}
+
+#endif
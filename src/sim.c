@@ -0,0 +1,549 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <libvxl.h>
+
+#include "sim.h"
+#include "network.h"
+
+void sim_create(struct sim_world* w, int width, int depth, int height, uint32_t seed) {
+	assert(w != NULL);
+
+	memset(w, 0, sizeof(struct sim_world));
+	occupancy_create(&w->map, width, depth, height);
+	particlesys_create(&w->particles, SIM_PARTICLES);
+	rng_seed(&w->rng, seed);
+	sim_search_create(&w->search, width, depth);
+}
+
+void sim_destroy(struct sim_world* w) {
+	assert(w != NULL);
+
+	occupancy_destroy(&w->map);
+	particlesys_destroy(&w->particles);
+	sim_search_destroy(&w->search);
+}
+
+bool sim_load_vxl(struct sim_world* w, const void* data, size_t size) {
+	assert(w != NULL && data != NULL);
+
+	struct occupancy* occ = &w->map;
+	struct libvxl_map map;
+
+	if(!libvxl_create(&map, occ->width, occ->depth, occ->height, data, size))
+		return false;
+
+	for(int z = 0; z < occ->depth; z++) {
+		for(int x = 0; x < occ->width; x++) {
+			uint64_t column = 0;
+
+			for(int y = 0; y < occ->height; y++) {
+				if(libvxl_map_issolid(&map, x, z, occ->height - 1 - y))
+					column |= (uint64_t)1 << y;
+			}
+
+			occupancy_set_column(occ, x, z, column);
+		}
+	}
+
+	libvxl_free(&map);
+	occupancy_update_tiles(occ);
+
+	return true;
+}
+
+void sim_spawn(struct sim_world* w, int id, float x, float y, float z) {
+	assert(w != NULL && id >= 0 && id < SIM_PLAYERS);
+
+	w->players[id] = (struct sim_player) {
+		.connected = true,
+		.alive = true,
+		.tool = TOOL_GUN,
+		.body = {
+			.pos = {x, y, z},
+			.orientation = {1.0F, 0.0F, 0.0F},
+		},
+	};
+}
+
+void sim_search_create(struct sim_search* s, int width, int depth) {
+	assert(s != NULL && width > 0 && depth > 0);
+
+	s->width = width;
+	s->visited = calloc((size_t)width * depth, sizeof(uint64_t));
+	assert(s->visited != NULL);
+
+	s->capacity = 1024;
+	s->stack = malloc(s->capacity * sizeof(uint32_t));
+	s->voxels = malloc(s->capacity * sizeof(uint32_t));
+	assert(s->stack != NULL && s->voxels != NULL);
+}
+
+void sim_search_destroy(struct sim_search* s) {
+	assert(s != NULL);
+
+	free(s->visited);
+	free(s->stack);
+	free(s->voxels);
+}
+
+static bool sim_visit(struct sim_search* s, int x, int y, int z) {
+	uint64_t* column = s->visited + x + z * s->width;
+
+	if((*column >> y) & 1)
+		return false;
+
+	*column |= (uint64_t)1 << y;
+	return true;
+}
+
+size_t sim_search_floating(struct sim_search* s, const struct occupancy* occ, int x, int y, int z) {
+	static const int directions[][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, -1, 0}};
+
+	assert(s != NULL && occ != NULL && occ->width == s->width);
+
+	if(y <= 1 || x < 0 || z < 0 || x >= occ->width || z >= occ->depth || occupancy_isair(occ, x, y, z))
+		return 0;
+
+	size_t stack = 0, count = 0;
+	bool grounded = false;
+
+	sim_visit(s, x, y, z);
+	s->stack[stack++] = s->voxels[count++] = SIM_KEY(x, y, z);
+
+	// depth first, going down is tried first
+	while(stack > 0 && !grounded) {
+		uint32_t current = s->stack[--stack];
+
+		for(size_t k = 0; k < sizeof(directions) / sizeof(*directions); k++) {
+			int bx = SIM_KEY_X(current) + directions[k][0];
+			int by = SIM_KEY_Y(current) + directions[k][1];
+			int bz = SIM_KEY_Z(current) + directions[k][2];
+
+			if(bx < 0 || by < 0 || bz < 0 || bx >= occ->width || by >= occ->height || bz >= occ->depth
+			   || occupancy_isair(occ, bx, by, bz))
+				continue;
+
+			if(by <= 1) { // indestructible ground layer
+				grounded = true;
+				break;
+			}
+
+			if(!sim_visit(s, bx, by, bz))
+				continue;
+
+			if(count >= s->capacity) {
+				s->capacity *= 2;
+				s->stack = realloc(s->stack, s->capacity * sizeof(uint32_t));
+				s->voxels = realloc(s->voxels, s->capacity * sizeof(uint32_t));
+				assert(s->stack != NULL && s->voxels != NULL);
+			}
+
+			s->stack[stack++] = s->voxels[count++] = SIM_KEY(bx, by, bz);
+		}
+	}
+
+	for(size_t k = 0; k < count; k++)
+		s->visited[SIM_KEY_X(s->voxels[k]) + SIM_KEY_Z(s->voxels[k]) * s->width] = 0;
+
+	return grounded ? 0 : count;
+}
+
+int sim_collapse_candidates(const struct occupancy* occ, int x, int y, int z, int (*candidates)[3]) {
+	assert(occ != NULL && candidates != NULL);
+
+	int neighbours[][3] = {
+		{x + 1, y, z}, {x - 1, y, z}, {x, y, z + 1}, {x, y, z - 1}, {x, y - 1, z}, {x, y + 1, z},
+	};
+	int count = 0;
+
+	for(size_t k = 0; k < sizeof(neighbours) / sizeof(*neighbours); k++) {
+		int* n = neighbours[k];
+
+		// the ground layers below y = 2 never fall
+		if(n[0] < 0 || n[2] < 0 || n[0] >= occ->width || n[2] >= occ->depth || n[1] < 2 || n[1] >= occ->height
+		   || occupancy_isair(occ, n[0], n[1], n[2]))
+			continue;
+
+		memcpy(candidates[count++], n, sizeof(int[3]));
+	}
+
+	return count;
+}
+
+int sim_block_action_edits(int action, int x, int y, int z, int height, struct sim_edit* edits) {
+	assert(edits != NULL);
+
+	// the packet has z pointing down and y, z swapped
+	int top = height - 1 - z;
+	int count = 0;
+
+	switch(action) {
+		case ACTION_BUILD: edits[count++] = (struct sim_edit) {x, top, y, .solid = true}; break;
+		case ACTION_DESTROY:
+			if(top > 0)
+				edits[count++] = (struct sim_edit) {x, top, y, .debris = true};
+			break;
+		case ACTION_SPADE:
+			for(int by = top - 1; by <= top + 1; by++) {
+				if(by > 1)
+					edits[count++] = (struct sim_edit) {x, by, y, .debris = (by == top)};
+			}
+			break;
+		case ACTION_GRENADE:
+			for(int by = top - 1; by <= top + 1; by++)
+				for(int bz = y - 1; bz <= y + 1; bz++)
+					for(int bx = x - 1; bx <= x + 1; bx++)
+						if(by > 1)
+							edits[count++] = (struct sim_edit) {bx, by, bz};
+			break;
+	}
+
+	return count;
+}
+
+int sim_block_line_edits(int sx, int sy, int sz, int ex, int ey, int ez, int height, struct sim_edit* edits) {
+	assert(edits != NULL);
+
+	struct Point cubes[SIM_LINE_LENGTH];
+	int count = sim_cube_line(sx, sy, sz, ex, ey, ez, cubes);
+
+	for(int k = 0; k < count; k++)
+		edits[k] = (struct sim_edit) {cubes[k].x, height - 1 - cubes[k].z, cubes[k].y, .solid = true};
+
+	return count;
+}
+
+// Copyright (c) Mathias Kaerlev 2011-2012 (but might be original code by Ben himself)
+int sim_cube_line(int x1, int y1, int z1, int x2, int y2, int z2, struct Point* cube_array) {
+	struct Point c, d;
+	long ixi, iyi, izi, dx, dy, dz, dxi, dyi, dzi;
+	int count = 0;
+
+	// Note: positions MUST be rounded towards -inf
+	c.x = x1;
+	c.y = y1;
+	c.z = z1;
+
+	d.x = x2 - x1;
+	d.y = y2 - y1;
+	d.z = z2 - z1;
+
+	if(d.x < 0)
+		ixi = -1;
+	else
+		ixi = 1;
+	if(d.y < 0)
+		iyi = -1;
+	else
+		iyi = 1;
+	if(d.z < 0)
+		izi = -1;
+	else
+		izi = 1;
+
+	if((abs(d.x) >= abs(d.y)) && (abs(d.x) >= abs(d.z))) {
+		dxi = 1024;
+		dx = 512;
+		dyi = (long)(!d.y ? 0x3fffffff / 512 : abs(d.x * 1024 / d.y));
+		dy = dyi / 2;
+		dzi = (long)(!d.z ? 0x3fffffff / 512 : abs(d.x * 1024 / d.z));
+		dz = dzi / 2;
+	} else if(abs(d.y) >= abs(d.z)) {
+		dyi = 1024;
+		dy = 512;
+		dxi = (long)(!d.x ? 0x3fffffff / 512 : abs(d.y * 1024 / d.x));
+		dx = dxi / 2;
+		dzi = (long)(!d.z ? 0x3fffffff / 512 : abs(d.y * 1024 / d.z));
+		dz = dzi / 2;
+	} else {
+		dzi = 1024;
+		dz = 512;
+		dxi = (long)(!d.x ? 0x3fffffff / 512 : abs(d.z * 1024 / d.x));
+		dx = dxi / 2;
+		dyi = (long)(!d.y ? 0x3fffffff / 512 : abs(d.z * 1024 / d.y));
+		dy = dyi / 2;
+	}
+	if(ixi >= 0)
+		dx = dxi - dx;
+	if(iyi >= 0)
+		dy = dyi - dy;
+	if(izi >= 0)
+		dz = dzi - dz;
+
+	while(1) {
+		if(cube_array != NULL)
+			cube_array[count] = c;
+
+		if(count++ == SIM_LINE_LENGTH - 1)
+			return count;
+
+		if(c.x == x2 && c.y == y2 && c.z == z2)
+			return count;
+
+		if(dz <= dx && dz <= dy) {
+			c.z += izi;
+			if(c.z < 0 || c.z >= 64)
+				return count;
+			dz += dzi;
+		} else {
+			if(dx < dy) {
+				c.x += ixi;
+				if((unsigned long)c.x >= 512)
+					return count;
+				dx += dxi;
+			} else {
+				c.y += iyi;
+				if((unsigned long)c.y >= 512)
+					return count;
+				dy += dyi;
+			}
+		}
+	}
+}
+
+// removes the structure right away, the client lets it fall first
+static void sim_collapse(struct sim_world* w, int x, int y, int z) {
+	size_t count = sim_search_floating(&w->search, &w->map, x, y, z);
+
+	if(!count)
+		return;
+
+	float pivot[3] = {0, 0, 0};
+
+	for(size_t k = 0; k < count; k++) {
+		uint32_t key = w->search.voxels[k];
+		occupancy_set(&w->map, SIM_KEY_X(key), SIM_KEY_Y(key), SIM_KEY_Z(key), false);
+		pivot[0] += SIM_KEY_X(key);
+		pivot[1] += SIM_KEY_Y(key);
+		pivot[2] += SIM_KEY_Z(key);
+	}
+
+	w->stats.structures_fallen++;
+	w->stats.voxels_fallen += count;
+
+	int amount = (count < 64) ? count : 64;
+	particlesys_burst(&w->particles, &w->rng, 0x7F7F7F, pivot[0] / count + 0.5F, pivot[1] / count + 0.5F,
+					  pivot[2] / count + 0.5F, 2.5F, 1.0F, amount, 0.1F, 0.25F, w->time);
+}
+
+static void sim_destroy_block(struct sim_world* w, int x, int y, int z, bool debris) {
+	if(x < 0 || z < 0 || x >= w->map.width || z >= w->map.depth || occupancy_isair(&w->map, x, y, z))
+		return;
+
+	occupancy_set(&w->map, x, y, z, false);
+	w->stats.blocks_destroyed++;
+
+	int candidates[6][3];
+	int count = sim_collapse_candidates(&w->map, x, y, z, candidates);
+
+	for(int k = 0; k < count; k++)
+		sim_collapse(w, candidates[k][0], candidates[k][1], candidates[k][2]);
+
+	if(debris)
+		particlesys_burst(&w->particles, &w->rng, 0x7F7F7F, x + 0.5F, y + 0.5F, z + 0.5F, 2.5F, 1.0F, 8, 0.1F, 0.25F,
+						  w->time);
+}
+
+static void sim_apply(struct sim_world* w, const struct sim_edit* edits, int count) {
+	for(int k = 0; k < count; k++) {
+		const struct sim_edit* e = edits + k;
+
+		if(!e->solid) {
+			sim_destroy_block(w, e->x, e->y, e->z, e->debris);
+		} else if(e->y < w->map.height && occupancy_isair(&w->map, e->x, e->y, e->z)) {
+			occupancy_set(&w->map, e->x, e->y, e->z, true);
+			w->stats.blocks_built++;
+		}
+	}
+}
+
+void sim_block_action(struct sim_world* w, int action, int x, int y, int z) {
+	assert(w != NULL);
+
+	struct sim_edit edits[SIM_ACTION_EDITS];
+	sim_apply(w, edits, sim_block_action_edits(action, x, y, z, w->map.height, edits));
+}
+
+void sim_block_line(struct sim_world* w, int sx, int sy, int sz, int ex, int ey, int ez) {
+	assert(w != NULL);
+
+	struct sim_edit edits[SIM_LINE_LENGTH];
+	sim_apply(w, edits, sim_block_line_edits(sx, sy, sz, ex, ey, ez, w->map.height, edits));
+}
+
+static void sim_world_update(struct sim_world* w, int id, float x, float y, float z, float ox, float oy, float oz) {
+	if(id < 0 || id >= SIM_PLAYERS || !w->players[id].connected || !w->players[id].alive)
+		return;
+
+	struct movement_body* b = &w->players[id].body;
+	float dx = b->pos.x - x;
+	float dy = b->pos.y - y;
+	float dz = b->pos.z - z;
+
+	// small corrections are ignored, like read_PacketWorldUpdate() does
+	if(dx * dx + dy * dy + dz * dz > 0.1F * 0.1F) {
+		b->pos.x = x;
+		b->pos.y = y;
+		b->pos.z = z;
+	}
+
+	b->orientation.x = ox;
+	b->orientation.y = oy;
+	b->orientation.z = oz;
+}
+
+void sim_packet(struct sim_world* w, const void* data, size_t length) {
+	assert(w != NULL && data != NULL);
+
+	if(length < 1)
+		return;
+
+	const unsigned char* packet = data;
+	const void* payload = packet + 1;
+	size_t size = length - 1;
+
+	w->stats.packets++;
+
+	switch(packet[0]) {
+		case PACKET_CREATEPLAYER_ID:
+			if(size >= sizeof(struct PacketCreatePlayer)) {
+				const struct PacketCreatePlayer* p = payload;
+				sim_spawn(w, p->player_id, p->x, p->y, p->z);
+				w->players[p->player_id].body.orientation.x = (p->team == 0) ? 1.0F : -1.0F;
+				return;
+			}
+			break;
+		case PACKET_PLAYERLEFT_ID:
+			if(size >= sizeof(struct PacketPlayerLeft)) {
+				const struct PacketPlayerLeft* p = payload;
+				w->players[p->player_id].connected = false;
+				w->players[p->player_id].alive = false;
+				return;
+			}
+			break;
+		case PACKET_KILLACTION_ID:
+			if(size >= sizeof(struct PacketKillAction)) {
+				const struct PacketKillAction* p = payload;
+				w->players[p->player_id].alive = false;
+				return;
+			}
+			break;
+		case PACKET_INPUTDATA_ID:
+			if(size >= sizeof(struct PacketInputData)) {
+				const struct PacketInputData* p = payload;
+				struct sim_player* player = w->players + p->player_id;
+				player->body.up = p->keys & 1;
+				player->body.down = p->keys & 2;
+				player->body.left = p->keys & 4;
+				player->body.right = p->keys & 8;
+				player->jump = p->keys & 16;
+				player->body.crouch = p->keys & 32;
+				player->body.sneak = p->keys & 64;
+				player->body.sprint = p->keys & 128;
+				return;
+			}
+			break;
+		case PACKET_WEAPONINPUT_ID:
+			if(size >= sizeof(struct PacketWeaponInput)) {
+				const struct PacketWeaponInput* p = payload;
+				w->players[p->player_id].secondary = p->secondary;
+				w->players[p->player_id].body.aiming = p->secondary && w->players[p->player_id].tool == TOOL_GUN;
+				return;
+			}
+			break;
+		case PACKET_SETTOOL_ID:
+			if(size >= sizeof(struct PacketSetTool)) {
+				const struct PacketSetTool* p = payload;
+				w->players[p->player_id].tool = p->tool;
+				w->players[p->player_id].body.aiming = w->players[p->player_id].secondary && p->tool == TOOL_GUN;
+				return;
+			}
+			break;
+		case PACKET_WORLDUPDATE_ID:
+			if(size > 0 && size % sizeof(struct PacketWorldUpdate075) == 0) {
+				for(size_t k = 0; k < size / sizeof(struct PacketWorldUpdate075); k++) {
+					const struct PacketWorldUpdate075* p = (const struct PacketWorldUpdate075*)payload + k;
+					sim_world_update(w, k, p->x, p->y, p->z, p->ox, p->oy, p->oz);
+				}
+				return;
+			} else if(size > 0 && size % sizeof(struct PacketWorldUpdate076) == 0) {
+				for(size_t k = 0; k < size / sizeof(struct PacketWorldUpdate076); k++) {
+					const struct PacketWorldUpdate076* p = (const struct PacketWorldUpdate076*)payload + k;
+					sim_world_update(w, p->player_id, p->x, p->y, p->z, p->ox, p->oy, p->oz);
+				}
+				return;
+			}
+			break;
+		case PACKET_BLOCKACTION_ID:
+			if(size >= sizeof(struct PacketBlockAction)) {
+				const struct PacketBlockAction* p = payload;
+				sim_block_action(w, p->action_type, p->x, p->y, p->z);
+				return;
+			}
+			break;
+		case PACKET_BLOCKLINE_ID:
+			if(size >= sizeof(struct PacketBlockLine)) {
+				const struct PacketBlockLine* p = payload;
+				sim_block_line(w, p->sx, p->sy, p->sz, p->ex, p->ey, p->ez);
+				return;
+			}
+			break;
+	}
+
+	w->stats.packets_ignored++;
+}
+
+void sim_step(struct sim_world* w, float dt) {
+	assert(w != NULL);
+
+	for(int k = 0; k < SIM_PLAYERS; k++) {
+		struct sim_player* p = w->players + k;
+		if(p->connected && p->alive)
+			movement_cache_gather(w->caches + k, &w->map, p->body.pos.x, p->body.pos.y);
+	}
+
+	for(int k = 0; k < SIM_PLAYERS; k++) {
+		struct sim_player* p = w->players + k;
+
+		if(!p->connected || !p->alive)
+			continue;
+
+		if(p->jump) {
+			p->jump = false;
+			p->body.velocity.z = -0.36F;
+		}
+
+		int damage = movement_step(&p->body, w->caches + k, dt);
+
+		w->stats.landings += p->body.landed;
+		w->stats.climbs += p->body.climbed;
+		if(damage > 0)
+			w->stats.fall_damage += damage;
+	}
+
+	particlesys_update(&w->particles, &w->map, dt, w->time);
+
+	w->time += dt;
+	w->stats.ticks++;
+}
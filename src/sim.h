@@ -0,0 +1,117 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "occupancy.h"
+#include "movement.h"
+#include "particlesystem.h"
+#include "utils.h"
+
+#define SIM_PLAYERS 256
+#define SIM_TICK_RATE 60
+#define SIM_PARTICLES 8192
+#define SIM_ACTION_EDITS 27
+#define SIM_LINE_LENGTH 64
+
+#define SIM_KEY(x, y, z) (((uint32_t)(z) << 20) | ((uint32_t)(x) << 8) | (uint32_t)(y))
+#define SIM_KEY_X(key) (((key) >> 8) & 0xFFF)
+#define SIM_KEY_Y(key) ((key)&0xFF)
+#define SIM_KEY_Z(key) (((key) >> 20) & 0xFFF)
+
+// the rules below are shared with the client, which applies them to its own map
+
+struct Point {
+	int x, y, z;
+};
+
+// one voxel changed by a block action, in client coordinates (y is up)
+struct sim_edit {
+	int x, y, z;
+	bool solid;	 // placed, otherwise removed
+	bool debris; // removal throws out particles
+};
+
+// scratch memory of the falling block search, a thread needs its own
+struct sim_search {
+	int width;
+	uint64_t* visited;
+	uint32_t* stack;
+	uint32_t* voxels;
+	size_t capacity;
+};
+
+void sim_search_create(struct sim_search* s, int width, int depth);
+void sim_search_destroy(struct sim_search* s);
+// voxels connected to x, y, z end up in s->voxels as SIM_KEY(), zero if any of them rests on the ground layer
+size_t sim_search_floating(struct sim_search* s, const struct occupancy* occ, int x, int y, int z);
+// solid neighbours that might have lost their support once x, y, z was removed, returns the count (at most 6)
+int sim_collapse_candidates(const struct occupancy* occ, int x, int y, int z, int (*candidates)[3]);
+// coordinates as in PacketBlockAction, returns the count (at most SIM_ACTION_EDITS)
+int sim_block_action_edits(int action, int x, int y, int z, int height, struct sim_edit* edits);
+// coordinates as in PacketBlockLine, returns the count (at most SIM_LINE_LENGTH)
+int sim_block_line_edits(int sx, int sy, int sz, int ex, int ey, int ez, int height, struct sim_edit* edits);
+// voxlap coordinates, cube_array may be NULL, returns the count (at most SIM_LINE_LENGTH)
+int sim_cube_line(int x1, int y1, int z1, int x2, int y2, int z2, struct Point* cube_array);
+
+// headless copy of the game state, everything here is in voxlap coordinates (z is down)
+// except for the occupancy grid and particles, which use the client's (y is up)
+struct sim_player {
+	bool connected, alive;
+	bool jump;
+	unsigned char tool;
+	bool secondary;
+	struct movement_body body;
+};
+
+struct sim_stats {
+	unsigned long ticks;
+	unsigned long packets, packets_ignored;
+	unsigned long landings, climbs, fall_damage;
+	unsigned long blocks_built, blocks_destroyed;
+	unsigned long structures_fallen, voxels_fallen;
+};
+
+struct sim_world {
+	struct occupancy map;
+	struct sim_player players[SIM_PLAYERS];
+	struct movement_cache caches[SIM_PLAYERS];
+	struct particle_system particles;
+	struct rng rng;
+	float time;
+	struct sim_stats stats;
+	struct sim_search search;
+};
+
+void sim_create(struct sim_world* w, int width, int depth, int height, uint32_t seed);
+void sim_destroy(struct sim_world* w);
+bool sim_load_vxl(struct sim_world* w, const void* data, size_t size);
+void sim_spawn(struct sim_world* w, int id, float x, float y, float z);
+void sim_block_action(struct sim_world* w, int action, int x, int y, int z);
+void sim_block_line(struct sim_world* w, int sx, int sy, int sz, int ex, int ey, int ez);
+// handles one packet as received from the server, first byte is the packet id
+void sim_packet(struct sim_world* w, const void* data, size_t length);
+void sim_step(struct sim_world* w, float dt);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <string.h>
+
+// GCC/Clang vector extensions, lowered to SSE on x86 and NEON on ARM
+typedef float v4f __attribute__((vector_size(16)));
+typedef int32_t v4i __attribute__((vector_size(16)));
+
+#define LANES 4
+
+static inline v4f v4f_load(const float* src) {
+	v4f v;
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+static inline void v4f_store(float* dst, v4f v) {
+	memcpy(dst, &v, sizeof(v));
+}
+
+static inline v4i v4i_load(const uint32_t* src) {
+	v4i v;
+	memcpy(&v, src, sizeof(v));
+	return v;
+}
+
+static inline void v4i_store(uint32_t* dst, v4i v) {
+	memcpy(dst, &v, sizeof(v));
+}
+
+static inline v4f v4f_select(v4i mask, v4f a, v4f b) {
+	return (v4f)(((v4i)a & mask) | ((v4i)b & ~mask));
+}
+
+static inline v4f v4f_splat(float s) {
+	return (v4f) {s, s, s, s};
+}
+
+static inline v4f v4f_min(v4f a, v4f b) {
+	return v4f_select(a < b, a, b);
+}
+
+static inline v4f v4f_max(v4f a, v4f b) {
+	return v4f_select(a > b, a, b);
+}
+
+#endif
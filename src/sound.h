@@ -31,8 +31,11 @@
 #endif
 
 #include "player.h"
+#include "voicepool.h"
 
 #define SOUND_SCALE 0.6F
+#define SOUND_VOICES 64
+#define SOUND_POLLS_PER_FRAME 8
 
 enum sound_space {
 	SOUND_WORLD,
@@ -44,6 +47,7 @@ extern int sound_enabled;
 struct Sound_wav {
 	int openal_buffer;
 	float min, max;
+	enum voice_category category;
 };
 
 extern struct Sound_wav sound_footstep1;
@@ -104,7 +108,7 @@ void sound_volume(float vol);
 void sound_create_sticky(struct Sound_wav* w, struct Player* player, int player_id);
 void sound_create(enum sound_space option, struct Sound_wav* w, float x, float y, float z);
 void sound_update(void);
-void sound_load(struct Sound_wav* wav, char* name, float min, float max);
+void sound_load(struct Sound_wav* wav, char* name, float min, float max, enum voice_category category);
 void sound_init(void);
 
 #endif
@@ -0,0 +1,186 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "common.h"
+#include "camera.h"
+#include "config.h"
+#include "matrix.h"
+#include "map.h"
+#include "glx.h"
+#include "sprite.h"
+
+static struct glx_stream sprite_stream;
+static bool sprite_stream_created = false;
+static int sprite_program = -1;
+
+void sprite_batch_create(struct sprite_batch* b, size_t capacity) {
+	b->count = 0;
+	b->capacity = max(capacity, 64);
+	b->max_size = 0.0F;
+	b->sprites = malloc(b->capacity * sizeof(struct sprite));
+	CHECK_ALLOCATION_ERROR(b->sprites)
+	b->sorted = malloc(b->capacity * sizeof(struct sprite));
+	CHECK_ALLOCATION_ERROR(b->sorted)
+}
+
+void sprite_batch_destroy(struct sprite_batch* b) {
+	free(b->sprites);
+	free(b->sorted);
+	b->sprites = NULL;
+	b->sorted = NULL;
+}
+
+void sprite_batch_clear(struct sprite_batch* b) {
+	b->count = 0;
+	b->max_size = 0.0F;
+}
+
+void sprite_batch_add(struct sprite_batch* b, float x, float y, float z, float size, uint32_t color) {
+	if(b->count >= b->capacity) {
+		b->capacity *= 2;
+		b->sprites = realloc(b->sprites, b->capacity * sizeof(struct sprite));
+		CHECK_ALLOCATION_ERROR(b->sprites)
+		b->sorted = realloc(b->sorted, b->capacity * sizeof(struct sprite));
+		CHECK_ALLOCATION_ERROR(b->sorted)
+	}
+
+	b->sprites[b->count++] = (struct sprite) {
+		.x = x,
+		.y = y,
+		.z = z,
+		.size = size,
+		.color = color,
+	};
+
+	if(size > b->max_size)
+		b->max_size = size;
+}
+
+static int sprite_size_step(struct sprite_batch* b, float size) {
+	int step = size / b->max_size * SPRITE_SIZE_STEPS;
+	return min(step, SPRITE_SIZE_STEPS - 1);
+}
+
+// fixed function points share one size per draw call, so group sprites by size (counting sort)
+static void sprite_batch_sort(struct sprite_batch* b, size_t* start) {
+	memset(start, 0, sizeof(size_t) * (SPRITE_SIZE_STEPS + 1));
+
+	for(size_t k = 0; k < b->count; k++)
+		start[sprite_size_step(b, b->sprites[k].size) + 1]++;
+
+	for(int k = 0; k < SPRITE_SIZE_STEPS; k++)
+		start[k + 1] += start[k];
+
+	size_t next[SPRITE_SIZE_STEPS];
+	memcpy(next, start, sizeof(next));
+
+	for(size_t k = 0; k < b->count; k++)
+		b->sorted[next[sprite_size_step(b, b->sprites[k].size)]++] = b->sprites[k];
+}
+
+void sprite_batch_draw(struct sprite_batch* b) {
+	if(!b->count)
+		return;
+
+	if(!sprite_stream_created) {
+		glx_stream_create(&sprite_stream, GLX_STREAM_REGIONS * b->capacity * sizeof(struct sprite));
+		sprite_stream_created = true;
+	}
+
+	// same projected size as voxlap style kv6 models
+	float near_plane_height
+		= (float)settings.window_height / (2.0F * tan(glm_persp_fovy(matrix_projection) / 2.0F));
+	float scale = 1.414F * near_plane_height;
+
+	if(settings.multisamples)
+		glDisable(GL_MULTISAMPLE);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+#ifndef OPENGL_ES
+	if(glx_version) {
+		if(sprite_program < 0) {
+			sprite_program = glx_shader("uniform float scale;\n"
+										"uniform vec3 fog;\n"
+										"uniform vec3 camera;\n"
+										"uniform float dist_factor;\n"
+										"void main(void) {\n"
+										"	vec4 pos = vec4(gl_Vertex.xyz,1.0);\n"
+										"	gl_Position = gl_ModelViewProjectionMatrix*pos;\n"
+										"	float dist = length(pos.xz-camera.xz)*dist_factor;\n"
+										"	gl_FrontColor = mix(gl_Color,vec4(fog,1.0),min(dist,1.0));\n"
+										"	gl_PointSize = scale*gl_Vertex.w/gl_Position.w;\n"
+										"}\n",
+										"void main(void) {\n"
+										"	gl_FragColor = gl_Color;\n"
+										"}\n");
+		}
+
+		// size is passed along as w component of the position
+		size_t offset = glx_stream_upload(&sprite_stream, b->sprites, b->count * sizeof(struct sprite));
+		glVertexPointer(4, GL_FLOAT, sizeof(struct sprite), (const void*)(offset + offsetof(struct sprite, x)));
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(struct sprite),
+					   (const void*)(offset + offsetof(struct sprite, color)));
+
+		glEnable(GL_PROGRAM_POINT_SIZE);
+		glUseProgram(sprite_program);
+		glUniform1f(glGetUniformLocation(sprite_program, "dist_factor"),
+					glx_fog ? 1.0F / settings.render_distance : 0.0F);
+		glUniform1f(glGetUniformLocation(sprite_program, "scale"), scale);
+		glUniform3f(glGetUniformLocation(sprite_program, "fog"), fog_color[0], fog_color[1], fog_color[2]);
+		glUniform3f(glGetUniformLocation(sprite_program, "camera"), camera_x, camera_y, camera_z);
+
+		glDrawArrays(GL_POINTS, 0, b->count);
+
+		glUseProgram(0);
+		glDisable(GL_PROGRAM_POINT_SIZE);
+	} else
+#endif
+	{
+		size_t start[SPRITE_SIZE_STEPS + 1];
+		sprite_batch_sort(b, start);
+
+		size_t offset = glx_stream_upload(&sprite_stream, b->sorted, b->count * sizeof(struct sprite));
+		glVertexPointer(3, GL_FLOAT, sizeof(struct sprite), (const void*)(offset + offsetof(struct sprite, x)));
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(struct sprite),
+					   (const void*)(offset + offsetof(struct sprite, color)));
+
+		glPointParameterfv(GL_POINT_DISTANCE_ATTENUATION, (float[]) {0.0F, 0.0F, 1.0F});
+
+		for(int k = 0; k < SPRITE_SIZE_STEPS; k++) {
+			if(start[k + 1] > start[k]) {
+				glPointSize(scale * b->max_size * (k + 1) / SPRITE_SIZE_STEPS);
+				glDrawArrays(GL_POINTS, start[k], start[k + 1] - start[k]);
+			}
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	if(settings.multisamples)
+		glEnable(GL_MULTISAMPLE);
+}
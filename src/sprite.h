@@ -0,0 +1,52 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "glx.h"
+
+#define SPRITE_SIZE_STEPS 32
+
+// one cube shaped particle, drawn as a single distance-scaled point
+struct sprite {
+	float x, y, z;
+	float size;
+	uint32_t color;
+};
+
+struct sprite_batch {
+	struct sprite* sprites;
+	struct sprite* sorted;
+	size_t count;
+	size_t capacity;
+	float max_size;
+};
+
+void sprite_batch_create(struct sprite_batch* b, size_t capacity);
+void sprite_batch_destroy(struct sprite_batch* b);
+void sprite_batch_clear(struct sprite_batch* b);
+void sprite_batch_add(struct sprite_batch* b, float x, float y, float z, float size, uint32_t color);
+// uploads all sprites in one go and draws them with world space positions
+void sprite_batch_draw(struct sprite_batch* b);
+
+#endif
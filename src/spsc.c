@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+bool spsc_create(struct spsc_queue* q, size_t object_size, size_t length) {
+	assert(q != NULL && object_size > 0 && length > 0);
+	assert((length & (length - 1)) == 0);
+
+	q->object_size = object_size;
+	q->length = length;
+	q->loc_insert = 0;
+	q->loc_remove = 0;
+	q->queue = malloc(object_size * length);
+
+	return q->queue != NULL;
+}
+
+void spsc_destroy(struct spsc_queue* q) {
+	assert(q != NULL);
+
+	free(q->queue);
+	q->queue = NULL;
+}
+
+bool spsc_push(struct spsc_queue* q, const void* object) {
+	assert(q != NULL && object != NULL);
+
+	size_t insert = q->loc_insert;
+
+	if(insert - __atomic_load_n(&q->loc_remove, __ATOMIC_ACQUIRE) >= q->length)
+		return false;
+
+	memcpy((uint8_t*)q->queue + (insert & (q->length - 1)) * q->object_size, object, q->object_size);
+	__atomic_store_n(&q->loc_insert, insert + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+bool spsc_pop(struct spsc_queue* q, void* object) {
+	assert(q != NULL && object != NULL);
+
+	size_t remove = q->loc_remove;
+
+	if(remove == __atomic_load_n(&q->loc_insert, __ATOMIC_ACQUIRE))
+		return false;
+
+	memcpy(object, (uint8_t*)q->queue + (remove & (q->length - 1)) * q->object_size, q->object_size);
+	__atomic_store_n(&q->loc_remove, remove + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+size_t spsc_size(struct spsc_queue* q) {
+	assert(q != NULL);
+
+	size_t remove = __atomic_load_n(&q->loc_remove, __ATOMIC_ACQUIRE);
+	size_t insert = __atomic_load_n(&q->loc_insert, __ATOMIC_ACQUIRE);
+
+	return insert - remove;
+}
@@ -0,0 +1,54 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SPSC_CACHE_LINE 64
+
+// bounded ring buffer for exactly one producer and one consumer thread, never blocks
+// both indices only ever grow, their difference is the number of queued objects
+struct spsc_queue {
+	size_t object_size;
+	size_t length; // power of two
+	void* queue;
+	char pad0[SPSC_CACHE_LINE];
+	size_t loc_insert; // written by the producer only
+	char pad1[SPSC_CACHE_LINE];
+	size_t loc_remove; // written by the consumer only
+	char pad2[SPSC_CACHE_LINE];
+};
+
+bool spsc_create(struct spsc_queue* q, size_t object_size, size_t length);
+
+void spsc_destroy(struct spsc_queue* q);
+
+// returns false if the queue is full
+bool spsc_push(struct spsc_queue* q, const void* object);
+
+// returns false if the queue is empty
+bool spsc_pop(struct spsc_queue* q, void* object);
+
+// exact for producer and consumer, a snapshot for anyone else
+size_t spsc_size(struct spsc_queue* q);
+
+#endif
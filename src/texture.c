@@ -24,6 +24,9 @@
 #include "map.h"
 #include "log.h"
 #include "file.h"
+#include "asset.h"
+#include "pack.h"
+#include "batch.h"
 
 #include "lodepng/lodepng.c"
 
@@ -69,6 +72,22 @@ struct texture texture_ui_alert;
 struct texture texture_ui_joystick;
 struct texture texture_ui_knob;
 
+#define TEXTURE_ATLAS_SIZE 1024
+#define TEXTURE_ATLAS_PADDING 2 // edge pixels are repeated this far, so filtering never reaches a neighbour
+#define TEXTURE_ATLAS_IMAGE 256 // larger images keep a texture of their own
+#define TEXTURE_ATLAS_MAX 8
+
+// small images that are only ever drawn through the texture_draw and texture_batch functions
+struct texture_atlas {
+	int texture_id;
+	int filter;
+	int size;
+	int x, y, row_height;
+};
+
+static struct texture_atlas texture_atlases[TEXTURE_ATLAS_MAX];
+static int texture_atlas_count = 0;
+
 static char* texture_flags[251]
 	= {"AD",  "AE", "AF", "AG", "AI", "AL", "AM", "AN", "AO", "AQ", "AR", "AS", "AT", "AU", "AW", "AX", "AZ", "BA",
 	   "BB",  "BD", "BE", "BF", "BG", "BH", "BI", "BJ", "BL", "BM", "BN", "BO", "BR", "BS", "BT", "BV", "BW", "BY",
@@ -120,27 +139,232 @@ void texture_filter(struct texture* t, int filter) {
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-int texture_create(struct texture* t, char* filename) {
-	int sz = file_size(filename);
-	void* data = file_load(filename);
-	int error = lodepng_decode32(&t->pixels, &t->width, &t->height, data, sz);
-	free(data);
+static int texture_pow2(int x) {
+	int p = 1;
+	while(p < x)
+		p += p;
+	return p;
+}
 
-	if(error) {
-		log_warn("Could not load texture (%u): %s", error, lodepng_error_text(error));
-		return 0;
-	}
+static bool texture_npot() {
+	static int supported = -1;
 
-	texture_resize_pow2(t, 0);
+	if(supported < 0)
+		supported = strstr((const char*)glGetString(GL_EXTENSIONS), "ARB_texture_non_power_of_two") != NULL;
+
+	return supported;
+}
+
+// without npot support the image is placed in the corner of a larger texture instead of being resampled,
+// the padding repeats the image so that GL_REPEAT still looks almost right
+static void texture_upload_padded(struct texture* t) {
+	int w = texture_npot() ? t->width : texture_pow2(t->width);
+	int h = texture_npot() ? t->height : texture_pow2(t->height);
+
+	int max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+	if(w > max_size || h > max_size)
+		log_warn("Texture of %i:%i exceeds the size limit of %i", w, h, max_size);
+
+	unsigned int* padded = NULL;
+
+	if(t->pixels && (w != t->width || h != t->height)) {
+		padded = malloc(w * h * sizeof(unsigned int));
+		CHECK_ALLOCATION_ERROR(padded)
+
+		for(int y = 0; y < h; y++)
+			for(int x = 0; x < w; x++)
+				padded[x + y * w] = ((unsigned int*)t->pixels)[(x % t->width) + (y % t->height) * t->width];
+	}
 
-	glGenTextures(1, &t->texture_id);
 	glBindTexture(GL_TEXTURE_2D, t->texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->width, t->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, t->pixels);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, padded ? (void*)padded : t->pixels);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	glBindTexture(GL_TEXTURE_2D, 0);
+
+	free(padded);
+
+	t->u = t->v = 0.0F;
+	t->us = (float)t->width / (float)w;
+	t->vs = (float)t->height / (float)h;
+}
+
+static void texture_upload(struct texture* t) {
+	glGenTextures(1, &t->texture_id);
+	texture_upload_padded(t);
+}
+
+static bool texture_atlas_place(struct texture_atlas* a, int w, int h, int* x, int* y) {
+	if(a->x + w > a->size) { // next row
+		a->x = 0;
+		a->y += a->row_height;
+		a->row_height = 0;
+	}
+
+	if(w > a->size || a->y + h > a->size)
+		return false;
+
+	*x = a->x;
+	*y = a->y;
+	a->x += w;
+	a->row_height = max(a->row_height, h);
+	return true;
+}
+
+static struct texture_atlas* texture_atlas_create(int filter) {
+	if(texture_atlas_count >= TEXTURE_ATLAS_MAX)
+		return NULL;
+
+	struct texture_atlas* a = texture_atlases + texture_atlas_count++;
+
+	int max_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+
+	*a = (struct texture_atlas) {
+		.filter = filter,
+		.size = min(max_size, TEXTURE_ATLAS_SIZE),
+	};
+
+	int gl_filter = (filter == TEXTURE_FILTER_LINEAR) ? GL_LINEAR : GL_NEAREST;
+
+	glGenTextures(1, &a->texture_id);
+	glBindTexture(GL_TEXTURE_2D, a->texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, a->size, a->size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, gl_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	log_info("Texture atlas %i created, %i:%i", texture_atlas_count - 1, a->size, a->size);
+	return a;
+}
+
+static bool texture_atlas_owns(struct texture* t) {
+	for(int k = 0; k < texture_atlas_count; k++) {
+		if(texture_atlases[k].texture_id == t->texture_id)
+			return true;
+	}
+
+	return false;
+}
+
+// returns false if the image must get a texture of its own
+static bool texture_atlas_upload(struct texture* t, int filter) {
+	if(t->width > TEXTURE_ATLAS_IMAGE || t->height > TEXTURE_ATLAS_IMAGE)
+		return false;
+
+	int w = t->width + TEXTURE_ATLAS_PADDING * 2;
+	int h = t->height + TEXTURE_ATLAS_PADDING * 2;
+	int x, y;
+
+	struct texture_atlas* a = NULL;
+
+	for(int k = 0; k < texture_atlas_count && !a; k++) {
+		if(texture_atlases[k].filter == filter && texture_atlas_place(texture_atlases + k, w, h, &x, &y))
+			a = texture_atlases + k;
+	}
+
+	if(!a) {
+		a = texture_atlas_create(filter);
+
+		if(!a || !texture_atlas_place(a, w, h, &x, &y))
+			return false;
+	}
+
+	unsigned int* padded = malloc(w * h * sizeof(unsigned int));
+	CHECK_ALLOCATION_ERROR(padded)
+
+	for(int py = 0; py < h; py++) {
+		int sy = min(max(py - TEXTURE_ATLAS_PADDING, 0), t->height - 1);
+
+		for(int px = 0; px < w; px++) {
+			int sx = min(max(px - TEXTURE_ATLAS_PADDING, 0), t->width - 1);
+			padded[px + py * w] = ((unsigned int*)t->pixels)[sx + sy * t->width];
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, a->texture_id);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RGBA, GL_UNSIGNED_BYTE, padded);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	free(padded);
+
+	t->texture_id = a->texture_id;
+	t->u = (float)(x + TEXTURE_ATLAS_PADDING) / a->size;
+	t->v = (float)(y + TEXTURE_ATLAS_PADDING) / a->size;
+	t->us = (float)t->width / a->size;
+	t->vs = (float)t->height / a->size;
+	return true;
+}
+
+static int texture_decode_png(const char* filename, unsigned char** pixels, unsigned int* width,
+							  unsigned int* height) {
+	int sz = file_size(filename);
+	void* data = file_load(filename);
+	int error = lodepng_decode32(pixels, width, height, data, sz);
+	free(data);
+
+	if(error)
+		log_warn("Could not load texture %s (%u): %s", filename, error, lodepng_error_text(error));
+
+	return !error;
+}
+
+int texture_create(struct texture* t, char* filename) {
+	if(!texture_decode_png(filename, &t->pixels, (unsigned int*)&t->width, (unsigned int*)&t->height))
+		return 0;
+
+	texture_upload(t);
+	return 1;
+}
+
+static void texture_asset_decode(struct asset* a) {
+	const struct pack_entry* e = pack_find(a->filename, PACK_IMAGE);
+
+	if(e) { // copied, textures own their pixels
+		a->data = malloc(e->size);
+		CHECK_ALLOCATION_ERROR(a->data)
+		memcpy(a->data, pack_data(e), e->size);
+		a->info[0] = e->info[0];
+		a->info[1] = e->info[1];
+	} else if(!texture_decode_png(a->filename, (unsigned char**)&a->data, a->info + 0, a->info + 1)) {
+		a->data = NULL;
+	}
+}
+
+static void texture_asset_upload(struct asset* a) {
+	if(!a->data)
+		return;
+
+	struct texture* t = a->target;
+	t->pixels = a->data;
+	t->width = a->info[0];
+	t->height = a->info[1];
+
+	if(a->param[1] && texture_atlas_upload(t, a->param[0]))
+		return;
+
+	texture_upload(t);
+
+	if(a->param[0] != TEXTURE_FILTER_NEAREST)
+		texture_filter(t, a->param[0]);
+}
+
+// decoded in the background, see asset.h
+// with atlas set the image shares a texture with others, then it must not be drawn repeated
+static void texture_load(struct texture* t, char* filename, int filter, bool atlas, enum asset_group group) {
+	asset_load(&(struct asset) {
+		.group = group,
+		.filename = filename,
+		.target = t,
+		.param = {filter, atlas},
+		.decode = texture_asset_decode,
+		.upload = texture_asset_upload,
+	});
 }
 
 int texture_create_buffer(struct texture* t, int width, int height, unsigned char* buff, int new) {
@@ -149,30 +373,25 @@ int texture_create_buffer(struct texture* t, int width, int height, unsigned cha
 	t->width = width;
 	t->height = height;
 	t->pixels = buff;
-	texture_resize_pow2(t, max(width, height));
-
-	glBindTexture(GL_TEXTURE_2D, t->texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->width, t->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, t->pixels);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	texture_upload_padded(t);
 }
 
 void texture_delete(struct texture* t) {
 	if(t->pixels)
 		free(t->pixels);
-	glDeleteTextures(1, &t->texture_id);
+	if(!texture_atlas_owns(t))
+		glDeleteTextures(1, &t->texture_id);
 }
 
-void texture_draw_sector(struct texture* t, float x, float y, float w, float h, float u, float v, float us, float vs) {
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindTexture(GL_TEXTURE_2D, t->texture_id);
+// from coordinates relative to the image to coordinates of the texture that holds it
+static void texture_map(struct texture* t, float* u, float* v, float* us, float* vs) {
+	*u = t->u + *u * t->us;
+	*v = t->v + *v * t->vs;
+	*us *= t->us;
+	*vs *= t->vs;
+}
 
-	float vertices[12] = {x, y, x, y - h, x + w, y - h, x, y, x + w, y - h, x + w, y};
+static void texture_draw_quad(const float* vertices, float u, float v, float us, float vs) {
 	float texcoords[12] = {u, v, u, v + vs, u + us, v + vs, u, v, u + us, v + vs, u + us, v};
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	glEnableClientState(GL_VERTEX_ARRAY);
@@ -181,127 +400,81 @@ void texture_draw_sector(struct texture* t, float x, float y, float w, float h,
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glDisable(GL_BLEND);
-	glDisable(GL_TEXTURE_2D);
+#define texture_emit_rotated(tx, ty, x, y, a) cos(a) * (x)-sin(a) * (y) + (tx), sin(a) * (x) + cos(a) * (y) + (ty)
+
+static void texture_rotated_vertices(float* vertices, float x, float y, float w, float h, float angle) {
+	float rotated[12]
+		= {texture_emit_rotated(x, y, -w / 2, h / 2, angle), texture_emit_rotated(x, y, -w / 2, -h / 2, angle),
+		   texture_emit_rotated(x, y, w / 2, -h / 2, angle), texture_emit_rotated(x, y, -w / 2, h / 2, angle),
+		   texture_emit_rotated(x, y, w / 2, -h / 2, angle), texture_emit_rotated(x, y, w / 2, h / 2, angle)};
+	memcpy(vertices, rotated, sizeof(rotated));
 }
 
-void texture_draw(struct texture* t, float x, float y, float w, float h) {
+static void texture_draw_begin(struct texture* t) {
 	glEnable(GL_TEXTURE_2D);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glBindTexture(GL_TEXTURE_2D, t->texture_id);
-	texture_draw_empty(x, y, w, h);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glDisable(GL_BLEND);
-	glDisable(GL_TEXTURE_2D);
 }
 
-void texture_draw_rotated(struct texture* t, float x, float y, float w, float h, float angle) {
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindTexture(GL_TEXTURE_2D, t->texture_id);
-	texture_draw_empty_rotated(x, y, w, h, angle);
+static void texture_draw_end() {
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glDisable(GL_BLEND);
 	glDisable(GL_TEXTURE_2D);
 }
 
-void texture_draw_empty(float x, float y, float w, float h) {
-	float vertices[12] = {x, y, x, y - h, x + w, y - h, x, y, x + w, y - h, x + w, y};
-	float texcoords[12] = {0.0F, 0.0F, 0.0F, 1.0F, 1.0F, 1.0F, 0.0F, 0.0F, 1.0F, 1.0F, 1.0F, 0.0F};
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glTexCoordPointer(2, GL_FLOAT, 0, texcoords);
-	glVertexPointer(2, GL_FLOAT, 0, vertices);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
+void texture_draw_sector(struct texture* t, float x, float y, float w, float h, float u, float v, float us, float vs) {
+	texture_map(t, &u, &v, &us, &vs);
+	texture_draw_begin(t);
+	texture_draw_quad((float[]) {x, y, x, y - h, x + w, y - h, x, y, x + w, y - h, x + w, y}, u, v, us, vs);
+	texture_draw_end();
 }
 
-#define texture_emit_rotated(tx, ty, x, y, a) cos(a) * (x)-sin(a) * (y) + (tx), sin(a) * (x) + cos(a) * (y) + (ty)
+void texture_draw(struct texture* t, float x, float y, float w, float h) {
+	texture_draw_sector(t, x, y, w, h, 0.0F, 0.0F, 1.0F, 1.0F);
+}
 
-void texture_draw_empty_rotated(float x, float y, float w, float h, float angle) {
-	float vertices[12]
-		= {texture_emit_rotated(x, y, -w / 2, h / 2, angle), texture_emit_rotated(x, y, -w / 2, -h / 2, angle),
-		   texture_emit_rotated(x, y, w / 2, -h / 2, angle), texture_emit_rotated(x, y, -w / 2, h / 2, angle),
-		   texture_emit_rotated(x, y, w / 2, -h / 2, angle), texture_emit_rotated(x, y, w / 2, h / 2, angle)};
-	float texcoords[12] = {0.0F, 0.0F, 0.0F, 1.0F, 1.0F, 1.0F, 0.0F, 0.0F, 1.0F, 1.0F, 1.0F, 0.0F};
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glTexCoordPointer(2, GL_FLOAT, 0, texcoords);
-	glVertexPointer(2, GL_FLOAT, 0, vertices);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
+void texture_draw_rotated(struct texture* t, float x, float y, float w, float h, float angle) {
+	float vertices[12];
+	texture_rotated_vertices(vertices, x, y, w, h, angle);
+	texture_draw_begin(t);
+	texture_draw_quad(vertices, t->u, t->v, t->us, t->vs);
+	texture_draw_end();
 }
 
-void texture_resize_pow2(struct texture* t, int min_size) {
-	if(!t->pixels)
-		return;
-	int max_size = 0;
-	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
-	max_size = max(max_size, min_size);
-
-	int w = 1, h = 1;
-	if(strstr(glGetString(GL_EXTENSIONS), "ARB_texture_non_power_of_two") != NULL) {
-		if(t->width <= max_size && t->height <= max_size)
-			return;
-		w = t->width;
-		h = t->height;
-	} else {
-		while(w < t->width)
-			w += w;
-		while(h < t->height)
-			h += h;
-	}
+void texture_draw_empty(float x, float y, float w, float h) {
+	texture_draw_quad((float[]) {x, y, x, y - h, x + w, y - h, x, y, x + w, y - h, x + w, y}, 0.0F, 0.0F, 1.0F, 1.0F);
+}
 
-	w = min(w, max_size);
-	h = min(h, max_size);
+void texture_draw_empty_rotated(float x, float y, float w, float h, float angle) {
+	float vertices[12];
+	texture_rotated_vertices(vertices, x, y, w, h, angle);
+	texture_draw_quad(vertices, 0.0F, 0.0F, 1.0F, 1.0F);
+}
 
-	if(t->width == w && t->height == h)
-		return;
+void texture_batch(struct batch* b, struct texture* t, float x, float y, float w, float h) {
+	texture_batch_sector(b, t, x, y, w, h, 0.0F, 0.0F, 1.0F, 1.0F);
+}
 
-	log_info("texture original: %i:%i now: %i:%i limit: %i", t->width, t->height, w, h, max_size);
+void texture_batch_sector(struct batch* b, struct texture* t, float x, float y, float w, float h, float u, float v,
+						  float us, float vs) {
+	if(t)
+		texture_map(t, &u, &v, &us, &vs);
 
-	if(!t->pixels)
-		return;
+	batch_texture(b, t ? t->texture_id : 0);
+	batch_rect(b, x, y, w, h, u, v, us, vs);
+}
 
-	unsigned int* pixels_new = malloc(w * h * sizeof(unsigned int));
-	CHECK_ALLOCATION_ERROR(pixels_new)
-	for(int y = 0; y < h; y++) {
-		for(int x = 0; x < w; x++) {
-			float px = (float)x / (float)w * (float)t->width;
-			float py = (float)y / (float)h * (float)t->height;
-			float u = px - (int)px;
-			float v = py - (int)py;
-			unsigned int aa = ((unsigned int*)t->pixels)[(int)px + (int)py * t->width];
-			unsigned int ba = ((unsigned int*)t->pixels)[min((int)px + (int)py * t->width + 1, t->width * t->height)];
-			unsigned int ab
-				= ((unsigned int*)t->pixels)[min((int)px + (int)py * t->width + t->width, t->width * t->height)];
-			unsigned int bb
-				= ((unsigned int*)t->pixels)[min((int)px + (int)py * t->width + 1 + t->width, t->width * t->height)];
-			pixels_new[x + y * w] = 0;
-			pixels_new[x + y * w] |= (int)((1.0F - v) * u * red(ba) + (1.0F - v) * (1.0F - u) * red(aa)
-										   + v * u * red(bb) + v * (1.0F - u) * red(ab));
-			pixels_new[x + y * w] |= (int)((1.0F - v) * u * green(ba) + (1.0F - v) * (1.0F - u) * green(aa)
-										   + v * u * green(bb) + v * (1.0F - u) * green(ab))
-				<< 8;
-			pixels_new[x + y * w] |= (int)((1.0F - v) * u * blue(ba) + (1.0F - v) * (1.0F - u) * blue(aa)
-										   + v * u * blue(bb) + v * (1.0F - u) * blue(ab))
-				<< 16;
-			pixels_new[x + y * w] |= (int)((1.0F - v) * u * alpha(ba) + (1.0F - v) * (1.0F - u) * alpha(aa)
-										   + v * u * alpha(bb) + v * (1.0F - u) * alpha(ab))
-				<< 24;
-		}
+void texture_batch_rotated(struct batch* b, struct texture* t, float x, float y, float w, float h, float angle) {
+	if(t) {
+		batch_texture(b, t->texture_id);
+		batch_rect_rotated(b, x, y, w, h, angle, t->u, t->v, t->us, t->vs);
+	} else {
+		batch_texture(b, 0);
+		batch_rect_rotated(b, x, y, w, h, angle, 0.0F, 0.0F, 1.0F, 1.0F);
 	}
-
-	t->width = w;
-	t->height = h;
-	free(t->pixels);
-	t->pixels = (unsigned char*)pixels_new;
 }
 
 unsigned int texture_block_color(int x, int y) {
@@ -330,49 +503,44 @@ void texture_gradient_fog(unsigned int* gradient) {
 }
 
 void texture_init() {
-	texture_create(&texture_splash, "png/splash.png");
-
-	texture_create(&texture_health, "png/health.png");
-	texture_create(&texture_block, "png/block.png");
-	texture_create(&texture_grenade, "png/grenade.png");
-	texture_create(&texture_ammo_semi, "png/semiammo.png");
-	texture_create(&texture_ammo_smg, "png/smgammo.png");
-	texture_create(&texture_ammo_shotgun, "png/shotgunammo.png");
-
-	texture_create(&texture_zoom_semi, "png/semi.png");
-	texture_create(&texture_zoom_smg, "png/smg.png");
-	texture_create(&texture_zoom_shotgun, "png/shotgun.png");
-
-	texture_create(&texture_white, "png/white.png");
-	texture_create(&texture_target, "png/target.png");
-	texture_create(&texture_indicator, "png/indicator.png");
-
-	texture_create(&texture_player, "png/player.png");
-	texture_create(&texture_medical, "png/medical.png");
-	texture_create(&texture_intel, "png/intel.png");
-	texture_create(&texture_command, "png/command.png");
-	texture_create(&texture_tracer, "png/tracer.png");
-
-	texture_create(&texture_ui_wait, "png/ui/wait.png");
-	texture_filter(&texture_ui_wait, TEXTURE_FILTER_LINEAR);
-	texture_create(&texture_ui_join, "png/ui/join.png");
-	texture_create(&texture_ui_reload, "png/ui/reload.png");
-	texture_create(&texture_ui_bg, "png/ui/bg.png");
-	texture_create(&texture_ui_input, "png/ui/input.png");
-	texture_create(&texture_ui_box_empty, "png/ui/box_empty.png");
-	texture_create(&texture_ui_box_check, "png/ui/box_check.png");
-	texture_create(&texture_ui_collapsed, "png/ui/collapsed.png");
-	texture_create(&texture_ui_expanded, "png/ui/expanded.png");
-	texture_create(&texture_ui_flags, "png/ui/flags.png");
-	texture_filter(&texture_ui_flags, TEXTURE_FILTER_LINEAR);
-	texture_create(&texture_ui_alert, "png/ui/alert.png");
-	texture_filter(&texture_ui_alert, TEXTURE_FILTER_LINEAR);
+	texture_load(&texture_splash, "png/splash.png", TEXTURE_FILTER_NEAREST, false, ASSET_GROUP_GAME);
+
+	texture_load(&texture_health, "png/health.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_block, "png/block.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_grenade, "png/grenade.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_ammo_semi, "png/semiammo.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_ammo_smg, "png/smgammo.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_ammo_shotgun, "png/shotgunammo.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+
+	texture_load(&texture_zoom_semi, "png/semi.png", TEXTURE_FILTER_NEAREST, false, ASSET_GROUP_GAME);
+	texture_load(&texture_zoom_smg, "png/smg.png", TEXTURE_FILTER_NEAREST, false, ASSET_GROUP_GAME);
+	texture_load(&texture_zoom_shotgun, "png/shotgun.png", TEXTURE_FILTER_NEAREST, false, ASSET_GROUP_GAME);
+
+	texture_load(&texture_white, "png/white.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_target, "png/target.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_indicator, "png/indicator.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+
+	texture_load(&texture_player, "png/player.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_medical, "png/medical.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_intel, "png/intel.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_command, "png/command.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+	texture_load(&texture_tracer, "png/tracer.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_GAME);
+
+	texture_load(&texture_ui_wait, "png/ui/wait.png", TEXTURE_FILTER_LINEAR, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_join, "png/ui/join.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_reload, "png/ui/reload.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_bg, "png/ui/bg.png", TEXTURE_FILTER_NEAREST, false, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_input, "png/ui/input.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_box_empty, "png/ui/box_empty.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_box_check, "png/ui/box_check.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_collapsed, "png/ui/collapsed.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_expanded, "png/ui/expanded.png", TEXTURE_FILTER_NEAREST, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_flags, "png/ui/flags.png", TEXTURE_FILTER_LINEAR, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_alert, "png/ui/alert.png", TEXTURE_FILTER_LINEAR, true, ASSET_GROUP_MENU);
 
 #ifdef USE_TOUCH
-	texture_create(&texture_ui_knob, "png/ui/knob.png");
-	texture_filter(&texture_ui_knob, TEXTURE_FILTER_LINEAR);
-	texture_create(&texture_ui_joystick, "png/ui/joystick.png");
-	texture_filter(&texture_ui_joystick, TEXTURE_FILTER_LINEAR);
+	texture_load(&texture_ui_knob, "png/ui/knob.png", TEXTURE_FILTER_LINEAR, true, ASSET_GROUP_MENU);
+	texture_load(&texture_ui_joystick, "png/ui/joystick.png", TEXTURE_FILTER_LINEAR, true, ASSET_GROUP_MENU);
 #endif
 
 	unsigned int pixels[64 * 64];
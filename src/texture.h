@@ -24,6 +24,7 @@ struct texture {
 	int width, height;
 	int texture_id;
 	unsigned char* pixels;
+	float u, v, us, vs; // where the image is inside texture_id, which may be an atlas shared with other images
 };
 
 extern struct texture texture_splash;
@@ -83,7 +84,13 @@ void texture_draw_sector(struct texture* t, float x, float y, float w, float h,
 void texture_draw_empty(float x, float y, float w, float h);
 void texture_draw_empty_rotated(float x, float y, float w, float h, float angle);
 void texture_draw_rotated(struct texture* t, float x, float y, float w, float h, float angle);
-void texture_resize_pow2(struct texture* t, int min_size);
+
+struct batch;
+// same as the texture_draw functions above, but collected into a batch, t may be NULL for untextured quads
+void texture_batch(struct batch* b, struct texture* t, float x, float y, float w, float h);
+void texture_batch_sector(struct batch* b, struct texture* t, float x, float y, float w, float h, float u, float v,
+						  float us, float vs);
+void texture_batch_rotated(struct batch* b, struct texture* t, float x, float y, float w, float h, float angle);
 unsigned int texture_block_color(int x, int y);
 void texture_gradient_fog(unsigned int* gradient);
 
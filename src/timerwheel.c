@@ -0,0 +1,151 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "timerwheel.h"
+
+void timerwheel_create(struct timerwheel* tw, float resolution, uint32_t buckets, size_t capacity) {
+	assert(tw != NULL && resolution > 0.0F && buckets > 0 && (buckets & (buckets - 1)) == 0);
+
+	tw->resolution = resolution;
+	tw->tick = 0;
+	tw->mask = buckets - 1;
+	tw->buckets = malloc(buckets * sizeof(uint32_t));
+	assert(tw->buckets != NULL);
+	tw->entries = NULL;
+	tw->capacity = 0;
+
+	timerwheel_clear(tw);
+	timerwheel_reserve(tw, capacity);
+}
+
+void timerwheel_destroy(struct timerwheel* tw) {
+	assert(tw != NULL);
+
+	free(tw->buckets);
+	free(tw->entries);
+	tw->buckets = NULL;
+	tw->entries = NULL;
+	tw->capacity = 0;
+}
+
+void timerwheel_clear(struct timerwheel* tw) {
+	assert(tw != NULL);
+
+	for(uint32_t k = 0; k <= tw->mask; k++)
+		tw->buckets[k] = TIMERWHEEL_NONE;
+
+	for(size_t k = 0; k < tw->capacity; k++)
+		tw->entries[k].scheduled = false;
+}
+
+void timerwheel_reserve(struct timerwheel* tw, size_t capacity) {
+	assert(tw != NULL && capacity < TIMERWHEEL_NONE);
+
+	if(capacity <= tw->capacity)
+		return;
+
+	tw->entries = realloc(tw->entries, capacity * sizeof(struct timerwheel_entry));
+	assert(tw->entries != NULL);
+	memset(tw->entries + tw->capacity, 0, (capacity - tw->capacity) * sizeof(struct timerwheel_entry));
+	tw->capacity = capacity;
+}
+
+static void timerwheel_unlink(struct timerwheel* tw, uint32_t id) {
+	struct timerwheel_entry* e = tw->entries + id;
+
+	if(e->prev != TIMERWHEEL_NONE) {
+		tw->entries[e->prev].next = e->next;
+	} else {
+		tw->buckets[e->deadline & tw->mask] = e->next;
+	}
+
+	if(e->next != TIMERWHEEL_NONE)
+		tw->entries[e->next].prev = e->prev;
+
+	e->scheduled = false;
+}
+
+void timerwheel_schedule(struct timerwheel* tw, uint32_t id, float time) {
+	assert(tw != NULL && id < tw->capacity);
+
+	struct timerwheel_entry* e = tw->entries + id;
+
+	if(e->scheduled)
+		timerwheel_unlink(tw, id);
+
+	// never schedule into a bucket that was already passed
+	uint64_t deadline = time > 0.0F ? (uint64_t)ceilf(time / tw->resolution) : 0;
+	e->deadline = deadline > tw->tick ? deadline : tw->tick;
+
+	uint32_t* head = tw->buckets + (e->deadline & tw->mask);
+	e->prev = TIMERWHEEL_NONE;
+	e->next = *head;
+	e->scheduled = true;
+
+	if(*head != TIMERWHEEL_NONE)
+		tw->entries[*head].prev = id;
+	*head = id;
+}
+
+void timerwheel_cancel(struct timerwheel* tw, uint32_t id) {
+	assert(tw != NULL);
+
+	if(timerwheel_scheduled(tw, id))
+		timerwheel_unlink(tw, id);
+}
+
+void timerwheel_advance(struct timerwheel* tw, float now, void (*expired)(uint32_t id, void* user), void* user) {
+	assert(tw != NULL && expired != NULL);
+
+	if(now < 0.0F)
+		return;
+
+	uint64_t now_tick = (uint64_t)(now / tw->resolution);
+
+	if(now_tick < tw->tick)
+		return;
+
+	// after a long pause one revolution already visits every bucket
+	uint64_t start = tw->tick;
+	uint64_t end = now_tick - start > tw->mask ? start + tw->mask : now_tick;
+
+	// timers rescheduled from the callback are due on the next call at the earliest
+	tw->tick = now_tick + 1;
+
+	for(uint64_t tick = start; tick <= end; tick++) {
+		uint32_t id = tw->buckets[tick & tw->mask];
+
+		while(id != TIMERWHEEL_NONE) {
+			uint32_t next = tw->entries[id].next;
+
+			if(tw->entries[id].deadline <= now_tick) {
+				timerwheel_unlink(tw, id);
+				expired(id, user);
+			}
+
+			id = next;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TIMERWHEEL_NONE UINT32_MAX
+
+struct timerwheel_entry {
+	uint64_t deadline; // in ticks
+	uint32_t prev, next;
+	bool scheduled;
+};
+
+// hashed timer wheel over dense ids [0, capacity), every bucket is an intrusive doubly linked list,
+// timers further away than one revolution stay in their bucket until a later round reaches them
+struct timerwheel {
+	float resolution;
+	uint64_t tick;
+	uint32_t mask;
+	uint32_t* buckets;
+	struct timerwheel_entry* entries;
+	size_t capacity;
+};
+
+// buckets must be a power of two
+void timerwheel_create(struct timerwheel* tw, float resolution, uint32_t buckets, size_t capacity);
+void timerwheel_destroy(struct timerwheel* tw);
+void timerwheel_clear(struct timerwheel* tw);
+// grows the id range, existing timers are kept
+void timerwheel_reserve(struct timerwheel* tw, size_t capacity);
+// replaces an already scheduled timer of the same id
+void timerwheel_schedule(struct timerwheel* tw, uint32_t id, float time);
+void timerwheel_cancel(struct timerwheel* tw, uint32_t id);
+// calls expired() for every timer due at now, the callback may only cancel or reschedule the id it was given
+void timerwheel_advance(struct timerwheel* tw, float now, void (*expired)(uint32_t id, void* user), void* user);
+
+static inline bool timerwheel_scheduled(const struct timerwheel* tw, uint32_t id) {
+	return id < tw->capacity && tw->entries[id].scheduled;
+}
+
+#endif
@@ -31,8 +31,10 @@
 #include "config.h"
 #include "sound.h"
 #include "entitysystem.h"
+#include "sprite.h"
 
 struct entity_system tracers;
+struct sprite_batch tracer_sprites;
 
 void tracer_pvelocity(float* o, struct Player* p) {
 	o[0] = o[0] * 256.0F / 32.0F + p->physics.velocity.x;
@@ -41,6 +43,7 @@ void tracer_pvelocity(float* o, struct Player* p) {
 }
 
 struct tracer_minimap_info {
+	struct batch* batch;
 	int large;
 	float scalef;
 	float minimap_x;
@@ -53,24 +56,27 @@ static bool tracer_minimap_single(void* obj, void* user) {
 
 	if(info->large) {
 		float ang = -atan2(t->r.direction.z, t->r.direction.x) - HALFPI;
-		texture_draw_rotated(&texture_tracer, info->minimap_x + t->r.origin.x * info->scalef,
-							 info->minimap_y - t->r.origin.z * info->scalef, 15 * info->scalef, 15 * info->scalef, ang);
+		texture_batch_rotated(info->batch, &texture_tracer, info->minimap_x + t->r.origin.x * info->scalef,
+							  info->minimap_y - t->r.origin.z * info->scalef, 15 * info->scalef, 15 * info->scalef,
+							  ang);
 	} else {
 		float tracer_x = t->r.origin.x - info->minimap_x;
 		float tracer_y = t->r.origin.z - info->minimap_y;
 		if(tracer_x > 0.0F && tracer_x < 128.0F && tracer_y > 0.0F && tracer_y < 128.0F) {
 			float ang = -atan2(t->r.direction.z, t->r.direction.x) - HALFPI;
-			texture_draw_rotated(&texture_tracer, settings.window_width - 143 * info->scalef + tracer_x * info->scalef,
-								 (585 - tracer_y) * info->scalef, 15 * info->scalef, 15 * info->scalef, ang);
+			texture_batch_rotated(info->batch, &texture_tracer,
+								  settings.window_width - 143 * info->scalef + tracer_x * info->scalef,
+								  (585 - tracer_y) * info->scalef, 15 * info->scalef, 15 * info->scalef, ang);
 		}
 	}
 
 	return false;
 }
 
-void tracer_minimap(int large, float scalef, float minimap_x, float minimap_y) {
+void tracer_minimap(struct batch* b, int large, float scalef, float minimap_x, float minimap_y) {
 	entitysys_iterate(&tracers,
 					  &(struct tracer_minimap_info) {
+						  .batch = b,
 						  .large = large,
 						  .scalef = scalef,
 						  .minimap_x = minimap_x,
@@ -97,28 +103,42 @@ void tracer_add(int type, float x, float y, float z, float dx, float dy, float d
 	entitysys_add(&tracers, &t);
 }
 
+// tracers are short, emit each of their voxels as a sprite instead of drawing the model one by one
 static bool tracer_render_single(void* obj, void* user) {
 	struct Tracer* t = (struct Tracer*)obj;
-
-	matrix_push(matrix_model);
-	matrix_translate(matrix_model, t->r.origin.x, t->r.origin.y, t->r.origin.z);
-	matrix_pointAt(matrix_model, t->r.direction.x, t->r.direction.y, t->r.direction.z);
-	matrix_rotate(matrix_model, 90.0F, 0.0F, 1.0F, 0.0F);
-	matrix_upload();
-	kv6_render(
-		(struct kv6_t*[]) {
-			&model_semi_tracer,
-			&model_smg_tracer,
-			&model_shotgun_tracer,
-		}[t->type],
-		TEAM_SPECTATOR);
-	matrix_pop(matrix_model);
+	struct sprite_batch* sprites = (struct sprite_batch*)user;
+
+	struct kv6_t* model = (struct kv6_t*[]) {
+		&model_semi_tracer,
+		&model_smg_tracer,
+		&model_shotgun_tracer,
+	}[t->type];
+
+	mat4 m;
+	matrix_identity(m);
+	matrix_translate(m, t->r.origin.x, t->r.origin.y, t->r.origin.z);
+	matrix_pointAt(m, t->r.direction.x, t->r.direction.y, t->r.direction.z);
+	matrix_rotate(m, 90.0F, 0.0F, 1.0F, 0.0F);
+
+	for(int k = 0; k < model->voxel_count; k++) {
+		struct kv6_voxel* v = model->voxels + k;
+		float x = (v->x - model->xpiv + 0.5F) * model->scale;
+		float y = (v->z - model->zpiv + 0.5F) * model->scale;
+		float z = (v->y - model->ypiv + 0.5F) * model->scale;
+
+		sprite_batch_add(sprites, m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0],
+						 m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1],
+						 m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2], model->scale,
+						 rgb2bgr(v->color) | 0xFF000000);
+	}
 
 	return false;
 }
 
 void tracer_render() {
-	entitysys_iterate(&tracers, NULL, tracer_render_single);
+	sprite_batch_clear(&tracer_sprites);
+	entitysys_iterate(&tracers, &tracer_sprites, tracer_render_single);
+	sprite_batch_draw(&tracer_sprites);
 }
 
 static bool tracer_update_single(void* obj, void* user) {
@@ -148,4 +168,5 @@ void tracer_update(float dt) {
 
 void tracer_init() {
 	entitysys_create(&tracers, sizeof(struct Tracer), PLAYERS_MAX);
+	sprite_batch_create(&tracer_sprites, PLAYERS_MAX * 64);
 }
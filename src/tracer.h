@@ -32,7 +32,8 @@ struct Tracer {
 	float created;
 };
 
-void tracer_minimap(int large, float scalef, float minimap_x, float minimap_y);
+struct batch;
+void tracer_minimap(struct batch* b, int large, float scalef, float minimap_x, float minimap_y);
 void tracer_pvelocity(float* o, struct Player* p);
 void tracer_add(int type, float x, float y, float z, float dx, float dy, float dz);
 void tracer_update(float dt);
@@ -18,6 +18,7 @@
 */
 
 #include <assert.h>
+#include <time.h>
 
 #include "utils.h"
 
@@ -123,3 +124,12 @@ bool ht_iterate(HashTable* ht, void* user, bool (*callback)(void* key, void* val
 
 	return false;
 }
+
+struct rng* rng_thread() {
+	static __thread struct rng thread_rng;
+
+	if(!thread_rng.state)
+		rng_seed(&thread_rng, (uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)&thread_rng);
+
+	return &thread_rng;
+}
@@ -32,4 +32,28 @@ size_t int_hash(void* raw_key, size_t key_size);
 void ht_iterate_remove(HashTable* ht, void* user, bool (*callback)(void* key, void* value, void* user));
 bool ht_iterate(HashTable* ht, void* user, bool (*callback)(void* key, void* value, void* user));
 
+// xorshift32, not suitable for anything but visual effects
+struct rng {
+	uint32_t state;
+};
+
+struct rng* rng_thread(void);
+
+static inline void rng_seed(struct rng* r, uint32_t seed) {
+	r->state = seed ? seed : 0x9E3779B9; // zero is a fixed point of xorshift
+}
+
+static inline uint32_t rng_next(struct rng* r) {
+	uint32_t x = r->state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return r->state = x;
+}
+
+// uniform in [0, 1)
+static inline float rng_float(struct rng* r) {
+	return (rng_next(r) >> 8) * (1.0F / 16777216.0F);
+}
+
 #endif
@@ -0,0 +1,253 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#if __APPLE__
+#include <OpenAL/al.h>
+#else
+#include <AL/al.h>
+#endif
+
+#include "voicepool.h"
+
+static const float voicepool_weight[VOICE_CATEGORIES] = {
+	[VOICE_AMBIENT] = 0.5F,
+	[VOICE_EFFECT] = 1.0F,
+	[VOICE_WEAPON] = 2.0F,
+	[VOICE_ALERT] = 8.0F,
+};
+
+void voicepool_create(struct voicepool* vp, size_t capacity) {
+	assert(vp != NULL && capacity > 0);
+
+	vp->voices = calloc(capacity, sizeof(struct voice));
+	assert(vp->voices != NULL);
+	vp->count = 0;
+	vp->poll = 0;
+	vp->swept = false;
+	vp->listener[0] = vp->listener[1] = vp->listener[2] = 0.0F;
+	vp->played = vp->culled = vp->stolen = vp->dropped = 0;
+
+	while(vp->count < capacity) {
+		struct voice* v = vp->voices + vp->count;
+
+		alGetError();
+		alGenSources(1, &v->source);
+
+		if(alGetError() != AL_NO_ERROR)
+			break;
+
+		alSourcef(v->source, AL_PITCH, 1.0F);
+		alSourcef(v->source, AL_GAIN, 1.0F);
+		alSourcei(v->source, AL_LOOPING, AL_FALSE);
+		vp->count++;
+	}
+}
+
+void voicepool_destroy(struct voicepool* vp) {
+	assert(vp != NULL);
+
+	for(size_t k = 0; k < vp->count; k++) {
+		alSourceStop(vp->voices[k].source);
+		alDeleteSources(1, &vp->voices[k].source);
+	}
+
+	free(vp->voices);
+	vp->voices = NULL;
+	vp->count = 0;
+}
+
+void voicepool_listener(struct voicepool* vp, float x, float y, float z) {
+	assert(vp != NULL);
+
+	vp->listener[0] = x;
+	vp->listener[1] = y;
+	vp->listener[2] = z;
+}
+
+// loudness is the gain of AL_LINEAR_DISTANCE_CLAMPED, which is the model sound.c selects
+float voicepool_priority(const struct voicepool* vp, enum voice_category category, bool local, float x, float y,
+						 float z, float min, float max) {
+	assert(vp != NULL && category < VOICE_CATEGORIES);
+
+	if(local)
+		return voicepool_weight[category];
+
+	float dx = x - vp->listener[0];
+	float dy = y - vp->listener[1];
+	float dz = z - vp->listener[2];
+	float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+	if(distance >= max)
+		return 0.0F;
+
+	float gain = (distance <= min) ? 1.0F : 1.0F - (distance - min) / (max - min);
+	return voicepool_weight[category] * gain;
+}
+
+static bool voicepool_finished(struct voice* v) {
+	ALint state;
+	alGetSourcei(v->source, AL_SOURCE_STATE, &state);
+
+	if(state == AL_STOPPED)
+		v->active = false;
+
+	return !v->active;
+}
+
+static struct voice* voicepool_find(struct voicepool* vp, float priority) {
+	for(size_t k = 0; k < vp->count; k++) {
+		if(!vp->voices[k].active)
+			return vp->voices + k;
+	}
+
+	// voices that ended since they were last polled look busy, check all of them once per frame before stealing
+	if(!vp->swept) {
+		struct voice* finished = NULL;
+		vp->swept = true;
+
+		for(size_t k = 0; k < vp->count; k++) {
+			if(voicepool_finished(vp->voices + k) && !finished)
+				finished = vp->voices + k;
+		}
+
+		if(finished)
+			return finished;
+	}
+
+	struct voice* lowest = NULL;
+	float lowest_priority = priority;
+
+	for(size_t k = 0; k < vp->count; k++) {
+		struct voice* v = vp->voices + k;
+		float p = voicepool_priority(vp, v->category, v->local, v->x, v->y, v->z, v->min, v->max);
+
+		if(p < lowest_priority) {
+			lowest = v;
+			lowest_priority = p;
+		}
+	}
+
+	if(lowest) {
+		alSourceStop(lowest->source);
+		lowest->active = false;
+		vp->stolen++;
+	}
+
+	return lowest;
+}
+
+struct voice* voicepool_play(struct voicepool* vp, unsigned int buffer, enum voice_category category, bool local,
+							 float x, float y, float z, float min, float max, int owner) {
+	assert(vp != NULL);
+
+	float priority = voicepool_priority(vp, category, local, x, y, z, min, max);
+
+	if(priority <= 0.0F) {
+		vp->culled++;
+		return NULL;
+	}
+
+	struct voice* v = voicepool_find(vp, priority);
+
+	if(!v) {
+		vp->dropped++;
+		return NULL;
+	}
+
+	*v = (struct voice) {
+		.source = v->source,
+		.local = local,
+		.category = category,
+		.x = x,
+		.y = y,
+		.z = z,
+		.min = min,
+		.max = max,
+		.owner = owner,
+	};
+
+	alGetError();
+	alSourcef(v->source, AL_REFERENCE_DISTANCE, local ? 0.0F : min);
+	alSourcef(v->source, AL_MAX_DISTANCE, local ? 2048.0F : max);
+	alSource3f(v->source, AL_POSITION, local ? 0.0F : x, local ? 0.0F : y, local ? 0.0F : z);
+	alSource3f(v->source, AL_VELOCITY, 0.0F, 0.0F, 0.0F);
+	alSourcei(v->source, AL_SOURCE_RELATIVE, local);
+	alSourcei(v->source, AL_BUFFER, buffer);
+	alSourcePlay(v->source);
+
+	if(alGetError() != AL_NO_ERROR) {
+		vp->dropped++;
+		return NULL;
+	}
+
+	v->active = true;
+	vp->played++;
+	return v;
+}
+
+void voicepool_move(struct voice* v, float x, float y, float z, float vx, float vy, float vz) {
+	assert(v != NULL);
+
+	if(v->local)
+		return;
+
+	v->x = x;
+	v->y = y;
+	v->z = z;
+	alSource3f(v->source, AL_POSITION, x, y, z);
+	alSource3f(v->source, AL_VELOCITY, vx, vy, vz);
+}
+
+void voicepool_stop(struct voicepool* vp, struct voice* v) {
+	assert(vp != NULL && v != NULL);
+
+	alSourceStop(v->source);
+	v->active = false;
+}
+
+void voicepool_update(struct voicepool* vp, size_t polls, bool (*update)(struct voice* v, void* user), void* user) {
+	assert(vp != NULL);
+
+	if(!vp->count)
+		return;
+
+	vp->swept = false;
+
+	for(size_t k = 0; k < polls && k < vp->count; k++) {
+		struct voice* v = vp->voices + vp->poll;
+		vp->poll = (vp->poll + 1) % vp->count;
+
+		if(v->active)
+			voicepool_finished(v);
+	}
+
+	if(update) {
+		for(size_t k = 0; k < vp->count; k++) {
+			struct voice* v = vp->voices + k;
+
+			if(v->active && !update(v, user))
+				voicepool_stop(vp, v);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+/*
+	Copyright (c) 2017-2020 ByteBit
+
+	This file is part of BetterSpades.
+
+	BetterSpades is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	BetterSpades is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with BetterSpades.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef VOICEPOOL_H
+#define VOICEPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+enum voice_category {
+	VOICE_AMBIENT, // footsteps, wading, debris
+	VOICE_EFFECT,
+	VOICE_WEAPON,
+	VOICE_ALERT, // interface and game state, never stolen by the others
+	VOICE_CATEGORIES,
+};
+
+// one OpenAL source that is generated once and reused for every sound it plays
+struct voice {
+	unsigned int source;
+	bool active;
+	bool local;
+	enum voice_category category;
+	float x, y, z;
+	float min, max; // reference and max distance of the linear clamped model
+	int owner;		// free for the caller, e.g. a player the voice follows
+};
+
+struct voicepool {
+	struct voice* voices;
+	size_t count;
+	size_t poll;
+	bool swept; // all voices were polled since the last update
+	float listener[3];
+	size_t played, culled, stolen, dropped;
+};
+
+// generates up to capacity sources, fewer if the device runs out of them
+void voicepool_create(struct voicepool* vp, size_t capacity);
+void voicepool_destroy(struct voicepool* vp);
+void voicepool_listener(struct voicepool* vp, float x, float y, float z);
+// how much a sound would be heard right now weighted by its category, zero for inaudible ones
+float voicepool_priority(const struct voicepool* vp, enum voice_category category, bool local, float x, float y,
+						 float z, float min, float max);
+// inaudible sounds are culled before they get a voice, a full pool hands over its lowest priority voice
+// if that one ranks below the new sound, returns NULL when nothing was played
+struct voice* voicepool_play(struct voicepool* vp, unsigned int buffer, enum voice_category category, bool local,
+							 float x, float y, float z, float min, float max, int owner);
+void voicepool_move(struct voice* v, float x, float y, float z, float vx, float vy, float vz);
+void voicepool_stop(struct voicepool* vp, struct voice* v);
+// asks OpenAL for the state of at most polls voices (round robin) and releases finished ones,
+// then calls update() on every active voice, returning false from it stops the voice
+void voicepool_update(struct voicepool* vp, size_t polls, bool (*update)(struct voice* v, void* user), void* user);
+
+#endif
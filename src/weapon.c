@@ -232,16 +232,27 @@ void weapon_shoot() {
 	// https://pastebin.com/raw/TMjKSTXG
 	// http://paste.quacknet.org/view/a3ea2743
 
-	for(int i = 0; i < ((players[local_player_id].weapon == WEAPON_SHOTGUN) ? 8 : 1); i++) {
-		float o[3] = {players[local_player_id].orientation.x, players[local_player_id].orientation.y,
-					  players[local_player_id].orientation.z};
+	int pellets = (players[local_player_id].weapon == WEAPON_SHOTGUN) ? 8 : 1;
+	float spread[8 * 3];
+
+	for(int i = 0; i < pellets; i++) {
+		float* o = spread + i * 3;
+		o[0] = players[local_player_id].orientation.x;
+		o[1] = players[local_player_id].orientation.y;
+		o[2] = players[local_player_id].orientation.z;
 
 		weapon_spread(&players[local_player_id], o);
+	}
 
-		struct Camera_HitType hit;
-		camera_hit(&hit, local_player_id, players[local_player_id].physics.eye.x,
-				   players[local_player_id].physics.eye.y + player_height(&players[local_player_id]),
-				   players[local_player_id].physics.eye.z, o[0], o[1], o[2], 128.0F);
+	// all pellets are tested against the same cached hitboxes at once
+	struct Camera_HitType hits[8];
+	camera_hit_batch(hits, local_player_id, players[local_player_id].physics.eye.x,
+					 players[local_player_id].physics.eye.y + player_height(&players[local_player_id]),
+					 players[local_player_id].physics.eye.z, spread, pellets, 128.0F);
+
+	for(int i = 0; i < pellets; i++) {
+		float* o = spread + i * 3;
+		struct Camera_HitType hit = hits[i];
 
 		if(players[local_player_id].input.buttons.packed != network_buttons_last) {
 			struct PacketWeaponInput in;
@@ -97,6 +97,8 @@ enum window_keys {
 	WINDOW_KEY_MEDKIT,
 	WINDOW_KEY_CUSTOM_MACRO,
 	WINDOW_KEY_CUSTOM_MACRO2,
+	WINDOW_KEY_PROFILER,
+	WINDOW_KEY_PROFILER_TRACE,
 };
 
 enum {